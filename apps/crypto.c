@@ -15,6 +15,7 @@
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/keys.h>
+#include <xmlsec/keysmngr.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/errors.h>
 
@@ -71,6 +72,21 @@ xmlSecAppCryptoSimpleKeysMngrSave(xmlSecKeysMngrPtr mngr, const char *filename,
     return(xmlSecCryptoAppDefaultKeysMngrSave(mngr, filename, type));
 }
 
+int
+xmlSecAppCryptoSimpleKeysMngrSaveBinary(xmlSecKeysMngrPtr mngr, const char *filename, xmlSecKeyDataType type) {
+    xmlSecKeyStorePtr store;
+
+    xmlSecAssert2(mngr != NULL, -1);
+    xmlSecAssert2(filename != NULL, -1);
+
+    store = xmlSecKeysMngrGetKeysStore(mngr);
+    if((store == NULL) || !xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId)) {
+        fprintf(stderr, "Error: binary keys files are supported only by the simple keys store\n");
+        return(-1);
+    }
+    return(xmlSecSimpleKeysStoreSaveBinary(store, filename, type));
+}
+
 int 
 xmlSecAppCryptoSimpleKeysMngrCertLoad(xmlSecKeysMngrPtr mngr, const char *filename, 
                                       xmlSecKeyDataFormat format, xmlSecKeyDataType type) {
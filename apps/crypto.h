@@ -38,6 +38,9 @@ int     xmlSecAppCryptoSimpleKeysMngrLoad                       (xmlSecKeysMngrP
 int     xmlSecAppCryptoSimpleKeysMngrSave                       (xmlSecKeysMngrPtr mngr, 
                                                                  const char *filename,
                                                                  xmlSecKeyDataType type);
+int     xmlSecAppCryptoSimpleKeysMngrSaveBinary                 (xmlSecKeysMngrPtr mngr,
+                                                                 const char *filename,
+                                                                 xmlSecKeyDataType type);
 int     xmlSecAppCryptoSimpleKeysMngrCertLoad                   (xmlSecKeysMngrPtr mngr, 
                                                                  const char *filename, 
                                                                  xmlSecKeyDataFormat format,
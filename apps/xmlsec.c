@@ -62,7 +62,8 @@ static const char helpCommands1[] =
     "  --help-all  "    "\tdisplay help information for all commands/options and exit\n"
     "  --help-<cmd>"    "\tdisplay help information for command <cmd> and exit\n"
     "  --version   "    "\tprint version information and exit\n"
-    "  --keys      "    "\tkeys XML file manipulation\n";
+    "  --keys      "    "\tkeys XML file manipulation\n"
+    "  --keys-binary"   "\tbinary keys file manipulation\n";
 
 static const char helpCommands2[] =     
 #ifndef XMLSEC_NO_XMLDSIG
@@ -85,6 +86,11 @@ static const char helpVersion[] =
 static const char helpKeys[] =     
     "Usage: xmlsec keys [<options>] <file>\n"
     "Creates a new XML keys file <file>\n";
+
+static const char helpKeysBinary[] =
+    "Usage: xmlsec keys-binary [<options>] <file>\n"
+    "Creates a new binary keys file <file> (use \"--keys-file\" to convert\n"
+    "an XML keys file and \"keys\" command to convert it back)\n";
     
 static const char helpSign[] =     
     "Usage: xmlsec sign [<options>] <file>\n"
@@ -240,7 +246,7 @@ static xmlSecAppCmdLineParam keysFileParam = {
     "--keys-file",
     "-k",
     "--keys-file <file>"
-    "\n\tload keys from XML file",
+    "\n\tload keys from XML or binary keys file",
     xmlSecAppCmdLineParamTypeString,
     xmlSecAppCmdLineParamFlagMultipleValues,
     NULL
@@ -393,6 +399,18 @@ static xmlSecAppCmdLineParam enabledRetrievalMethodUrisParam = {
     NULL
 };
 
+static xmlSecAppCmdLineParam sharedKeysParam = { 
+    xmlSecAppCmdLineTopicKeysMngr,
+    "--shared-keys",
+    NULL,
+    "--shared-keys"
+    "\n\tuse the keys found in the keys manager without copying them"
+    "\n\t(the keys are shared with the keys store)",
+    xmlSecAppCmdLineParamTypeFlag,
+    xmlSecAppCmdLineParamFlagNone,
+    NULL
+};
+
 /****************************************************************
  *
  * Common params
@@ -608,6 +626,31 @@ static xmlSecAppCmdLineParam enableVisa3DHackParam = {
     NULL
 };
 
+static xmlSecAppCmdLineParam verifySignatureFirstParam = { 
+    xmlSecAppCmdLineTopicDSigVerify,
+    "--verify-signature-first",
+    NULL,
+    "--verify-signature-first"
+    "\n\tverify <dsig:SignatureValue/> before processing <dsig:Reference/>"
+    "\n\telements and skip them if the signature is invalid",
+    xmlSecAppCmdLineParamTypeFlag,
+    xmlSecAppCmdLineParamFlagNone,
+    NULL
+};
+
+static xmlSecAppCmdLineParam parallelReferencesParam = { 
+    xmlSecAppCmdLineTopicDSigVerify,
+    "--parallel-references",
+    NULL,
+    "--parallel-references"
+    "\n\tprocess <dsig:Reference/> elements in <dsig:SignedInfo/> as one batch;"
+    "\n\tthe batch is executed in the reverse order (the result must be"
+    "\n\tthe same as without this option)",
+    xmlSecAppCmdLineParamTypeFlag,
+    xmlSecAppCmdLineParamFlagNone,
+    NULL
+};
+
 #endif /* XMLSEC_NO_XMLDSIG */
 
 /****************************************************************
@@ -650,6 +693,19 @@ static xmlSecAppCmdLineParam xmlDataParam = {
     xmlSecAppCmdLineParamFlagNone,
     NULL
 };
+
+static xmlSecAppCmdLineParam streamCipherValueParam = {
+    xmlSecAppCmdLineTopicEncEncrypt,
+    "--stream-cipher-value",
+    NULL,
+    "--stream-cipher-value"
+    "\n\twrite the encrypted in-memory data (\"encrypt-tmpl\" command)"
+    "\n\tdirectly to <enc:CipherValue/> node in chunks (the result"
+    "\n\tbuffer is left empty)",
+    xmlSecAppCmdLineParamTypeFlag,
+    xmlSecAppCmdLineParamFlagNone,
+    NULL
+};
 #endif /* XMLSEC_NO_XMLENC */
 
 
@@ -801,6 +857,8 @@ static xmlSecAppCmdLineParamPtr parameters[] = {
     &storeSignaturesParam,
     &enabledRefUrisParam,
     &enableVisa3DHackParam,
+    &verifySignatureFirstParam,
+    &parallelReferencesParam,
 #endif /* XMLSEC_NO_XMLDSIG */
 
     /* enc params */
@@ -808,6 +866,7 @@ static xmlSecAppCmdLineParamPtr parameters[] = {
     &binaryDataParam,
     &xmlDataParam,
     &enabledCipherRefUrisParam,
+    &streamCipherValueParam,
 #endif /* XMLSEC_NO_XMLENC */
              
     /* common dsig and enc parameters */
@@ -824,6 +883,7 @@ static xmlSecAppCmdLineParamPtr parameters[] = {
     /* Keys Manager params */
     &enabledKeyDataParam,
     &enabledRetrievalMethodUrisParam,
+    &sharedKeysParam,
     &genKeyParam,
     &keysFileParam,
     &privkeyParam,
@@ -880,6 +940,7 @@ typedef enum {
     xmlSecAppCommandCheckTransforms,    
     xmlSecAppCommandVersion,
     xmlSecAppCommandKeys,
+    xmlSecAppCommandKeysBinary,
     xmlSecAppCommandSign,
     xmlSecAppCommandVerify,
     xmlSecAppCommandSignTmpl,
@@ -921,6 +982,10 @@ static int                      xmlSecAppSignTmpl               (void);
 #endif /* XMLSEC_NO_TMPL_TEST */
 static int                      xmlSecAppPrepareDSigCtx         (xmlSecDSigCtxPtr dsigCtx);
 static void                     xmlSecAppPrintDSigCtx           (xmlSecDSigCtxPtr dsigCtx);
+static int                      xmlSecAppReferencesExecutor     (xmlSecDSigCtxPtr dsigCtx,
+                                                                 xmlSecDSigReferenceTaskMethod method,
+                                                                 void** tasks,
+                                                                 xmlSecSize tasksSize);
 #endif /* XMLSEC_NO_XMLDSIG */
 
 #ifndef XMLSEC_NO_XMLENC
@@ -1038,6 +1103,7 @@ int main(int argc, const char **argv) {
     /* we need to have some files at the end */
     switch(command) {
         case xmlSecAppCommandKeys:
+        case xmlSecAppCommandKeysBinary:
         case xmlSecAppCommandSign:
         case xmlSecAppCommandVerify:
         case xmlSecAppCommandEncrypt:
@@ -1129,6 +1195,14 @@ int main(int argc, const char **argv) {
                 }
             }
             break;
+        case xmlSecAppCommandKeysBinary:
+            for(i = pos; i < argc; ++i) {
+                if(xmlSecAppCryptoSimpleKeysMngrSaveBinary(gKeysMngr, utf8_argv[i], xmlSecKeyDataTypeAny) < 0) {
+                    fprintf(stderr, "Error: failed to save keys to binary file \"%s\"\n", utf8_argv[i]);
+                    goto fail;
+                }
+            }
+            break;
 #ifndef XMLSEC_NO_XMLDSIG
         case xmlSecAppCommandSign:
             for(i = pos; i < argc; ++i) {
@@ -1549,6 +1623,13 @@ xmlSecAppPrepareDSigCtx(xmlSecDSigCtxPtr dsigCtx) {
     if(xmlSecAppCmdLineParamIsSet(&enableVisa3DHackParam)) {
         dsigCtx->flags |= XMLSEC_DSIG_FLAGS_USE_VISA3D_HACK; 
     }
+    if(xmlSecAppCmdLineParamIsSet(&verifySignatureFirstParam)) {
+        dsigCtx->flags |= XMLSEC_DSIG_FLAGS_VERIFY_SIGNATURE_FIRST;
+    }
+    if(xmlSecAppCmdLineParamIsSet(&parallelReferencesParam)) {
+        dsigCtx->flags |= XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES;
+        dsigCtx->referencesExecutor = xmlSecAppReferencesExecutor;
+    }
     
     if(xmlSecAppCmdLineParamGetStringList(&enabledRefUrisParam) != NULL) {
         dsigCtx->enabledReferenceUris = xmlSecAppGetUriType(
@@ -1563,6 +1644,20 @@ xmlSecAppPrepareDSigCtx(xmlSecDSigCtxPtr dsigCtx) {
     return(0);
 }
 
+/* runs the tasks backwards in the calling thread: the batch result must not
+ * depend on the order (the xmlsec1 app never runs the tasks concurrently) */
+static int
+xmlSecAppReferencesExecutor(xmlSecDSigCtxPtr dsigCtx ATTRIBUTE_UNUSED,
+                            xmlSecDSigReferenceTaskMethod method,
+                            void** tasks, xmlSecSize tasksSize) {
+    xmlSecSize ii;
+
+    for(ii = tasksSize; ii > 0; --ii) {
+        method(tasks[ii - 1]);
+    }
+    return(0);
+}
+
 static void
 xmlSecAppPrintDSigCtx(xmlSecDSigCtxPtr dsigCtx) { 
     if(dsigCtx == NULL) {
@@ -1858,6 +1953,10 @@ xmlSecAppPrepareEncCtx(xmlSecEncCtxPtr encCtx) {
             return(-1);
         }
     }
+
+    if(xmlSecAppCmdLineParamIsSet(&streamCipherValueParam)) {
+        encCtx->flags |= XMLSEC_ENC_STREAM_CIPHER_VALUE;
+    }
     return(0);
 }
 
@@ -1934,6 +2033,10 @@ xmlSecAppPrepareKeyInfoReadCtx(xmlSecKeyInfoCtxPtr keyInfoCtx) {
     }
 #endif /* XMLSEC_NO_X509 */
 
+    if(xmlSecAppCmdLineParamIsSet(&sharedKeysParam)) {
+        keyInfoCtx->flags |= XMLSEC_KEYINFO_FLAGS_SHARED_KEYS;
+    }
+
     /* read enabled key data list */
     for(value = enabledKeyDataParam.value; value != NULL; value = value->next) {
         if(value->strListValue == NULL) {
@@ -2776,6 +2879,15 @@ xmlSecAppParseCommand(const char* cmd, xmlSecAppCmdLineParamTopic* cmdLineTopics
                         xmlSecAppCmdLineTopicX509Certs;
         return(xmlSecAppCommandKeys);
     } else 
+
+    if((strcmp(cmd, "keys-binary") == 0) || (strcmp(cmd, "--keys-binary") == 0)) {
+        (*cmdLineTopics) = 
+                        xmlSecAppCmdLineTopicGeneral | 
+                        xmlSecAppCmdLineTopicCryptoConfig |
+                        xmlSecAppCmdLineTopicKeysMngr |
+                        xmlSecAppCmdLineTopicX509Certs;
+        return(xmlSecAppCommandKeysBinary);
+    } else 
     
 #ifndef XMLSEC_NO_XMLDSIG
     if((strcmp(cmd, "sign") == 0) || (strcmp(cmd, "--sign") == 0)) {
@@ -2885,6 +2997,9 @@ xmlSecAppPrintHelp(xmlSecAppCommand command, xmlSecAppCmdLineParamTopic topics)
     case xmlSecAppCommandKeys:
         fprintf(stdout, "%s\n", helpKeys);
         break;
+    case xmlSecAppCommandKeysBinary:
+        fprintf(stdout, "%s\n", helpKeysBinary);
+        break;
     case xmlSecAppCommandSign:
         fprintf(stdout, "%s\n", helpSign);
         break;
@@ -154,6 +154,15 @@ typedef enum {
  */
 #define XMLSEC_KEYINFO_FLAGS_X509DATA_SKIP_STRICT_CHECKS        0x00004000
 
+/**
+ * XMLSEC_KEYINFO_FLAGS_SHARED_KEYS:
+ *
+ * If the flag is set then the keys found in the keys manager are not
+ * copied: the keys store returns the key shared with the store (see
+ * #xmlSecKeyRef) and the caller must not modify it.
+ */
+#define XMLSEC_KEYINFO_FLAGS_SHARED_KEYS                        0x00008000
+
 /**
  * xmlSecKeyInfoCtx:
  * @userData:           the pointer to user data (xmlsec and xmlsec-crypto
@@ -188,6 +188,7 @@ XMLSEC_EXPORT xmlSecKeyPtr      xmlSecKeyCreate         (void);
 XMLSEC_EXPORT void              xmlSecKeyDestroy        (xmlSecKeyPtr key);
 XMLSEC_EXPORT void              xmlSecKeyEmpty          (xmlSecKeyPtr key);
 XMLSEC_EXPORT xmlSecKeyPtr      xmlSecKeyDuplicate      (xmlSecKeyPtr key);
+XMLSEC_EXPORT xmlSecKeyPtr      xmlSecKeyRef            (xmlSecKeyPtr key);
 XMLSEC_EXPORT int               xmlSecKeyCopy           (xmlSecKeyPtr keyDst,
                                                          xmlSecKeyPtr keySrc);
 
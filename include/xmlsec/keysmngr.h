@@ -253,6 +253,12 @@ XMLSEC_EXPORT int                       xmlSecSimpleKeysStoreLoad       (xmlSecK
 XMLSEC_EXPORT int                       xmlSecSimpleKeysStoreSave       (xmlSecKeyStorePtr store,
                                                                          const char *filename,
                                                                          xmlSecKeyDataType type);
+XMLSEC_EXPORT int                       xmlSecSimpleKeysStoreLoadBinary (xmlSecKeyStorePtr store,
+                                                                         const char *filename,
+                                                                         xmlSecKeysMngrPtr keysMngr);
+XMLSEC_EXPORT int                       xmlSecSimpleKeysStoreSaveBinary (xmlSecKeyStorePtr store,
+                                                                         const char *filename,
+                                                                         xmlSecKeyDataType type);
 XMLSEC_EXPORT xmlSecPtrListPtr          xmlSecSimpleKeysStoreGetKeys    (xmlSecKeyStorePtr store);
 
 
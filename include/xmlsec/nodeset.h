@@ -123,6 +123,9 @@ XMLSEC_EXPORT xmlSecNodeSetPtr  xmlSecNodeSetGetChildren(xmlDocPtr doc,
                                                          const xmlNodePtr parent,
                                                          int withComments,
                                                          int invert);
+XMLSEC_EXPORT int               xmlSecNodeSetIsWholeDocument(xmlSecNodeSetPtr nset);
+XMLSEC_EXPORT xmlNodePtr        xmlSecNodeSetGetExcludedSubtree(xmlSecNodeSetPtr nset,
+                                                         int* withComments);
 XMLSEC_EXPORT int               xmlSecNodeSetWalk       (xmlSecNodeSetPtr nset,
                                                          xmlSecNodeSetWalkCallback walkFunc,
                                                          void* data);
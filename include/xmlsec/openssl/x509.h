@@ -62,6 +62,13 @@ XMLSEC_CRYPTO_EXPORT xmlSecSize         xmlSecOpenSSLKeyDataX509GetCrlsSize(xmlS
 
 XMLSEC_CRYPTO_EXPORT xmlSecKeyDataPtr   xmlSecOpenSSLX509CertGetKey     (X509* cert);
 
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509CertsCacheInit (void);
+XMLSEC_CRYPTO_EXPORT void               xmlSecOpenSSLX509CertsCacheShutdown(void);
+XMLSEC_CRYPTO_EXPORT void               xmlSecOpenSSLX509CertsCacheSetMaxSize(xmlSecSize maxSize);
+XMLSEC_CRYPTO_EXPORT void               xmlSecOpenSSLX509CertsCacheGetStats(xmlSecSize* size,
+                                                                         xmlSecSize* hits,
+                                                                         xmlSecSize* misses);
+
 
 /**
  * xmlSecOpenSSLKeyDataRawX509CertId:
@@ -95,10 +102,14 @@ XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreAdoptCert (xmlSecK
                                                                          xmlSecKeyDataType type);
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreAdoptCrl  (xmlSecKeyDataStorePtr store,
                                                                          X509_CRL* crl);
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreReplaceCrls(xmlSecKeyDataStorePtr store,
+                                                                         XMLSEC_STACK_OF_X509_CRL* crls);
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreAddCertsPath(xmlSecKeyDataStorePtr store,
                                                                          const char* path);
 XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreAddCertsFile(xmlSecKeyDataStorePtr store,
                                                                          const char* filename);
+XMLSEC_CRYPTO_EXPORT int                xmlSecOpenSSLX509StoreSetVerifyCacheSize(xmlSecKeyDataStorePtr store,
+                                                                         xmlSecSize maxSize);
 
 #endif /* XMLSEC_NO_X509 */
 
@@ -32,6 +32,23 @@ XMLSEC_EXPORT xmlDocPtr         xmlSecParseMemoryExt    (const xmlSecByte *prefi
                                                          const xmlSecByte *postfix,
                                                          xmlSecSize postfixSize);
 
+/**
+ * XMLSEC_PARSER_POOL_DEFAULT_MAX_SIZE:
+ *
+ * The default max number of libxml2 parser contexts kept for reuse
+ * in the process-wide parser contexts pool: the pool is disabled by
+ * default, use #xmlSecParserPoolSetMaxSize to enable it.
+ */
+#define XMLSEC_PARSER_POOL_DEFAULT_MAX_SIZE             0
+
+XMLSEC_EXPORT int               xmlSecParserPoolInit    (void);
+XMLSEC_EXPORT void              xmlSecParserPoolShutdown(void);
+XMLSEC_EXPORT void              xmlSecParserPoolSetMaxSize
+                                                        (xmlSecSize maxSize);
+XMLSEC_EXPORT void              xmlSecParserPoolGetStats(xmlSecSize* size,
+                                                         xmlSecSize* hits,
+                                                         xmlSecSize* misses);
+
 
 /**
  * xmlSecTransformXmlParserId:
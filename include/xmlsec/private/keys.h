@@ -0,0 +1,30 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * Keys helper functions
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_PRIVATE_KEYS_H__
+#define __XMLSEC_PRIVATE_KEYS_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "xmlsec/private/keys.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+int  xmlSecKeysInitialize                                   (void);
+void xmlSecKeysShutdown                                     (void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_PRIVATE_KEYS_H__ */
+
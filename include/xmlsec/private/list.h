@@ -0,0 +1,54 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * List index helper functions
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_PRIVATE_LIST_H__
+#define __XMLSEC_PRIVATE_LIST_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "xmlsec/private/list.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <libxml/hash.h>
+
+#include <xmlsec/xmlsec.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * The list index maps a (name, name2) pair to the positions of the matching
+ * items in a #xmlSecPtrList (or any other positional container), in the
+ * order they were added to the index.
+ */
+XMLSEC_EXPORT int       xmlSecPtrListIndexAdd           (xmlHashTablePtr* index,
+                                                         const xmlChar* name,
+                                                         const xmlChar* name2,
+                                                         xmlSecSize pos);
+XMLSEC_EXPORT const xmlSecSize* xmlSecPtrListIndexLookup(xmlHashTablePtr index,
+                                                         const xmlChar* name,
+                                                         const xmlChar* name2,
+                                                         xmlSecSize* count);
+XMLSEC_EXPORT void      xmlSecPtrListIndexDestroy       (xmlHashTablePtr index);
+
+/*
+ * The changes counter of a process-wide list allows to check that an index
+ * built for the list is still up to date: it is incremented every time
+ * the list items are added, replaced or removed.
+ */
+XMLSEC_EXPORT int       xmlSecPtrListTrackChanges       (xmlSecPtrListPtr list);
+XMLSEC_EXPORT void      xmlSecPtrListUntrackChanges     (xmlSecPtrListPtr list);
+XMLSEC_EXPORT xmlSecSize xmlSecPtrListGetChanges        (xmlSecPtrListPtr list);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_PRIVATE_LIST_H__ */
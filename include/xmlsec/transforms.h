@@ -949,6 +949,19 @@ XMLSEC_EXPORT int               xmlSecTransformXPointerSetExpr          (xmlSecT
                                                                          const xmlChar* expr,
                                                                          xmlSecNodeSetType nodeSetType,
                                                                          xmlNodePtr hereNode);
+
+/**
+ * XMLSEC_TRANSFORM_XPATH_CACHE_DEFAULT_MAX_SIZE:
+ *
+ * The default max number of compiled expressions in the process-wide
+ * XPath/XPointer expressions cache.
+ */
+#define XMLSEC_TRANSFORM_XPATH_CACHE_DEFAULT_MAX_SIZE           256
+
+XMLSEC_EXPORT void              xmlSecTransformXPathCacheSetMaxSize     (xmlSecSize maxSize);
+XMLSEC_EXPORT void              xmlSecTransformXPathCacheGetStats       (xmlSecSize* size,
+                                                                         xmlSecSize* hits,
+                                                                         xmlSecSize* misses);
 /**
  * xmlSecTransformRelationshipId:
  *
@@ -970,6 +983,19 @@ XMLSEC_EXPORT xmlSecTransformId xmlSecTransformRelationshipGetKlass     (void);
         xmlSecTransformXsltGetKlass()
 XMLSEC_EXPORT xmlSecTransformId xmlSecTransformXsltGetKlass             (void);
 XMLSEC_EXPORT void              xmlSecTransformXsltSetDefaultSecurityPrefs(xsltSecurityPrefsPtr sec);
+
+/**
+ * XMLSEC_TRANSFORM_XSLT_CACHE_DEFAULT_MAX_SIZE:
+ *
+ * The default max number of compiled stylesheets in the process-wide
+ * XSLT stylesheets cache.
+ */
+#define XMLSEC_TRANSFORM_XSLT_CACHE_DEFAULT_MAX_SIZE            32
+
+XMLSEC_EXPORT void              xmlSecTransformXsltCacheSetMaxSize      (xmlSecSize maxSize);
+XMLSEC_EXPORT void              xmlSecTransformXsltCacheGetStats        (xmlSecSize* size,
+                                                                         xmlSecSize* hits,
+                                                                         xmlSecSize* misses);
 #endif /* XMLSEC_NO_XSLT */
 
 /**
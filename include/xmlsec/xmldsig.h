@@ -94,6 +94,64 @@ typedef enum {
  */
 #define XMLSEC_DSIG_FLAGS_USE_VISA3D_HACK                       0x00000010
 
+/**
+ * XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES:
+ *
+ * If this flag is set then during signature verification all the
+ * <dsig:Reference/> children of <dsig:SignedInfo/> element are read first
+ * and their transforms are executed as one batch using the
+ * #xmlSecDSigCtx::referencesExecutor (if it is set), which might run them
+ * concurrently. The results are merged in document order and the processing
+ * status is the same as without this flag. The document must not be modified
+ * by the application while the references are executed. The flag is ignored
+ * when signing since a reference might digest the <dsig:DigestValue/> node
+ * written by a previous one.
+ */
+#define XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES                   0x00000020
+
+/**
+ * XMLSEC_DSIG_FLAGS_VERIFY_SIGNATURE_FIRST:
+ *
+ * If this flag is set then the <dsig:SignatureValue/> is verified over
+ * <dsig:SignedInfo/> element before the <dsig:Reference/> elements are
+ * processed and the references are skipped if the signature is invalid.
+ * The #xmlSecDSigCtx::signedInfoReferences list is empty for such
+ * signatures. The final status is the same as without this flag unless
+ * processing of a <dsig:Reference/> element would fail: in this case
+ * the signature is reported as invalid (#xmlSecDSigStatusInvalid)
+ * instead of returning an error because the references are never
+ * processed.
+ */
+#define XMLSEC_DSIG_FLAGS_VERIFY_SIGNATURE_FIRST                0x00000040
+
+/**
+ * xmlSecDSigReferenceTaskMethod:
+ * @task:                       the opaque <dsig:Reference/> processing task.
+ *
+ * Executes the transforms of one <dsig:Reference/> element. The outcome
+ * is recorded in the @task itself.
+ */
+typedef void            (*xmlSecDSigReferenceTaskMethod)        (void* task);
+
+/**
+ * xmlSecDSigReferencesExecutor:
+ * @dsigCtx:                    the pointer to <dsig:Signature/> processing context.
+ * @method:                     the task execution method.
+ * @tasks:                      the array of tasks.
+ * @tasksSize:                  the number of tasks in @tasks array.
+ *
+ * Calls @method for each task in @tasks array, in any order and possibly
+ * from several threads at once, and waits until all of them are completed
+ * (see #XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES flag). The executor must not
+ * return before every started task is completed, even on error.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+typedef int             (*xmlSecDSigReferencesExecutor)         (xmlSecDSigCtxPtr dsigCtx,
+                                                                 xmlSecDSigReferenceTaskMethod method,
+                                                                 void** tasks,
+                                                                 xmlSecSize tasksSize);
+
 /**
  * xmlSecDSigCtx:
  * @userData:                   the pointer to user data (xmlsec and xmlsec-crypto libraries
@@ -123,7 +181,10 @@ typedef enum {
  * @id:                         the pointer to Id attribute of <dsig:Signature/> node.
  * @signedInfoReferences:       the list of references in <dsig:SignedInfo/> node.
  * @manifestReferences:         the list of references in <dsig:Manifest/> nodes.
- * @reserved0:                  reserved for the future.
+ * @referencesExecutor:         the executor for <dsig:Reference/> elements
+ *                              (used only if #XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES
+ *                              flag is set); takes the first reserved slot,
+ *                              so the structure layout is unchanged.
  * @reserved1:                  reserved for the future.
  *
  * XML DSig processing context.
@@ -155,9 +216,9 @@ struct _xmlSecDSigCtx {
     xmlChar*                    id;
     xmlSecPtrList               signedInfoReferences;
     xmlSecPtrList               manifestReferences;
+    xmlSecDSigReferencesExecutor referencesExecutor;
 
     /* reserved for future */
-    void*                       reserved0;
     void*                       reserved1;
 };
 
@@ -49,6 +49,14 @@ typedef enum {
  */
 #define XMLSEC_ENC_RETURN_REPLACED_NODE                 0x00000001
 
+/**
+ * XMLSEC_ENC_STREAM_CIPHER_VALUE:
+ *
+ * If this flag is set, then #xmlSecEncCtxBinaryEncrypt writes the base64 encoded
+ * data directly to <enc:CipherValue/> node in chunks and leaves #result empty.
+ */
+#define XMLSEC_ENC_STREAM_CIPHER_VALUE                  0x00000002
+
 /**
  * xmlSecEncCtx:
  * @userData:                   the pointer to user data (xmlsec and xmlsec-crypto libraries
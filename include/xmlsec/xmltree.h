@@ -95,6 +95,25 @@ XMLSEC_EXPORT xmlDocPtr         xmlSecCreateTree        (const xmlChar* rootNode
                                                          const xmlChar* rootNodeNs);
 XMLSEC_EXPORT int               xmlSecIsEmptyNode       (xmlNodePtr node);
 XMLSEC_EXPORT int               xmlSecIsEmptyString     (const xmlChar* str);
+
+/**
+ * xmlSecNodeContentWalkCallback:
+ * @content:            the pointer to the next piece of the node content.
+ * @contentSize:        the size of @content.
+ * @data:               the pointer to application specific data.
+ *
+ * The callback function called once per each text or CDATA node
+ * in the node content.
+ *
+ * Returns: 0 on success or a negative value if an error occurs
+ * and the walk procedure should be interrupted.
+ */
+typedef int (*xmlSecNodeContentWalkCallback)                (const xmlChar* content,
+                                                         xmlSecSize contentSize,
+                                                         void* data);
+XMLSEC_EXPORT int               xmlSecNodeContentWalk   (xmlNodePtr node,
+                                                         xmlSecNodeContentWalkCallback walkFunc,
+                                                         void* data);
 XMLSEC_EXPORT xmlChar*          xmlSecGetQName          (xmlNodePtr node,
                                                          const xmlChar* href,
                                                          const xmlChar* local);
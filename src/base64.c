@@ -62,6 +62,31 @@ static const xmlSecByte base64[] =
 #define xmlSecIsBase64Space(ch)         (((ch) == ' ') || ((ch) == '\t') || \
                                          ((ch) == '\x0d') || ((ch) == '\x0a'))
 
+/*
+ * the table to map base64 characters to numbers (-1 for everything else:
+ * spaces, '=' and invalid characters are handled by the state machine)
+ */
+static const signed char base64Reverse[] =
+{
+/*   0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F   */
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, /* 0 */
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, /* 1 */
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63, /* 2 */
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1, /* 3 */
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, /* 4 */
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1, /* 5 */
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, /* 6 */
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1, /* 7 */
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, /* 8 */
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, /* 9 */
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, /* A */
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, /* B */
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, /* C */
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, /* D */
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, /* E */
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1  /* F */
+};
+
 
 
 /***********************************************************************
@@ -94,6 +119,18 @@ static xmlSecBase64Status       xmlSecBase64CtxEncodeByteFinal  (xmlSecBase64Ctx
 static xmlSecBase64Status       xmlSecBase64CtxDecodeByte       (xmlSecBase64CtxPtr ctx,
                                                                  xmlSecByte inByte,
                                                                  xmlSecByte* outByte);
+static xmlSecSize               xmlSecBase64CtxEncodeBlocks     (xmlSecBase64CtxPtr ctx,
+                                                                 const xmlSecByte* inBuf,
+                                                                 xmlSecSize inBufSize,
+                                                                 xmlSecByte* outBuf,
+                                                                 xmlSecSize outBufSize,
+                                                                 xmlSecSize* outBufResSize);
+static xmlSecSize               xmlSecBase64CtxDecodeBlocks     (xmlSecBase64CtxPtr ctx,
+                                                                 const xmlSecByte* inBuf,
+                                                                 xmlSecSize inBufSize,
+                                                                 xmlSecByte* outBuf,
+                                                                 xmlSecSize outBufSize,
+                                                                 xmlSecSize* outBufResSize);
 static int                      xmlSecBase64CtxEncode           (xmlSecBase64CtxPtr ctx,
                                                                  const xmlSecByte* inBuf,
                                                                  xmlSecSize inBufSize,
@@ -442,13 +479,98 @@ xmlSecBase64CtxDecodeByte(xmlSecBase64CtxPtr ctx, xmlSecByte inByte, xmlSecByte*
     return(xmlSecBase64StatusFailed);
 }
 
+/*
+ * Encodes whole 3 bytes groups while the context is between groups
+ * and the group fits into the current line. Everything else (the line
+ * breaks inside a group, the tail of the input) is left to
+ * xmlSecBase64CtxEncodeByte(). Returns the number of consumed bytes.
+ */
+static xmlSecSize
+xmlSecBase64CtxEncodeBlocks(xmlSecBase64CtxPtr ctx,
+                     const xmlSecByte* inBuf, xmlSecSize inBufSize,
+                     xmlSecByte* outBuf, xmlSecSize outBufSize, xmlSecSize* outBufResSize) {
+    xmlSecSize inPos, outPos;
+    unsigned long val;
+
+    xmlSecAssert2(ctx != NULL, 0);
+    xmlSecAssert2(ctx->inPos == 0, 0);
+    xmlSecAssert2(inBuf != NULL, 0);
+    xmlSecAssert2(outBuf != NULL, 0);
+    xmlSecAssert2(outBufResSize != NULL, 0);
+
+    /* we might need 4 bytes for the group and 1 for the line break */
+    for(inPos = outPos = 0; (inPos + 3 <= inBufSize) && (outPos + 5 <= outBufSize); inPos += 3, outPos += 4) {
+        if(ctx->columns > 0) {
+            if(ctx->linePos >= ctx->columns) {
+                outBuf[outPos++] = '\n';
+                ctx->linePos = 0;
+            }
+            if(ctx->linePos + 4 > ctx->columns) {
+                break;
+            }
+        }
+
+        val = (((unsigned long)inBuf[inPos]) << 16) |
+              (((unsigned long)inBuf[inPos + 1]) << 8) |
+              ((unsigned long)inBuf[inPos + 2]);
+        outBuf[outPos]     = base64[(val >> 18) & 0x3F];
+        outBuf[outPos + 1] = base64[(val >> 12) & 0x3F];
+        outBuf[outPos + 2] = base64[(val >> 6) & 0x3F];
+        outBuf[outPos + 3] = base64[val & 0x3F];
+        ctx->linePos += 4;
+    }
+
+    (*outBufResSize) = outPos;
+    return(inPos);
+}
+
+/*
+ * Decodes whole groups of 4 base64 characters while the context is
+ * between groups. Stops at the first space, '=' or invalid character
+ * and leaves it to xmlSecBase64CtxDecodeByte(). Returns the number of
+ * consumed bytes.
+ */
+static xmlSecSize
+xmlSecBase64CtxDecodeBlocks(xmlSecBase64CtxPtr ctx,
+                     const xmlSecByte* inBuf, xmlSecSize inBufSize,
+                     xmlSecByte* outBuf, xmlSecSize outBufSize, xmlSecSize* outBufResSize) {
+    xmlSecSize inPos, outPos;
+    int a, b, c, d;
+    unsigned long val;
+
+    xmlSecAssert2(ctx != NULL, 0);
+    xmlSecAssert2(ctx->inPos == 0, 0);
+    xmlSecAssert2(ctx->finished == 0, 0);
+    xmlSecAssert2(inBuf != NULL, 0);
+    xmlSecAssert2(outBuf != NULL, 0);
+    xmlSecAssert2(outBufResSize != NULL, 0);
+
+    for(inPos = outPos = 0; (inPos + 4 <= inBufSize) && (outPos + 3 <= outBufSize); inPos += 4, outPos += 3) {
+        a = base64Reverse[inBuf[inPos]];
+        b = base64Reverse[inBuf[inPos + 1]];
+        c = base64Reverse[inBuf[inPos + 2]];
+        d = base64Reverse[inBuf[inPos + 3]];
+        if((a | b | c | d) < 0) {
+            break;
+        }
+
+        val = (((unsigned long)a) << 18) | (((unsigned long)b) << 12) |
+              (((unsigned long)c) << 6) | ((unsigned long)d);
+        outBuf[outPos]     = (xmlSecByte)((val >> 16) & 0xFF);
+        outBuf[outPos + 1] = (xmlSecByte)((val >> 8) & 0xFF);
+        outBuf[outPos + 2] = (xmlSecByte)(val & 0xFF);
+    }
+
+    (*outBufResSize) = outPos;
+    return(inPos);
+}
 
 static int
 xmlSecBase64CtxEncode(xmlSecBase64CtxPtr ctx,
                      const xmlSecByte* inBuf, xmlSecSize inBufSize, xmlSecSize* inBufResSize,
                      xmlSecByte* outBuf, xmlSecSize outBufSize, xmlSecSize* outBufResSize) {
     xmlSecBase64Status status = xmlSecBase64StatusNext;
-    xmlSecSize inPos, outPos;
+    xmlSecSize inPos, outPos, outSize;
 
     xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(inBuf != NULL, -1);
@@ -458,6 +580,17 @@ xmlSecBase64CtxEncode(xmlSecBase64CtxPtr ctx,
 
     /* encode */
     for(inPos = outPos = 0; (inPos < inBufSize) && (outPos < outBufSize); ) {
+        /* whole groups first */
+        if(ctx->inPos == 0) {
+            outSize = 0;
+            inPos += xmlSecBase64CtxEncodeBlocks(ctx, inBuf + inPos, inBufSize - inPos,
+                        outBuf + outPos, outBufSize - outPos, &outSize);
+            outPos += outSize;
+            if((inPos >= inBufSize) || (outPos >= outBufSize)) {
+                break;
+            }
+        }
+
         status = xmlSecBase64CtxEncodeByte(ctx, inBuf[inPos], &(outBuf[outPos]));
         switch(status) {
             case xmlSecBase64StatusConsumeAndNext:
@@ -526,7 +659,7 @@ xmlSecBase64CtxDecode(xmlSecBase64CtxPtr ctx,
                      const xmlSecByte* inBuf, xmlSecSize inBufSize, xmlSecSize* inBufResSize,
                      xmlSecByte* outBuf, xmlSecSize outBufSize, xmlSecSize* outBufResSize) {
     xmlSecBase64Status status = xmlSecBase64StatusNext;
-    xmlSecSize inPos, outPos;
+    xmlSecSize inPos, outPos, outSize;
 
     xmlSecAssert2(ctx != NULL, -1);
     xmlSecAssert2(inBuf != NULL, -1);
@@ -536,6 +669,17 @@ xmlSecBase64CtxDecode(xmlSecBase64CtxPtr ctx,
 
     /* decode */
     for(inPos = outPos = 0; (inPos < inBufSize) && (outPos < outBufSize) && (status != xmlSecBase64StatusDone); ) {
+        /* whole groups first */
+        if((ctx->inPos == 0) && (ctx->finished == 0)) {
+            outSize = 0;
+            inPos += xmlSecBase64CtxDecodeBlocks(ctx, inBuf + inPos, inBufSize - inPos,
+                        outBuf + outPos, outBufSize - outPos, &outSize);
+            outPos += outSize;
+            if((inPos >= inBufSize) || (outPos >= outBufSize)) {
+                break;
+            }
+        }
+
         status = xmlSecBase64CtxDecodeByte(ctx, inBuf[inPos], &(outBuf[outPos]));
         switch(status) {
             case xmlSecBase64StatusConsumeAndNext:
@@ -26,6 +26,7 @@
 #include <xmlsec/xmltree.h>
 #include <xmlsec/base64.h>
 #include <xmlsec/buffer.h>
+#include <xmlsec/private.h>
 #include <xmlsec/errors.h>
 
 /*****************************************************************************
@@ -480,83 +481,203 @@ xmlSecBufferReadFile(xmlSecBufferPtr buf, const char* filename) {
     return(0);
 }
 
+static int
+xmlSecBufferBase64NodeContentSizeCallback(const xmlChar* content ATTRIBUTE_UNUSED,
+                                          xmlSecSize contentSize, void* data) {
+    xmlSecAssert2(data != NULL, -1);
+    UNREFERENCED_PARAMETER(content);
+
+    (*((xmlSecSize*)data)) += contentSize;
+    return(0);
+}
+
+typedef struct _xmlSecBufferBase64NodeContentReadCtx {
+    xmlSecBase64CtxPtr          base64Ctx;
+    xmlSecBufferPtr             buf;
+} xmlSecBufferBase64NodeContentReadCtx;
+
+static int
+xmlSecBufferBase64NodeContentReadCallback(const xmlChar* content, xmlSecSize contentSize, void* data) {
+    xmlSecBufferBase64NodeContentReadCtx* ctx = (xmlSecBufferBase64NodeContentReadCtx*)data;
+    xmlSecSize size;
+    int ret;
+
+    xmlSecAssert2(content != NULL, -1);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->base64Ctx != NULL, -1);
+    xmlSecAssert2(ctx->buf != NULL, -1);
+
+    if(contentSize == 0) {
+        return(0);
+    }
+
+    size = xmlSecBufferGetSize(ctx->buf);
+    xmlSecAssert2(size <= xmlSecBufferGetMaxSize(ctx->buf), -1);
+    ret = xmlSecBase64CtxUpdate(ctx->base64Ctx, content, contentSize,
+                                xmlSecBufferGetData(ctx->buf) + size,
+                                xmlSecBufferGetMaxSize(ctx->buf) - size);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBase64CtxUpdate", NULL);
+        return(-1);
+    }
+    size += ret;
+
+    ret = xmlSecBufferSetSize(ctx->buf, size);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecBufferSetSize", NULL, "size=%d", size);
+        return(-1);
+    }
+    return(0);
+}
+
 /**
  * xmlSecBufferBase64NodeContentRead:
  * @buf:                the pointer to buffer object.
  * @node:               the pointer to node.
  *
  * Reads the content of the @node, base64 decodes it and stores the
- * result in the buffer.
+ * result in the buffer. The text nodes are decoded one by one directly
+ * into the buffer without making a copy of the whole @node content.
  *
  * Returns: 0 on success or a negative value if an error occurs.
  */
 int
 xmlSecBufferBase64NodeContentRead(xmlSecBufferPtr buf, xmlNodePtr node) {
-    xmlChar* content;
-    xmlSecSize size;
+    xmlSecBufferBase64NodeContentReadCtx ctx;
+    xmlSecSize size = 0;
     int ret;
 
     xmlSecAssert2(buf != NULL, -1);
     xmlSecAssert2(node != NULL, -1);
 
-    content = xmlNodeGetContent(node);
-    if(content == NULL) {
+    /* base64 decode size is less than input size */
+    ret = xmlSecNodeContentWalk(node, xmlSecBufferBase64NodeContentSizeCallback, &size);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecNodeContentWalk", NULL);
+        return(-1);
+    }
+    if(size == 0) {
         xmlSecInvalidNodeContentError(node, NULL, "empty");
         return(-1);
     }
-
-    /* base64 decode size is less than input size */
-    ret = xmlSecBufferSetMaxSize(buf, xmlStrlen(content));
+    ret = xmlSecBufferSetMaxSize(buf, size + 1);
     if(ret < 0) {
         xmlSecInternalError("xmlSecBufferSetMaxSize", NULL);
-        xmlFree(content);
+        return(-1);
+    }
+    ret = xmlSecBufferSetSize(buf, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferSetSize", NULL);
         return(-1);
     }
 
-    ret = xmlSecBase64Decode(content, xmlSecBufferGetData(buf), xmlSecBufferGetMaxSize(buf));
+    ctx.base64Ctx = xmlSecBase64CtxCreate(0, 0);
+    if(ctx.base64Ctx == NULL) {
+        xmlSecInternalError("xmlSecBase64CtxCreate", NULL);
+        return(-1);
+    }
+    ctx.buf = buf;
+
+    ret = xmlSecNodeContentWalk(node, xmlSecBufferBase64NodeContentReadCallback, &ctx);
     if(ret < 0) {
-        xmlSecInternalError("xmlSecBase64Decode", NULL);
-        xmlFree(content);
+        xmlSecInternalError("xmlSecNodeContentWalk", NULL);
+        xmlSecBase64CtxDestroy(ctx.base64Ctx);
         return(-1);
     }
-    size = ret;
 
-    ret = xmlSecBufferSetSize(buf, size);
+    size = xmlSecBufferGetSize(buf);
+    ret = xmlSecBase64CtxFinal(ctx.base64Ctx, xmlSecBufferGetData(buf) + size,
+                               xmlSecBufferGetMaxSize(buf) - size);
     if(ret < 0) {
-        xmlSecInternalError2("xmlSecBufferSetSize", NULL, "size=%d", size);
-        xmlFree(content);
+        xmlSecInternalError("xmlSecBase64CtxFinal", NULL);
+        xmlSecBase64CtxDestroy(ctx.base64Ctx);
         return(-1);
     }
-    xmlFree(content);
+    xmlSecBase64CtxDestroy(ctx.base64Ctx);
 
     return(0);
 }
 
+/* the input chunk size for base64 encoding into the node content (multiple of 3) */
+#define XMLSEC_BUFFER_BASE64_WRITE_CHUNK                (3 * 16 * 1024)
+
 /**
  * xmlSecBufferBase64NodeContentWrite:
  * @buf:                the pointer to buffer object.
  * @node:               the pointer to a node.
  * @columns:            the max line size for base64 encoded data.
  *
- * Sets the content of the @node to the base64 encoded buffer data.
+ * Appends the base64 encoded buffer data to the content of the @node.
+ * The data is encoded and appended in bounded chunks, the whole base64
+ * string is never allocated in addition to the node content.
  *
  * Returns: 0 on success or a negative value if an error occurs.
  */
 int
 xmlSecBufferBase64NodeContentWrite(xmlSecBufferPtr buf, xmlNodePtr node, int columns) {
-    xmlChar* content;
+    xmlSecBase64CtxPtr base64Ctx;
+    const xmlSecByte* data;
+    xmlSecSize dataSize;
+    xmlSecSize chunkSize;
+    xmlSecByte* out;
+    xmlSecSize outSize;
+    int ret;
 
     xmlSecAssert2(buf != NULL, -1);
     xmlSecAssert2(node != NULL, -1);
 
-    content = xmlSecBase64Encode(xmlSecBufferGetData(buf), xmlSecBufferGetSize(buf), columns);
-    if(content == NULL) {
-        xmlSecInternalError("xmlSecBase64Encode", NULL);
+    data = xmlSecBufferGetData(buf);
+    dataSize = xmlSecBufferGetSize(buf);
+
+    /* output size for one chunk (see xmlSecBase64Encode) */
+    chunkSize = (dataSize < XMLSEC_BUFFER_BASE64_WRITE_CHUNK) ? dataSize : XMLSEC_BUFFER_BASE64_WRITE_CHUNK;
+    outSize = (4 * chunkSize) / 3 + 4;
+    if(columns > 0) {
+        outSize += (outSize / columns) + 4;
+    }
+    out = (xmlSecByte*)xmlMalloc(outSize);
+    if(out == NULL) {
+        xmlSecMallocError(outSize, NULL);
         return(-1);
     }
-    xmlNodeAddContent(node, content);
-    xmlFree(content);
 
+    base64Ctx = xmlSecBase64CtxCreate(1, columns);
+    if(base64Ctx == NULL) {
+        xmlSecInternalError("xmlSecBase64CtxCreate", NULL);
+        xmlFree(out);
+        return(-1);
+    }
+
+    while(dataSize > 0) {
+        chunkSize = (dataSize < XMLSEC_BUFFER_BASE64_WRITE_CHUNK) ? dataSize : XMLSEC_BUFFER_BASE64_WRITE_CHUNK;
+        ret = xmlSecBase64CtxUpdate(base64Ctx, data, chunkSize, out, outSize);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBase64CtxUpdate", NULL,
+                                 "size=%d", chunkSize);
+            xmlSecBase64CtxDestroy(base64Ctx);
+            xmlFree(out);
+            return(-1);
+        }
+        if(ret > 0) {
+            xmlNodeAddContentLen(node, out, ret);
+        }
+        data += chunkSize;
+        dataSize -= chunkSize;
+    }
+
+    ret = xmlSecBase64CtxFinal(base64Ctx, out, outSize);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBase64CtxFinal", NULL);
+        xmlSecBase64CtxDestroy(base64Ctx);
+        xmlFree(out);
+        return(-1);
+    }
+    if(ret > 0) {
+        xmlNodeAddContentLen(node, out, ret);
+    }
+
+    xmlSecBase64CtxDestroy(base64Ctx);
+    xmlFree(out);
     return(0);
 }
 
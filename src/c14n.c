@@ -73,6 +73,9 @@ static int              xmlSecTransformC14NPopBin       (xmlSecTransformPtr tran
                                                          xmlSecSize maxDataSize,
                                                          xmlSecSize* dataSize,
                                                          xmlSecTransformCtxPtr transformCtx);
+static int              xmlSecTransformC14NExcludedSubtreeIsVisible(void* data,
+                                                         xmlNodePtr node,
+                                                         xmlNodePtr parent);
 static int              xmlSecTransformC14NExecute      (xmlSecTransformId id,
                                                          xmlSecNodeSetPtr nodes,
                                                          xmlChar** nsList,
@@ -322,9 +325,6 @@ xmlSecTransformC14NPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
         if(outSize > maxDataSize) {
             outSize = maxDataSize;
         }
-        if(outSize > XMLSEC_TRANSFORM_BINARY_CHUNK) {
-            outSize = XMLSEC_TRANSFORM_BINARY_CHUNK;
-        }
         if(outSize > 0) {
             xmlSecAssert2(xmlSecBufferGetData(&(transform->outBuf)), -1);
 
@@ -352,9 +352,34 @@ xmlSecTransformC14NPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
     return(0);
 }
 
+/* the visibility callback for all the document nodes except one subtree */
+static int
+xmlSecTransformC14NExcludedSubtreeIsVisible(void* data, xmlNodePtr node, xmlNodePtr parent) {
+    xmlNodePtr subtree = (xmlNodePtr)data;
+
+    xmlSecAssert2(subtree != NULL, 0);
+    xmlSecAssert2(node != NULL, 0);
+
+    if(node == subtree) {
+        return(0);
+    }
+    for( ; (parent != NULL) && (parent->type == XML_ELEMENT_NODE); parent = parent->parent) {
+        if(parent == subtree) {
+            return(0);
+        }
+    }
+    return(1);
+}
+
 static int
 xmlSecTransformC14NExecute(xmlSecTransformId id, xmlSecNodeSetPtr nodes, xmlChar** nsList,
                            xmlOutputBufferPtr buf) {
+    xmlC14NIsVisibleCallback isVisible;
+    void* isVisibleData;
+    xmlNodePtr subtree;
+    int subtreeWithComments = 0;
+    int mode;
+    int withComments;
     int ret;
 
     xmlSecAssert2(id != xmlSecTransformIdUnknown, -1);
@@ -362,33 +387,31 @@ xmlSecTransformC14NExecute(xmlSecTransformId id, xmlSecNodeSetPtr nodes, xmlChar
     xmlSecAssert2(nodes->doc != NULL, -1);
     xmlSecAssert2(buf != NULL, -1);
 
-    /* execute c14n transform */
     if(id == xmlSecTransformInclC14NId) {
-        ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_1_0, NULL, 0, buf);
+        mode = XML_C14N_1_0;
+        withComments = 0;
     } else if(id == xmlSecTransformInclC14NWithCommentsId) {
-         ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_1_0, NULL, 1, buf);
+        mode = XML_C14N_1_0;
+        withComments = 1;
     } else if(id == xmlSecTransformInclC14N11Id) {
-        ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_1_1, NULL, 0, buf);
+        mode = XML_C14N_1_1;
+        withComments = 0;
     } else if(id == xmlSecTransformInclC14N11WithCommentsId) {
-         ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_1_1, NULL, 1, buf);
+        mode = XML_C14N_1_1;
+        withComments = 1;
     } else if(id == xmlSecTransformExclC14NId) {
-        ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_EXCLUSIVE_1_0, nsList, 0, buf);
+        mode = XML_C14N_EXCLUSIVE_1_0;
+        withComments = 0;
     } else if(id == xmlSecTransformExclC14NWithCommentsId) {
-        ret = xmlC14NExecute(nodes->doc,
-                        (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
-                        nodes, XML_C14N_EXCLUSIVE_1_0, nsList, 1, buf);
+        mode = XML_C14N_EXCLUSIVE_1_0;
+        withComments = 1;
     } else if(id == xmlSecTransformRemoveXmlTagsC14NId) {
         ret = xmlSecNodeSetDumpTextNodes(nodes, buf);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecNodeSetDumpTextNodes", xmlSecTransformKlassGetName(id));
+            return(-1);
+        }
+        return(0);
     } else {
         /* shoudn't be possible to come here, actually */
         xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_TRANSFORM,
@@ -396,6 +419,23 @@ xmlSecTransformC14NExecute(xmlSecTransformId id, xmlSecNodeSetPtr nodes, xmlChar
         return(-1);
     }
 
+    /* the whole document minus one subtree (enveloped signature) is checked
+     * by comparing the ancestors pointers instead of the nodes set lookups,
+     * the comments are dropped by libxml2 itself */
+    subtree = xmlSecNodeSetGetExcludedSubtree(nodes, &subtreeWithComments);
+    if(subtree != NULL) {
+        isVisible = xmlSecTransformC14NExcludedSubtreeIsVisible;
+        isVisibleData = subtree;
+        withComments = withComments && subtreeWithComments;
+    } else {
+        isVisible = (xmlC14NIsVisibleCallback)xmlSecNodeSetContains;
+        isVisibleData = nodes;
+    }
+
+    /* execute c14n transform */
+    ret = xmlC14NExecute(nodes->doc, isVisible, isVisibleData, mode,
+                        (mode == XML_C14N_EXCLUSIVE_1_0) ? nsList : NULL,
+                        withComments, buf);
     if(ret < 0) {
         xmlSecXmlError("xmlC14NExecute", xmlSecTransformKlassGetName(id));
         return(-1);
@@ -665,19 +665,24 @@ xmlSecKeyDataNameXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key, xmlNodePtr node,
             /* erase any current information in the key */
             xmlSecKeyEmpty(key);
 
-            /* TODO: since we will destroy tmpKey anyway, we can easily
-             * just re-assign key data values. It'll save use some memory
-             * malloc/free
-             */
-
-            /* and copy what we've found */
-            ret = xmlSecKeyCopy(key, tmpKey);
-            if(ret < 0) {
-                xmlSecInternalError("xmlSecKeyCopy",
-                                    xmlSecKeyDataKlassGetName(id));
-                xmlSecKeyDestroy(tmpKey);
-                xmlFree(newName);
-                return(-1);
+            if((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_SHARED_KEYS) == 0) {
+                xmlSecKey emptyKey;
+
+                /* the found key is our own copy: take its data instead
+                 * of copying it again */
+                emptyKey = (*key);
+                (*key) = (*tmpKey);
+                (*tmpKey) = emptyKey;
+            } else {
+                /* the found key is shared with the store: copy it */
+                ret = xmlSecKeyCopy(key, tmpKey);
+                if(ret < 0) {
+                    xmlSecInternalError("xmlSecKeyCopy",
+                                        xmlSecKeyDataKlassGetName(id));
+                    xmlSecKeyDestroy(tmpKey);
+                    xmlFree(newName);
+                    return(-1);
+                }
             }
             xmlSecKeyDestroy(tmpKey);
 
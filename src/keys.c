@@ -20,6 +20,8 @@
 #include <string.h>
 
 #include <libxml/tree.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
@@ -29,6 +31,8 @@
 #include <xmlsec/transforms.h>
 #include <xmlsec/keyinfo.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/private.h>
+#include <xmlsec/private/keys.h>
 
 
 /**************************************************************************
@@ -495,6 +499,104 @@ xmlSecKeyReqDebugXmlDump(xmlSecKeyReqPtr keyReq, FILE* output) {
  * xmlSecKey
  *
  *************************************************************************/
+/*
+ * The references to the shared keys (see xmlSecKeyRef) are counted in
+ * this hash table keyed by the key pointer value instead of the xmlSecKey
+ * structure: each entry is the number of the references added to the key
+ * besides the key owner. The table only has the keys that are currently
+ * shared (usually the keys found in the keys stores and used by the
+ * signature and encryption contexts) and is protected by the mutex.
+ *
+ * xmlSecKeyDestroy does not take the lock if no key is shared: the key
+ * reference is added before the key is passed to another holder, so
+ * the holder destroying a shared key always sees a non zero count.
+ */
+typedef struct _xmlSecKeyRefsEntry {
+    xmlSecSize                  refs;
+} xmlSecKeyRefsEntry, *xmlSecKeyRefsEntryPtr;
+
+static xmlMutexPtr              xmlSecKeysRefsMutex = NULL;
+static xmlHashTablePtr          xmlSecKeysRefs = NULL;
+static volatile xmlSecSize      xmlSecKeysRefsSize = 0;
+
+#define XMLSEC_KEYS_REFS_NAME_SIZE      32
+
+static void             xmlSecKeysRefsDeallocator       (void *payload,
+                                                         const xmlChar *name);
+static int              xmlSecKeysRefsName              (xmlSecKeyPtr key,
+                                                         xmlChar* name,
+                                                         int nameSize);
+
+/**
+ * xmlSecKeysInitialize:
+ *
+ * Initializes the shared keys references table and mutex.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecKeysInitialize(void) {
+    if(xmlSecKeysRefsMutex != NULL) {
+        return(0);
+    }
+
+    xmlSecKeysRefs = xmlHashCreate(0);
+    if(xmlSecKeysRefs == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        return(-1);
+    }
+
+    xmlSecKeysRefsMutex = xmlNewMutex();
+    if(xmlSecKeysRefsMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        xmlHashFree(xmlSecKeysRefs, NULL);
+        xmlSecKeysRefs = NULL;
+        return(-1);
+    }
+    xmlSecKeysRefsSize = 0;
+    return(0);
+}
+
+/**
+ * xmlSecKeysShutdown:
+ *
+ * Frees the shared keys references table and mutex.
+ */
+void
+xmlSecKeysShutdown(void) {
+    if(xmlSecKeysRefs != NULL) {
+        xmlHashFree(xmlSecKeysRefs, xmlSecKeysRefsDeallocator);
+        xmlSecKeysRefs = NULL;
+    }
+    xmlSecKeysRefsSize = 0;
+
+    if(xmlSecKeysRefsMutex != NULL) {
+        xmlFreeMutex(xmlSecKeysRefsMutex);
+        xmlSecKeysRefsMutex = NULL;
+    }
+}
+
+static void
+xmlSecKeysRefsDeallocator(void *payload, const xmlChar *name ATTRIBUTE_UNUSED) {
+    UNREFERENCED_PARAMETER(name);
+    xmlFree(payload);
+}
+
+static int
+xmlSecKeysRefsName(xmlSecKeyPtr key, xmlChar* name, int nameSize) {
+    int ret;
+
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(name != NULL, -1);
+
+    ret = xmlStrPrintf(name, nameSize, "%p", (void*)key);
+    if(ret < 0) {
+        xmlSecXmlError("xmlStrPrintf", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
 /**
  * xmlSecKeyCreate:
  *
@@ -546,16 +648,95 @@ xmlSecKeyEmpty(xmlSecKeyPtr key) {
  * xmlSecKeyDestroy:
  * @key:                the pointer to key.
  *
- * Destroys the key created using #xmlSecKeyCreate function.
+ * Destroys the key created using #xmlSecKeyCreate function. If the
+ * key is shared (see #xmlSecKeyRef) then only the reference is released
+ * and the key is destroyed when the last reference goes away.
  */
 void
 xmlSecKeyDestroy(xmlSecKeyPtr key) {
+    xmlSecKeyRefsEntryPtr entry;
+    xmlChar name[XMLSEC_KEYS_REFS_NAME_SIZE];
+    int shared = 0;
+
     xmlSecAssert(key != NULL);
 
+    if((xmlSecKeysRefsSize > 0) && (xmlSecKeysRefsMutex != NULL) &&
+       (xmlSecKeysRefsName(key, name, sizeof(name)) == 0)) {
+        xmlMutexLock(xmlSecKeysRefsMutex);
+        entry = (xmlSecKeyRefsEntryPtr)xmlHashLookup(xmlSecKeysRefs, name);
+        if(entry != NULL) {
+            /* release one reference, the last holder destroys the key */
+            if((--(entry->refs)) == 0) {
+                xmlHashRemoveEntry(xmlSecKeysRefs, name, xmlSecKeysRefsDeallocator);
+                --xmlSecKeysRefsSize;
+            }
+            shared = 1;
+        }
+        xmlMutexUnlock(xmlSecKeysRefsMutex);
+    }
+    if(shared != 0) {
+        return;
+    }
+
     xmlSecKeyEmpty(key);
     xmlFree(key);
 }
 
+/**
+ * xmlSecKeyRef:
+ * @key:                the pointer to key.
+ *
+ * Adds a reference to the @key. The key is shared between all the
+ * references holders and is destroyed when every holder called
+ * #xmlSecKeyDestroy. A shared key is read-only: use #xmlSecKeyDuplicate
+ * to get a private copy if the key needs to be modified.
+ *
+ * Returns: the @key or NULL if an error occurs.
+ */
+xmlSecKeyPtr
+xmlSecKeyRef(xmlSecKeyPtr key) {
+    xmlSecKeyRefsEntryPtr entry;
+    xmlChar name[XMLSEC_KEYS_REFS_NAME_SIZE];
+    xmlSecKeyPtr res = NULL;
+    int ret;
+
+    xmlSecAssert2(key != NULL, NULL);
+
+    xmlSecAssert2(xmlSecKeysRefsMutex != NULL, NULL);
+    xmlSecAssert2(xmlSecKeysRefs != NULL, NULL);
+
+    ret = xmlSecKeysRefsName(key, name, sizeof(name));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeysRefsName", NULL);
+        return(NULL);
+    }
+
+    xmlMutexLock(xmlSecKeysRefsMutex);
+    entry = (xmlSecKeyRefsEntryPtr)xmlHashLookup(xmlSecKeysRefs, name);
+    if(entry == NULL) {
+        entry = (xmlSecKeyRefsEntryPtr)xmlMalloc(sizeof(xmlSecKeyRefsEntry));
+        if(entry == NULL) {
+            xmlSecMallocError(sizeof(xmlSecKeyRefsEntry), NULL);
+            goto done;
+        }
+        entry->refs = 0;
+
+        ret = xmlHashAddEntry(xmlSecKeysRefs, name, entry);
+        if(ret != 0) {
+            xmlSecXmlError("xmlHashAddEntry", NULL);
+            xmlFree(entry);
+            goto done;
+        }
+        ++xmlSecKeysRefsSize;
+    }
+    ++(entry->refs);
+    res = key;
+
+done:
+    xmlMutexUnlock(xmlSecKeysRefsMutex);
+    return(res);
+}
+
 /**
  * xmlSecKeyCopy:
  * @keyDst:             the destination key.
@@ -1203,12 +1384,67 @@ xmlSecKeyReadMemory(xmlSecKeyDataId dataId, const xmlSecByte* data, xmlSecSize d
     return (key);
 }
 
+/*
+ * Returns the key shared with the keys store for the <dsig:KeyInfo/> node
+ * with the <dsig:KeyName/> first child (this is what xmlSecKeyInfoNodeRead
+ * would find) without copying it into a new key, or NULL to fall back to
+ * the xmlSecKeyInfoNodeRead path.
+ */
+static xmlSecKeyPtr
+xmlSecKeysMngrGetSharedKeyByName(xmlNodePtr keyInfoNode, xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecPtrListPtr enabledKeyData;
+    xmlNodePtr cur;
+    xmlChar* name;
+    xmlSecKeyPtr key;
+
+    xmlSecAssert2(keyInfoNode != NULL, NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
+    if(((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_SHARED_KEYS) == 0) ||
+       ((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_DONT_STOP_ON_KEY_FOUND) != 0) ||
+       (keyInfoCtx->keysMngr == NULL)) {
+        return(NULL);
+    }
+
+    cur = xmlSecGetNextElementNode(keyInfoNode->children);
+    if((cur == NULL) || !xmlSecCheckNodeName(cur, xmlSecNodeKeyName, xmlSecDSigNs)) {
+        return(NULL);
+    }
+
+    /* use global list only if we don't have a local one */
+    enabledKeyData = &(keyInfoCtx->enabledKeyData);
+    if(xmlSecPtrListGetSize(enabledKeyData) == 0) {
+        enabledKeyData = xmlSecKeyDataIdsGet();
+    }
+    if(xmlSecKeyDataIdListFindByNode(enabledKeyData, cur->name, xmlSecDSigNs,
+                xmlSecKeyDataUsageKeyInfoNodeRead) != xmlSecKeyDataNameId) {
+        return(NULL);
+    }
+
+    name = xmlNodeGetContent(cur);
+    if(name == NULL) {
+        return(NULL);
+    }
+
+    key = xmlSecKeysMngrFindKey(keyInfoCtx->keysMngr, name, keyInfoCtx);
+    if((key != NULL) && ((xmlSecKeyGetValue(key) == NULL) ||
+       (!xmlStrEqual(xmlSecKeyGetName(key), name)) ||
+       (xmlSecKeyMatch(key, NULL, &(keyInfoCtx->keyReq)) != 1))) {
+        xmlSecKeyDestroy(key);
+        key = NULL;
+    }
+    xmlFree(name);
+    return(key);
+}
+
 /**
  * xmlSecKeysMngrGetKey:
  * @keyInfoNode:        the pointer to <dsig:KeyInfo/> node.
  * @keyInfoCtx:         the pointer to <dsig:KeyInfo/> node processing context.
  *
  * Reads the <dsig:KeyInfo/> node @keyInfoNode and extracts the key.
+ * If #XMLSEC_KEYINFO_FLAGS_SHARED_KEYS flag is set in @keyInfoCtx then
+ * the returned key might be shared with the keys store (see #xmlSecKeyRef).
  *
  * Returns: the pointer to key or NULL if the key is not found or
  * an error occurs.
@@ -1220,6 +1456,13 @@ xmlSecKeysMngrGetKey(xmlNodePtr keyInfoNode, xmlSecKeyInfoCtxPtr keyInfoCtx) {
 
     xmlSecAssert2(keyInfoCtx != NULL, NULL);
 
+    /* the shared key found by <dsig:KeyName/> is returned as-is */
+    if(keyInfoNode != NULL) {
+        key = xmlSecKeysMngrGetSharedKeyByName(keyInfoNode, keyInfoCtx);
+        if(key != NULL) {
+            return(key);
+        }
+    }
 
     /* first try to read data from <dsig:KeyInfo/> node */
     key = xmlSecKeyCreate();
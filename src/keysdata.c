@@ -20,6 +20,7 @@
 #include <string.h>
 
 #include <libxml/tree.h>
+#include <libxml/hash.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
@@ -29,6 +30,7 @@
 #include <xmlsec/base64.h>
 #include <xmlsec/keyinfo.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/private/list.h>
 
 /**************************************************************************
  *
@@ -38,6 +40,15 @@
 static xmlSecPtrList xmlSecAllKeyDataIds;
 static int xmlSecImportPersistKey = 0;
 
+/* node (name, ns) and href -> positions in xmlSecAllKeyDataIds, updated on registration */
+static xmlHashTablePtr xmlSecAllKeyDataIdsNodeIndex = NULL;
+static xmlHashTablePtr xmlSecAllKeyDataIdsHrefIndex = NULL;
+static xmlSecSize xmlSecAllKeyDataIdsIndexedSize = 0;
+static xmlSecSize xmlSecAllKeyDataIdsIndexedChanges = 0;
+
+static int              xmlSecKeyDataIdsIndexUpdate             (void);
+static void             xmlSecKeyDataIdsIndexReset              (void);
+
 /**
  * xmlSecKeyDataIdsGet:
  *
@@ -68,6 +79,12 @@ xmlSecKeyDataIdsInit(void) {
         return(-1);
     }
 
+    ret = xmlSecPtrListTrackChanges(xmlSecKeyDataIdsGet());
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListTrackChanges", NULL);
+        return(-1);
+    }
+
     ret = xmlSecKeyDataIdsRegisterDefault();
     if(ret < 0) {
         xmlSecInternalError("xmlSecKeyDataIdsRegisterDefault", NULL);
@@ -85,6 +102,8 @@ xmlSecKeyDataIdsInit(void) {
  */
 void
 xmlSecKeyDataIdsShutdown(void) {
+    xmlSecKeyDataIdsIndexReset();
+    xmlSecPtrListUntrackChanges(xmlSecKeyDataIdsGet());
     xmlSecPtrListFinalize(xmlSecKeyDataIdsGet());
 }
 
@@ -109,9 +128,69 @@ xmlSecKeyDataIdsRegister(xmlSecKeyDataId id) {
         return(-1);
     }
 
+    ret = xmlSecKeyDataIdsIndexUpdate();
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyDataIdsIndexUpdate",
+                            xmlSecKeyDataKlassGetName(id));
+        return(-1);
+    }
+
+    return(0);
+}
+
+static int
+xmlSecKeyDataIdsIndexUpdate(void) {
+    xmlSecKeyDataId id;
+    xmlSecSize pos, size, changes;
+    int ret;
+
+    /* rebuild the index unless the items were only appended since the last update */
+    size = xmlSecPtrListGetSize(xmlSecKeyDataIdsGet());
+    changes = xmlSecPtrListGetChanges(xmlSecKeyDataIdsGet());
+    if((xmlSecAllKeyDataIdsIndexedSize > size) ||
+       ((changes - xmlSecAllKeyDataIdsIndexedChanges) != (size - xmlSecAllKeyDataIdsIndexedSize))) {
+        xmlSecKeyDataIdsIndexReset();
+    }
+
+    for(pos = xmlSecAllKeyDataIdsIndexedSize; pos < size; ++pos) {
+        id = (xmlSecKeyDataId)xmlSecPtrListGetItem(xmlSecKeyDataIdsGet(), pos);
+        if(id == xmlSecKeyDataIdUnknown) {
+            continue;
+        }
+        if(id->dataNodeName != NULL) {
+            ret = xmlSecPtrListIndexAdd(&xmlSecAllKeyDataIdsNodeIndex, id->dataNodeName, id->dataNodeNs, pos);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecPtrListIndexAdd(node)",
+                                    xmlSecKeyDataKlassGetName(id));
+                xmlSecKeyDataIdsIndexReset();
+                return(-1);
+            }
+        }
+        if(id->href != NULL) {
+            ret = xmlSecPtrListIndexAdd(&xmlSecAllKeyDataIdsHrefIndex, id->href, NULL, pos);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecPtrListIndexAdd(href)",
+                                    xmlSecKeyDataKlassGetName(id));
+                xmlSecKeyDataIdsIndexReset();
+                return(-1);
+            }
+        }
+    }
+    xmlSecAllKeyDataIdsIndexedSize = size;
+    xmlSecAllKeyDataIdsIndexedChanges = changes;
     return(0);
 }
 
+static void
+xmlSecKeyDataIdsIndexReset(void) {
+    xmlSecPtrListIndexDestroy(xmlSecAllKeyDataIdsNodeIndex);
+    xmlSecAllKeyDataIdsNodeIndex = NULL;
+    xmlSecPtrListIndexDestroy(xmlSecAllKeyDataIdsHrefIndex);
+    xmlSecAllKeyDataIdsHrefIndex = NULL;
+    xmlSecAllKeyDataIdsIndexedSize = 0;
+    xmlSecAllKeyDataIdsIndexedChanges = 0;
+}
+
 /**
  * xmlSecKeyDataIdsRegisterDefault:
  *
@@ -557,9 +636,8 @@ xmlSecKeyDataBinaryValueFinalize(xmlSecKeyDataPtr data) {
 int
 xmlSecKeyDataBinaryValueXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
                                 xmlNodePtr node, xmlSecKeyInfoCtxPtr keyInfoCtx) {
-    xmlChar* str;
-    xmlSecSize len;
-    xmlSecKeyDataPtr data;
+    xmlSecBufferPtr buffer, newBuffer;
+    xmlSecKeyDataPtr data, newData;
     int ret;
 
     xmlSecAssert2(id != xmlSecKeyDataIdUnknown, -1);
@@ -567,94 +645,81 @@ xmlSecKeyDataBinaryValueXmlRead(xmlSecKeyDataId id, xmlSecKeyPtr key,
     xmlSecAssert2(node != NULL, -1);
     xmlSecAssert2(keyInfoCtx != NULL, -1);
 
-    str = xmlNodeGetContent(node);
-    if(str == NULL) {
-        xmlSecInvalidNodeContentError(node, xmlSecKeyDataKlassGetName(id), "empty");
+    /* decode directly into the new key data buffer */
+    newData = xmlSecKeyDataCreate(id);
+    if(newData == NULL ) {
+        xmlSecInternalError("xmlSecKeyDataCreate",
+                            xmlSecKeyDataKlassGetName(id));
+        return(-1);
+    }
+
+    newBuffer = xmlSecKeyDataBinaryValueGetBuffer(newData);
+    if(newBuffer == NULL) {
+        xmlSecInternalError("xmlSecKeyDataBinaryValueGetBuffer",
+                            xmlSecKeyDataKlassGetName(id));
+        xmlSecKeyDataDestroy(newData);
         return(-1);
     }
 
-    /* usual trick: decode into the same buffer */
-    ret = xmlSecBase64Decode(str, (xmlSecByte*)str, xmlStrlen(str));
+    ret = xmlSecBufferBase64NodeContentRead(newBuffer, node);
     if(ret < 0) {
-        xmlSecInternalError("xmlSecBase64Decode",
+        xmlSecInternalError("xmlSecBufferBase64NodeContentRead",
                             xmlSecKeyDataKlassGetName(id));
-        xmlFree(str);
+        xmlSecKeyDataDestroy(newData);
         return(-1);
     }
-    len = ret;
 
     /* check do we have a key already */
     data = xmlSecKeyGetValue(key);
     if(data != NULL) {
-        xmlSecBufferPtr buffer;
-
         if(!xmlSecKeyDataCheckId(data, id)) {
             xmlSecOtherError2(XMLSEC_ERRORS_R_KEY_DATA_ALREADY_EXIST,
                               xmlSecKeyDataGetName(data),
                               "id=%s",
                               xmlSecErrorsSafeString(xmlSecKeyDataKlassGetName(id)));
-            xmlFree(str);
+            xmlSecKeyDataDestroy(newData);
             return(-1);
         }
 
         buffer = xmlSecKeyDataBinaryValueGetBuffer(data);
-        if((buffer != NULL) && (xmlSecBufferGetSize(buffer) != len)) {
+        if((buffer != NULL) && (xmlSecBufferGetSize(buffer) != xmlSecBufferGetSize(newBuffer))) {
             xmlSecOtherError3(XMLSEC_ERRORS_R_KEY_DATA_ALREADY_EXIST,
                               xmlSecKeyDataGetName(data),
                               "cur-data-size=%lu;new-data-size=%lu",
                               (unsigned long)xmlSecBufferGetSize(buffer),
-                              (unsigned long)len);
-            xmlFree(str);
+                              (unsigned long)xmlSecBufferGetSize(newBuffer));
+            xmlSecKeyDataDestroy(newData);
             return(-1);
         }
-        if((buffer != NULL) && (len > 0) && (memcmp(xmlSecBufferGetData(buffer), str, len) != 0)) {
+        if((buffer != NULL) && (xmlSecBufferGetSize(newBuffer) > 0) &&
+           (memcmp(xmlSecBufferGetData(buffer), xmlSecBufferGetData(newBuffer), xmlSecBufferGetSize(newBuffer)) != 0)) {
             xmlSecOtherError(XMLSEC_ERRORS_R_KEY_DATA_ALREADY_EXIST,
                              xmlSecKeyDataGetName(data),
                              "key already has a different value");
-            xmlFree(str);
+            xmlSecKeyDataDestroy(newData);
             return(-1);
         }
         if(buffer != NULL) {
             /* we already have exactly the same key */
-            xmlFree(str);
+            xmlSecKeyDataDestroy(newData);
             return(0);
         }
 
         /* we have binary key value with empty buffer */
     }
 
-
-    data = xmlSecKeyDataCreate(id);
-    if(data == NULL ) {
-        xmlSecInternalError("xmlSecKeyDataCreate",
-                            xmlSecKeyDataKlassGetName(id));
-        xmlFree(str);
-        return(-1);
-    }
-
-    ret = xmlSecKeyDataBinaryValueSetBuffer(data, (xmlSecByte*)str, len);
-    if(ret < 0) {
-        xmlSecInternalError2("xmlSecKeyDataBinaryValueSetBuffer",
-                             xmlSecKeyDataKlassGetName(id),
-                             "size=%d", len);
-        xmlSecKeyDataDestroy(data);
-        xmlFree(str);
-        return(-1);
-    }
-    xmlFree(str);
-
-    if(xmlSecKeyReqMatchKeyValue(&(keyInfoCtx->keyReq), data) != 1) {
+    if(xmlSecKeyReqMatchKeyValue(&(keyInfoCtx->keyReq), newData) != 1) {
         xmlSecInternalError("xmlSecKeyReqMatchKeyValue",
                             xmlSecKeyDataKlassGetName(id));
-        xmlSecKeyDataDestroy(data);
+        xmlSecKeyDataDestroy(newData);
         return(0);
     }
 
-    ret = xmlSecKeySetValue(key, data);
+    ret = xmlSecKeySetValue(key, newData);
     if(ret < 0) {
         xmlSecInternalError("xmlSecKeySetValue",
                             xmlSecKeyDataKlassGetName(id));
-        xmlSecKeyDataDestroy(data);
+        xmlSecKeyDataDestroy(newData);
         return(-1);
     }
 
@@ -1057,12 +1122,27 @@ xmlSecKeyDataId
 xmlSecKeyDataIdListFindByNode(xmlSecPtrListPtr list, const xmlChar* nodeName,
                             const xmlChar* nodeNs, xmlSecKeyDataUsage usage) {
     xmlSecKeyDataId dataId;
+    const xmlSecSize* pos;
     xmlSecSize i, size;
 
     xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyDataIdListId), xmlSecKeyDataIdUnknown);
     xmlSecAssert2(nodeName != NULL, xmlSecKeyDataIdUnknown);
 
     size = xmlSecPtrListGetSize(list);
+
+    /* the global list is indexed by node, check only the candidates */
+    if((list == xmlSecKeyDataIdsGet()) && (xmlSecAllKeyDataIdsIndexedSize == size) &&
+       (xmlSecAllKeyDataIdsIndexedChanges == xmlSecPtrListGetChanges(list))) {
+        pos = xmlSecPtrListIndexLookup(xmlSecAllKeyDataIdsNodeIndex, nodeName, nodeNs, &size);
+        for(i = 0; i < size; ++i) {
+            dataId = (xmlSecKeyDataId)xmlSecPtrListGetItem(list, pos[i]);
+            if((dataId != xmlSecKeyDataIdUnknown) && ((usage & dataId->usage) != 0)) {
+                return(dataId);
+            }
+        }
+        return(xmlSecKeyDataIdUnknown);
+    }
+
     for(i = 0; i < size; ++i) {
         dataId = (xmlSecKeyDataId)xmlSecPtrListGetItem(list, i);
         xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, xmlSecKeyDataIdUnknown);
@@ -1091,12 +1171,27 @@ xmlSecKeyDataId
 xmlSecKeyDataIdListFindByHref(xmlSecPtrListPtr list, const xmlChar* href,
                             xmlSecKeyDataUsage usage) {
     xmlSecKeyDataId dataId;
+    const xmlSecSize* pos;
     xmlSecSize i, size;
 
     xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyDataIdListId), xmlSecKeyDataIdUnknown);
     xmlSecAssert2(href != NULL, xmlSecKeyDataIdUnknown);
 
     size = xmlSecPtrListGetSize(list);
+
+    /* the global list is indexed by href, check only the candidates */
+    if((list == xmlSecKeyDataIdsGet()) && (xmlSecAllKeyDataIdsIndexedSize == size) &&
+       (xmlSecAllKeyDataIdsIndexedChanges == xmlSecPtrListGetChanges(list))) {
+        pos = xmlSecPtrListIndexLookup(xmlSecAllKeyDataIdsHrefIndex, href, NULL, &size);
+        for(i = 0; i < size; ++i) {
+            dataId = (xmlSecKeyDataId)xmlSecPtrListGetItem(list, pos[i]);
+            if((dataId != xmlSecKeyDataIdUnknown) && ((usage & dataId->usage) != 0)) {
+                return(dataId);
+            }
+        }
+        return(xmlSecKeyDataIdUnknown);
+    }
+
     for(i = 0; i < size; ++i) {
         dataId = (xmlSecKeyDataId)xmlSecPtrListGetItem(list, i);
         xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, xmlSecKeyDataIdUnknown);
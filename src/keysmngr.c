@@ -20,17 +20,30 @@
 #include <string.h>
 #include <errno.h>
 
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif /* defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) */
+
 #include <libxml/tree.h>
 #include <libxml/parser.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
 #include <xmlsec/list.h>
+#include <xmlsec/buffer.h>
 #include <xmlsec/keys.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/keysmngr.h>
+#include <xmlsec/parser.h>
 #include <xmlsec/errors.h>
 #include <xmlsec/private.h>
+#include <xmlsec/private/list.h>
 
 
 /****************************************************************************
@@ -98,7 +111,10 @@ xmlSecKeysMngrDestroy(xmlSecKeysMngrPtr mngr) {
  * @keyInfoCtx:         the pointer to <dsig:KeyInfo/> node processing context.
  *
  * Lookups key in the keys manager keys store. The caller is responsible
- * for destroying the returned key using #xmlSecKeyDestroy method.
+ * for destroying the returned key using #xmlSecKeyDestroy method. If
+ * #XMLSEC_KEYINFO_FLAGS_SHARED_KEYS flag is set in @keyInfoCtx then the
+ * returned key might be shared with the store (see #xmlSecKeyRef) and
+ * should be duplicated with #xmlSecKeyDuplicate before any modification.
  *
  * Returns: the pointer to a key or NULL if key is not found or an error occurs.
  */
@@ -284,7 +300,10 @@ xmlSecKeyStoreDestroy(xmlSecKeyStorePtr store) {
  * @keyInfoCtx:         the pointer to <dsig:KeyInfo/> node processing context.
  *
  * Lookups key in the store. The caller is responsible for destroying
- * the returned key using #xmlSecKeyDestroy method.
+ * the returned key using #xmlSecKeyDestroy method. If
+ * #XMLSEC_KEYINFO_FLAGS_SHARED_KEYS flag is set in @keyInfoCtx then the
+ * returned key might be shared with the store (see #xmlSecKeyRef) and
+ * should be duplicated with #xmlSecKeyDuplicate before any modification.
  *
  * Returns: the pointer to a key or NULL if key is not found or an error occurs.
  */
@@ -301,14 +320,112 @@ xmlSecKeyStoreFindKey(xmlSecKeyStorePtr store, const xmlChar* name, xmlSecKeyInf
  *
  * Simple Keys Store
  *
- * keys list (xmlSecPtrList) is located after xmlSecKeyStore
+ * xmlSecSimpleKeysStoreCtx is located after xmlSecKeyStore. The keys list
+ * is the first member so it can be returned from xmlSecSimpleKeysStoreGetKeys.
+ *
+ * The keys are indexed by name and by key value klass name: each index
+ * entry is an xmlSecBuffer with the (ascending) positions of the matching
+ * keys in the list. Every change of the keys list bumps the generation
+ * counter (the list returned from xmlSecSimpleKeysStoreGetKeys might be
+ * changed by the caller), the index is only used if it was built for
+ * the current generation and falls back to the list scan otherwise.
+ * xmlSecSimpleKeysStoreAdoptKey updates or rebuilds the index.
+ *
+ * The keys loaded from the binary keys files (see below) are kept in the
+ * mapped files list and are looked up after the keys in the keys list.
  *
  ***************************************************************************/
+typedef struct _xmlSecSimpleKeysStoreMapped     xmlSecSimpleKeysStoreMapped,
+                                                *xmlSecSimpleKeysStoreMappedPtr;
+
+typedef struct _xmlSecSimpleKeysStoreCtx        xmlSecSimpleKeysStoreCtx,
+                                                *xmlSecSimpleKeysStoreCtxPtr;
+struct _xmlSecSimpleKeysStoreCtx {
+    xmlSecPtrList                       keys;
+    xmlHashTablePtr                     namesIndex;
+    xmlHashTablePtr                     idsIndex;
+    xmlSecSize                          generation;
+    xmlSecSize                          indexedGeneration;
+    xmlSecSimpleKeysStoreMappedPtr      mapped;
+};
+
+/*
+ * The binary keys file (all integers are 4 bytes big-endian, all offsets
+ * are from the beginning of the file, all strings are zero terminated):
+ *
+ *  header (32 bytes):
+ *      magic           "XMLSECKS"
+ *      version         XMLSEC_SIMPLE_KEYS_STORE_BIN_VERSION
+ *      count           the number of keys
+ *      namesCount      the number of keys with a name
+ *      size            the file size
+ *      checksum        Adler-32 of the keys table and the indexes
+ *      reserved        0
+ *  keys table (count entries, 32 bytes each, in the keys store order):
+ *      nameOffset, nameSize    the key name or 0, 0
+ *      klassOffset, klassSize  the key value klass name
+ *      format                  XMLSEC_SIMPLE_KEYS_STORE_BIN_FORMAT_*
+ *      dataOffset, dataSize    the key data
+ *      checksum                Adler-32 of the key name, klass and data
+ *  names index (namesCount integers): the keys table positions sorted
+ *      by the key name and the position
+ *  klasses index (count integers): the keys table positions sorted
+ *      by the key value klass name and the position
+ *  strings and keys data
+ *
+ * The key entry checksum is verified when the key is read from the file for
+ * the first time, the file is not read in full when it is loaded.
+ */
+#define XMLSEC_SIMPLE_KEYS_STORE_BIN_MAGIC              "XMLSECKS"
+#define XMLSEC_SIMPLE_KEYS_STORE_BIN_MAGIC_SIZE         8
+#define XMLSEC_SIMPLE_KEYS_STORE_BIN_VERSION            1
+#define XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE        32
+#define XMLSEC_SIMPLE_KEYS_STORE_BIN_ENTRY_SIZE         32
+#define XMLSEC_SIMPLE_KEYS_STORE_BIN_MAX_SIZE           0xFFFFFFFFUL
+#define XMLSEC_SIMPLE_KEYS_STORE_BIN_FORMAT_BINARY      1       /* xmlSecKeyDataBinRead() */
+#define XMLSEC_SIMPLE_KEYS_STORE_BIN_FORMAT_KEYINFO     2       /* <dsig:KeyInfo/> element */
+
+#define xmlSecSimpleKeysStoreBinGetEntry(data, pos) \
+    ((data) + XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE + (pos) * XMLSEC_SIMPLE_KEYS_STORE_BIN_ENTRY_SIZE)
+
+struct _xmlSecSimpleKeysStoreMapped {
+    const xmlSecByte*                   data;
+    xmlSecSize                          size;
+    xmlSecBufferPtr                     buffer;     /* NULL if the file is mapped */
+    xmlSecSize                          count;
+    xmlSecSize                          namesCount;
+    xmlSecKeyPtr*                       keys;       /* the keys read from the file */
+    xmlSecByte*                         states;     /* 0 - not read, 1 - read, 2 - failed */
+    xmlMutexPtr                         mutex;
+    xmlSecSimpleKeysStoreMappedPtr      next;
+};
+
+typedef struct _xmlSecSimpleKeysStoreBinEntry   xmlSecSimpleKeysStoreBinEntry,
+                                                *xmlSecSimpleKeysStoreBinEntryPtr;
+struct _xmlSecSimpleKeysStoreBinEntry {
+    const xmlChar*                      name;
+    const xmlChar*                      klass;
+    xmlSecSize                          format;
+    xmlSecByte*                         data;
+    xmlSecSize                          dataSize;
+};
+
+typedef struct _xmlSecSimpleKeysStoreBinIndexItem xmlSecSimpleKeysStoreBinIndexItem,
+                                                *xmlSecSimpleKeysStoreBinIndexItemPtr;
+struct _xmlSecSimpleKeysStoreBinIndexItem {
+    const xmlChar*                      str;
+    xmlSecSize                          pos;
+};
+
 #define xmlSecSimpleKeysStoreSize \
-        (sizeof(xmlSecKeyStore) + sizeof(xmlSecPtrList))
+        (sizeof(xmlSecKeyStore) + sizeof(xmlSecSimpleKeysStoreCtx))
+#define xmlSecSimpleKeysStoreGetCtx(store) \
+    ((xmlSecKeyStoreCheckSize((store), xmlSecSimpleKeysStoreSize)) ? \
+        (xmlSecSimpleKeysStoreCtxPtr)(((xmlSecByte*)(store)) + sizeof(xmlSecKeyStore)) : \
+        (xmlSecSimpleKeysStoreCtxPtr)NULL)
 #define xmlSecSimpleKeysStoreGetList(store) \
     ((xmlSecKeyStoreCheckSize((store), xmlSecSimpleKeysStoreSize)) ? \
-        (xmlSecPtrListPtr)(((xmlSecByte*)(store)) + sizeof(xmlSecKeyStore)) : \
+        &(((xmlSecSimpleKeysStoreCtxPtr)(((xmlSecByte*)(store)) + sizeof(xmlSecKeyStore)))->keys) : \
         (xmlSecPtrListPtr)NULL)
 
 static int                      xmlSecSimpleKeysStoreInitialize (xmlSecKeyStorePtr store);
@@ -316,6 +433,59 @@ static void                     xmlSecSimpleKeysStoreFinalize   (xmlSecKeyStoreP
 static xmlSecKeyPtr             xmlSecSimpleKeysStoreFindKey    (xmlSecKeyStorePtr store,
                                                                  const xmlChar* name,
                                                                  xmlSecKeyInfoCtxPtr keyInfoCtx);
+static int                      xmlSecSimpleKeysStoreIndexAdd   (xmlSecSimpleKeysStoreCtxPtr ctx,
+                                                                 xmlSecKeyPtr key,
+                                                                 xmlSecSize pos);
+static int                      xmlSecSimpleKeysStoreIndexBuild (xmlSecSimpleKeysStoreCtxPtr ctx);
+static void                     xmlSecSimpleKeysStoreIndexReset (xmlSecSimpleKeysStoreCtxPtr ctx);
+static xmlSecKeyPtr             xmlSecSimpleKeysStoreListFindKey(xmlSecSimpleKeysStoreCtxPtr ctx,
+                                                                 const xmlChar* name,
+                                                                 xmlSecKeyInfoCtxPtr keyInfoCtx);
+static xmlSecSize               xmlSecSimpleKeysStoreGetKeysSize(xmlSecSimpleKeysStoreCtxPtr ctx);
+static xmlSecKeyPtr             xmlSecSimpleKeysStoreGetKeysItem(xmlSecSimpleKeysStoreCtxPtr ctx,
+                                                                 xmlSecSize pos);
+static int                      xmlSecSimpleKeysStoreWriteKeyInfo
+                                                                (xmlSecKeyStorePtr store,
+                                                                 xmlNodePtr keyInfoNode,
+                                                                 xmlSecKeyPtr key,
+                                                                 xmlSecKeyDataType type);
+
+static xmlSecSize               xmlSecSimpleKeysStoreBinGetInt  (const xmlSecByte* data);
+static void                     xmlSecSimpleKeysStoreBinSetInt  (xmlSecByte* data,
+                                                                 xmlSecSize val);
+static xmlSecSize               xmlSecSimpleKeysStoreBinChecksum(xmlSecSize adler,
+                                                                 const xmlSecByte* data,
+                                                                 xmlSecSize size);
+static xmlSecSize               xmlSecSimpleKeysStoreBinEntryChecksum
+                                                                (const xmlSecByte* data,
+                                                                 const xmlSecByte* entry);
+static int                      xmlSecSimpleKeysStoreBinIndexCompare
+                                                                (const void* a,
+                                                                 const void* b);
+static int                      xmlSecSimpleKeysStoreBinEntryWrite
+                                                                (xmlSecKeyStorePtr store,
+                                                                 xmlSecKeyPtr key,
+                                                                 xmlSecKeyDataType type,
+                                                                 xmlSecSimpleKeysStoreBinEntryPtr entry);
+static int                      xmlSecSimpleKeysStoreIsBinaryFile
+                                                                (const char* filename);
+static xmlSecSimpleKeysStoreMappedPtr xmlSecSimpleKeysStoreMappedCreate
+                                                                (const char* filename);
+static void                     xmlSecSimpleKeysStoreMappedDestroy
+                                                                (xmlSecSimpleKeysStoreMappedPtr mapped);
+static int                      xmlSecSimpleKeysStoreMappedVerify
+                                                                (xmlSecSimpleKeysStoreMappedPtr mapped,
+                                                                 const char* filename);
+static xmlSecKeyPtr             xmlSecSimpleKeysStoreMappedGetKey
+                                                                (xmlSecSimpleKeysStoreMappedPtr mapped,
+                                                                 xmlSecSize pos);
+static xmlSecKeyPtr             xmlSecSimpleKeysStoreMappedReadKey
+                                                                (xmlSecSimpleKeysStoreMappedPtr mapped,
+                                                                 xmlSecSize pos);
+static xmlSecKeyPtr             xmlSecSimpleKeysStoreMappedFindKey
+                                                                (xmlSecSimpleKeysStoreMappedPtr mapped,
+                                                                 const xmlChar* name,
+                                                                 xmlSecKeyInfoCtxPtr keyInfoCtx);
 
 static xmlSecKeyStoreKlass xmlSecSimpleKeysStoreKlass = {
     sizeof(xmlSecKeyStoreKlass),
@@ -337,7 +507,9 @@ static xmlSecKeyStoreKlass xmlSecSimpleKeysStoreKlass = {
 /**
  * xmlSecSimpleKeysStoreGetKlass:
  *
- * The simple list based keys store klass.
+ * The simple list based keys store klass. The keys are indexed by name
+ * and by key value klass. The found keys are copied or shared with the
+ * store if #XMLSEC_KEYINFO_FLAGS_SHARED_KEYS flag is set.
  *
  * Returns: simple list based keys store klass.
  */
@@ -357,22 +529,41 @@ xmlSecSimpleKeysStoreGetKlass(void) {
  */
 int
 xmlSecSimpleKeysStoreAdoptKey(xmlSecKeyStorePtr store, xmlSecKeyPtr key) {
-    xmlSecPtrListPtr list;
+    xmlSecSimpleKeysStoreCtxPtr ctx;
+    xmlSecSize pos;
     int ret;
 
     xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
     xmlSecAssert2(key != NULL, -1);
 
-    list = xmlSecSimpleKeysStoreGetList(store);
-    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), -1);
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(xmlSecPtrListCheckId(&(ctx->keys), xmlSecKeyPtrListId), -1);
 
-    ret = xmlSecPtrListAdd(list, key);
+    pos = xmlSecPtrListGetSize(&(ctx->keys));
+    ret = xmlSecPtrListAdd(&(ctx->keys), key);
     if(ret < 0) {
         xmlSecInternalError("xmlSecPtrListAdd",
                             xmlSecKeyStoreGetName(store));
         return(-1);
     }
 
+    /* the keys list might have been changed thru xmlSecSimpleKeysStoreGetKeys */
+    if((ctx->indexedGeneration == ctx->generation) && (ctx->generation > 0)) {
+        ret = xmlSecSimpleKeysStoreIndexAdd(ctx, key, pos);
+    } else {
+        ret = xmlSecSimpleKeysStoreIndexBuild(ctx);
+    }
+    ++(ctx->generation);
+    if(ret < 0) {
+        /* the lookup falls back to the list scan */
+        xmlSecInternalError("xmlSecSimpleKeysStoreIndexAdd",
+                            xmlSecKeyStoreGetName(store));
+        xmlSecSimpleKeysStoreIndexReset(ctx);
+        return(0);
+    }
+    ctx->indexedGeneration = ctx->generation;
+
     return(0);
 }
 
@@ -382,13 +573,15 @@ xmlSecSimpleKeysStoreAdoptKey(xmlSecKeyStorePtr store, xmlSecKeyPtr key) {
  * @uri:                the filename.
  * @keysMngr:           the pointer to associated keys manager.
  *
- * Reads keys from an XML file.
+ * Reads keys from an XML file. The binary keys files (see
+ * #xmlSecSimpleKeysStoreSaveBinary) are detected and loaded with
+ * #xmlSecSimpleKeysStoreLoadBinary.
  *
  * Returns: 0 on success or a negative value if an error occurs.
  */
 int
 xmlSecSimpleKeysStoreLoad(xmlSecKeyStorePtr store, const char *uri,
-                            xmlSecKeysMngrPtr keysMngr ATTRIBUTE_UNUSED) {
+                            xmlSecKeysMngrPtr keysMngr) {
     xmlDocPtr doc;
     xmlNodePtr root;
     xmlNodePtr cur;
@@ -398,7 +591,10 @@ xmlSecSimpleKeysStoreLoad(xmlSecKeyStorePtr store, const char *uri,
 
     xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
     xmlSecAssert2(uri != NULL, -1);
-    UNREFERENCED_PARAMETER(keysMngr);
+
+    if(xmlSecSimpleKeysStoreIsBinaryFile(uri) == 1) {
+        return(xmlSecSimpleKeysStoreLoadBinary(store, uri, keysMngr));
+    }
 
     doc = xmlParseFile(uri);
     if(doc == NULL) {
@@ -492,23 +688,19 @@ xmlSecSimpleKeysStoreLoad(xmlSecKeyStorePtr store, const char *uri,
  */
 int
 xmlSecSimpleKeysStoreSave(xmlSecKeyStorePtr store, const char *filename, xmlSecKeyDataType type) {
-    xmlSecKeyInfoCtx keyInfoCtx;
-    xmlSecPtrListPtr list;
+    xmlSecSimpleKeysStoreCtxPtr ctx;
     xmlSecKeyPtr key;
     xmlSecSize i, keysSize;
     xmlDocPtr doc;
     xmlNodePtr cur;
-    xmlSecKeyDataPtr data;
-    xmlSecPtrListPtr idsList;
-    xmlSecKeyDataId dataId;
-    xmlSecSize idsSize, j;
     int ret;
 
     xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
     xmlSecAssert2(filename != NULL, -1);
 
-    list = xmlSecSimpleKeysStoreGetList(store);
-    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), -1);
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(xmlSecPtrListCheckId(&(ctx->keys), xmlSecKeyPtrListId), -1);
 
     /* create doc */
     doc = xmlSecCreateTree(BAD_CAST "Keys", xmlSecNs);
@@ -518,14 +710,19 @@ xmlSecSimpleKeysStoreSave(xmlSecKeyStorePtr store, const char *filename, xmlSecK
         return(-1);
     }
 
-    idsList = xmlSecKeyDataIdsGet();
-    xmlSecAssert2(idsList != NULL, -1);
-
-    keysSize = xmlSecPtrListGetSize(list);
-    idsSize = xmlSecPtrListGetSize(idsList);
+    keysSize = xmlSecSimpleKeysStoreGetKeysSize(ctx);
     for(i = 0; i < keysSize; ++i) {
-        key = (xmlSecKeyPtr)xmlSecPtrListGetItem(list, i);
-        xmlSecAssert2(key != NULL, -1);
+        key = xmlSecSimpleKeysStoreGetKeysItem(ctx, i);
+        if(key == NULL) {
+            if(i < xmlSecPtrListGetSize(&(ctx->keys))) {
+                continue;
+            }
+            /* don't lose the keys from a corrupted binary keys file */
+            xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_KEY_DATA, xmlSecKeyStoreGetName(store),
+                             "failed to read the key from the binary keys file");
+            xmlFreeDoc(doc);
+            return(-1);
+        }
 
         cur = xmlSecAddChild(xmlDocGetRootElement(doc), xmlSecNodeKeyInfo, xmlSecDSigNs);
         if(cur == NULL) {
@@ -537,64 +734,13 @@ xmlSecSimpleKeysStoreSave(xmlSecKeyStorePtr store, const char *filename, xmlSecK
             return(-1);
         }
 
-        /* special data key name */
-        if(xmlSecKeyGetName(key) != NULL) {
-            if(xmlSecAddChild(cur, xmlSecNodeKeyName, xmlSecDSigNs) == NULL) {
-                xmlSecInternalError2("xmlSecAddChild",
-                                     xmlSecKeyStoreGetName(store),
-                                     "node=%s",
-                                     xmlSecErrorsSafeString(xmlSecNodeKeyName));
-                xmlFreeDoc(doc);
-                return(-1);
-            }
-        }
-
-        /* create nodes for other keys data */
-        for(j = 0; j < idsSize; ++j) {
-            dataId = (xmlSecKeyDataId)xmlSecPtrListGetItem(idsList, j);
-            xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, -1);
-
-            if(dataId->dataNodeName == NULL) {
-                continue;
-            }
-
-            data = xmlSecKeyGetData(key, dataId);
-            if(data == NULL) {
-                continue;
-            }
-
-            if(xmlSecAddChild(cur, dataId->dataNodeName, dataId->dataNodeNs) == NULL) {
-                xmlSecInternalError2("xmlSecAddChild",
-                                     xmlSecKeyStoreGetName(store),
-                                    "node=%s", xmlSecErrorsSafeString(dataId->dataNodeName));
-                xmlFreeDoc(doc);
-                return(-1);
-            }
-        }
-
-        ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL);
-        if(ret < 0) {
-            xmlSecInternalError("xmlSecKeyInfoCtxInitialize",
-                                xmlSecKeyStoreGetName(store));
-            xmlFreeDoc(doc);
-            return(-1);
-        }
-
-        keyInfoCtx.mode                 = xmlSecKeyInfoModeWrite;
-        keyInfoCtx.keyReq.keyId         = xmlSecKeyDataIdUnknown;
-        keyInfoCtx.keyReq.keyType       = type;
-        keyInfoCtx.keyReq.keyUsage      = xmlSecKeyDataUsageAny;
-
-        /* finally write key in the node */
-        ret = xmlSecKeyInfoNodeWrite(cur, key, &keyInfoCtx);
+        ret = xmlSecSimpleKeysStoreWriteKeyInfo(store, cur, key, type);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecKeyInfoNodeWrite",
+            xmlSecInternalError("xmlSecSimpleKeysStoreWriteKeyInfo",
                                 xmlSecKeyStoreGetName(store));
-            xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
             xmlFreeDoc(doc);
             return(-1);
         }
-        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
     }
 
     /* now write result */
@@ -610,38 +756,303 @@ xmlSecSimpleKeysStoreSave(xmlSecKeyStorePtr store, const char *filename, xmlSecK
     return(0);
 }
 
+/**
+ * xmlSecSimpleKeysStoreLoadBinary:
+ * @store:              the pointer to simple keys store.
+ * @filename:           the binary keys filename.
+ * @keysMngr:           the pointer to associated keys manager.
+ *
+ * Maps a binary keys file created with #xmlSecSimpleKeysStoreSaveBinary
+ * into the @store. Only the file header, the keys table and the indexes
+ * are verified here: each key is read from the file (and its checksum is
+ * verified) when it is found by the lookup for the first time.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecSimpleKeysStoreLoadBinary(xmlSecKeyStorePtr store, const char *filename,
+                            xmlSecKeysMngrPtr keysMngr ATTRIBUTE_UNUSED) {
+    xmlSecSimpleKeysStoreCtxPtr ctx;
+    xmlSecSimpleKeysStoreMappedPtr mapped;
+    xmlSecSimpleKeysStoreMappedPtr* last;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
+    xmlSecAssert2(filename != NULL, -1);
+    UNREFERENCED_PARAMETER(keysMngr);
+
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    mapped = xmlSecSimpleKeysStoreMappedCreate(filename);
+    if(mapped == NULL) {
+        xmlSecInternalError2("xmlSecSimpleKeysStoreMappedCreate",
+                             xmlSecKeyStoreGetName(store),
+                             "filename=%s", xmlSecErrorsSafeString(filename));
+        return(-1);
+    }
+
+    /* keep the files in the load order */
+    for(last = &(ctx->mapped); (*last) != NULL; last = &((*last)->next));
+    (*last) = mapped;
+    return(0);
+}
+
+/**
+ * xmlSecSimpleKeysStoreSaveBinary:
+ * @store:              the pointer to simple keys store.
+ * @filename:           the filename.
+ * @type:               the saved keys type (public, private, ...).
+ *
+ * Writes keys from @store to a binary keys file that can be loaded with
+ * #xmlSecSimpleKeysStoreLoadBinary. The keys with a key data klass that
+ * supports binary format and without additional key data (e.g. certificates)
+ * are stored in the key data binary format, all other keys are stored
+ * as <dsig:KeyInfo/> elements.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecSimpleKeysStoreSaveBinary(xmlSecKeyStorePtr store, const char *filename, xmlSecKeyDataType type) {
+    xmlSecSimpleKeysStoreCtxPtr ctx;
+    xmlSecSimpleKeysStoreBinEntryPtr entries = NULL;
+    xmlSecSimpleKeysStoreBinIndexItemPtr names = NULL;
+    xmlSecSimpleKeysStoreBinIndexItemPtr klasses = NULL;
+    xmlSecBuffer buffer;
+    xmlSecByte* data;
+    xmlSecKeyPtr key;
+    xmlSecSize keysSize, count, namesCount, offset, size, maxSize, len, ii;
+    FILE* f = NULL;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
+    xmlSecAssert2(filename != NULL, -1);
+
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    ret = xmlSecBufferInitialize(&buffer, 0);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferInitialize",
+                            xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+
+    keysSize = xmlSecSimpleKeysStoreGetKeysSize(ctx);
+    if(keysSize > 0) {
+        entries = (xmlSecSimpleKeysStoreBinEntryPtr)xmlMalloc(keysSize * sizeof(xmlSecSimpleKeysStoreBinEntry));
+        names = (xmlSecSimpleKeysStoreBinIndexItemPtr)xmlMalloc(keysSize * sizeof(xmlSecSimpleKeysStoreBinIndexItem));
+        klasses = (xmlSecSimpleKeysStoreBinIndexItemPtr)xmlMalloc(keysSize * sizeof(xmlSecSimpleKeysStoreBinIndexItem));
+        if((entries == NULL) || (names == NULL) || (klasses == NULL)) {
+            xmlSecMallocError(keysSize * sizeof(xmlSecSimpleKeysStoreBinEntry),
+                              xmlSecKeyStoreGetName(store));
+            goto done;
+        }
+        memset(entries, 0, keysSize * sizeof(xmlSecSimpleKeysStoreBinEntry));
+    }
+
+    /* get the keys data */
+    for(ii = 0, count = 0, namesCount = 0; ii < keysSize; ++ii) {
+        key = xmlSecSimpleKeysStoreGetKeysItem(ctx, ii);
+        if((key == NULL) && (ii >= xmlSecPtrListGetSize(&(ctx->keys)))) {
+            xmlSecOtherError(XMLSEC_ERRORS_R_INVALID_KEY_DATA, xmlSecKeyStoreGetName(store),
+                             "failed to read the key from the binary keys file");
+            goto done;
+        }
+        if((key == NULL) || (key->value == NULL) || (key->value->id->name == NULL)) {
+            continue;
+        }
+
+        ret = xmlSecSimpleKeysStoreBinEntryWrite(store, key, type, &(entries[count]));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecSimpleKeysStoreBinEntryWrite",
+                                xmlSecKeyStoreGetName(store));
+            goto done;
+        }
+        if(entries[count].data == NULL) {
+            /* nothing to write for this key type */
+            continue;
+        }
+
+        if(entries[count].name != NULL) {
+            names[namesCount].str = entries[count].name;
+            names[namesCount].pos = count;
+            ++namesCount;
+        }
+        klasses[count].str = entries[count].klass;
+        klasses[count].pos = count;
+        ++count;
+    }
+    if(count > 0) {
+        qsort(names, namesCount, sizeof(xmlSecSimpleKeysStoreBinIndexItem), xmlSecSimpleKeysStoreBinIndexCompare);
+        qsort(klasses, count, sizeof(xmlSecSimpleKeysStoreBinIndexItem), xmlSecSimpleKeysStoreBinIndexCompare);
+    }
+
+    /* layout: header, keys table, names index, klasses index, strings and key data;
+     * the file size must fit into 4 bytes (and into xmlSecSize) */
+    maxSize = (xmlSecSize)XMLSEC_SIMPLE_KEYS_STORE_BIN_MAX_SIZE;
+    if(count > (maxSize - XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE) / (XMLSEC_SIMPLE_KEYS_STORE_BIN_ENTRY_SIZE + 8)) {
+        xmlSecInvalidSizeMoreThanError("Binary keys file keys count", count,
+                                       (maxSize - XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE) / (XMLSEC_SIMPLE_KEYS_STORE_BIN_ENTRY_SIZE + 8),
+                                       xmlSecKeyStoreGetName(store));
+        goto done;
+    }
+    offset = XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE +
+             count * XMLSEC_SIMPLE_KEYS_STORE_BIN_ENTRY_SIZE +
+             (namesCount + count) * 4;
+    for(size = offset, ii = 0; ii < count; ++ii) {
+        len = xmlStrlen(entries[ii].klass) + 1;
+        if(entries[ii].name != NULL) {
+            len += xmlStrlen(entries[ii].name) + 1;
+        }
+        if((len > maxSize - size) || (entries[ii].dataSize > maxSize - size - len)) {
+            xmlSecInvalidSizeMoreThanError("Binary keys file", size,
+                                           maxSize,
+                                           xmlSecKeyStoreGetName(store));
+            goto done;
+        }
+        size += len + entries[ii].dataSize;
+    }
+
+    ret = xmlSecBufferSetSize(&buffer, size);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecBufferSetSize", xmlSecKeyStoreGetName(store),
+                             "size=%d", size);
+        goto done;
+    }
+    data = xmlSecBufferGetData(&buffer);
+    xmlSecAssert2(data != NULL, -1);
+    memset(data, 0, size);
+
+    memcpy(data, XMLSEC_SIMPLE_KEYS_STORE_BIN_MAGIC, XMLSEC_SIMPLE_KEYS_STORE_BIN_MAGIC_SIZE);
+    xmlSecSimpleKeysStoreBinSetInt(data + 8, XMLSEC_SIMPLE_KEYS_STORE_BIN_VERSION);
+    xmlSecSimpleKeysStoreBinSetInt(data + 12, count);
+    xmlSecSimpleKeysStoreBinSetInt(data + 16, namesCount);
+    xmlSecSimpleKeysStoreBinSetInt(data + 20, size);
+
+    for(ii = 0; ii < count; ++ii) {
+        xmlSecByte* entry = xmlSecSimpleKeysStoreBinGetEntry(data, ii);
+
+        if(entries[ii].name != NULL) {
+            len = xmlStrlen(entries[ii].name);
+            xmlSecSimpleKeysStoreBinSetInt(entry + 0, offset);
+            xmlSecSimpleKeysStoreBinSetInt(entry + 4, len);
+            memcpy(data + offset, entries[ii].name, len);
+            offset += len + 1;
+        }
+
+        len = xmlStrlen(entries[ii].klass);
+        xmlSecSimpleKeysStoreBinSetInt(entry + 8, offset);
+        xmlSecSimpleKeysStoreBinSetInt(entry + 12, len);
+        memcpy(data + offset, entries[ii].klass, len);
+        offset += len + 1;
+
+        xmlSecSimpleKeysStoreBinSetInt(entry + 16, entries[ii].format);
+        xmlSecSimpleKeysStoreBinSetInt(entry + 20, offset);
+        xmlSecSimpleKeysStoreBinSetInt(entry + 24, entries[ii].dataSize);
+        memcpy(data + offset, entries[ii].data, entries[ii].dataSize);
+        offset += entries[ii].dataSize;
+
+        xmlSecSimpleKeysStoreBinSetInt(entry + 28, xmlSecSimpleKeysStoreBinEntryChecksum(data, entry));
+    }
+    xmlSecAssert2(offset == size, -1);
+
+    offset = XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE + count * XMLSEC_SIMPLE_KEYS_STORE_BIN_ENTRY_SIZE;
+    for(ii = 0; ii < namesCount; ++ii, offset += 4) {
+        xmlSecSimpleKeysStoreBinSetInt(data + offset, names[ii].pos);
+    }
+    for(ii = 0; ii < count; ++ii, offset += 4) {
+        xmlSecSimpleKeysStoreBinSetInt(data + offset, klasses[ii].pos);
+    }
+
+    xmlSecSimpleKeysStoreBinSetInt(data + 24,
+        xmlSecSimpleKeysStoreBinChecksum(1, data + XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE,
+                                         offset - XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE));
+
+    /* now write result */
+#ifndef _MSC_VER
+    f = fopen(filename, "wb");
+#else
+    fopen_s(&f, filename, "wb");
+#endif /* _MSC_VER */
+    if(f == NULL) {
+        xmlSecIOError("fopen", filename, xmlSecKeyStoreGetName(store));
+        goto done;
+    }
+    if(fwrite(data, 1, size, f) != size) {
+        xmlSecIOError("fwrite", filename, xmlSecKeyStoreGetName(store));
+        fclose(f);
+        goto done;
+    }
+    if(fclose(f) != 0) {
+        xmlSecIOError("fclose", filename, xmlSecKeyStoreGetName(store));
+        goto done;
+    }
+
+    /* success */
+    res = 0;
+
+done:
+    if(entries != NULL) {
+        for(ii = 0; ii < keysSize; ++ii) {
+            if(entries[ii].data != NULL) {
+                xmlFree(entries[ii].data);
+            }
+        }
+        xmlFree(entries);
+    }
+    if(names != NULL) {
+        xmlFree(names);
+    }
+    if(klasses != NULL) {
+        xmlFree(klasses);
+    }
+    xmlSecBufferFinalize(&buffer);
+    return(res);
+}
+
 /**
  * xmlSecSimpleKeysStoreGetKeys:
  * @store:              the pointer to simple keys store.
  *
- * Gets list of keys from simple keys store.
+ * Gets list of keys from simple keys store. The keys loaded from
+ * binary keys files are not in this list. The keys index is not used
+ * for the lookups after this call (the caller might change the list)
+ * until the next #xmlSecSimpleKeysStoreAdoptKey call rebuilds it.
  *
  * Returns: pointer to the list of keys stored in the keys store or NULL
  * if an error occurs.
  */
 xmlSecPtrListPtr
 xmlSecSimpleKeysStoreGetKeys(xmlSecKeyStorePtr store) {
+    xmlSecSimpleKeysStoreCtxPtr ctx;
     xmlSecPtrListPtr list;
 
     xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), NULL);
 
-    list = xmlSecSimpleKeysStoreGetList(store);
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    list = &(ctx->keys);
     xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), NULL);
 
+    /* the list might be changed by the caller */
+    ++(ctx->generation);
     return list;
 }
 
 static int
 xmlSecSimpleKeysStoreInitialize(xmlSecKeyStorePtr store) {
-    xmlSecPtrListPtr list;
+    xmlSecSimpleKeysStoreCtxPtr ctx;
     int ret;
 
     xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), -1);
 
-    list = xmlSecSimpleKeysStoreGetList(store);
-    xmlSecAssert2(list != NULL, -1);
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
 
-    ret = xmlSecPtrListInitialize(list, xmlSecKeyPtrListId);
+    memset(ctx, 0, sizeof(xmlSecSimpleKeysStoreCtx));
+    ret = xmlSecPtrListInitialize(&(ctx->keys), xmlSecKeyPtrListId);
     if(ret < 0) {
         xmlSecInternalError("xmlSecPtrListInitialize(xmlSecKeyPtrListId)",
                             xmlSecKeyStoreGetName(store));
@@ -653,36 +1064,895 @@ xmlSecSimpleKeysStoreInitialize(xmlSecKeyStorePtr store) {
 
 static void
 xmlSecSimpleKeysStoreFinalize(xmlSecKeyStorePtr store) {
-    xmlSecPtrListPtr list;
+    xmlSecSimpleKeysStoreCtxPtr ctx;
 
     xmlSecAssert(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId));
 
-    list = xmlSecSimpleKeysStoreGetList(store);
-    xmlSecAssert(list != NULL);
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert(ctx != NULL);
 
-    xmlSecPtrListFinalize(list);
+    while(ctx->mapped != NULL) {
+        xmlSecSimpleKeysStoreMappedPtr mapped = ctx->mapped;
+
+        ctx->mapped = mapped->next;
+        xmlSecSimpleKeysStoreMappedDestroy(mapped);
+    }
+    xmlSecSimpleKeysStoreIndexReset(ctx);
+    xmlSecPtrListFinalize(&(ctx->keys));
+    memset(ctx, 0, sizeof(xmlSecSimpleKeysStoreCtx));
 }
 
+/*
+ * Returns the key shared with the store if XMLSEC_KEYINFO_FLAGS_SHARED_KEYS
+ * flag is set (callers must not modify it, see xmlSecKeyRef) or a copy.
+ */
 static xmlSecKeyPtr
 xmlSecSimpleKeysStoreFindKey(xmlSecKeyStorePtr store, const xmlChar* name,
                             xmlSecKeyInfoCtxPtr keyInfoCtx) {
-    xmlSecPtrListPtr list;
+    xmlSecSimpleKeysStoreCtxPtr ctx;
+    xmlSecSimpleKeysStoreMappedPtr mapped;
     xmlSecKeyPtr key;
-    xmlSecSize pos, size;
 
     xmlSecAssert2(xmlSecKeyStoreCheckId(store, xmlSecSimpleKeysStoreId), NULL);
     xmlSecAssert2(keyInfoCtx != NULL, NULL);
 
-    list = xmlSecSimpleKeysStoreGetList(store);
-    xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecKeyPtrListId), NULL);
+    ctx = xmlSecSimpleKeysStoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(xmlSecPtrListCheckId(&(ctx->keys), xmlSecKeyPtrListId), NULL);
 
-    size = xmlSecPtrListGetSize(list);
-    for(pos = 0; pos < size; ++pos) {
-        key = (xmlSecKeyPtr)xmlSecPtrListGetItem(list, pos);
+    key = xmlSecSimpleKeysStoreListFindKey(ctx, name, keyInfoCtx);
+    for(mapped = ctx->mapped; (key == NULL) && (mapped != NULL); mapped = mapped->next) {
+        key = xmlSecSimpleKeysStoreMappedFindKey(mapped, name, keyInfoCtx);
+    }
+    if(key == NULL) {
+        return(NULL);
+    }
+
+    if((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_SHARED_KEYS) != 0) {
+        return(xmlSecKeyRef(key));
+    }
+    return(xmlSecKeyDuplicate(key));
+}
+
+static xmlSecKeyPtr
+xmlSecSimpleKeysStoreListFindKey(xmlSecSimpleKeysStoreCtxPtr ctx, const xmlChar* name,
+                            xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    const xmlSecSize* pos;
+    xmlSecKeyPtr key;
+    xmlSecSize ii, size;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
+    size = xmlSecPtrListGetSize(&(ctx->keys));
+
+    /* pick the candidates from the index if it is up to date */
+    if((ctx->indexedGeneration == ctx->generation) && (ctx->generation > 0) &&
+       ((name != NULL) || (keyInfoCtx->keyReq.keyId != xmlSecKeyDataIdUnknown))) {
+        if(name != NULL) {
+            pos = xmlSecPtrListIndexLookup(ctx->namesIndex, name, NULL, &size);
+        } else {
+            pos = xmlSecPtrListIndexLookup(ctx->idsIndex, keyInfoCtx->keyReq.keyId->name, NULL, &size);
+        }
+        for(ii = 0; ii < size; ++ii) {
+            key = (xmlSecKeyPtr)xmlSecPtrListGetItem(&(ctx->keys), pos[ii]);
+            if((key != NULL) && (xmlSecKeyMatch(key, name, &(keyInfoCtx->keyReq)) == 1)) {
+                return(key);
+            }
+        }
+        return(NULL);
+    }
+
+    for(ii = 0; ii < size; ++ii) {
+        key = (xmlSecKeyPtr)xmlSecPtrListGetItem(&(ctx->keys), ii);
         if((key != NULL) && (xmlSecKeyMatch(key, name, &(keyInfoCtx->keyReq)) == 1)) {
-            return(xmlSecKeyDuplicate(key));
+            return(key);
+        }
+    }
+    return(NULL);
+}
+
+static int
+xmlSecSimpleKeysStoreIndexAdd(xmlSecSimpleKeysStoreCtxPtr ctx, xmlSecKeyPtr key, xmlSecSize pos) {
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    if(key->name != NULL) {
+        ret = xmlSecPtrListIndexAdd(&(ctx->namesIndex), key->name, NULL, pos);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecPtrListIndexAdd(name)", NULL);
+            return(-1);
+        }
+    }
+    if((key->value != NULL) && (key->value->id != NULL) && (key->value->id->name != NULL)) {
+        ret = xmlSecPtrListIndexAdd(&(ctx->idsIndex), key->value->id->name, NULL, pos);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecPtrListIndexAdd(id)", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static int
+xmlSecSimpleKeysStoreIndexBuild(xmlSecSimpleKeysStoreCtxPtr ctx) {
+    xmlSecKeyPtr key;
+    xmlSecSize pos, size;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+
+    xmlSecSimpleKeysStoreIndexReset(ctx);
+
+    size = xmlSecPtrListGetSize(&(ctx->keys));
+    for(pos = 0; pos < size; ++pos) {
+        key = (xmlSecKeyPtr)xmlSecPtrListGetItem(&(ctx->keys), pos);
+        if(key == NULL) {
+            continue;
+        }
+        ret = xmlSecSimpleKeysStoreIndexAdd(ctx, key, pos);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecSimpleKeysStoreIndexAdd", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static void
+xmlSecSimpleKeysStoreIndexReset(xmlSecSimpleKeysStoreCtxPtr ctx) {
+    xmlSecAssert(ctx != NULL);
+
+    xmlSecPtrListIndexDestroy(ctx->namesIndex);
+    ctx->namesIndex = NULL;
+    xmlSecPtrListIndexDestroy(ctx->idsIndex);
+    ctx->idsIndex = NULL;
+    ctx->indexedGeneration = 0;
+}
+
+
+/* the keys list followed by the keys from the binary keys files */
+static xmlSecSize
+xmlSecSimpleKeysStoreGetKeysSize(xmlSecSimpleKeysStoreCtxPtr ctx) {
+    xmlSecSimpleKeysStoreMappedPtr mapped;
+    xmlSecSize size;
+
+    xmlSecAssert2(ctx != NULL, 0);
+
+    size = xmlSecPtrListGetSize(&(ctx->keys));
+    for(mapped = ctx->mapped; mapped != NULL; mapped = mapped->next) {
+        size += mapped->count;
+    }
+    return(size);
+}
+
+static xmlSecKeyPtr
+xmlSecSimpleKeysStoreGetKeysItem(xmlSecSimpleKeysStoreCtxPtr ctx, xmlSecSize pos) {
+    xmlSecSimpleKeysStoreMappedPtr mapped;
+    xmlSecSize size;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    size = xmlSecPtrListGetSize(&(ctx->keys));
+    if(pos < size) {
+        return((xmlSecKeyPtr)xmlSecPtrListGetItem(&(ctx->keys), pos));
+    }
+    for(pos -= size, mapped = ctx->mapped; mapped != NULL; pos -= mapped->count, mapped = mapped->next) {
+        if(pos < mapped->count) {
+            return(xmlSecSimpleKeysStoreMappedGetKey(mapped, pos));
         }
     }
     return(NULL);
 }
 
+static int
+xmlSecSimpleKeysStoreWriteKeyInfo(xmlSecKeyStorePtr store, xmlNodePtr cur,
+                                  xmlSecKeyPtr key, xmlSecKeyDataType type) {
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecKeyDataPtr data;
+    xmlSecPtrListPtr idsList;
+    xmlSecKeyDataId dataId;
+    xmlSecSize idsSize, j;
+    int ret;
+
+    xmlSecAssert2(store != NULL, -1);
+    xmlSecAssert2(cur != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+
+    idsList = xmlSecKeyDataIdsGet();
+    xmlSecAssert2(idsList != NULL, -1);
+    idsSize = xmlSecPtrListGetSize(idsList);
+
+    /* special data key name */
+    if(xmlSecKeyGetName(key) != NULL) {
+        if(xmlSecAddChild(cur, xmlSecNodeKeyName, xmlSecDSigNs) == NULL) {
+            xmlSecInternalError2("xmlSecAddChild",
+                                 xmlSecKeyStoreGetName(store),
+                                 "node=%s",
+                                 xmlSecErrorsSafeString(xmlSecNodeKeyName));
+            return(-1);
+        }
+    }
+
+    /* create nodes for other keys data */
+    for(j = 0; j < idsSize; ++j) {
+        dataId = (xmlSecKeyDataId)xmlSecPtrListGetItem(idsList, j);
+        xmlSecAssert2(dataId != xmlSecKeyDataIdUnknown, -1);
+
+        if(dataId->dataNodeName == NULL) {
+            continue;
+        }
+
+        data = xmlSecKeyGetData(key, dataId);
+        if(data == NULL) {
+            continue;
+        }
+
+        if(xmlSecAddChild(cur, dataId->dataNodeName, dataId->dataNodeNs) == NULL) {
+            xmlSecInternalError2("xmlSecAddChild",
+                                 xmlSecKeyStoreGetName(store),
+                                "node=%s", xmlSecErrorsSafeString(dataId->dataNodeName));
+            return(-1);
+        }
+    }
+
+    ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyInfoCtxInitialize",
+                            xmlSecKeyStoreGetName(store));
+        return(-1);
+    }
+
+    keyInfoCtx.mode                 = xmlSecKeyInfoModeWrite;
+    keyInfoCtx.keyReq.keyId         = xmlSecKeyDataIdUnknown;
+    keyInfoCtx.keyReq.keyType       = type;
+    keyInfoCtx.keyReq.keyUsage      = xmlSecKeyDataUsageAny;
+
+    /* finally write key in the node */
+    ret = xmlSecKeyInfoNodeWrite(cur, key, &keyInfoCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyInfoNodeWrite",
+                            xmlSecKeyStoreGetName(store));
+        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+        return(-1);
+    }
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    return(0);
+}
+
+/****************************************************************************
+ *
+ * Binary keys files
+ *
+ ***************************************************************************/
+static xmlSecSize
+xmlSecSimpleKeysStoreBinGetInt(const xmlSecByte* data) {
+    xmlSecAssert2(data != NULL, 0);
+
+    return((((xmlSecSize)data[0]) << 24) | (((xmlSecSize)data[1]) << 16) |
+           (((xmlSecSize)data[2]) << 8) | ((xmlSecSize)data[3]));
+}
+
+static void
+xmlSecSimpleKeysStoreBinSetInt(xmlSecByte* data, xmlSecSize val) {
+    xmlSecAssert(data != NULL);
+
+    data[0] = (xmlSecByte)((val >> 24) & 0xFF);
+    data[1] = (xmlSecByte)((val >> 16) & 0xFF);
+    data[2] = (xmlSecByte)((val >> 8) & 0xFF);
+    data[3] = (xmlSecByte)(val & 0xFF);
+}
+
+/* Adler-32 of @data continued from the @adler value (1 for the new checksum) */
+static xmlSecSize
+xmlSecSimpleKeysStoreBinChecksum(xmlSecSize adler, const xmlSecByte* data, xmlSecSize size) {
+    unsigned long a = adler & 0xFFFF;
+    unsigned long b = (adler >> 16) & 0xFFFF;
+    xmlSecSize chunk;
+
+    xmlSecAssert2(data != NULL, 0);
+
+    while(size > 0) {
+        /* the largest chunk that can't overflow 32 bits sums */
+        chunk = (size < 5552) ? size : 5552;
+        size -= chunk;
+        for(; chunk > 0; --chunk, ++data) {
+            a += (*data);
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return((xmlSecSize)(((b << 16) | a) & 0xFFFFFFFFUL));
+}
+
+/* the entry strings and data offsets must be valid */
+static xmlSecSize
+xmlSecSimpleKeysStoreBinEntryChecksum(const xmlSecByte* data, const xmlSecByte* entry) {
+    xmlSecSize adler = 1;
+    xmlSecSize offset;
+
+    xmlSecAssert2(data != NULL, 0);
+    xmlSecAssert2(entry != NULL, 0);
+
+    offset = xmlSecSimpleKeysStoreBinGetInt(entry + 0);
+    if(offset != 0) {
+        adler = xmlSecSimpleKeysStoreBinChecksum(adler, data + offset, xmlSecSimpleKeysStoreBinGetInt(entry + 4));
+    }
+    adler = xmlSecSimpleKeysStoreBinChecksum(adler, data + xmlSecSimpleKeysStoreBinGetInt(entry + 8),
+                                             xmlSecSimpleKeysStoreBinGetInt(entry + 12));
+    adler = xmlSecSimpleKeysStoreBinChecksum(adler, data + xmlSecSimpleKeysStoreBinGetInt(entry + 20),
+                                             xmlSecSimpleKeysStoreBinGetInt(entry + 24));
+    return(adler);
+}
+
+static int
+xmlSecSimpleKeysStoreBinIndexCompare(const void* a, const void* b) {
+    const xmlSecSimpleKeysStoreBinIndexItem* item1 = (const xmlSecSimpleKeysStoreBinIndexItem*)a;
+    const xmlSecSimpleKeysStoreBinIndexItem* item2 = (const xmlSecSimpleKeysStoreBinIndexItem*)b;
+    int ret;
+
+    ret = xmlStrcmp(item1->str, item2->str);
+    if(ret != 0) {
+        return(ret);
+    }
+    return((item1->pos < item2->pos) ? -1 : ((item1->pos > item2->pos) ? 1 : 0));
+}
+
+static int
+xmlSecSimpleKeysStoreBinEntryWrite(xmlSecKeyStorePtr store, xmlSecKeyPtr key,
+                                   xmlSecKeyDataType type,
+                                   xmlSecSimpleKeysStoreBinEntryPtr entry) {
+    xmlSecKeyDataId id;
+    int ret;
+
+    xmlSecAssert2(store != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(key->value != NULL, -1);
+    xmlSecAssert2(entry != NULL, -1);
+
+    id = key->value->id;
+    memset(entry, 0, sizeof(xmlSecSimpleKeysStoreBinEntry));
+    entry->name  = xmlSecKeyGetName(key);
+    entry->klass = id->name;
+
+    if((id->binWrite != NULL) && ((key->dataList == NULL) || (xmlSecPtrListGetSize(key->dataList) == 0))) {
+        xmlSecKeyInfoCtx keyInfoCtx;
+
+        ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeyInfoCtxInitialize",
+                                xmlSecKeyStoreGetName(store));
+            return(-1);
+        }
+
+        keyInfoCtx.mode                 = xmlSecKeyInfoModeWrite;
+        keyInfoCtx.keyReq.keyId         = xmlSecKeyDataIdUnknown;
+        keyInfoCtx.keyReq.keyType       = type;
+        keyInfoCtx.keyReq.keyUsage      = xmlSecKeyDataUsageAny;
+
+        ret = xmlSecKeyDataBinWrite(id, key, &(entry->data), &(entry->dataSize), &keyInfoCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeyDataBinWrite",
+                                xmlSecKeyStoreGetName(store));
+            xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+            return(-1);
+        }
+        xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+        entry->format = XMLSEC_SIMPLE_KEYS_STORE_BIN_FORMAT_BINARY;
+    } else {
+        xmlDocPtr doc;
+        xmlChar* data = NULL;
+        int dataSize = 0;
+
+        doc = xmlSecCreateTree(xmlSecNodeKeyInfo, xmlSecDSigNs);
+        if(doc == NULL) {
+            xmlSecInternalError("xmlSecCreateTree",
+                                xmlSecKeyStoreGetName(store));
+            return(-1);
+        }
+
+        ret = xmlSecSimpleKeysStoreWriteKeyInfo(store, xmlDocGetRootElement(doc), key, type);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecSimpleKeysStoreWriteKeyInfo",
+                                xmlSecKeyStoreGetName(store));
+            xmlFreeDoc(doc);
+            return(-1);
+        }
+
+        xmlDocDumpMemory(doc, &data, &dataSize);
+        xmlFreeDoc(doc);
+        if((data == NULL) || (dataSize <= 0)) {
+            xmlSecXmlError("xmlDocDumpMemory", xmlSecKeyStoreGetName(store));
+            if(data != NULL) {
+                xmlFree(data);
+            }
+            return(-1);
+        }
+        entry->data     = (xmlSecByte*)data;
+        entry->dataSize = XMLSEC_SIZE_BAD_CAST(dataSize);
+        entry->format   = XMLSEC_SIMPLE_KEYS_STORE_BIN_FORMAT_KEYINFO;
+    }
+    return(0);
+}
+
+static int
+xmlSecSimpleKeysStoreIsBinaryFile(const char* filename) {
+    xmlSecByte magic[XMLSEC_SIMPLE_KEYS_STORE_BIN_MAGIC_SIZE];
+    FILE* f = NULL;
+    size_t len;
+
+    xmlSecAssert2(filename != NULL, -1);
+
+#ifndef _MSC_VER
+    f = fopen(filename, "rb");
+#else
+    fopen_s(&f, filename, "rb");
+#endif /* _MSC_VER */
+    if(f == NULL) {
+        /* not a local file: leave the error to the XML parser */
+        return(0);
+    }
+    len = fread(magic, 1, sizeof(magic), f);
+    fclose(f);
+
+    if((len != sizeof(magic)) || (memcmp(magic, XMLSEC_SIMPLE_KEYS_STORE_BIN_MAGIC, sizeof(magic)) != 0)) {
+        return(0);
+    }
+    return(1);
+}
+
+static xmlSecSimpleKeysStoreMappedPtr
+xmlSecSimpleKeysStoreMappedCreate(const char* filename) {
+    xmlSecSimpleKeysStoreMappedPtr mapped;
+    int ret;
+
+    xmlSecAssert2(filename != NULL, NULL);
+
+    mapped = (xmlSecSimpleKeysStoreMappedPtr)xmlMalloc(sizeof(xmlSecSimpleKeysStoreMapped));
+    if(mapped == NULL) {
+        xmlSecMallocError(sizeof(xmlSecSimpleKeysStoreMapped), NULL);
+        return(NULL);
+    }
+    memset(mapped, 0, sizeof(xmlSecSimpleKeysStoreMapped));
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+    {
+        struct stat st;
+        void* data;
+        int fd;
+
+        fd = open(filename, O_RDONLY);
+        if(fd < 0) {
+            xmlSecIOError("open", filename, NULL);
+            xmlSecSimpleKeysStoreMappedDestroy(mapped);
+            return(NULL);
+        }
+        if(fstat(fd, &st) != 0) {
+            xmlSecIOError("fstat", filename, NULL);
+            close(fd);
+            xmlSecSimpleKeysStoreMappedDestroy(mapped);
+            return(NULL);
+        }
+        if((st.st_size < XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE) ||
+           ((unsigned long)st.st_size > XMLSEC_SIMPLE_KEYS_STORE_BIN_MAX_SIZE)) {
+            xmlSecInvalidSizeOtherError("binary keys file size is invalid", NULL);
+            close(fd);
+            xmlSecSimpleKeysStoreMappedDestroy(mapped);
+            return(NULL);
+        }
+
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if(data == MAP_FAILED) {
+            xmlSecIOError("mmap", filename, NULL);
+            xmlSecSimpleKeysStoreMappedDestroy(mapped);
+            return(NULL);
+        }
+        mapped->data = (const xmlSecByte*)data;
+        mapped->size = (xmlSecSize)st.st_size;
+    }
+#else /* defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) */
+    mapped->buffer = xmlSecBufferCreate(0);
+    if(mapped->buffer == NULL) {
+        xmlSecInternalError("xmlSecBufferCreate", NULL);
+        xmlSecSimpleKeysStoreMappedDestroy(mapped);
+        return(NULL);
+    }
+    ret = xmlSecBufferReadFile(mapped->buffer, filename);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecBufferReadFile", NULL,
+                             "filename=%s", xmlSecErrorsSafeString(filename));
+        xmlSecSimpleKeysStoreMappedDestroy(mapped);
+        return(NULL);
+    }
+    mapped->data = xmlSecBufferGetData(mapped->buffer);
+    mapped->size = xmlSecBufferGetSize(mapped->buffer);
+#endif /* defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) */
+
+    ret = xmlSecSimpleKeysStoreMappedVerify(mapped, filename);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecSimpleKeysStoreMappedVerify", NULL,
+                             "filename=%s", xmlSecErrorsSafeString(filename));
+        xmlSecSimpleKeysStoreMappedDestroy(mapped);
+        return(NULL);
+    }
+
+    if(mapped->count > 0) {
+        mapped->keys = (xmlSecKeyPtr*)xmlMalloc(mapped->count * sizeof(xmlSecKeyPtr));
+        if(mapped->keys == NULL) {
+            xmlSecMallocError(mapped->count * sizeof(xmlSecKeyPtr), NULL);
+            xmlSecSimpleKeysStoreMappedDestroy(mapped);
+            return(NULL);
+        }
+        memset(mapped->keys, 0, mapped->count * sizeof(xmlSecKeyPtr));
+
+        mapped->states = (xmlSecByte*)xmlMalloc(mapped->count);
+        if(mapped->states == NULL) {
+            xmlSecMallocError(mapped->count, NULL);
+            xmlSecSimpleKeysStoreMappedDestroy(mapped);
+            return(NULL);
+        }
+        memset(mapped->states, 0, mapped->count);
+    }
+
+    mapped->mutex = xmlNewMutex();
+    if(mapped->mutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        xmlSecSimpleKeysStoreMappedDestroy(mapped);
+        return(NULL);
+    }
+    return(mapped);
+}
+
+static void
+xmlSecSimpleKeysStoreMappedDestroy(xmlSecSimpleKeysStoreMappedPtr mapped) {
+    xmlSecSize ii;
+
+    xmlSecAssert(mapped != NULL);
+
+    if(mapped->keys != NULL) {
+        for(ii = 0; ii < mapped->count; ++ii) {
+            if(mapped->keys[ii] != NULL) {
+                xmlSecKeyDestroy(mapped->keys[ii]);
+            }
+        }
+        xmlFree(mapped->keys);
+    }
+    if(mapped->states != NULL) {
+        xmlFree(mapped->states);
+    }
+    if(mapped->mutex != NULL) {
+        xmlFreeMutex(mapped->mutex);
+    }
+    if(mapped->buffer != NULL) {
+        xmlSecBufferDestroy(mapped->buffer);
+    }
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+    else if(mapped->data != NULL) {
+        munmap((void*)mapped->data, (size_t)mapped->size);
+    }
+#endif /* defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) */
+    memset(mapped, 0, sizeof(xmlSecSimpleKeysStoreMapped));
+    xmlFree(mapped);
+}
+
+/* checks that the string at @strOffset has @strSize bytes and is zero terminated */
+#define xmlSecSimpleKeysStoreMappedCheckString(mapped, strOffset, strSize) \
+    (((strOffset) >= XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE) && \
+     ((strOffset) < (mapped)->size) && \
+     ((strSize) < (mapped)->size - (strOffset)) && \
+     ((mapped)->data[(strOffset) + (strSize)] == '\0'))
+
+static int
+xmlSecSimpleKeysStoreMappedVerify(xmlSecSimpleKeysStoreMappedPtr mapped, const char* filename) {
+    const xmlSecByte* data;
+    const xmlSecByte* entry;
+    xmlSecSize size, count, namesCount, tablesSize, offset, len, pos, ii;
+
+    xmlSecAssert2(mapped != NULL, -1);
+    xmlSecAssert2(mapped->data != NULL, -1);
+
+    data = mapped->data;
+    size = mapped->size;
+    if((size < XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE) ||
+       (memcmp(data, XMLSEC_SIMPLE_KEYS_STORE_BIN_MAGIC, XMLSEC_SIMPLE_KEYS_STORE_BIN_MAGIC_SIZE) != 0)) {
+        xmlSecInvalidDataError("binary keys file magic is invalid", NULL);
+        return(-1);
+    }
+    if(xmlSecSimpleKeysStoreBinGetInt(data + 8) != XMLSEC_SIMPLE_KEYS_STORE_BIN_VERSION) {
+        xmlSecInvalidIntegerDataError("version", xmlSecSimpleKeysStoreBinGetInt(data + 8),
+                                      "1", NULL);
+        return(-1);
+    }
+    if(xmlSecSimpleKeysStoreBinGetInt(data + 20) != size) {
+        xmlSecInvalidSizeError("Binary keys file", size,
+                               xmlSecSimpleKeysStoreBinGetInt(data + 20), NULL);
+        return(-1);
+    }
+    count = xmlSecSimpleKeysStoreBinGetInt(data + 12);
+    namesCount = xmlSecSimpleKeysStoreBinGetInt(data + 16);
+    if((count > size / XMLSEC_SIMPLE_KEYS_STORE_BIN_ENTRY_SIZE) || (namesCount > count)) {
+        xmlSecInvalidSizeOtherError("binary keys file keys count is invalid", NULL);
+        return(-1);
+    }
+    tablesSize = XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE +
+                 count * XMLSEC_SIMPLE_KEYS_STORE_BIN_ENTRY_SIZE +
+                 (namesCount + count) * 4;
+    if(tablesSize > size) {
+        xmlSecInvalidSizeLessThanError("Binary keys file", size, tablesSize, NULL);
+        return(-1);
+    }
+    if(xmlSecSimpleKeysStoreBinGetInt(data + 24) !=
+       xmlSecSimpleKeysStoreBinChecksum(1, data + XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE,
+                                        tablesSize - XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE)) {
+        xmlSecOtherError2(XMLSEC_ERRORS_R_INVALID_DATA, NULL,
+                          "binary keys file checksum mismatch: filename=%s",
+                          xmlSecErrorsSafeString(filename));
+        return(-1);
+    }
+    mapped->count = count;
+    mapped->namesCount = namesCount;
+
+    for(ii = 0; ii < count; ++ii) {
+        entry = xmlSecSimpleKeysStoreBinGetEntry(data, ii);
+
+        offset = xmlSecSimpleKeysStoreBinGetInt(entry + 0);
+        len = xmlSecSimpleKeysStoreBinGetInt(entry + 4);
+        if((offset != 0) && !xmlSecSimpleKeysStoreMappedCheckString(mapped, offset, len)) {
+            xmlSecInvalidDataError("binary keys file key name is invalid", NULL);
+            return(-1);
+        }
+
+        offset = xmlSecSimpleKeysStoreBinGetInt(entry + 8);
+        len = xmlSecSimpleKeysStoreBinGetInt(entry + 12);
+        if(!xmlSecSimpleKeysStoreMappedCheckString(mapped, offset, len)) {
+            xmlSecInvalidDataError("binary keys file key klass is invalid", NULL);
+            return(-1);
+        }
+
+        pos = xmlSecSimpleKeysStoreBinGetInt(entry + 16);
+        if((pos != XMLSEC_SIMPLE_KEYS_STORE_BIN_FORMAT_BINARY) && (pos != XMLSEC_SIMPLE_KEYS_STORE_BIN_FORMAT_KEYINFO)) {
+            xmlSecInvalidIntegerDataError("format", pos, "supported key format", NULL);
+            return(-1);
+        }
+
+        offset = xmlSecSimpleKeysStoreBinGetInt(entry + 20);
+        len = xmlSecSimpleKeysStoreBinGetInt(entry + 24);
+        if((offset < tablesSize) || (offset > size) || (len > size - offset)) {
+            xmlSecInvalidDataError("binary keys file key data is invalid", NULL);
+            return(-1);
+        }
+    }
+
+    offset = XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE + count * XMLSEC_SIMPLE_KEYS_STORE_BIN_ENTRY_SIZE;
+    for(ii = 0; ii < namesCount + count; ++ii, offset += 4) {
+        pos = xmlSecSimpleKeysStoreBinGetInt(data + offset);
+        if(pos >= count) {
+            xmlSecInvalidDataError("binary keys file index is invalid", NULL);
+            return(-1);
+        }
+        if((ii < namesCount) && (xmlSecSimpleKeysStoreBinGetInt(xmlSecSimpleKeysStoreBinGetEntry(data, pos)) == 0)) {
+            xmlSecInvalidDataError("binary keys file names index is invalid", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static xmlSecKeyPtr
+xmlSecSimpleKeysStoreMappedGetKey(xmlSecSimpleKeysStoreMappedPtr mapped, xmlSecSize pos) {
+    xmlSecKeyPtr key, found;
+    xmlSecByte state;
+
+    xmlSecAssert2(mapped != NULL, NULL);
+    xmlSecAssert2(mapped->keys != NULL, NULL);
+    xmlSecAssert2(mapped->states != NULL, NULL);
+    xmlSecAssert2(pos < mapped->count, NULL);
+
+    xmlMutexLock(mapped->mutex);
+    state = mapped->states[pos];
+    key = mapped->keys[pos];
+    xmlMutexUnlock(mapped->mutex);
+    if(state != 0) {
+        return(key);
+    }
+
+    /* read the key without holding the lock, the first thread to finish wins */
+    key = xmlSecSimpleKeysStoreMappedReadKey(mapped, pos);
+
+    xmlMutexLock(mapped->mutex);
+    if(mapped->states[pos] == 0) {
+        mapped->keys[pos] = key;
+        mapped->states[pos] = (key != NULL) ? 1 : 2;
+        key = NULL;
+    }
+    found = mapped->keys[pos];
+    xmlMutexUnlock(mapped->mutex);
+
+    if(key != NULL) {
+        xmlSecKeyDestroy(key);
+    }
+    return(found);
+}
+
+static xmlSecKeyPtr
+xmlSecSimpleKeysStoreMappedReadKey(xmlSecSimpleKeysStoreMappedPtr mapped, xmlSecSize pos) {
+    const xmlSecByte* entry;
+    const xmlChar* name;
+    const xmlChar* klass;
+    const xmlSecByte* data;
+    xmlSecSize dataSize, offset;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecKeyPtr key;
+    int ret;
+
+    xmlSecAssert2(mapped != NULL, NULL);
+    xmlSecAssert2(pos < mapped->count, NULL);
+
+    entry = xmlSecSimpleKeysStoreBinGetEntry(mapped->data, pos);
+    offset = xmlSecSimpleKeysStoreBinGetInt(entry + 0);
+    name = (offset != 0) ? (const xmlChar*)(mapped->data + offset) : NULL;
+    klass = (const xmlChar*)(mapped->data + xmlSecSimpleKeysStoreBinGetInt(entry + 8));
+    data = mapped->data + xmlSecSimpleKeysStoreBinGetInt(entry + 20);
+    dataSize = xmlSecSimpleKeysStoreBinGetInt(entry + 24);
+
+    if(xmlSecSimpleKeysStoreBinGetInt(entry + 28) != xmlSecSimpleKeysStoreBinEntryChecksum(mapped->data, entry)) {
+        xmlSecOtherError2(XMLSEC_ERRORS_R_INVALID_DATA, NULL,
+                          "binary keys file key checksum mismatch: klass=%s",
+                          xmlSecErrorsSafeString(klass));
+        return(NULL);
+    }
+
+    key = xmlSecKeyCreate();
+    if(key == NULL) {
+        xmlSecInternalError("xmlSecKeyCreate", NULL);
+        return(NULL);
+    }
+
+    ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecKeyInfoCtxInitialize", NULL);
+        xmlSecKeyDestroy(key);
+        return(NULL);
+    }
+
+    keyInfoCtx.mode           = xmlSecKeyInfoModeRead;
+    keyInfoCtx.keysMngr       = NULL;
+    keyInfoCtx.flags          = XMLSEC_KEYINFO_FLAGS_DONT_STOP_ON_KEY_FOUND |
+                                XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS;
+    keyInfoCtx.keyReq.keyId   = xmlSecKeyDataIdUnknown;
+    keyInfoCtx.keyReq.keyType = xmlSecKeyDataTypeAny;
+    keyInfoCtx.keyReq.keyUsage= xmlSecKeyDataUsageAny;
+
+    if(xmlSecSimpleKeysStoreBinGetInt(entry + 16) == XMLSEC_SIMPLE_KEYS_STORE_BIN_FORMAT_BINARY) {
+        xmlSecKeyDataId id;
+
+        id = xmlSecKeyDataIdListFindByName(xmlSecKeyDataIdsGet(), klass, xmlSecKeyDataUsageAny);
+        if(id == xmlSecKeyDataIdUnknown) {
+            xmlSecInternalError2("xmlSecKeyDataIdListFindByName", NULL,
+                                 "klass=%s", xmlSecErrorsSafeString(klass));
+            xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+            xmlSecKeyDestroy(key);
+            return(NULL);
+        }
+
+        ret = xmlSecKeyDataBinRead(id, key, data, dataSize, &keyInfoCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeyDataBinRead",
+                                xmlSecKeyDataKlassGetName(id));
+            xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+            xmlSecKeyDestroy(key);
+            return(NULL);
+        }
+
+        if(name != NULL) {
+            ret = xmlSecKeySetName(key, name);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecKeySetName", NULL);
+                xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+                xmlSecKeyDestroy(key);
+                return(NULL);
+            }
+        }
+    } else {
+        xmlDocPtr doc;
+        xmlNodePtr root;
+
+        doc = xmlSecParseMemory(data, dataSize, 0);
+        if(doc == NULL) {
+            xmlSecInternalError("xmlSecParseMemory", NULL);
+            xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+            xmlSecKeyDestroy(key);
+            return(NULL);
+        }
+
+        root = xmlDocGetRootElement(doc);
+        if(!xmlSecCheckNodeName(root, xmlSecNodeKeyInfo, xmlSecDSigNs)) {
+            xmlSecInvalidNodeError(root, xmlSecNodeKeyInfo, NULL);
+            xmlFreeDoc(doc);
+            xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+            xmlSecKeyDestroy(key);
+            return(NULL);
+        }
+
+        ret = xmlSecKeyInfoNodeRead(root, key, &keyInfoCtx);
+        xmlFreeDoc(doc);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecKeyInfoNodeRead", NULL);
+            xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+            xmlSecKeyDestroy(key);
+            return(NULL);
+        }
+    }
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+
+    if(!xmlSecKeyIsValid(key)) {
+        xmlSecOtherError2(XMLSEC_ERRORS_R_INVALID_KEY_DATA, NULL,
+                          "klass=%s", xmlSecErrorsSafeString(klass));
+        xmlSecKeyDestroy(key);
+        return(NULL);
+    }
+    return(key);
+}
+
+static xmlSecKeyPtr
+xmlSecSimpleKeysStoreMappedFindKey(xmlSecSimpleKeysStoreMappedPtr mapped, const xmlChar* name,
+                                   xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    const xmlSecByte* index;
+    const xmlChar* str;
+    xmlSecSize indexSize, field, pos, first, last, middle;
+    xmlSecKeyPtr key;
+
+    xmlSecAssert2(mapped != NULL, NULL);
+    xmlSecAssert2(keyInfoCtx != NULL, NULL);
+
+    index = mapped->data + XMLSEC_SIMPLE_KEYS_STORE_BIN_HEADER_SIZE +
+            mapped->count * XMLSEC_SIMPLE_KEYS_STORE_BIN_ENTRY_SIZE;
+    if(name != NULL) {
+        str = name;
+        indexSize = mapped->namesCount;
+        field = 0;  /* nameOffset */
+    } else if((keyInfoCtx->keyReq.keyId != xmlSecKeyDataIdUnknown) && (keyInfoCtx->keyReq.keyId->name != NULL)) {
+        str = keyInfoCtx->keyReq.keyId->name;
+        index += mapped->namesCount * 4;
+        indexSize = mapped->count;
+        field = 8;  /* klassOffset */
+    } else {
+        for(pos = 0; pos < mapped->count; ++pos) {
+            key = xmlSecSimpleKeysStoreMappedGetKey(mapped, pos);
+            if((key != NULL) && (xmlSecKeyMatch(key, name, &(keyInfoCtx->keyReq)) == 1)) {
+                return(key);
+            }
+        }
+        return(NULL);
+    }
+
+#define xmlSecSimpleKeysStoreMappedIndexStr(ii) \
+    ((const xmlChar*)(mapped->data + xmlSecSimpleKeysStoreBinGetInt( \
+        xmlSecSimpleKeysStoreBinGetEntry(mapped->data, xmlSecSimpleKeysStoreBinGetInt(index + 4 * (ii))) + field)))
+
+    /* find the first index item with the string (the index is sorted by
+     * the string and then by the keys table position) */
+    for(first = 0, last = indexSize; first < last; ) {
+        middle = first + (last - first) / 2;
+        if(xmlStrcmp(xmlSecSimpleKeysStoreMappedIndexStr(middle), str) < 0) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+
+    for(; (first < indexSize) && xmlStrEqual(xmlSecSimpleKeysStoreMappedIndexStr(first), str); ++first) {
+        key = xmlSecSimpleKeysStoreMappedGetKey(mapped, xmlSecSimpleKeysStoreBinGetInt(index + 4 * first));
+        if((key != NULL) && (xmlSecKeyMatch(key, name, &(keyInfoCtx->keyReq)) == 1)) {
+            return(key);
+        }
+    }
+
+#undef xmlSecSimpleKeysStoreMappedIndexStr
+
+    return(NULL);
+}
@@ -19,17 +19,32 @@
 #include <string.h>
 
 #include <libxml/tree.h>
+#include <libxml/hash.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/list.h>
+#include <xmlsec/buffer.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/private.h>
+#include <xmlsec/private/list.h>
 
 static int              xmlSecPtrListEnsureSize                 (xmlSecPtrListPtr list,
                                                                  xmlSecSize size);
+static void             xmlSecPtrListIndexDeallocator           (void *payload,
+                                                                 const xmlChar *name);
+static void             xmlSecPtrListChanged                    (xmlSecPtrListPtr list);
 
 static xmlSecAllocMode gAllocMode = xmlSecAllocModeDouble;
 static xmlSecSize gInitialSize = 64;
 
+/* the lists with tracked changes, see xmlSecPtrListTrackChanges() */
+#define XMLSEC_PTR_LIST_TRACKED_MAX_SIZE                8
+typedef struct _xmlSecPtrListTracked {
+    xmlSecPtrListPtr            list;
+    xmlSecSize                  changes;
+} xmlSecPtrListTracked;
+static xmlSecPtrListTracked gTrackedLists[XMLSEC_PTR_LIST_TRACKED_MAX_SIZE];
+
 /**
  * xmlSecPtrListSetDefaultAllocMode:
  * @defAllocMode:       the new default memory allocation mode.
@@ -158,6 +173,7 @@ xmlSecPtrListEmpty(xmlSecPtrListPtr list) {
     }
     list->max = list->use = 0;
     list->data = NULL;
+    xmlSecPtrListChanged(list);
 }
 
 /**
@@ -205,6 +221,7 @@ xmlSecPtrListCopy(xmlSecPtrListPtr dst, xmlSecPtrListPtr src) {
             dst->data[dst->use] = src->data[i];
         }
     }
+    xmlSecPtrListChanged(dst);
 
     return(0);
 }
@@ -299,6 +316,7 @@ xmlSecPtrListAdd(xmlSecPtrListPtr list, xmlSecPtr item) {
     }
 
     list->data[list->use++] = item;
+    xmlSecPtrListChanged(list);
     return(0);
 }
 
@@ -323,6 +341,7 @@ xmlSecPtrListSet(xmlSecPtrListPtr list, xmlSecPtr item, xmlSecSize pos) {
         list->id->destroyItem(list->data[pos]);
     }
     list->data[pos] = item;
+    xmlSecPtrListChanged(list);
     return(0);
 }
 
@@ -348,6 +367,7 @@ xmlSecPtrListRemove(xmlSecPtrListPtr list, xmlSecSize pos) {
     if(pos == list->use - 1) {
         --list->use;
     }
+    xmlSecPtrListChanged(list);
     return(0);
 }
 
@@ -373,6 +393,7 @@ xmlSecPtrListRemoveAndReturn(xmlSecPtrListPtr list, xmlSecSize pos) {
     if(pos == list->use - 1) {
         --list->use;
     }
+    xmlSecPtrListChanged(list);
     return(res);
 }
 
@@ -469,6 +490,202 @@ xmlSecPtrListEnsureSize(xmlSecPtrListPtr list, xmlSecSize size) {
     return(0);
 }
 
+/***********************************************************************
+ *
+ * List index
+ *
+ **********************************************************************/
+/**
+ * xmlSecPtrListIndexAdd:
+ * @index:              the pointer to the index (created on first use).
+ * @name:               the first part of the key.
+ * @name2:              the second part of the key (may be NULL).
+ * @pos:                the item position in the list.
+ *
+ * Appends @pos to the positions stored in @index for the (@name, @name2) key.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecPtrListIndexAdd(xmlHashTablePtr* index, const xmlChar* name,
+                      const xmlChar* name2, xmlSecSize pos) {
+    xmlSecBufferPtr positions;
+    int ret;
+
+    xmlSecAssert2(index != NULL, -1);
+    xmlSecAssert2(name != NULL, -1);
+
+    if((*index) == NULL) {
+        (*index) = xmlHashCreate(0);
+        if((*index) == NULL) {
+            xmlSecXmlError("xmlHashCreate", NULL);
+            return(-1);
+        }
+    }
+
+    positions = (xmlSecBufferPtr)xmlHashLookup2((*index), name, name2);
+    if(positions == NULL) {
+        positions = xmlSecBufferCreate(sizeof(xmlSecSize));
+        if(positions == NULL) {
+            xmlSecInternalError("xmlSecBufferCreate", NULL);
+            return(-1);
+        }
+        ret = xmlHashAddEntry2((*index), name, name2, positions);
+        if(ret != 0) {
+            xmlSecXmlError("xmlHashAddEntry2", NULL);
+            xmlSecBufferDestroy(positions);
+            return(-1);
+        }
+    }
+
+    ret = xmlSecBufferAppend(positions, (const xmlSecByte*)&pos, sizeof(pos));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferAppend", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/**
+ * xmlSecPtrListIndexLookup:
+ * @index:              the index (may be NULL).
+ * @name:               the first part of the key.
+ * @name2:              the second part of the key (may be NULL).
+ * @count:              the pointer to the returned positions count.
+ *
+ * Looks up the list positions stored for the (@name, @name2) key.
+ *
+ * Returns: the positions array or NULL if there are none.
+ */
+const xmlSecSize*
+xmlSecPtrListIndexLookup(xmlHashTablePtr index, const xmlChar* name,
+                         const xmlChar* name2, xmlSecSize* count) {
+    xmlSecBufferPtr positions;
+
+    xmlSecAssert2(count != NULL, NULL);
+
+    (*count) = 0;
+    if((index == NULL) || (name == NULL)) {
+        return(NULL);
+    }
+
+    positions = (xmlSecBufferPtr)xmlHashLookup2(index, name, name2);
+    if(positions == NULL) {
+        return(NULL);
+    }
+    (*count) = xmlSecBufferGetSize(positions) / sizeof(xmlSecSize);
+    return((const xmlSecSize*)xmlSecBufferGetData(positions));
+}
+
+/**
+ * xmlSecPtrListIndexDestroy:
+ * @index:              the index (may be NULL).
+ *
+ * Destroys @index and all the positions stored in it.
+ */
+void
+xmlSecPtrListIndexDestroy(xmlHashTablePtr index) {
+    if(index != NULL) {
+        xmlHashFree(index, xmlSecPtrListIndexDeallocator);
+    }
+}
+
+static void
+xmlSecPtrListIndexDeallocator(void *payload, const xmlChar *name ATTRIBUTE_UNUSED) {
+    UNREFERENCED_PARAMETER(name);
+    xmlSecBufferDestroy((xmlSecBufferPtr)payload);
+}
+
+/**
+ * xmlSecPtrListTrackChanges:
+ * @list:               the pointer to list.
+ *
+ * Starts counting the changes of @list items: every function adding,
+ * replacing or removing the items increments the counter returned by
+ * #xmlSecPtrListGetChanges. Only a few process-wide lists can be tracked
+ * at once and the caller must stop tracking with #xmlSecPtrListUntrackChanges
+ * before @list is finalized.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecPtrListTrackChanges(xmlSecPtrListPtr list) {
+    xmlSecSize ii;
+
+    xmlSecAssert2(xmlSecPtrListIsValid(list), -1);
+
+    for(ii = 0; ii < XMLSEC_PTR_LIST_TRACKED_MAX_SIZE; ++ii) {
+        if(gTrackedLists[ii].list == list) {
+            return(0);
+        }
+    }
+    for(ii = 0; ii < XMLSEC_PTR_LIST_TRACKED_MAX_SIZE; ++ii) {
+        if(gTrackedLists[ii].list == NULL) {
+            gTrackedLists[ii].list = list;
+            gTrackedLists[ii].changes = 0;
+            return(0);
+        }
+    }
+    xmlSecInvalidSizeMoreThanError("Tracked lists", ii + 1,
+        XMLSEC_PTR_LIST_TRACKED_MAX_SIZE, xmlSecPtrListGetName(list));
+    return(-1);
+}
+
+/**
+ * xmlSecPtrListUntrackChanges:
+ * @list:               the pointer to list.
+ *
+ * Stops counting the changes of @list items.
+ */
+void
+xmlSecPtrListUntrackChanges(xmlSecPtrListPtr list) {
+    xmlSecSize ii;
+
+    xmlSecAssert(list != NULL);
+
+    for(ii = 0; ii < XMLSEC_PTR_LIST_TRACKED_MAX_SIZE; ++ii) {
+        if(gTrackedLists[ii].list == list) {
+            gTrackedLists[ii].list = NULL;
+            gTrackedLists[ii].changes = 0;
+        }
+    }
+}
+
+/**
+ * xmlSecPtrListGetChanges:
+ * @list:               the pointer to list.
+ *
+ * Gets the number of @list items changes since #xmlSecPtrListTrackChanges
+ * was called (always 0 if the @list changes are not tracked).
+ *
+ * Returns: the number of changes.
+ */
+xmlSecSize
+xmlSecPtrListGetChanges(xmlSecPtrListPtr list) {
+    xmlSecSize ii;
+
+    xmlSecAssert2(list != NULL, 0);
+
+    for(ii = 0; ii < XMLSEC_PTR_LIST_TRACKED_MAX_SIZE; ++ii) {
+        if(gTrackedLists[ii].list == list) {
+            return(gTrackedLists[ii].changes);
+        }
+    }
+    return(0);
+}
+
+static void
+xmlSecPtrListChanged(xmlSecPtrListPtr list) {
+    xmlSecSize ii;
+
+    for(ii = 0; ii < XMLSEC_PTR_LIST_TRACKED_MAX_SIZE; ++ii) {
+        if(gTrackedLists[ii].list == list) {
+            ++gTrackedLists[ii].changes;
+            return;
+        }
+    }
+}
+
 /***********************************************************************
  *
  * strings list
@@ -33,6 +33,85 @@
         (node)->parent : \
         (xmlNodePtr)((xmlNsPtr)(node))->next)
 
+/**************************************************************************
+ *
+ * Nodes index: the hash table with the nodes from the @nodes list, it
+ * is located after xmlSecNodeSet structure. Namespace nodes are hashed
+ * by the parent element and prefix, exactly as xmlXPathNodeSetContains
+ * compares them.
+ *
+ *************************************************************************/
+typedef struct _xmlSecNodeSetOrder              xmlSecNodeSetOrder,
+                                                *xmlSecNodeSetOrderPtr;
+typedef struct _xmlSecNodeSetChain              xmlSecNodeSetChain,
+                                                *xmlSecNodeSetChainPtr;
+
+typedef struct _xmlSecNodeSetIndex {
+    xmlNodePtr*         table;
+    xmlSecSize          tableSize;
+
+    /* tree nodes sets only: see xmlSecNodeSetTreeIndexContains() */
+    int                 treeIndexStatus;
+    xmlSecNodeSetOrderPtr order;
+    xmlSecSize*         ranges;
+    xmlSecSize          rangesNr;
+
+    /* the first nodes set of a tree nodes sets run: see xmlSecNodeSetChainContains() */
+    int                 chainStatus;
+    xmlSecNodeSetChainPtr chain;
+
+    /* tree nodes sets with a single element: see xmlSecNodeSetSubtreeContains() */
+    xmlNodePtr          subtree;
+
+    /* the nodes set created for all the document children */
+    int                 wholeDoc;
+} xmlSecNodeSetIndex, *xmlSecNodeSetIndexPtr;
+
+/* smaller lists are faster to scan than to hash */
+#define XMLSEC_NODESET_INDEX_MIN_SIZE   16
+
+/* tree index status */
+#define XMLSEC_NODESET_TREE_INDEX_NONE          0
+#define XMLSEC_NODESET_TREE_INDEX_READY         1
+#define XMLSEC_NODESET_TREE_INDEX_FAILED        2
+
+/* chain status */
+#define XMLSEC_NODESET_CHAIN_NONE               0
+#define XMLSEC_NODESET_CHAIN_READY              1
+#define XMLSEC_NODESET_CHAIN_FAILED             2
+
+/* shorter runs are checked by the tree index of each nodes set */
+#define XMLSEC_NODESET_CHAIN_MIN_SIZE           2
+
+#define xmlSecNodeSetSize \
+    (sizeof(xmlSecNodeSet) + sizeof(xmlSecNodeSetIndex))
+#define xmlSecNodeSetGetIndex(nset) \
+    ((xmlSecNodeSetIndexPtr)(((xmlSecByte*)(nset)) + sizeof(xmlSecNodeSet)))
+
+static int      xmlSecNodeSetIndexInitialize            (xmlSecNodeSetIndexPtr idx,
+                                                         xmlNodeSetPtr nodes);
+static void     xmlSecNodeSetIndexFinalize              (xmlSecNodeSetIndexPtr idx);
+static int      xmlSecNodeSetIndexContains              (xmlSecNodeSetIndexPtr idx,
+                                                         xmlNodePtr node);
+static int      xmlSecNodeSetTreeIndexContains          (xmlSecNodeSetPtr nset,
+                                                         xmlNodePtr node);
+static int      xmlSecNodeSetSubtreeContains            (xmlNodePtr subtree,
+                                                         xmlNodePtr node);
+
+static int      xmlSecNodeSetChainContains              (xmlSecNodeSetPtr nset,
+                                                         xmlNodePtr node,
+                                                         xmlNodePtr parent,
+                                                         int status,
+                                                         xmlSecNodeSetPtr* last);
+static void     xmlSecNodeSetChainDestroy               (xmlSecNodeSetChainPtr chain);
+
+static xmlSecNodeSetOrderPtr xmlSecNodeSetOrderCreate   (xmlDocPtr doc);
+static void     xmlSecNodeSetOrderDestroy               (xmlSecNodeSetOrderPtr order);
+static int      xmlSecNodeSetOrderFind                  (xmlSecNodeSetOrderPtr order,
+                                                         xmlNodePtr node,
+                                                         xmlSecSize* first,
+                                                         xmlSecSize* last);
+
 static int      xmlSecNodeSetOneContains                (xmlSecNodeSetPtr nset,
                                                          xmlNodePtr node,
                                                          xmlNodePtr parent);
@@ -49,25 +128,51 @@ static int      xmlSecNodeSetWalkRecursive              (xmlSecNodeSetPtr nset,
  * @type:               the nodes set type.
  *
  * Creates new nodes set. Caller is responsible for freeing returned object
- * by calling #xmlSecNodeSetDestroy function.
+ * by calling #xmlSecNodeSetDestroy function. The nodes set takes ownership
+ * of the @nodes list and indexes it for fast lookups, the list should not
+ * be modified after this call.
  *
  * Returns: pointer to newly allocated node set or NULL if an error occurs.
  */
 xmlSecNodeSetPtr
 xmlSecNodeSetCreate(xmlDocPtr doc, xmlNodeSetPtr nodes, xmlSecNodeSetType type) {
     xmlSecNodeSetPtr nset;
+    int ret;
 
-    nset = (xmlSecNodeSetPtr)xmlMalloc(sizeof(xmlSecNodeSet));
+    nset = (xmlSecNodeSetPtr)xmlMalloc(xmlSecNodeSetSize);
     if(nset == NULL) {
-        xmlSecMallocError(sizeof(xmlSecNodeSet), NULL);
+        xmlSecMallocError(xmlSecNodeSetSize, NULL);
+        return(NULL);
+    }
+    memset(nset, 0,  xmlSecNodeSetSize);
+
+    ret = xmlSecNodeSetIndexInitialize(xmlSecNodeSetGetIndex(nset), nodes);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecNodeSetIndexInitialize", NULL);
+        xmlFree(nset);
         return(NULL);
     }
-    memset(nset, 0,  sizeof(xmlSecNodeSet));
 
     nset->doc   = doc;
     nset->nodes = nodes;
     nset->type  = type;
     nset->next  = nset->prev = nset;
+
+    /* one element subtree (e.g. enveloped signature) is checked by
+     * comparing the ancestors pointers, no index is needed */
+    if((nodes != NULL) && (nodes->nodeNr == 1) && (nodes->nodeTab[0] != NULL) &&
+       (nodes->nodeTab[0]->type == XML_ELEMENT_NODE)) {
+        switch(type) {
+        case xmlSecNodeSetTree:
+        case xmlSecNodeSetTreeWithoutComments:
+        case xmlSecNodeSetTreeInvert:
+        case xmlSecNodeSetTreeWithoutCommentsInvert:
+            xmlSecNodeSetGetIndex(nset)->subtree = nodes->nodeTab[0];
+            break;
+        default:
+            break;
+        }
+    }
     return(nset);
 }
 
@@ -93,6 +198,7 @@ xmlSecNodeSetDestroy(xmlSecNodeSetPtr nset) {
             nset = NULL;
         }
 
+        xmlSecNodeSetIndexFinalize(xmlSecNodeSetGetIndex(tmp));
         if(tmp->nodes != NULL) {
             xmlXPathFreeNodeSet(tmp->nodes);
         }
@@ -104,7 +210,7 @@ xmlSecNodeSetDestroy(xmlSecNodeSetPtr nset) {
             xmlSecAssert((destroyDoc == NULL) || (tmp->doc == destroyDoc));
             destroyDoc = tmp->doc; /* can't destroy here because other node sets can refer to it */
         }
-        memset(tmp, 0,  sizeof(xmlSecNodeSet));
+        memset(tmp, 0,  xmlSecNodeSetSize);
         xmlFree(tmp);
     }
 
@@ -149,8 +255,12 @@ xmlSecNodeSetOneContains(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr pare
     }
 
     if(nset->nodes != NULL) {
+        xmlSecNodeSetIndexPtr idx = xmlSecNodeSetGetIndex(nset);
+
         if(node->type != XML_NAMESPACE_DECL) {
-            in_nodes_set = xmlXPathNodeSetContains(nset->nodes, node);
+            in_nodes_set = (idx->table != NULL) ?
+                xmlSecNodeSetIndexContains(idx, node) :
+                xmlXPathNodeSetContains(nset->nodes, node);
         } else {
             xmlNs ns;
 
@@ -167,7 +277,9 @@ xmlSecNodeSetOneContains(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr pare
              * If the input is an XPath node-set, then the node-set must explicitly
              * contain every node to be rendered to the canonical form.
              */
-            in_nodes_set = (xmlXPathNodeSetContains(nset->nodes, (xmlNodePtr)&ns));
+            in_nodes_set = (idx->table != NULL) ?
+                xmlSecNodeSetIndexContains(idx, (xmlNodePtr)&ns) :
+                xmlXPathNodeSetContains(nset->nodes, (xmlNodePtr)&ns);
         }
     }
 
@@ -181,7 +293,14 @@ xmlSecNodeSetOneContains(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr pare
         if(in_nodes_set) {
             return(1);
         }
+        if(xmlSecNodeSetGetIndex(nset)->subtree != NULL) {
+            return(xmlSecNodeSetSubtreeContains(xmlSecNodeSetGetIndex(nset)->subtree, parent));
+        }
         if((parent != NULL) && (parent->type == XML_ELEMENT_NODE)) {
+            int ret = xmlSecNodeSetTreeIndexContains(nset, parent);
+            if(ret >= 0) {
+                return(ret);
+            }
             return(xmlSecNodeSetOneContains(nset, parent, parent->parent));
         }
         return(0);
@@ -190,7 +309,14 @@ xmlSecNodeSetOneContains(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr pare
         if(in_nodes_set) {
             return(0);
         }
+        if(xmlSecNodeSetGetIndex(nset)->subtree != NULL) {
+            return(!xmlSecNodeSetSubtreeContains(xmlSecNodeSetGetIndex(nset)->subtree, parent));
+        }
         if((parent != NULL) && (parent->type == XML_ELEMENT_NODE)) {
+            int ret = xmlSecNodeSetTreeIndexContains(nset, parent);
+            if(ret >= 0) {
+                return(!ret);
+            }
             return(xmlSecNodeSetOneContains(nset, parent, parent->parent));
         }
         return(1);
@@ -202,6 +328,791 @@ xmlSecNodeSetOneContains(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr pare
     return(0);
 }
 
+static xmlSecSize
+xmlSecNodeSetIndexHash(xmlNodePtr node) {
+    size_t hash;
+
+    xmlSecAssert2(node != NULL, 0);
+
+    if(node->type != XML_NAMESPACE_DECL) {
+        hash = (size_t)(void*)node;
+    } else {
+        xmlNsPtr ns = (xmlNsPtr)node;
+        const xmlChar* p;
+
+        hash = (size_t)(void*)(ns->next);
+        if(ns->prefix != NULL) {
+            for(p = ns->prefix; (*p) != '\0'; ++p) {
+                hash = hash * 31 + (*p);
+            }
+        }
+    }
+
+    /* pointers are aligned: mix the high bits into the low ones */
+    hash ^= (hash >> 4) ^ (hash >> 12) ^ (hash >> 20);
+    return((xmlSecSize)(hash * 2654435761U));
+}
+
+static int
+xmlSecNodeSetIndexEqual(xmlNodePtr node1, xmlNodePtr node2) {
+    xmlSecAssert2(node1 != NULL, 0);
+    xmlSecAssert2(node2 != NULL, 0);
+
+    if(node1 == node2) {
+        return(1);
+    }
+    if((node1->type == XML_NAMESPACE_DECL) && (node2->type == XML_NAMESPACE_DECL)) {
+        xmlNsPtr ns1 = (xmlNsPtr)node1;
+        xmlNsPtr ns2 = (xmlNsPtr)node2;
+
+        /* same as in xmlXPathNodeSetContains() */
+        return(((ns1->next != NULL) && (ns2->next == ns1->next) &&
+                xmlStrEqual(ns1->prefix, ns2->prefix)) ? 1 : 0);
+    }
+    return(0);
+}
+
+static int
+xmlSecNodeSetIndexInitialize(xmlSecNodeSetIndexPtr idx, xmlNodeSetPtr nodes) {
+    xmlSecSize size, mask, pos;
+    int i;
+
+    xmlSecAssert2(idx != NULL, -1);
+
+    memset(idx, 0, sizeof(xmlSecNodeSetIndex));
+    if((nodes == NULL) || (nodes->nodeNr < XMLSEC_NODESET_INDEX_MIN_SIZE)) {
+        return(0);
+    }
+
+    /* keep the table at most half full */
+    for(size = XMLSEC_NODESET_INDEX_MIN_SIZE; size < 2 * (xmlSecSize)nodes->nodeNr; size *= 2);
+
+    idx->table = (xmlNodePtr*)xmlMalloc(size * sizeof(xmlNodePtr));
+    if(idx->table == NULL) {
+        xmlSecMallocError(size * sizeof(xmlNodePtr), NULL);
+        return(-1);
+    }
+    memset(idx->table, 0, size * sizeof(xmlNodePtr));
+    idx->tableSize = size;
+
+    mask = size - 1;
+    for(i = 0; i < nodes->nodeNr; ++i) {
+        xmlNodePtr cur = nodes->nodeTab[i];
+        if(cur == NULL) {
+            continue;
+        }
+
+        for(pos = xmlSecNodeSetIndexHash(cur) & mask; idx->table[pos] != NULL; pos = (pos + 1) & mask) {
+            if(xmlSecNodeSetIndexEqual(idx->table[pos], cur)) {
+                break;
+            }
+        }
+        if(idx->table[pos] == NULL) {
+            idx->table[pos] = cur;
+        }
+    }
+    return(0);
+}
+
+static void
+xmlSecNodeSetIndexFinalize(xmlSecNodeSetIndexPtr idx) {
+    xmlSecAssert(idx != NULL);
+
+    if(idx->table != NULL) {
+        xmlFree(idx->table);
+    }
+    if(idx->order != NULL) {
+        xmlSecNodeSetOrderDestroy(idx->order);
+    }
+    if(idx->ranges != NULL) {
+        xmlFree(idx->ranges);
+    }
+    if(idx->chain != NULL) {
+        xmlSecNodeSetChainDestroy(idx->chain);
+    }
+    memset(idx, 0, sizeof(xmlSecNodeSetIndex));
+}
+
+static int
+xmlSecNodeSetIndexContains(xmlSecNodeSetIndexPtr idx, xmlNodePtr node) {
+    xmlSecSize mask, pos;
+
+    xmlSecAssert2(idx != NULL, 0);
+    xmlSecAssert2(idx->table != NULL, 0);
+    xmlSecAssert2(idx->tableSize > 0, 0);
+    xmlSecAssert2(node != NULL, 0);
+
+    mask = idx->tableSize - 1;
+    for(pos = xmlSecNodeSetIndexHash(node) & mask; idx->table[pos] != NULL; pos = (pos + 1) & mask) {
+        if(xmlSecNodeSetIndexEqual(idx->table[pos], node)) {
+            return(1);
+        }
+    }
+    return(0);
+}
+
+/**************************************************************************
+ *
+ * Tree index: the elements of the document are numbered in the document
+ * order (kept in the xmlSecNodeSetOrder side table), an element subtree
+ * is the [first, last] interval of these numbers. The subtrees of the
+ * element nodes from the @nodes list are merged into a sorted list of
+ * disjoint intervals and the "is the element or any of its ancestors
+ * in the list" check becomes a binary search instead of the walk up the
+ * parents chain.
+ *
+ *************************************************************************/
+static int
+xmlSecNodeSetTreeIndexRangesCmp(const void* a, const void* b) {
+    xmlSecSize first1 = ((const xmlSecSize*)a)[0];
+    xmlSecSize first2 = ((const xmlSecSize*)b)[0];
+
+    return((first1 < first2) ? -1 : ((first1 > first2) ? 1 : 0));
+}
+
+/* computes the sorted disjoint intervals covered by the subtrees of the
+ * element nodes from @nodes, the caller frees the returned @ranges */
+static int
+xmlSecNodeSetTreeIndexRanges(xmlSecNodeSetOrderPtr order, xmlNodeSetPtr nodes,
+                             xmlSecSize** ranges, xmlSecSize* rangesNr) {
+    xmlSecSize first, last, ii, jj;
+    int i, ret;
+
+    xmlSecAssert2(order != NULL, -1);
+    xmlSecAssert2(nodes != NULL, -1);
+    xmlSecAssert2(ranges != NULL, -1);
+    xmlSecAssert2((*ranges) == NULL, -1);
+    xmlSecAssert2(rangesNr != NULL, -1);
+
+    (*rangesNr) = 0;
+    if(nodes->nodeNr <= 0) {
+        return(0);
+    }
+
+    (*ranges) = (xmlSecSize*)xmlMalloc(2 * nodes->nodeNr * sizeof(xmlSecSize));
+    if((*ranges) == NULL) {
+        xmlSecMallocError(2 * nodes->nodeNr * sizeof(xmlSecSize), NULL);
+        return(-1);
+    }
+
+    /* only element nodes have subtrees we care about */
+    for(i = 0, ii = 0; i < nodes->nodeNr; ++i) {
+        xmlNodePtr cur = nodes->nodeTab[i];
+        if((cur == NULL) || (cur->type != XML_ELEMENT_NODE)) {
+            continue;
+        }
+
+        ret = xmlSecNodeSetOrderFind(order, cur, &first, &last);
+        if(ret != 1) {
+            /* the element is not in the document tree */
+            xmlFree(*ranges);
+            (*ranges) = NULL;
+            return(-1);
+        }
+        (*ranges)[2 * ii] = first;
+        (*ranges)[2 * ii + 1] = last;
+        ++ii;
+    }
+    if(ii == 0) {
+        return(0);
+    }
+
+    /* sort and merge nested intervals */
+    qsort((*ranges), ii, 2 * sizeof(xmlSecSize), xmlSecNodeSetTreeIndexRangesCmp);
+    for(jj = 0, i = 1; (xmlSecSize)i < ii; ++i) {
+        if((*ranges)[2 * i] <= (*ranges)[2 * jj + 1]) {
+            if((*ranges)[2 * i + 1] > (*ranges)[2 * jj + 1]) {
+                (*ranges)[2 * jj + 1] = (*ranges)[2 * i + 1];
+            }
+        } else {
+            ++jj;
+            (*ranges)[2 * jj] = (*ranges)[2 * i];
+            (*ranges)[2 * jj + 1] = (*ranges)[2 * i + 1];
+        }
+    }
+    (*rangesNr) = jj + 1;
+    return(0);
+}
+
+static int
+xmlSecNodeSetTreeIndexBuild(xmlSecNodeSetPtr nset, xmlSecNodeSetIndexPtr idx) {
+    int ret;
+
+    xmlSecAssert2(nset != NULL, -1);
+    xmlSecAssert2(nset->doc != NULL, -1);
+    xmlSecAssert2(nset->nodes != NULL, -1);
+    xmlSecAssert2(idx != NULL, -1);
+    xmlSecAssert2(idx->order == NULL, -1);
+    xmlSecAssert2(idx->ranges == NULL, -1);
+
+    idx->order = xmlSecNodeSetOrderCreate(nset->doc);
+    if(idx->order == NULL) {
+        xmlSecInternalError("xmlSecNodeSetOrderCreate", NULL);
+        return(-1);
+    }
+
+    ret = xmlSecNodeSetTreeIndexRanges(idx->order, nset->nodes, &(idx->ranges), &(idx->rangesNr));
+    if(ret < 0) {
+        return(-1);
+    }
+    return(0);
+}
+
+/* returns 1 if the @node or any of its ancestors is an element from @nset->nodes,
+ * 0 if it is not and -1 if the tree index can't answer this question */
+static int
+xmlSecNodeSetTreeIndexContains(xmlSecNodeSetPtr nset, xmlNodePtr node) {
+    xmlSecNodeSetIndexPtr idx;
+    xmlSecSize first, last, lo, hi, mid;
+    int ret;
+
+    xmlSecAssert2(nset != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(node->type == XML_ELEMENT_NODE, -1);
+
+    if((nset->nodes == NULL) || (nset->doc == NULL) || (node->doc != nset->doc)) {
+        return(-1);
+    }
+
+    /* build it on the first use, the doc might change after the nodes set is created */
+    idx = xmlSecNodeSetGetIndex(nset);
+    if(idx->treeIndexStatus == XMLSEC_NODESET_TREE_INDEX_NONE) {
+        ret = xmlSecNodeSetTreeIndexBuild(nset, idx);
+        if(ret < 0) {
+            /* we can always fall back to walking the parents */
+            if(idx->order != NULL) {
+                xmlSecNodeSetOrderDestroy(idx->order);
+                idx->order = NULL;
+            }
+            if(idx->ranges != NULL) {
+                xmlFree(idx->ranges);
+                idx->ranges = NULL;
+            }
+            idx->rangesNr = 0;
+            idx->treeIndexStatus = XMLSEC_NODESET_TREE_INDEX_FAILED;
+        } else {
+            idx->treeIndexStatus = XMLSEC_NODESET_TREE_INDEX_READY;
+        }
+    }
+    if(idx->treeIndexStatus != XMLSEC_NODESET_TREE_INDEX_READY) {
+        return(-1);
+    }
+
+    ret = xmlSecNodeSetOrderFind(idx->order, node, &first, &last);
+    if(ret != 1) {
+        return(-1);
+    }
+
+    /* find the last interval that starts before or at the node */
+    lo = 0;
+    hi = idx->rangesNr;
+    while(lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if(idx->ranges[2 * mid] <= first) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if((lo > 0) && (first <= idx->ranges[2 * (lo - 1) + 1])) {
+        return(1);
+    }
+    return(0);
+}
+
+/* returns 1 if the element @node is @subtree or one of its descendants
+ * and 0 otherwise */
+static int
+xmlSecNodeSetSubtreeContains(xmlNodePtr subtree, xmlNodePtr node) {
+    xmlSecAssert2(subtree != NULL, 0);
+
+    /* the tree nodes sets only include the children of elements */
+    for( ; (node != NULL) && (node->type == XML_ELEMENT_NODE); node = node->parent) {
+        if(node == subtree) {
+            return(1);
+        }
+    }
+    return(0);
+}
+
+/**************************************************************************
+ *
+ * Document order side table: maps the document elements to their
+ * position in the document order and the position of the last element
+ * in their subtrees.
+ *
+ *************************************************************************/
+typedef struct _xmlSecNodeSetOrderEntry {
+    xmlNodePtr          node;
+    xmlSecSize          first;
+    xmlSecSize          last;
+} xmlSecNodeSetOrderEntry, *xmlSecNodeSetOrderEntryPtr;
+
+struct _xmlSecNodeSetOrder {
+    xmlSecNodeSetOrderEntryPtr  table;
+    xmlSecSize                  tableSize;
+    xmlSecSize                  count;
+};
+
+static xmlNodePtr
+xmlSecNodeSetOrderNextElement(xmlNodePtr cur) {
+    while((cur != NULL) && (cur->type != XML_ELEMENT_NODE)) {
+        cur = cur->next;
+    }
+    return(cur);
+}
+
+static xmlSecNodeSetOrderEntryPtr
+xmlSecNodeSetOrderLookup(xmlSecNodeSetOrderPtr order, xmlNodePtr node) {
+    xmlSecSize mask, pos;
+
+    xmlSecAssert2(order != NULL, NULL);
+    xmlSecAssert2(order->table != NULL, NULL);
+    xmlSecAssert2(node != NULL, NULL);
+
+    mask = order->tableSize - 1;
+    for(pos = xmlSecNodeSetIndexHash(node) & mask; order->table[pos].node != NULL; pos = (pos + 1) & mask) {
+        if(order->table[pos].node == node) {
+            break;
+        }
+    }
+    return(&(order->table[pos]));
+}
+
+/* walks all the elements in the document order without recursion, the
+ * documents might be very deep */
+static xmlSecSize
+xmlSecNodeSetOrderWalk(xmlSecNodeSetOrderPtr order, xmlDocPtr doc) {
+    xmlSecNodeSetOrderEntryPtr entry;
+    xmlNodePtr cur, next;
+    xmlSecSize pos = 0;
+
+    xmlSecAssert2(doc != NULL, 0);
+
+    cur = xmlSecNodeSetOrderNextElement(doc->children);
+    while(cur != NULL) {
+        if(order != NULL) {
+            entry = xmlSecNodeSetOrderLookup(order, cur);
+            entry->node = cur;
+            entry->first = pos;
+            entry->last = pos;
+        }
+        ++pos;
+
+        /* go down */
+        next = xmlSecNodeSetOrderNextElement(cur->children);
+        if(next != NULL) {
+            cur = next;
+            continue;
+        }
+
+        /* go to the next sibling or up */
+        while(cur != NULL) {
+            if(order != NULL) {
+                xmlSecNodeSetOrderLookup(order, cur)->last = pos - 1;
+            }
+            next = xmlSecNodeSetOrderNextElement(cur->next);
+            if(next != NULL) {
+                cur = next;
+                break;
+            }
+            cur = cur->parent;
+            if((cur == NULL) || (cur->type != XML_ELEMENT_NODE)) {
+                cur = NULL;
+            }
+        }
+    }
+    return(pos);
+}
+
+static xmlSecNodeSetOrderPtr
+xmlSecNodeSetOrderCreate(xmlDocPtr doc) {
+    xmlSecNodeSetOrderPtr order;
+    xmlSecSize count, size;
+
+    xmlSecAssert2(doc != NULL, NULL);
+
+    order = (xmlSecNodeSetOrderPtr)xmlMalloc(sizeof(xmlSecNodeSetOrder));
+    if(order == NULL) {
+        xmlSecMallocError(sizeof(xmlSecNodeSetOrder), NULL);
+        return(NULL);
+    }
+    memset(order, 0, sizeof(xmlSecNodeSetOrder));
+
+    /* keep the table at most half full */
+    count = xmlSecNodeSetOrderWalk(NULL, doc);
+    for(size = XMLSEC_NODESET_INDEX_MIN_SIZE; size < 2 * count; size *= 2);
+
+    order->table = (xmlSecNodeSetOrderEntryPtr)xmlMalloc(size * sizeof(xmlSecNodeSetOrderEntry));
+    if(order->table == NULL) {
+        xmlSecMallocError(size * sizeof(xmlSecNodeSetOrderEntry), NULL);
+        xmlSecNodeSetOrderDestroy(order);
+        return(NULL);
+    }
+    memset(order->table, 0, size * sizeof(xmlSecNodeSetOrderEntry));
+    order->tableSize = size;
+    order->count = count;
+
+    xmlSecNodeSetOrderWalk(order, doc);
+    return(order);
+}
+
+static void
+xmlSecNodeSetOrderDestroy(xmlSecNodeSetOrderPtr order) {
+    xmlSecAssert(order != NULL);
+
+    if(order->table != NULL) {
+        xmlFree(order->table);
+    }
+    memset(order, 0, sizeof(xmlSecNodeSetOrder));
+    xmlFree(order);
+}
+
+/* returns 1 if the element is found, 0 otherwise */
+static int
+xmlSecNodeSetOrderFind(xmlSecNodeSetOrderPtr order, xmlNodePtr node,
+                       xmlSecSize* first, xmlSecSize* last) {
+    xmlSecNodeSetOrderEntryPtr entry;
+
+    xmlSecAssert2(order != NULL, 0);
+    xmlSecAssert2(node != NULL, 0);
+    xmlSecAssert2(first != NULL, 0);
+    xmlSecAssert2(last != NULL, 0);
+
+    entry = xmlSecNodeSetOrderLookup(order, node);
+    if(entry->node == NULL) {
+        return(0);
+    }
+    (*first) = entry->first;
+    (*last) = entry->last;
+    return(1);
+}
+
+/**************************************************************************
+ *
+ * Chain: a run of consecutive tree nodes sets in the nodes sets list
+ * (e.g. the XPath Filter 2.0 filters) compiled into one table indexed
+ * by the element position in the document order. For every element the
+ * table keeps the result of the whole run for both incoming statuses,
+ * so the check doesn't depend on the number of nodes sets in the run.
+ * Other nodes get the result of their parent element unless they are
+ * in one of the nodes lists themselves (@others).
+ *
+ *************************************************************************/
+struct _xmlSecNodeSetChain {
+    xmlSecNodeSetPtr            last;
+    xmlSecNodeSetOrderPtr       order;
+    xmlSecByte*                 states;
+    xmlNodeSetPtr               others;
+    xmlSecNodeSetIndex          othersIndex;
+    int                         withoutComments;
+};
+
+/* the element result for incoming status 0 and 1 */
+#define XMLSEC_NODESET_CHAIN_STATE0             0x01
+#define XMLSEC_NODESET_CHAIN_STATE1             0x02
+
+static int
+xmlSecNodeSetChainIsTree(xmlSecNodeSetPtr nset) {
+    xmlSecAssert2(nset != NULL, 0);
+
+    if(nset->nodes == NULL) {
+        return(0);
+    }
+    switch(nset->type) {
+    case xmlSecNodeSetTree:
+    case xmlSecNodeSetTreeWithoutComments:
+    case xmlSecNodeSetTreeInvert:
+    case xmlSecNodeSetTreeWithoutCommentsInvert:
+        break;
+    default:
+        return(0);
+    }
+    switch(nset->op) {
+    case xmlSecNodeSetIntersection:
+    case xmlSecNodeSetSubtraction:
+    case xmlSecNodeSetUnion:
+        break;
+    default:
+        return(0);
+    }
+    return(1);
+}
+
+static int
+xmlSecNodeSetChainApply(xmlSecNodeSetOp op, int status, int in_nodes_set) {
+    switch(op) {
+    case xmlSecNodeSetIntersection:
+        return((status && in_nodes_set) ? 1 : 0);
+    case xmlSecNodeSetSubtraction:
+        return((status && !in_nodes_set) ? 1 : 0);
+    case xmlSecNodeSetUnion:
+        return((status || in_nodes_set) ? 1 : 0);
+    default:
+        break;
+    }
+    return(0);
+}
+
+static int
+xmlSecNodeSetChainAdd(xmlSecNodeSetChainPtr chain, xmlSecNodeSetPtr nset) {
+    xmlSecSize* ranges = NULL;
+    xmlSecSize rangesNr = 0;
+    xmlSecSize pos, ii;
+    xmlSecByte state;
+    int invert, in_nodes_set;
+    int i, ret;
+
+    xmlSecAssert2(chain != NULL, -1);
+    xmlSecAssert2(chain->order != NULL, -1);
+    xmlSecAssert2(chain->states != NULL, -1);
+    xmlSecAssert2(chain->others != NULL, -1);
+    xmlSecAssert2(nset != NULL, -1);
+    xmlSecAssert2(nset->nodes != NULL, -1);
+
+    ret = xmlSecNodeSetTreeIndexRanges(chain->order, nset->nodes, &ranges, &rangesNr);
+    if(ret < 0) {
+        return(-1);
+    }
+
+    invert = ((nset->type == xmlSecNodeSetTreeInvert) ||
+              (nset->type == xmlSecNodeSetTreeWithoutCommentsInvert)) ? 1 : 0;
+    if((nset->type == xmlSecNodeSetTreeWithoutComments) ||
+       (nset->type == xmlSecNodeSetTreeWithoutCommentsInvert)) {
+        chain->withoutComments = 1;
+    }
+
+    /* the elements and the intervals are both in the document order */
+    for(pos = 0, ii = 0; pos < chain->order->count; ++pos) {
+        while((ii < rangesNr) && (ranges[2 * ii + 1] < pos)) {
+            ++ii;
+        }
+        in_nodes_set = ((ii < rangesNr) && (ranges[2 * ii] <= pos)) ? 1 : 0;
+        if(invert) {
+            in_nodes_set = !in_nodes_set;
+        }
+
+        state = 0;
+        if(xmlSecNodeSetChainApply(nset->op, (chain->states[pos] & XMLSEC_NODESET_CHAIN_STATE0) ? 1 : 0, in_nodes_set)) {
+            state |= XMLSEC_NODESET_CHAIN_STATE0;
+        }
+        if(xmlSecNodeSetChainApply(nset->op, (chain->states[pos] & XMLSEC_NODESET_CHAIN_STATE1) ? 1 : 0, in_nodes_set)) {
+            state |= XMLSEC_NODESET_CHAIN_STATE1;
+        }
+        chain->states[pos] = state;
+    }
+    if(ranges != NULL) {
+        xmlFree(ranges);
+    }
+
+    /* all the other nodes are checked directly */
+    for(i = 0; i < nset->nodes->nodeNr; ++i) {
+        xmlNodePtr cur = nset->nodes->nodeTab[i];
+        if((cur == NULL) || (cur->type == XML_ELEMENT_NODE)) {
+            continue;
+        }
+        ret = xmlXPathNodeSetAddUnique(chain->others, cur);
+        if(ret < 0) {
+            xmlSecXmlError("xmlXPathNodeSetAddUnique", NULL);
+            return(-1);
+        }
+    }
+    return(0);
+}
+
+static xmlSecNodeSetChainPtr
+xmlSecNodeSetChainCreate(xmlSecNodeSetPtr first, xmlSecNodeSetPtr last) {
+    xmlSecNodeSetChainPtr chain;
+    xmlSecNodeSetPtr cur;
+    xmlSecSize pos;
+    int ret;
+
+    xmlSecAssert2(first != NULL, NULL);
+    xmlSecAssert2(first->doc != NULL, NULL);
+    xmlSecAssert2(last != NULL, NULL);
+
+    chain = (xmlSecNodeSetChainPtr)xmlMalloc(sizeof(xmlSecNodeSetChain));
+    if(chain == NULL) {
+        xmlSecMallocError(sizeof(xmlSecNodeSetChain), NULL);
+        return(NULL);
+    }
+    memset(chain, 0, sizeof(xmlSecNodeSetChain));
+    chain->last = last;
+
+    chain->order = xmlSecNodeSetOrderCreate(first->doc);
+    if(chain->order == NULL) {
+        xmlSecInternalError("xmlSecNodeSetOrderCreate", NULL);
+        xmlSecNodeSetChainDestroy(chain);
+        return(NULL);
+    }
+    if(chain->order->count == 0) {
+        xmlSecNodeSetChainDestroy(chain);
+        return(NULL);
+    }
+
+    chain->states = (xmlSecByte*)xmlMalloc(chain->order->count * sizeof(xmlSecByte));
+    if(chain->states == NULL) {
+        xmlSecMallocError(chain->order->count * sizeof(xmlSecByte), NULL);
+        xmlSecNodeSetChainDestroy(chain);
+        return(NULL);
+    }
+    for(pos = 0; pos < chain->order->count; ++pos) {
+        chain->states[pos] = XMLSEC_NODESET_CHAIN_STATE1;
+    }
+
+    chain->others = xmlXPathNodeSetCreate(NULL);
+    if(chain->others == NULL) {
+        xmlSecXmlError("xmlXPathNodeSetCreate", NULL);
+        xmlSecNodeSetChainDestroy(chain);
+        return(NULL);
+    }
+
+    cur = first;
+    do {
+        ret = xmlSecNodeSetChainAdd(chain, cur);
+        if(ret < 0) {
+            xmlSecNodeSetChainDestroy(chain);
+            return(NULL);
+        }
+    } while((cur != last) && ((cur = cur->next) != NULL));
+
+    ret = xmlSecNodeSetIndexInitialize(&(chain->othersIndex), chain->others);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecNodeSetIndexInitialize", NULL);
+        xmlSecNodeSetChainDestroy(chain);
+        return(NULL);
+    }
+    return(chain);
+}
+
+static void
+xmlSecNodeSetChainDestroy(xmlSecNodeSetChainPtr chain) {
+    xmlSecAssert(chain != NULL);
+
+    xmlSecNodeSetIndexFinalize(&(chain->othersIndex));
+    if(chain->others != NULL) {
+        xmlXPathFreeNodeSet(chain->others);
+    }
+    if(chain->states != NULL) {
+        xmlFree(chain->states);
+    }
+    if(chain->order != NULL) {
+        xmlSecNodeSetOrderDestroy(chain->order);
+    }
+    memset(chain, 0, sizeof(xmlSecNodeSetChain));
+    xmlFree(chain);
+}
+
+/* builds the chain for the run of tree nodes sets that starts at @first (the
+ * run ends before the @head of the nodes sets list) */
+static void
+xmlSecNodeSetChainBuild(xmlSecNodeSetPtr head, xmlSecNodeSetPtr first) {
+    xmlSecNodeSetIndexPtr idx;
+    xmlSecNodeSetPtr cur, last = NULL;
+    xmlSecSize size = 0;
+
+    xmlSecAssert(head != NULL);
+    xmlSecAssert(first != NULL);
+
+    idx = xmlSecNodeSetGetIndex(first);
+    xmlSecAssert(idx->chainStatus == XMLSEC_NODESET_CHAIN_NONE);
+    xmlSecAssert(idx->chain == NULL);
+
+    cur = first;
+    do {
+        if((cur->doc != first->doc) || !xmlSecNodeSetChainIsTree(cur)) {
+            break;
+        }
+        last = cur;
+        ++size;
+        cur = cur->next;
+    } while((cur != NULL) && (cur != head));
+
+    if((first->doc != NULL) && (size >= XMLSEC_NODESET_CHAIN_MIN_SIZE)) {
+        idx->chain = xmlSecNodeSetChainCreate(first, last);
+    }
+    if(idx->chain != NULL) {
+        idx->chainStatus = XMLSEC_NODESET_CHAIN_READY;
+        return;
+    }
+
+    /* we can always check the nodes sets one by one, don't try the rest of the run again */
+    cur = first;
+    do {
+        xmlSecNodeSetGetIndex(cur)->chainStatus = XMLSEC_NODESET_CHAIN_FAILED;
+    } while((cur != last) && (last != NULL) && ((cur = cur->next) != NULL));
+}
+
+/* returns the status after the run of tree nodes sets that starts at @nset
+ * or -1 if the chain can't answer this question; the last nodes set of the
+ * run is returned in @last if there is a run */
+static int
+xmlSecNodeSetChainContains(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr parent,
+                           int status, xmlSecNodeSetPtr* last) {
+    xmlSecNodeSetIndexPtr idx;
+    xmlSecNodeSetChainPtr chain;
+    xmlNodePtr elem;
+    xmlSecSize first, tmp;
+    int ret;
+
+    xmlSecAssert2(nset != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(last != NULL, -1);
+
+    (*last) = NULL;
+    idx = xmlSecNodeSetGetIndex(nset);
+    if(idx->chainStatus != XMLSEC_NODESET_CHAIN_READY) {
+        return(-1);
+    }
+    chain = idx->chain;
+    xmlSecAssert2(chain != NULL, -1);
+    (*last) = chain->last;
+
+    if(node->type == XML_ELEMENT_NODE) {
+        elem = node;
+    } else {
+        if((node->type == XML_COMMENT_NODE) && (chain->withoutComments != 0)) {
+            return(-1);
+        }
+        if(chain->others->nodeNr > 0) {
+            if(node->type != XML_NAMESPACE_DECL) {
+                ret = (chain->othersIndex.table != NULL) ?
+                    xmlSecNodeSetIndexContains(&(chain->othersIndex), node) :
+                    xmlXPathNodeSetContains(chain->others, node);
+            } else {
+                xmlNs ns;
+
+                /* same as in xmlSecNodeSetOneContains() */
+                memcpy(&ns, node, sizeof(ns));
+                if((parent != NULL) && (parent->type == XML_ATTRIBUTE_NODE)) {
+                    ns.next = (xmlNsPtr)parent->parent;
+                } else {
+                    ns.next = (xmlNsPtr)parent;
+                }
+                ret = (chain->othersIndex.table != NULL) ?
+                    xmlSecNodeSetIndexContains(&(chain->othersIndex), (xmlNodePtr)&ns) :
+                    xmlXPathNodeSetContains(chain->others, (xmlNodePtr)&ns);
+            }
+            if(ret) {
+                return(-1);
+            }
+        }
+        if((parent == NULL) || (parent->type != XML_ELEMENT_NODE)) {
+            return(-1);
+        }
+        elem = parent;
+    }
+
+    if(elem->doc != nset->doc) {
+        return(-1);
+    }
+    ret = xmlSecNodeSetOrderFind(chain->order, elem, &first, &tmp);
+    if(ret != 1) {
+        return(-1);
+    }
+    return((chain->states[first] & ((status) ? XMLSEC_NODESET_CHAIN_STATE1 : XMLSEC_NODESET_CHAIN_STATE0)) ? 1 : 0);
+}
+
 /**
  * xmlSecNodeSetContains:
  * @nset:               the pointer to node set.
@@ -217,6 +1128,8 @@ int
 xmlSecNodeSetContains(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr parent) {
     int status = 1;
     xmlSecNodeSetPtr cur;
+    xmlSecNodeSetPtr runLast = NULL;
+    int ret;
 
     xmlSecAssert2(node != NULL, 0);
 
@@ -228,6 +1141,20 @@ xmlSecNodeSetContains(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr parent)
     status = 1;
     cur = nset;
     do {
+        /* runs of tree nodes sets are checked all at once */
+        if(runLast == NULL) {
+            if(xmlSecNodeSetGetIndex(cur)->chainStatus == XMLSEC_NODESET_CHAIN_NONE) {
+                xmlSecNodeSetChainBuild(nset, cur);
+            }
+            ret = xmlSecNodeSetChainContains(cur, node, parent, status, &runLast);
+            if(ret >= 0) {
+                status = ret;
+                cur = runLast->next;
+                runLast = NULL;
+                continue;
+            }
+        }
+
         switch(cur->op) {
         case xmlSecNodeSetIntersection:
             if(status && !xmlSecNodeSetOneContains(cur, node, parent)) {
@@ -249,6 +1176,9 @@ xmlSecNodeSetContains(xmlSecNodeSetPtr nset, xmlNodePtr node, xmlNodePtr parent)
                               "node set operation=%d", (int)cur->op);
             return(-1);
         }
+        if(cur == runLast) {
+            runLast = NULL;
+        }
         cur = cur->next;
     } while(cur != nset);
 
@@ -460,6 +1390,7 @@ xmlSecNodeSetPtr
 xmlSecNodeSetGetChildren(xmlDocPtr doc, const xmlNodePtr parent, int withComments, int invert) {
     xmlNodeSetPtr nodes;
     xmlSecNodeSetType type;
+    xmlSecNodeSetPtr nset;
 
     xmlSecAssert2(doc != NULL, NULL);
 
@@ -489,7 +1420,99 @@ xmlSecNodeSetGetChildren(xmlDocPtr doc, const xmlNodePtr parent, int withComment
         type = xmlSecNodeSetTreeWithoutComments;
     }
 
-    return(xmlSecNodeSetCreate(doc, nodes, type));
+    nset = xmlSecNodeSetCreate(doc, nodes, type);
+    if(nset == NULL) {
+        xmlSecInternalError("xmlSecNodeSetCreate", NULL);
+        xmlXPathFreeNodeSet(nodes);
+        return(NULL);
+    }
+    if(parent == NULL) {
+        xmlSecNodeSetGetIndex(nset)->wholeDoc = 1;
+    }
+    return(nset);
+}
+
+/**
+ * xmlSecNodeSetIsWholeDocument:
+ * @nset:               the pointer to nodes set.
+ *
+ * Checks if @nset contains all the document nodes (except the comments
+ * for the nodes sets created "without comments").
+ *
+ * Returns: 1 if @nset is the whole document nodes set or 0 otherwise.
+ */
+int
+xmlSecNodeSetIsWholeDocument(xmlSecNodeSetPtr nset) {
+    xmlSecAssert2(nset != NULL, 0);
+
+    if((nset->next != nset) || (nset->op != xmlSecNodeSetIntersection)) {
+        return(0);
+    }
+    switch(nset->type) {
+    case xmlSecNodeSetNormal:
+        return((nset->nodes == NULL) ? 1 : 0);
+    case xmlSecNodeSetTree:
+    case xmlSecNodeSetTreeWithoutComments:
+        return(((nset->nodes == NULL) || (xmlSecNodeSetGetIndex(nset)->wholeDoc != 0)) ? 1 : 0);
+    default:
+        return(0);
+    }
+}
+
+/**
+ * xmlSecNodeSetGetExcludedSubtree:
+ * @nset:               the pointer to nodes set.
+ * @withComments:       the pointer to the result "with comments" flag.
+ *
+ * Checks if @nset contains all the document nodes except the subtree of
+ * one element (e.g. the whole document reference followed by the enveloped
+ * signature transform). If it does then @withComments is set to 1 if
+ * comment nodes are included and to 0 otherwise.
+ *
+ * Returns: the root element of the excluded subtree or NULL if @nset
+ * is a different nodes set.
+ */
+xmlNodePtr
+xmlSecNodeSetGetExcludedSubtree(xmlSecNodeSetPtr nset, int* withComments) {
+    xmlSecNodeSetPtr excl;
+    xmlNodePtr subtree;
+
+    xmlSecAssert2(nset != NULL, NULL);
+    xmlSecAssert2(withComments != NULL, NULL);
+
+    if(nset->op != xmlSecNodeSetIntersection) {
+        return(NULL);
+    }
+
+    (*withComments) = 1;
+    excl = nset;
+    if(nset->next != nset) {
+        /* the whole document first */
+        if((nset->next->next != nset) || (xmlSecNodeSetGetIndex(nset)->wholeDoc == 0)) {
+            return(NULL);
+        }
+        if(nset->type == xmlSecNodeSetTreeWithoutComments) {
+            (*withComments) = 0;
+        } else if(nset->type != xmlSecNodeSetTree) {
+            return(NULL);
+        }
+        excl = nset->next;
+    }
+
+    subtree = xmlSecNodeSetGetIndex(excl)->subtree;
+    if((subtree == NULL) || (subtree->doc != nset->doc)) {
+        return(NULL);
+    }
+    if(excl->op == xmlSecNodeSetIntersection) {
+        if(excl->type == xmlSecNodeSetTreeWithoutCommentsInvert) {
+            (*withComments) = 0;
+        } else if(excl->type != xmlSecNodeSetTreeInvert) {
+            return(NULL);
+        }
+    } else if((excl->op != xmlSecNodeSetSubtraction) || (excl->type != xmlSecNodeSetTree)) {
+        return(NULL);
+    }
+    return(subtree);
 }
 
 static int
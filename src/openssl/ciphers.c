@@ -29,6 +29,7 @@
 #include <xmlsec/openssl/crypto.h>
 #include <xmlsec/openssl/evp.h>
 #include "openssl_compat.h"
+#include "private.h"
 
 #define xmlSecOpenSSLAesGcmNonceLengthInBytes 12
 #define xmlSecOpenSSLAesGcmTagLengthInBytes 16
@@ -689,6 +690,9 @@ xmlSecOpenSSLEvpBlockCipherInitialize(xmlSecTransformPtr transform) {
         return(-1);
     }
 
+    /* avoid provider lookups for every message */
+    ctx->cipher = xmlSecOpenSSLEvpGetCipher(ctx->cipher);
+
     /* create cipher ctx */
     ctx->cipherCtx = EVP_CIPHER_CTX_new();
     if(ctx->cipherCtx == NULL) {
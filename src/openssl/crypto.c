@@ -32,6 +32,7 @@
 #include <xmlsec/openssl/app.h>
 #include <xmlsec/openssl/crypto.h>
 #include <xmlsec/openssl/x509.h>
+#include "private.h"
 
 static int              xmlSecOpenSSLErrorsInit                 (void);
 
@@ -338,6 +339,18 @@ xmlSecOpenSSLInit (void)  {
         return(-1);
     }
 
+    if(xmlSecOpenSSLEvpAlgorithmsInit() < 0) {
+        xmlSecInternalError("xmlSecOpenSSLEvpAlgorithmsInit", NULL);
+        return(-1);
+    }
+
+#ifndef XMLSEC_NO_X509
+    if(xmlSecOpenSSLX509CertsCacheInit() < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509CertsCacheInit", NULL);
+        return(-1);
+    }
+#endif /* XMLSEC_NO_X509 */
+
     /* register our klasses */
     if(xmlSecCryptoDLFunctionsRegisterKeyDataAndTransforms(xmlSecCryptoGetFunctions_openssl()) < 0) {
         xmlSecInternalError("xmlSecCryptoDLFunctionsRegisterKeyDataAndTransforms", NULL);
@@ -356,6 +369,10 @@ xmlSecOpenSSLInit (void)  {
  */
 int
 xmlSecOpenSSLShutdown(void) {
+#ifndef XMLSEC_NO_X509
+    xmlSecOpenSSLX509CertsCacheShutdown();
+#endif /* XMLSEC_NO_X509 */
+    xmlSecOpenSSLEvpAlgorithmsShutdown();
     xmlSecOpenSSLSetDefaultTrustedCertsFolder(NULL);
     return(0);
 }
@@ -28,6 +28,7 @@
 #include <xmlsec/openssl/crypto.h>
 #include <xmlsec/openssl/evp.h>
 #include "openssl_compat.h"
+#include "private.h"
 
 /**************************************************************************
  *
@@ -64,6 +65,11 @@ static int      xmlSecOpenSSLEvpDigestVerify            (xmlSecTransformPtr tran
 static int      xmlSecOpenSSLEvpDigestExecute           (xmlSecTransformPtr transform,
                                                          int last,
                                                          xmlSecTransformCtxPtr transformCtx);
+static int      xmlSecOpenSSLEvpDigestPushBin           (xmlSecTransformPtr transform,
+                                                         const xmlSecByte* data,
+                                                         xmlSecSize dataSize,
+                                                         int final,
+                                                         xmlSecTransformCtxPtr transformCtx);
 static int      xmlSecOpenSSLEvpDigestCheckId           (xmlSecTransformPtr transform);
 
 static int
@@ -222,6 +228,8 @@ xmlSecOpenSSLEvpDigestInitialize(xmlSecTransformPtr transform) {
         return(-1);
     }
 
+    ctx->digest = xmlSecOpenSSLEvpGetDigest(ctx->digest);
+
     /* create digest CTX */
     ctx->digestCtx = EVP_MD_CTX_new();
     if(ctx->digestCtx == NULL) {
@@ -376,6 +384,54 @@ xmlSecOpenSSLEvpDigestExecute(xmlSecTransformPtr transform, int last, xmlSecTran
     return(0);
 }
 
+/*
+ * The previous transform (usually C14N writing thru the output buffer created
+ * with xmlSecTransformCreateOutputBuffer) pushes data directly to the digest
+ * without copying it to the input buffer and splitting it into chunks.
+ */
+static int
+xmlSecOpenSSLEvpDigestPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
+                              xmlSecSize dataSize, int final, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecOpenSSLDigestCtxPtr ctx;
+    int ret;
+
+    xmlSecAssert2(xmlSecOpenSSLEvpDigestCheckId(transform), -1);
+    xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecOpenSSLEvpDigestSize), -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecOpenSSLEvpDigestGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->digestCtx != NULL, -1);
+
+    if((dataSize > 0) && (xmlSecBufferGetSize(&(transform->inBuf)) == 0)) {
+        xmlSecAssert2(data != NULL, -1);
+
+        /* initialize digest if needed */
+        if(transform->status == xmlSecTransformStatusNone) {
+            ret = xmlSecOpenSSLEvpDigestExecute(transform, 0, transformCtx);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecOpenSSLEvpDigestExecute",
+                                    xmlSecTransformGetName(transform));
+                return(-1);
+            }
+        }
+
+        if(transform->status == xmlSecTransformStatusWorking) {
+            ret = EVP_DigestUpdate(ctx->digestCtx, data, dataSize);
+            if(ret != 1) {
+                xmlSecOpenSSLError2("EVP_DigestUpdate",
+                                    xmlSecTransformGetName(transform),
+                                    "size=%lu", (unsigned long)dataSize);
+                return(-1);
+            }
+            data = NULL;
+            dataSize = 0;
+        }
+    }
+
+    /* everything else (final call, status errors) is handled as usual */
+    return(xmlSecTransformDefaultPushBin(transform, data, dataSize, final, transformCtx));
+}
 
 #ifndef XMLSEC_NO_MD5
 /******************************************************************************
@@ -400,7 +456,7 @@ static xmlSecTransformKlass xmlSecOpenSSLMd5Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
@@ -446,7 +502,7 @@ static xmlSecTransformKlass xmlSecOpenSSLRipemd160Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
@@ -493,7 +549,7 @@ static xmlSecTransformKlass xmlSecOpenSSLSha1Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
@@ -539,7 +595,7 @@ static xmlSecTransformKlass xmlSecOpenSSLSha224Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
@@ -585,7 +641,7 @@ static xmlSecTransformKlass xmlSecOpenSSLSha256Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
@@ -631,7 +687,7 @@ static xmlSecTransformKlass xmlSecOpenSSLSha384Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
@@ -677,7 +733,7 @@ static xmlSecTransformKlass xmlSecOpenSSLSha512Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,               /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
@@ -722,7 +778,7 @@ static xmlSecTransformKlass xmlSecOpenSSLGostR3411_94Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,                 /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
@@ -767,7 +823,7 @@ static xmlSecTransformKlass xmlSecOpenSSLGostR3411_2012_256Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,                 /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
@@ -809,7 +865,7 @@ static xmlSecTransformKlass xmlSecOpenSSLGostR3411_2012_512Klass = {
     NULL,                                       /* xmlSecTransformSetKeyMethod setKey; */
     xmlSecOpenSSLEvpDigestVerify,                 /* xmlSecTransformVerifyMethod verify; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
-    xmlSecTransformDefaultPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
+    xmlSecOpenSSLEvpDigestPushBin,              /* xmlSecTransformPushBinMethod pushBin; */
     xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
     NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
     NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
@@ -18,7 +18,9 @@
 
 #include <string.h>
 
+#include <openssl/err.h>
 #include <openssl/evp.h>
+#include <openssl/objects.h>
 #include <openssl/rand.h>
 
 #include <xmlsec/xmlsec.h>
@@ -33,6 +35,7 @@
 #include <xmlsec/openssl/bn.h>
 #include <xmlsec/openssl/evp.h>
 #include "openssl_compat.h"
+#include "private.h"
 
 /******************************************************************************
  *
@@ -412,6 +415,189 @@ xmlSecOpenSSLEvpKeyAdopt(EVP_PKEY *pKey) {
     return(data);
 }
 
+/******************************************************************************
+ *
+ * Pre-fetched digests and ciphers
+ *
+ * OpenSSL 3.0 looks up the provider implementation of the legacy EVP_MD and
+ * EVP_CIPHER objects (e.g. EVP_sha256()) on every EVP_DigestInit() or
+ * EVP_CipherInit() call. The explicitly fetched objects are used as is.
+ *
+ *****************************************************************************/
+#ifdef XMLSEC_OPENSSL_API_300
+
+#define XMLSEC_OPENSSL_EVP_MAX_FETCHED          16
+
+typedef const EVP_MD*     (*xmlSecOpenSSLEvpDigestGetMethod)(void);
+typedef const EVP_CIPHER* (*xmlSecOpenSSLEvpCipherGetMethod)(void);
+
+static const xmlSecOpenSSLEvpDigestGetMethod xmlSecOpenSSLEvpLegacyDigests[] = {
+#ifndef XMLSEC_NO_MD5
+    EVP_md5,
+#endif /* XMLSEC_NO_MD5 */
+#ifndef XMLSEC_NO_RIPEMD160
+    EVP_ripemd160,
+#endif /* XMLSEC_NO_RIPEMD160 */
+#ifndef XMLSEC_NO_SHA1
+    EVP_sha1,
+#endif /* XMLSEC_NO_SHA1 */
+#ifndef XMLSEC_NO_SHA224
+    EVP_sha224,
+#endif /* XMLSEC_NO_SHA224 */
+#ifndef XMLSEC_NO_SHA256
+    EVP_sha256,
+#endif /* XMLSEC_NO_SHA256 */
+#ifndef XMLSEC_NO_SHA384
+    EVP_sha384,
+#endif /* XMLSEC_NO_SHA384 */
+#ifndef XMLSEC_NO_SHA512
+    EVP_sha512,
+#endif /* XMLSEC_NO_SHA512 */
+    NULL
+};
+
+static const xmlSecOpenSSLEvpCipherGetMethod xmlSecOpenSSLEvpLegacyCiphers[] = {
+#ifndef XMLSEC_NO_DES
+    EVP_des_ede3_cbc,
+#endif /* XMLSEC_NO_DES */
+#ifndef XMLSEC_NO_AES
+    EVP_aes_128_cbc,
+    EVP_aes_192_cbc,
+    EVP_aes_256_cbc,
+    EVP_aes_128_gcm,
+    EVP_aes_192_gcm,
+    EVP_aes_256_gcm,
+#endif /* XMLSEC_NO_AES */
+    NULL
+};
+
+static EVP_MD*          xmlSecOpenSSLEvpDigests[XMLSEC_OPENSSL_EVP_MAX_FETCHED];
+static xmlSecSize       xmlSecOpenSSLEvpDigestsSize = 0;
+static EVP_CIPHER*      xmlSecOpenSSLEvpCiphers[XMLSEC_OPENSSL_EVP_MAX_FETCHED];
+static xmlSecSize       xmlSecOpenSSLEvpCiphersSize = 0;
+
+#endif /* XMLSEC_OPENSSL_API_300 */
+
+/**
+ * xmlSecOpenSSLEvpAlgorithmsInit:
+ *
+ * Fetches the digests and ciphers used by the OpenSSL transforms once,
+ * so that the transforms do not trigger implicit fetches from the
+ * providers for every message. The algorithms that are not available
+ * (e.g. MD5 in FIPS mode) are skipped. This function is called from
+ * #xmlSecOpenSSLInit function and the application should not call it
+ * directly.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecOpenSSLEvpAlgorithmsInit(void) {
+#ifdef XMLSEC_OPENSSL_API_300
+    xmlSecSize ii;
+
+    xmlSecOpenSSLEvpAlgorithmsShutdown();
+
+    for(ii = 0; xmlSecOpenSSLEvpLegacyDigests[ii] != NULL; ++ii) {
+        const EVP_MD* legacy = xmlSecOpenSSLEvpLegacyDigests[ii]();
+        EVP_MD* md;
+
+        xmlSecAssert2(xmlSecOpenSSLEvpDigestsSize < XMLSEC_OPENSSL_EVP_MAX_FETCHED, -1);
+
+        ERR_set_mark();
+        md = EVP_MD_fetch(NULL, OBJ_nid2sn(EVP_MD_type(legacy)), NULL);
+        ERR_pop_to_mark();
+        if(md != NULL) {
+            xmlSecOpenSSLEvpDigests[xmlSecOpenSSLEvpDigestsSize++] = md;
+        }
+    }
+
+    for(ii = 0; xmlSecOpenSSLEvpLegacyCiphers[ii] != NULL; ++ii) {
+        const EVP_CIPHER* legacy = xmlSecOpenSSLEvpLegacyCiphers[ii]();
+        EVP_CIPHER* cipher;
+
+        xmlSecAssert2(xmlSecOpenSSLEvpCiphersSize < XMLSEC_OPENSSL_EVP_MAX_FETCHED, -1);
+
+        ERR_set_mark();
+        cipher = EVP_CIPHER_fetch(NULL, OBJ_nid2sn(EVP_CIPHER_nid(legacy)), NULL);
+        ERR_pop_to_mark();
+        if(cipher != NULL) {
+            xmlSecOpenSSLEvpCiphers[xmlSecOpenSSLEvpCiphersSize++] = cipher;
+        }
+    }
+#endif /* XMLSEC_OPENSSL_API_300 */
+
+    return(0);
+}
+
+/**
+ * xmlSecOpenSSLEvpAlgorithmsShutdown:
+ *
+ * Releases the digests and ciphers fetched by #xmlSecOpenSSLEvpAlgorithmsInit.
+ * This function is called from #xmlSecOpenSSLShutdown function and
+ * the application should not call it directly.
+ */
+void
+xmlSecOpenSSLEvpAlgorithmsShutdown(void) {
+#ifdef XMLSEC_OPENSSL_API_300
+    while(xmlSecOpenSSLEvpDigestsSize > 0) {
+        EVP_MD_free(xmlSecOpenSSLEvpDigests[--xmlSecOpenSSLEvpDigestsSize]);
+    }
+    while(xmlSecOpenSSLEvpCiphersSize > 0) {
+        EVP_CIPHER_free(xmlSecOpenSSLEvpCiphers[--xmlSecOpenSSLEvpCiphersSize]);
+    }
+#endif /* XMLSEC_OPENSSL_API_300 */
+}
+
+/**
+ * xmlSecOpenSSLEvpGetDigest:
+ * @md:                 the pointer to EVP_MD (e.g. EVP_sha256()).
+ *
+ * Gets the pre-fetched implementation of @md.
+ *
+ * Returns: the pre-fetched digest or @md if it is not available.
+ */
+const EVP_MD*
+xmlSecOpenSSLEvpGetDigest(const EVP_MD* md) {
+#ifdef XMLSEC_OPENSSL_API_300
+    xmlSecSize ii;
+
+    xmlSecAssert2(md != NULL, NULL);
+
+    for(ii = 0; ii < xmlSecOpenSSLEvpDigestsSize; ++ii) {
+        if(EVP_MD_type(xmlSecOpenSSLEvpDigests[ii]) == EVP_MD_type(md)) {
+            return(xmlSecOpenSSLEvpDigests[ii]);
+        }
+    }
+#endif /* XMLSEC_OPENSSL_API_300 */
+
+    return(md);
+}
+
+/**
+ * xmlSecOpenSSLEvpGetCipher:
+ * @cipher:             the pointer to EVP_CIPHER (e.g. EVP_aes_128_cbc()).
+ *
+ * Gets the pre-fetched implementation of @cipher.
+ *
+ * Returns: the pre-fetched cipher or @cipher if it is not available.
+ */
+const EVP_CIPHER*
+xmlSecOpenSSLEvpGetCipher(const EVP_CIPHER* cipher) {
+#ifdef XMLSEC_OPENSSL_API_300
+    xmlSecSize ii;
+
+    xmlSecAssert2(cipher != NULL, NULL);
+
+    for(ii = 0; ii < xmlSecOpenSSLEvpCiphersSize; ++ii) {
+        if(EVP_CIPHER_nid(xmlSecOpenSSLEvpCiphers[ii]) == EVP_CIPHER_nid(cipher)) {
+            return(xmlSecOpenSSLEvpCiphers[ii]);
+        }
+    }
+#endif /* XMLSEC_OPENSSL_API_300 */
+
+    return(cipher);
+}
+
 #ifndef XMLSEC_NO_DSA
 /**************************************************************************
  *
@@ -42,6 +42,7 @@
 
 #include <xmlsec/openssl/crypto.h>
 #include "openssl_compat.h"
+#include "private.h"
 
 /* sizes in bits */
 #define XMLSEC_OPENSSL_MIN_HMAC_SIZE            80
@@ -235,6 +236,8 @@ xmlSecOpenSSLHmacInitialize(xmlSecTransformPtr transform) {
         return(-1);
     }
 
+    ctx->hmacDgst = xmlSecOpenSSLEvpGetDigest(ctx->hmacDgst);
+
     /* create hmac CTX */
     ctx->hmacCtx = HMAC_CTX_new();
     if(ctx->hmacCtx == NULL) {
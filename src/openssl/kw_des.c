@@ -34,6 +34,7 @@
 #include <xmlsec/openssl/crypto.h>
 
 #include "../kw_aes_des.h"
+#include "private.h"
 
 /*********************************************************************
  *
@@ -485,7 +486,7 @@ xmlSecOpenSSLKWDes3Encrypt(const xmlSecByte *key, xmlSecSize keySize,
         return(-1);
     }
 
-    ret = EVP_CipherInit(cipherCtx, EVP_des_ede3_cbc(), key, iv, enc);
+    ret = EVP_CipherInit(cipherCtx, xmlSecOpenSSLEvpGetCipher(EVP_des_ede3_cbc()), key, iv, enc);
     if(ret != 1) {
         xmlSecOpenSSLError("EVP_CipherInit", NULL);
         EVP_CIPHER_CTX_free(cipherCtx);
@@ -39,6 +39,8 @@
 /* X509 stuff */
 #define ASN1_STRING_get0_data(data)        ASN1_STRING_data((data))
 #define X509_CRL_get0_nextUpdate(crl)      X509_CRL_get_nextUpdate((crl))
+#define X509_CRL_up_ref(crl)               CRYPTO_add(&((crl)->references), 1, CRYPTO_LOCK_X509_CRL)
+#define X509_up_ref(x509)                  CRYPTO_add(&((x509)->references), 1, CRYPTO_LOCK_X509)
 #define X509_get0_notBefore(x509)          X509_get_notBefore((x509))
 #define X509_get0_notAfter(x509)           X509_get_notAfter((x509))
 #define X509_STORE_CTX_get_by_subject      X509_STORE_get_by_subject
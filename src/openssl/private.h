@@ -0,0 +1,39 @@
+/*
+ * XML Security Library (http://www.aleksey.com/xmlsec).
+ *
+ * THIS IS A PRIVATE XMLSEC HEADER FILE
+ * DON'T USE IT IN YOUR APPLICATION
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#ifndef __XMLSEC_OPENSSL_PRIVATE_H__
+#define __XMLSEC_OPENSSL_PRIVATE_H__
+
+#ifndef XMLSEC_PRIVATE
+#error "private.h file contains private xmlsec definitions and should not be used outside xmlsec or xmlsec-$crypto libraries"
+#endif /* XMLSEC_PRIVATE */
+
+#include <openssl/evp.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/********************************************************************
+ *
+ * Pre-fetched digests and ciphers
+ *
+ ********************************************************************/
+int                     xmlSecOpenSSLEvpAlgorithmsInit          (void);
+void                    xmlSecOpenSSLEvpAlgorithmsShutdown      (void);
+const EVP_MD*           xmlSecOpenSSLEvpGetDigest               (const EVP_MD* md);
+const EVP_CIPHER*       xmlSecOpenSSLEvpGetCipher               (const EVP_CIPHER* cipher);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __XMLSEC_OPENSSL_PRIVATE_H__ */
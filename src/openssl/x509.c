@@ -26,6 +26,8 @@
 #include <time.h>
 
 #include <libxml/tree.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
@@ -118,6 +120,28 @@ static void             xmlSecOpenSSLX509CertDebugXmlDump       (X509* cert,
 static int              xmlSecOpenSSLX509CertGetTime            (XMLSEC_CONST_ASN1_TIME * t,
                                                                  time_t* res);
 
+/*************************************************************************
+ *
+ * Process-wide certificates cache: DER digest -> shared X509
+ *
+ ************************************************************************/
+static xmlMutexPtr      xmlSecOpenSSLX509CertsCacheMutex = NULL;
+static xmlHashTablePtr  xmlSecOpenSSLX509CertsCacheHash = NULL;
+static xmlSecSize       xmlSecOpenSSLX509CertsCacheSize = 0;
+static xmlSecSize       xmlSecOpenSSLX509CertsCacheMaxSize = 0;  /* disabled */
+static xmlSecSize       xmlSecOpenSSLX509CertsCacheHits = 0;
+static xmlSecSize       xmlSecOpenSSLX509CertsCacheMisses = 0;
+
+static X509*            xmlSecOpenSSLX509CertsCacheGet          (const xmlSecByte* buf,
+                                                                 xmlSecSize size,
+                                                                 xmlChar* key,
+                                                                 xmlSecSize keySize);
+static void             xmlSecOpenSSLX509CertsCachePut          (const xmlChar* key,
+                                                                 X509* cert);
+static void             xmlSecOpenSSLX509CertsCacheFlush        (void);
+static void             xmlSecOpenSSLX509CertsCacheDeallocator  (void *payload,
+                                                                 const xmlChar *name);
+
 /*************************************************************************
  *
  * Internal OpenSSL X509 data CTX
@@ -1470,12 +1494,9 @@ xmlSecOpenSSLKeyDataX509VerifyAndExtractKey(xmlSecKeyDataPtr data, xmlSecKeyPtr
         if(cert != NULL) {
             xmlSecKeyDataPtr keyValue;
 
-            ctx->keyCert = X509_dup(cert);
-            if(ctx->keyCert == NULL) {
-                xmlSecOpenSSLError("X509_dup",
-                                   xmlSecKeyDataGetName(data));
-                return(-1);
-            }
+            /* share the cert (and its already decoded public key) */
+            X509_up_ref(cert);
+            ctx->keyCert = cert;
 
             keyValue = xmlSecOpenSSLX509CertGetKey(ctx->keyCert);
             if(keyValue == NULL) {
@@ -1684,6 +1705,220 @@ xmlSecOpenSSLX509CertGetKey(X509* cert) {
     return(data);
 }
 
+/**
+ * xmlSecOpenSSLX509CertsCacheInit:
+ *
+ * Initializes the process-wide cache of parsed certificates used when
+ * reading <dsig:X509Certificate/> elements and raw DER certificates.
+ * This function is called from #xmlSecOpenSSLInit function and
+ * the application should not call it directly.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecOpenSSLX509CertsCacheInit(void) {
+    if(xmlSecOpenSSLX509CertsCacheMutex != NULL) {
+        return(0);
+    }
+
+    xmlSecOpenSSLX509CertsCacheMutex = xmlNewMutex();
+    if(xmlSecOpenSSLX509CertsCacheMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        return(-1);
+    }
+
+    xmlSecOpenSSLX509CertsCacheHits = xmlSecOpenSSLX509CertsCacheMisses = 0;
+    return(0);
+}
+
+/**
+ * xmlSecOpenSSLX509CertsCacheShutdown:
+ *
+ * Releases all the cached certificates. This function is called from
+ * #xmlSecOpenSSLShutdown function and the application should not call
+ * it directly.
+ */
+void
+xmlSecOpenSSLX509CertsCacheShutdown(void) {
+    if(xmlSecOpenSSLX509CertsCacheMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecOpenSSLX509CertsCacheMutex);
+    xmlSecOpenSSLX509CertsCacheFlush();
+    xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+
+    xmlFreeMutex(xmlSecOpenSSLX509CertsCacheMutex);
+    xmlSecOpenSSLX509CertsCacheMutex = NULL;
+}
+
+/**
+ * xmlSecOpenSSLX509CertsCacheSetMaxSize:
+ * @maxSize:            the max number of cached certificates (0 disables the cache).
+ *
+ * Sets the max number of parsed certificates kept in the process-wide
+ * cache. The cached certificate (and its public key) is shared by all
+ * the keys read from the same DER bytes. When the cache is full, it is
+ * flushed. The cache is disabled by default.
+ */
+void
+xmlSecOpenSSLX509CertsCacheSetMaxSize(xmlSecSize maxSize) {
+    if(xmlSecOpenSSLX509CertsCacheMutex == NULL) {
+        xmlSecOpenSSLX509CertsCacheMaxSize = maxSize;
+        return;
+    }
+
+    xmlMutexLock(xmlSecOpenSSLX509CertsCacheMutex);
+    xmlSecOpenSSLX509CertsCacheMaxSize = maxSize;
+    if(xmlSecOpenSSLX509CertsCacheSize > maxSize) {
+        xmlSecOpenSSLX509CertsCacheFlush();
+    }
+    xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+}
+
+/**
+ * xmlSecOpenSSLX509CertsCacheGetStats:
+ * @size:               the pointer to the current number of cached certificates (optional).
+ * @hits:               the pointer to the number of certificates found in the cache (optional).
+ * @misses:             the pointer to the number of parsed certificates (optional).
+ *
+ * Gets the certificates cache statistics.
+ */
+void
+xmlSecOpenSSLX509CertsCacheGetStats(xmlSecSize* size, xmlSecSize* hits, xmlSecSize* misses) {
+    if(xmlSecOpenSSLX509CertsCacheMutex != NULL) {
+        xmlMutexLock(xmlSecOpenSSLX509CertsCacheMutex);
+    }
+    if(size != NULL) {
+        (*size) = xmlSecOpenSSLX509CertsCacheSize;
+    }
+    if(hits != NULL) {
+        (*hits) = xmlSecOpenSSLX509CertsCacheHits;
+    }
+    if(misses != NULL) {
+        (*misses) = xmlSecOpenSSLX509CertsCacheMisses;
+    }
+    if(xmlSecOpenSSLX509CertsCacheMutex != NULL) {
+        xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+    }
+}
+
+/*
+ * Returns a new reference to the cached cert for the DER bytes in @buf
+ * or NULL. The @key is set to the cache key for the following
+ * #xmlSecOpenSSLX509CertsCachePut call or to an empty string if the
+ * cache is disabled.
+ */
+static X509*
+xmlSecOpenSSLX509CertsCacheGet(const xmlSecByte* buf, xmlSecSize size, xmlChar* key, xmlSecSize keySize) {
+    static const char hex[] = "0123456789abcdef";
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int mdLen = 0;
+    unsigned int ii;
+    xmlSecSize maxSize;
+    X509* cert;
+
+    xmlSecAssert2(buf != NULL, NULL);
+    xmlSecAssert2(key != NULL, NULL);
+    xmlSecAssert2(keySize >= 2 * EVP_MAX_MD_SIZE + 1, NULL);
+
+    key[0] = '\0';
+    if(xmlSecOpenSSLX509CertsCacheMutex == NULL) {
+        return(NULL);
+    }
+
+    xmlMutexLock(xmlSecOpenSSLX509CertsCacheMutex);
+    maxSize = xmlSecOpenSSLX509CertsCacheMaxSize;
+    xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+    if(maxSize <= 0) {
+        return(NULL);
+    }
+
+    if(EVP_Digest(buf, size, md, &mdLen, EVP_sha256(), NULL) != 1) {
+        xmlSecOpenSSLError("EVP_Digest", NULL);
+        return(NULL);
+    }
+    for(ii = 0; ii < mdLen; ++ii) {
+        key[2 * ii]     = hex[(md[ii] >> 4) & 0x0F];
+        key[2 * ii + 1] = hex[md[ii] & 0x0F];
+    }
+    key[2 * mdLen] = '\0';
+
+    xmlMutexLock(xmlSecOpenSSLX509CertsCacheMutex);
+    cert = NULL;
+    if(xmlSecOpenSSLX509CertsCacheHash != NULL) {
+        cert = (X509*)xmlHashLookup(xmlSecOpenSSLX509CertsCacheHash, key);
+    }
+    if(cert != NULL) {
+        X509_up_ref(cert);
+        ++xmlSecOpenSSLX509CertsCacheHits;
+    } else {
+        ++xmlSecOpenSSLX509CertsCacheMisses;
+    }
+    xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+
+    return(cert);
+}
+
+/* adds a reference to @cert to the cache; failures are not fatal for the caller */
+static void
+xmlSecOpenSSLX509CertsCachePut(const xmlChar* key, X509* cert) {
+    int ret;
+
+    xmlSecAssert(key != NULL);
+    xmlSecAssert(cert != NULL);
+
+    if((key[0] == '\0') || (xmlSecOpenSSLX509CertsCacheMutex == NULL)) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecOpenSSLX509CertsCacheMutex);
+    if(xmlSecOpenSSLX509CertsCacheMaxSize <= 0) {
+        goto done;
+    }
+    if(xmlSecOpenSSLX509CertsCacheSize >= xmlSecOpenSSLX509CertsCacheMaxSize) {
+        xmlSecOpenSSLX509CertsCacheFlush();
+    }
+    if(xmlSecOpenSSLX509CertsCacheHash == NULL) {
+        xmlSecOpenSSLX509CertsCacheHash = xmlHashCreate(0);
+        if(xmlSecOpenSSLX509CertsCacheHash == NULL) {
+            xmlSecXmlError("xmlHashCreate", NULL);
+            goto done;
+        }
+    } else if(xmlHashLookup(xmlSecOpenSSLX509CertsCacheHash, key) != NULL) {
+        /* another thread was faster */
+        goto done;
+    }
+
+    X509_up_ref(cert);
+    ret = xmlHashAddEntry(xmlSecOpenSSLX509CertsCacheHash, key, cert);
+    if(ret != 0) {
+        xmlSecXmlError("xmlHashAddEntry", NULL);
+        X509_free(cert);
+        goto done;
+    }
+    ++xmlSecOpenSSLX509CertsCacheSize;
+
+done:
+    xmlMutexUnlock(xmlSecOpenSSLX509CertsCacheMutex);
+}
+
+/* the caller must hold xmlSecOpenSSLX509CertsCacheMutex */
+static void
+xmlSecOpenSSLX509CertsCacheFlush(void) {
+    if(xmlSecOpenSSLX509CertsCacheHash != NULL) {
+        xmlHashFree(xmlSecOpenSSLX509CertsCacheHash, xmlSecOpenSSLX509CertsCacheDeallocator);
+        xmlSecOpenSSLX509CertsCacheHash = NULL;
+    }
+    xmlSecOpenSSLX509CertsCacheSize = 0;
+}
+
+static void
+xmlSecOpenSSLX509CertsCacheDeallocator(void *payload, const xmlChar *name ATTRIBUTE_UNUSED) {
+    UNREFERENCED_PARAMETER(name);
+    X509_free((X509*)payload);
+}
+
 static X509*
 xmlSecOpenSSLX509CertBase64DerRead(xmlChar* buf) {
     int ret;
@@ -1702,6 +1937,7 @@ xmlSecOpenSSLX509CertBase64DerRead(xmlChar* buf) {
 
 static X509*
 xmlSecOpenSSLX509CertDerRead(const xmlSecByte* buf, xmlSecSize size) {
+    xmlChar key[2 * EVP_MAX_MD_SIZE + 1];
     X509 *cert = NULL;
     BIO *mem = NULL;
     int ret;
@@ -1709,6 +1945,12 @@ xmlSecOpenSSLX509CertDerRead(const xmlSecByte* buf, xmlSecSize size) {
     xmlSecAssert2(buf != NULL, NULL);
     xmlSecAssert2(size > 0, NULL);
 
+    /* repeat messages carry the same certs: skip parsing if possible */
+    cert = xmlSecOpenSSLX509CertsCacheGet(buf, size, key, sizeof(key));
+    if(cert != NULL) {
+        return(cert);
+    }
+
     mem = BIO_new(BIO_s_mem());
     if(mem == NULL) {
         xmlSecOpenSSLError("BIO_new", NULL);
@@ -1732,6 +1974,7 @@ xmlSecOpenSSLX509CertDerRead(const xmlSecByte* buf, xmlSecSize size) {
     }
 
     BIO_free_all(mem);
+    xmlSecOpenSSLX509CertsCachePut(key, cert);
     return(cert);
 }
 
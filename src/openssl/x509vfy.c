@@ -23,8 +23,11 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <time.h>
 
 #include <libxml/tree.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
@@ -32,6 +35,9 @@
 #include <xmlsec/keyinfo.h>
 #include <xmlsec/keysmngr.h>
 #include <xmlsec/base64.h>
+#include <xmlsec/buffer.h>
+#include <xmlsec/private.h>
+#include <xmlsec/private/list.h>
 #include <xmlsec/errors.h>
 
 #include <xmlsec/openssl/crypto.h>
@@ -49,15 +55,43 @@
  * Internal OpenSSL X509 store CTX
  *
  *************************************************************************/
+/*
+ * The store CRLs are verified and indexed by issuer when added to the
+ * store. The set is never modified: it is replaced with a new one and
+ * the old set is destroyed when the last verification using it is done.
+ */
+typedef struct _xmlSecOpenSSLX509CrlSet                 xmlSecOpenSSLX509CrlSet,
+                                                        *xmlSecOpenSSLX509CrlSetPtr;
+struct _xmlSecOpenSSLX509CrlSet {
+    STACK_OF(X509_CRL)* crls;
+    xmlHashTablePtr     issuerIndex;
+    int                 refs;           /* protected by the store crlsMutex */
+};
+
 typedef struct _xmlSecOpenSSLX509StoreCtx               xmlSecOpenSSLX509StoreCtx,
                                                         *xmlSecOpenSSLX509StoreCtxPtr;
 struct _xmlSecOpenSSLX509StoreCtx {
     X509_STORE*         xst;
     STACK_OF(X509)*     untrusted;
-    STACK_OF(X509_CRL)* crls;
+    xmlSecOpenSSLX509CrlSetPtr crls;
+    xmlMutexPtr         crlsMutex;
     X509_VERIFY_PARAM * vpm;
+
+    /* successful chain verifications cache, disabled if verifyCacheMaxSize is 0 */
+    xmlMutexPtr         verifyCacheMutex;
+    xmlHashTablePtr     verifyCache;
+    xmlSecSize          verifyCacheMaxSize;
+    xmlSecSize          generation;
+
+    /* subject, issuer+serial and SKI index of the untrusted certs */
+    xmlHashTablePtr     untrustedIndex;
+    int                 untrustedIndexedSize;
 };
 
+#define xmlSecOpenSSLX509IndexSubject           BAD_CAST "subject"
+#define xmlSecOpenSSLX509IndexIssuerSerial      BAD_CAST "issuer-serial"
+#define xmlSecOpenSSLX509IndexSki               BAD_CAST "ski"
+
 /****************************************************************************
  *
  * xmlSecOpenSSLKeyDataStoreX509Id:
@@ -90,9 +124,57 @@ static xmlSecKeyDataStoreKlass xmlSecOpenSSLX509StoreKlass = {
     NULL,                                       /* void* reserved1; */
 };
 
+static int              xmlSecOpenSSLX509StoreVerifyCacheKey            (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         STACK_OF(X509)* certs,
+                                                                         STACK_OF(X509_CRL)* crls,
+                                                                         xmlSecKeyInfoCtxPtr keyInfoCtx,
+                                                                         xmlChar* key,
+                                                                         xmlSecSize keySize);
+static X509*            xmlSecOpenSSLX509StoreVerifyCacheLookup         (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         const xmlChar* key,
+                                                                         STACK_OF(X509)* certs,
+                                                                         time_t checkTime);
+static void             xmlSecOpenSSLX509StoreVerifyCacheAdd            (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         const xmlChar* key,
+                                                                         STACK_OF(X509)* certs,
+                                                                         X509* cert,
+                                                                         time_t expiration);
+static void             xmlSecOpenSSLX509StoreVerifyCacheReset          (xmlSecOpenSSLX509StoreCtxPtr ctx);
+static void             xmlSecOpenSSLX509StoreVerifyCacheDeallocator    (void *payload,
+                                                                         const xmlChar *name);
+static void             xmlSecOpenSSLX509UpdateExpiration               (const ASN1_TIME* tm,
+                                                                         time_t* expiration);
+static xmlSecOpenSSLX509CrlSetPtr xmlSecOpenSSLX509CrlSetCreate         (STACK_OF(X509_CRL)* crls);
+static void             xmlSecOpenSSLX509CrlSetDestroy                  (xmlSecOpenSSLX509CrlSetPtr crlSet);
+static int              xmlSecOpenSSLX509CrlSetVerifyCert               (xmlSecOpenSSLX509CrlSetPtr crlSet,
+                                                                         X509* cert);
+static xmlSecOpenSSLX509CrlSetPtr xmlSecOpenSSLX509StoreGetCrlSet       (xmlSecOpenSSLX509StoreCtxPtr ctx);
+static void             xmlSecOpenSSLX509StoreReleaseCrlSet             (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         xmlSecOpenSSLX509CrlSetPtr crlSet);
+static int              xmlSecOpenSSLX509StoreSwapCrlSet                (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         STACK_OF(X509_CRL)* crls);
 static int              xmlSecOpenSSLX509VerifyCRL                      (X509_STORE* xst,
                                                                          X509_CRL *crl );
+static int              xmlSecOpenSSLX509StoreIndexUpdate               (xmlSecOpenSSLX509StoreCtxPtr ctx);
+static int              xmlSecOpenSSLX509StoreIndexCert                 (xmlSecOpenSSLX509StoreCtxPtr ctx,
+                                                                         X509* cert,
+                                                                         int pos);
+static void             xmlSecOpenSSLX509StoreIndexReset                (xmlSecOpenSSLX509StoreCtxPtr ctx);
+static int              xmlSecOpenSSLX509NameWrite                      (X509_NAME* nm,
+                                                                         xmlSecBufferPtr buf);
+static int              xmlSecOpenSSLX509SerialWrite                    (ASN1_INTEGER* serial,
+                                                                         xmlSecBufferPtr buf);
+static int              xmlSecOpenSSLX509IndexKey                       (xmlSecBufferPtr buf,
+                                                                         xmlChar* key,
+                                                                         xmlSecSize keySize);
+static int              xmlSecOpenSSLX509FindCertCandidates             (STACK_OF(X509) *certs,
+                                                                         xmlHashTablePtr index,
+                                                                         xmlSecBufferPtr buf,
+                                                                         const xmlChar* kind,
+                                                                         const xmlSecSize** positions,
+                                                                         xmlSecSize* size);
 static X509*            xmlSecOpenSSLX509FindCert                       (STACK_OF(X509) *certs,
+                                                                         xmlHashTablePtr index,
                                                                          xmlChar *subjectName,
                                                                          xmlChar *issuerName,
                                                                          xmlChar *issuerSerial,
@@ -101,6 +183,8 @@ static X509*            xmlSecOpenSSLX509FindNextChainCert              (STACK_O
                                                                          X509 *cert);
 static int              xmlSecOpenSSLX509VerifyCertAgainstCrls          (STACK_OF(X509_CRL) *crls,
                                                                          X509* cert);
+static int              xmlSecOpenSSLX509VerifyCertAgainstCrl           (X509_CRL *crl,
+                                                                         X509* cert);
 static X509_NAME*       xmlSecOpenSSLX509NameRead                       (xmlSecByte *str,
                                                                          int len);
 static int              xmlSecOpenSSLX509NameStringRead                 (xmlSecByte **str,
@@ -158,7 +242,10 @@ xmlSecOpenSSLX509StoreFindCert(xmlSecKeyDataStorePtr store, xmlChar *subjectName
     xmlSecAssert2(ctx != NULL, NULL);
 
     if((res == NULL) && (ctx->untrusted != NULL)) {
-        res = xmlSecOpenSSLX509FindCert(ctx->untrusted, subjectName, issuerName, issuerSerial, ski);
+        /* use the index only if it is up to date */
+        res = xmlSecOpenSSLX509FindCert(ctx->untrusted,
+                (ctx->untrustedIndexedSize == sk_X509_num(ctx->untrusted)) ? ctx->untrustedIndex : NULL,
+                subjectName, issuerName, issuerSerial, ski);
     }
     return(res);
 }
@@ -180,10 +267,15 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
     xmlSecOpenSSLX509StoreCtxPtr ctx;
     STACK_OF(X509)* certs2 = NULL;
     STACK_OF(X509_CRL)* crls2 = NULL;
+    xmlSecOpenSSLX509CrlSetPtr crlSet = NULL;
     X509 * res = NULL;
     X509 * cert;
     X509 * err_cert = NULL;
-    X509_STORE_CTX *xsc;
+    X509_STORE_CTX *xsc = NULL;
+    xmlChar cacheKey[2 * EVP_MAX_MD_SIZE + 1];
+    xmlSecSize cacheMaxSize;
+    int useCache = 0;
+    time_t expiration = 0;
     int err = 0;
     int i;
     int ret;
@@ -192,6 +284,32 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
     xmlSecAssert2(certs != NULL, NULL);
     xmlSecAssert2(keyInfoCtx != NULL, NULL);
 
+    ctx = xmlSecOpenSSLX509StoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->xst != NULL, NULL);
+    xmlSecAssert2(ctx->verifyCacheMutex != NULL, NULL);
+
+    /* check if we already verified the same chain with the same settings */
+    xmlMutexLock(ctx->verifyCacheMutex);
+    cacheMaxSize = ctx->verifyCacheMaxSize;
+    xmlMutexUnlock(ctx->verifyCacheMutex);
+    if((cacheMaxSize > 0) &&
+       ((keyInfoCtx->flags & XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS) == 0)) {
+        ret = xmlSecOpenSSLX509StoreVerifyCacheKey(ctx, certs, crls, keyInfoCtx,
+                                                   cacheKey, sizeof(cacheKey));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509StoreVerifyCacheKey",
+                                xmlSecKeyDataStoreGetName(store));
+            goto done;
+        }
+        res = xmlSecOpenSSLX509StoreVerifyCacheLookup(ctx, cacheKey, certs,
+                (keyInfoCtx->certsVerificationTime > 0) ? keyInfoCtx->certsVerificationTime : time(NULL));
+        if(res != NULL) {
+            return(res);
+        }
+        useCache = 1;
+    }
+
     xsc = X509_STORE_CTX_new();
     if(xsc == NULL) {
         xmlSecOpenSSLError("X509_STORE_CTX_new",
@@ -199,10 +317,6 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
         goto done;
     }
 
-    ctx = xmlSecOpenSSLX509StoreGetCtx(store);
-    xmlSecAssert2(ctx != NULL, NULL);
-    xmlSecAssert2(ctx->xst != NULL, NULL);
-
     /* dup certs */
     certs2 = sk_X509_dup(certs);
     if(certs2 == NULL) {
@@ -247,6 +361,7 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
     }
 
     /* remove all revoked certs */
+    crlSet = xmlSecOpenSSLX509StoreGetCrlSet(ctx);
     for(i = 0; i < sk_X509_num(certs2);) {
         cert = sk_X509_value(certs2, i);
 
@@ -262,13 +377,13 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
             }
         }
 
-        if(ctx->crls != NULL) {
-            ret = xmlSecOpenSSLX509VerifyCertAgainstCrls(ctx->crls, cert);
+        if(crlSet != NULL) {
+            ret = xmlSecOpenSSLX509CrlSetVerifyCert(crlSet, cert);
             if(ret == 0) {
                 (void)sk_X509_delete(certs2, i);
                 continue;
             } else if(ret != 1) {
-                xmlSecInternalError("xmlSecOpenSSLX509VerifyCertAgainstCrls",
+                xmlSecInternalError("xmlSecOpenSSLX509CrlSetVerifyCert",
                                     xmlSecKeyDataStoreGetName(store));
                 goto done;
             }
@@ -324,10 +439,35 @@ xmlSecOpenSSLX509StoreVerify(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509*
             err_cert    = X509_STORE_CTX_get_current_cert(xsc);
             err         = X509_STORE_CTX_get_error(xsc);
 
+            /* the cached result expires with the first cert or crl in use */
+            if((ret == 1) && (useCache != 0)) {
+                STACK_OF(X509)* chain;
+                int j;
+
+                chain = X509_STORE_CTX_get1_chain(xsc);
+                if(chain != NULL) {
+                    for(j = 0; j < sk_X509_num(chain); ++j) {
+                        xmlSecOpenSSLX509UpdateExpiration(X509_get0_notAfter(sk_X509_value(chain, j)), &expiration);
+                    }
+                    sk_X509_pop_free(chain, X509_free);
+                } else {
+                    useCache = 0;
+                }
+                for(j = 0; (crls2 != NULL) && (j < sk_X509_CRL_num(crls2)); ++j) {
+                    xmlSecOpenSSLX509UpdateExpiration(X509_CRL_get0_nextUpdate(sk_X509_CRL_value(crls2, j)), &expiration);
+                }
+                for(j = 0; (crlSet != NULL) && (j < sk_X509_CRL_num(crlSet->crls)); ++j) {
+                    xmlSecOpenSSLX509UpdateExpiration(X509_CRL_get0_nextUpdate(sk_X509_CRL_value(crlSet->crls, j)), &expiration);
+                }
+            }
+
             X509_STORE_CTX_cleanup (xsc);
 
             if(ret == 1) {
                 res = cert;
+                if((useCache != 0) && (expiration > 0)) {
+                    xmlSecOpenSSLX509StoreVerifyCacheAdd(ctx, cacheKey, certs, res, expiration);
+                }
                 goto done;
             } else if(ret < 0) {
                 /* real error */
@@ -395,6 +535,9 @@ done:
     if(crls2 != NULL) {
         sk_X509_CRL_free(crls2);
     }
+    if(crlSet != NULL) {
+        xmlSecOpenSSLX509StoreReleaseCrlSet(ctx, crlSet);
+    }
     if(xsc != NULL) {
         X509_STORE_CTX_free(xsc);
     }
@@ -442,7 +585,16 @@ xmlSecOpenSSLX509StoreAdoptCert(xmlSecKeyDataStorePtr store, X509* cert, xmlSecK
                                xmlSecKeyDataStoreGetName(store));
             return(-1);
         }
+
+        /* the cert is already adopted, lookups fall back to the linear search on failure */
+        ret = xmlSecOpenSSLX509StoreIndexUpdate(ctx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509StoreIndexUpdate",
+                                xmlSecKeyDataStoreGetName(store));
+        }
     }
+
+    xmlSecOpenSSLX509StoreVerifyCacheReset(ctx);
     return(0);
 }
 
@@ -451,13 +603,17 @@ xmlSecOpenSSLX509StoreAdoptCert(xmlSecKeyDataStorePtr store, X509* cert, xmlSecK
  * @store:              the pointer to X509 key data store klass.
  * @crl:                the pointer to OpenSSL X509_CRL.
  *
- * Adds X509 CRL to the store.
+ * Adds X509 CRL to the store. The CRL is verified against the trusted
+ * certificates in @store, hence these should be added first.
  *
  * Returns: 0 on success or a negative value if an error occurs.
  */
 int
 xmlSecOpenSSLX509StoreAdoptCrl(xmlSecKeyDataStorePtr store, X509_CRL* crl) {
     xmlSecOpenSSLX509StoreCtxPtr ctx;
+    xmlSecOpenSSLX509CrlSetPtr crlSet;
+    STACK_OF(X509_CRL)* crls;
+    int i;
     int ret;
 
     xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId), -1);
@@ -465,18 +621,102 @@ xmlSecOpenSSLX509StoreAdoptCrl(xmlSecKeyDataStorePtr store, X509_CRL* crl) {
 
     ctx = xmlSecOpenSSLX509StoreGetCtx(store);
     xmlSecAssert2(ctx != NULL, -1);
-        xmlSecAssert2(ctx->crls != NULL, -1);
+    xmlSecAssert2(ctx->xst != NULL, -1);
+
+    ret = xmlSecOpenSSLX509VerifyCRL(ctx->xst, crl);
+    if(ret != 1) {
+        xmlSecInternalError("xmlSecOpenSSLX509VerifyCRL",
+                            xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
 
-        ret = sk_X509_CRL_push(ctx->crls, crl);
+    /* the new set is the current set plus the new crl */
+    crls = sk_X509_CRL_new_null();
+    if(crls == NULL) {
+        xmlSecOpenSSLError("sk_X509_CRL_new_null",
+                           xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+    crlSet = xmlSecOpenSSLX509StoreGetCrlSet(ctx);
+    for(i = 0; (crlSet != NULL) && (i < sk_X509_CRL_num(crlSet->crls)); ++i) {
+        ret = sk_X509_CRL_push(crls, sk_X509_CRL_value(crlSet->crls, i));
         if(ret < 1) {
             xmlSecOpenSSLError("sk_X509_CRL_push",
                                xmlSecKeyDataStoreGetName(store));
+            xmlSecOpenSSLX509StoreReleaseCrlSet(ctx, crlSet);
+            sk_X509_CRL_pop_free(crls, X509_CRL_free);
             return(-1);
         }
+        X509_CRL_up_ref(sk_X509_CRL_value(crlSet->crls, i));
+    }
+    if(crlSet != NULL) {
+        xmlSecOpenSSLX509StoreReleaseCrlSet(ctx, crlSet);
+    }
+
+    ret = sk_X509_CRL_push(crls, crl);
+    if(ret < 1) {
+        xmlSecOpenSSLError("sk_X509_CRL_push",
+                           xmlSecKeyDataStoreGetName(store));
+        sk_X509_CRL_pop_free(crls, X509_CRL_free);
+        return(-1);
+    }
 
+    ret = xmlSecOpenSSLX509StoreSwapCrlSet(ctx, crls);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509StoreSwapCrlSet",
+                            xmlSecKeyDataStoreGetName(store));
+        /* the crl is owned by the caller on error */
+        (void)sk_X509_CRL_pop(crls);
+        sk_X509_CRL_pop_free(crls, X509_CRL_free);
+        return(-1);
+    }
     return (0);
 }
 
+/**
+ * xmlSecOpenSSLX509StoreReplaceCrls:
+ * @store:              the pointer to X509 key data store klass.
+ * @crls:               the new CRLs stack.
+ *
+ * Replaces all the CRLs in @store with @crls. The CRLs are verified
+ * against the trusted certificates in @store. The verifications in
+ * progress keep using the previous CRLs. The @store takes ownership
+ * of @crls on success.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecOpenSSLX509StoreReplaceCrls(xmlSecKeyDataStorePtr store, XMLSEC_STACK_OF_X509_CRL* crls) {
+    xmlSecOpenSSLX509StoreCtxPtr ctx;
+    int i;
+    int ret;
+
+    xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId), -1);
+    xmlSecAssert2(crls != NULL, -1);
+
+    ctx = xmlSecOpenSSLX509StoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->xst != NULL, -1);
+
+    for(i = 0; i < sk_X509_CRL_num(crls); ++i) {
+        ret = xmlSecOpenSSLX509VerifyCRL(ctx->xst, sk_X509_CRL_value(crls, i));
+        if(ret != 1) {
+            xmlSecInternalError2("xmlSecOpenSSLX509VerifyCRL",
+                                 xmlSecKeyDataStoreGetName(store),
+                                 "crl=%d", i);
+            return(-1);
+        }
+    }
+
+    ret = xmlSecOpenSSLX509StoreSwapCrlSet(ctx, crls);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509StoreSwapCrlSet",
+                            xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
+    return(0);
+}
+
 /**
  * xmlSecOpenSSLX509StoreAddCertsPath:
  * @store: the pointer to OpenSSL x509 store.
@@ -512,6 +752,8 @@ xmlSecOpenSSLX509StoreAddCertsPath(xmlSecKeyDataStorePtr store, const char *path
                             xmlSecErrorsSafeString(path));
         return(-1);
     }
+
+    xmlSecOpenSSLX509StoreVerifyCacheReset(ctx);
     return(0);
 }
 
@@ -550,6 +792,47 @@ xmlSecOpenSSLX509StoreAddCertsFile(xmlSecKeyDataStorePtr store, const char *file
                             xmlSecErrorsSafeString(filename));
         return(-1);
     }
+
+    xmlSecOpenSSLX509StoreVerifyCacheReset(ctx);
+    return(0);
+}
+
+/**
+ * xmlSecOpenSSLX509StoreSetVerifyCacheSize:
+ * @store:              the pointer to OpenSSL x509 store.
+ * @maxSize:            the max number of cached verification results
+ *                      (0 disables the cache).
+ *
+ * Enables caching of the successful certificates chain verifications
+ * in @store: the same certificates and CRLs verified with the same
+ * verification time and depth are not verified again until the first
+ * certificate in the chain expires or the first CRL needs an update.
+ * The cache is flushed when a certificate or a CRL is added to @store.
+ * However, the certificates and CRLs found in the folders added with
+ * #xmlSecOpenSSLX509StoreAddCertsPath are loaded by OpenSSL lazily
+ * during verification and do not flush the cache: a cached result might
+ * be returned even if a certificate or a CRL placed in such a folder
+ * later would change it. The cache is disabled by default.
+ *
+ * Returns: 0 on success or a negative value otherwise.
+ */
+int
+xmlSecOpenSSLX509StoreSetVerifyCacheSize(xmlSecKeyDataStorePtr store, xmlSecSize maxSize) {
+    xmlSecOpenSSLX509StoreCtxPtr ctx;
+
+    xmlSecAssert2(xmlSecKeyDataStoreCheckId(store, xmlSecOpenSSLX509StoreId), -1);
+
+    ctx = xmlSecOpenSSLX509StoreGetCtx(store);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->verifyCacheMutex != NULL, -1);
+
+    xmlMutexLock(ctx->verifyCacheMutex);
+    ctx->verifyCacheMaxSize = maxSize;
+    if(ctx->verifyCache != NULL) {
+        xmlHashFree(ctx->verifyCache, xmlSecOpenSSLX509StoreVerifyCacheDeallocator);
+        ctx->verifyCache = NULL;
+    }
+    xmlMutexUnlock(ctx->verifyCacheMutex);
     return(0);
 }
 
@@ -611,10 +894,10 @@ xmlSecOpenSSLX509StoreInitialize(xmlSecKeyDataStorePtr store) {
         return(-1);
     }
 
-    ctx->crls = sk_X509_CRL_new_null();
-    if(ctx->crls == NULL) {
-        xmlSecOpenSSLError("sk_X509_CRL_new_null",
-                           xmlSecKeyDataStoreGetName(store));
+    ctx->crlsMutex = xmlNewMutex();
+    if(ctx->crlsMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex",
+                       xmlSecKeyDataStoreGetName(store));
         return(-1);
     }
 
@@ -627,6 +910,12 @@ xmlSecOpenSSLX509StoreInitialize(xmlSecKeyDataStorePtr store) {
     X509_VERIFY_PARAM_set_depth(ctx->vpm, 9); /* the default cert verification path in openssl */
     X509_STORE_set1_param(ctx->xst, ctx->vpm);
 
+    ctx->verifyCacheMutex = xmlNewMutex();
+    if(ctx->verifyCacheMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex",
+                       xmlSecKeyDataStoreGetName(store));
+        return(-1);
+    }
 
     return(0);
 }
@@ -647,16 +936,427 @@ xmlSecOpenSSLX509StoreFinalize(xmlSecKeyDataStorePtr store) {
         sk_X509_pop_free(ctx->untrusted, X509_free);
     }
     if(ctx->crls != NULL) {
-        sk_X509_CRL_pop_free(ctx->crls, X509_CRL_free);
+        xmlSecOpenSSLX509CrlSetDestroy(ctx->crls);
+    }
+    if(ctx->crlsMutex != NULL) {
+        xmlFreeMutex(ctx->crlsMutex);
     }
     if(ctx->vpm != NULL) {
         X509_VERIFY_PARAM_free(ctx->vpm);
     }
+    if(ctx->verifyCache != NULL) {
+        xmlHashFree(ctx->verifyCache, xmlSecOpenSSLX509StoreVerifyCacheDeallocator);
+    }
+    if(ctx->verifyCacheMutex != NULL) {
+        xmlFreeMutex(ctx->verifyCacheMutex);
+    }
+    xmlSecOpenSSLX509StoreIndexReset(ctx);
 
     memset(ctx, 0, sizeof(xmlSecOpenSSLX509StoreCtx));
 }
 
 
+/*****************************************************************************
+ *
+ * Verification results cache
+ *
+ *****************************************************************************/
+typedef struct _xmlSecOpenSSLX509StoreVerifyCacheItem   xmlSecOpenSSLX509StoreVerifyCacheItem,
+                                                        *xmlSecOpenSSLX509StoreVerifyCacheItemPtr;
+struct _xmlSecOpenSSLX509StoreVerifyCacheItem {
+    int                 pos;            /* the verified cert position in the certs stack */
+    time_t              expiration;
+};
+
+static int
+xmlSecOpenSSLX509StoreVerifyCacheKey(xmlSecOpenSSLX509StoreCtxPtr ctx, STACK_OF(X509)* certs,
+                                     STACK_OF(X509_CRL)* crls, xmlSecKeyInfoCtxPtr keyInfoCtx,
+                                     xmlChar* key, xmlSecSize keySize) {
+    static const char hex[] = "0123456789abcdef";
+    EVP_MD_CTX* digestCtx;
+    xmlSecSize generation;
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int mdLen;
+    unsigned int ii;
+    int i;
+    int res = -1;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(certs != NULL, -1);
+    xmlSecAssert2(keyInfoCtx != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(keySize >= 2 * EVP_MAX_MD_SIZE + 1, -1);
+    xmlSecAssert2(ctx->verifyCacheMutex != NULL, -1);
+
+    /* the generation is changed by the store updates */
+    xmlMutexLock(ctx->verifyCacheMutex);
+    generation = ctx->generation;
+    xmlMutexUnlock(ctx->verifyCacheMutex);
+
+    digestCtx = EVP_MD_CTX_new();
+    if(digestCtx == NULL) {
+        xmlSecOpenSSLError("EVP_MD_CTX_new", NULL);
+        return(-1);
+    }
+    if(EVP_DigestInit_ex(digestCtx, EVP_sha256(), NULL) != 1) {
+        xmlSecOpenSSLError("EVP_DigestInit_ex", NULL);
+        goto done;
+    }
+
+    /* verification settings and the store state */
+    if((EVP_DigestUpdate(digestCtx, &generation, sizeof(generation)) != 1) ||
+       (EVP_DigestUpdate(digestCtx, &(keyInfoCtx->certsVerificationTime), sizeof(keyInfoCtx->certsVerificationTime)) != 1) ||
+       (EVP_DigestUpdate(digestCtx, &(keyInfoCtx->certsVerificationDepth), sizeof(keyInfoCtx->certsVerificationDepth)) != 1)) {
+        xmlSecOpenSSLError("EVP_DigestUpdate", NULL);
+        goto done;
+    }
+
+    /* certs and crls fingerprints in order */
+    for(i = 0; i < sk_X509_num(certs); ++i) {
+        if(X509_digest(sk_X509_value(certs, i), EVP_sha256(), md, &mdLen) != 1) {
+            xmlSecOpenSSLError("X509_digest", NULL);
+            goto done;
+        }
+        if(EVP_DigestUpdate(digestCtx, md, mdLen) != 1) {
+            xmlSecOpenSSLError("EVP_DigestUpdate", NULL);
+            goto done;
+        }
+    }
+    for(i = 0; (crls != NULL) && (i < sk_X509_CRL_num(crls)); ++i) {
+        if(X509_CRL_digest(sk_X509_CRL_value(crls, i), EVP_sha256(), md, &mdLen) != 1) {
+            xmlSecOpenSSLError("X509_CRL_digest", NULL);
+            goto done;
+        }
+        if(EVP_DigestUpdate(digestCtx, md, mdLen) != 1) {
+            xmlSecOpenSSLError("EVP_DigestUpdate", NULL);
+            goto done;
+        }
+    }
+
+    if(EVP_DigestFinal_ex(digestCtx, md, &mdLen) != 1) {
+        xmlSecOpenSSLError("EVP_DigestFinal_ex", NULL);
+        goto done;
+    }
+    for(ii = 0; ii < mdLen; ++ii) {
+        key[2 * ii]     = hex[(md[ii] >> 4) & 0x0F];
+        key[2 * ii + 1] = hex[md[ii] & 0x0F];
+    }
+    key[2 * mdLen] = '\0';
+
+    /* success */
+    res = 0;
+
+done:
+    EVP_MD_CTX_free(digestCtx);
+    return(res);
+}
+
+static X509*
+xmlSecOpenSSLX509StoreVerifyCacheLookup(xmlSecOpenSSLX509StoreCtxPtr ctx, const xmlChar* key,
+                                        STACK_OF(X509)* certs, time_t checkTime) {
+    xmlSecOpenSSLX509StoreVerifyCacheItemPtr item;
+    X509* res = NULL;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->verifyCacheMutex != NULL, NULL);
+    xmlSecAssert2(key != NULL, NULL);
+    xmlSecAssert2(certs != NULL, NULL);
+
+    xmlMutexLock(ctx->verifyCacheMutex);
+    if(ctx->verifyCache != NULL) {
+        item = (xmlSecOpenSSLX509StoreVerifyCacheItemPtr)xmlHashLookup(ctx->verifyCache, key);
+        if(item != NULL) {
+            if((checkTime < item->expiration) && (item->pos < sk_X509_num(certs))) {
+                res = sk_X509_value(certs, item->pos);
+            } else {
+                xmlHashRemoveEntry(ctx->verifyCache, key, xmlSecOpenSSLX509StoreVerifyCacheDeallocator);
+            }
+        }
+    }
+    xmlMutexUnlock(ctx->verifyCacheMutex);
+    return(res);
+}
+
+static void
+xmlSecOpenSSLX509StoreVerifyCacheAdd(xmlSecOpenSSLX509StoreCtxPtr ctx, const xmlChar* key,
+                                     STACK_OF(X509)* certs, X509* cert, time_t expiration) {
+    xmlSecOpenSSLX509StoreVerifyCacheItemPtr item;
+    int pos;
+
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(ctx->verifyCacheMutex != NULL);
+    xmlSecAssert(key != NULL);
+    xmlSecAssert(certs != NULL);
+    xmlSecAssert(cert != NULL);
+
+    /* we can only cache certs from the verified stack, not from the store */
+    for(pos = 0; (pos < sk_X509_num(certs)) && (sk_X509_value(certs, pos) != cert); ++pos) ;
+    if(pos >= sk_X509_num(certs)) {
+        return;
+    }
+
+    item = (xmlSecOpenSSLX509StoreVerifyCacheItemPtr)xmlMalloc(sizeof(xmlSecOpenSSLX509StoreVerifyCacheItem));
+    if(item == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLX509StoreVerifyCacheItem), NULL);
+        return;
+    }
+    item->pos = pos;
+    item->expiration = expiration;
+
+    xmlMutexLock(ctx->verifyCacheMutex);
+    /* the cache is bounded: start over when it is full */
+    if((ctx->verifyCache != NULL) &&
+       ((xmlSecSize)xmlHashSize(ctx->verifyCache) >= ctx->verifyCacheMaxSize)) {
+        xmlHashFree(ctx->verifyCache, xmlSecOpenSSLX509StoreVerifyCacheDeallocator);
+        ctx->verifyCache = NULL;
+    }
+    if((ctx->verifyCache == NULL) && (ctx->verifyCacheMaxSize > 0)) {
+        ctx->verifyCache = xmlHashCreate(0);
+        if(ctx->verifyCache == NULL) {
+            xmlSecXmlError("xmlHashCreate", NULL);
+        }
+    }
+    if((ctx->verifyCache == NULL) ||
+       (xmlHashUpdateEntry(ctx->verifyCache, key, item, xmlSecOpenSSLX509StoreVerifyCacheDeallocator) != 0)) {
+        xmlFree(item);
+    }
+    xmlMutexUnlock(ctx->verifyCacheMutex);
+}
+
+static void
+xmlSecOpenSSLX509StoreVerifyCacheReset(xmlSecOpenSSLX509StoreCtxPtr ctx) {
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(ctx->verifyCacheMutex != NULL);
+
+    xmlMutexLock(ctx->verifyCacheMutex);
+    ++ctx->generation;
+    if(ctx->verifyCache != NULL) {
+        xmlHashFree(ctx->verifyCache, xmlSecOpenSSLX509StoreVerifyCacheDeallocator);
+        ctx->verifyCache = NULL;
+    }
+    xmlMutexUnlock(ctx->verifyCacheMutex);
+}
+
+static void
+xmlSecOpenSSLX509StoreVerifyCacheDeallocator(void *payload, const xmlChar *name ATTRIBUTE_UNUSED) {
+    UNREFERENCED_PARAMETER(name);
+    xmlFree(payload);
+}
+
+static void
+xmlSecOpenSSLX509UpdateExpiration(const ASN1_TIME* tm, time_t* expiration) {
+    time_t res;
+    int days = 0, secs = 0;
+
+    xmlSecAssert(expiration != NULL);
+
+    if(tm == NULL) {
+        return;
+    }
+    if(ASN1_TIME_diff(&days, &secs, NULL, tm) != 1) {
+        /* can't tell: don't cache */
+        (*expiration) = -1;
+        return;
+    }
+    res = time(NULL) + (time_t)days * 24 * 60 * 60 + secs;
+    if((*expiration) == 0 || ((*expiration) > 0 && res < (*expiration))) {
+        (*expiration) = res;
+    }
+}
+
+/*****************************************************************************
+ *
+ * Store CRLs set
+ *
+ *****************************************************************************/
+static xmlSecOpenSSLX509CrlSetPtr
+xmlSecOpenSSLX509CrlSetCreate(STACK_OF(X509_CRL)* crls) {
+    xmlSecOpenSSLX509CrlSetPtr crlSet;
+    xmlChar key[2 * EVP_MAX_MD_SIZE + 1];
+    xmlSecBufferPtr buf;
+    ASN1_INTEGER *serial;
+    X509_REVOKED *revoked;
+    X509_CRL *crl;
+    int i;
+    int ret;
+
+    xmlSecAssert2(crls != NULL, NULL);
+
+    crlSet = (xmlSecOpenSSLX509CrlSetPtr)xmlMalloc(sizeof(xmlSecOpenSSLX509CrlSet));
+    if(crlSet == NULL) {
+        xmlSecMallocError(sizeof(xmlSecOpenSSLX509CrlSet), NULL);
+        return(NULL);
+    }
+    memset(crlSet, 0, sizeof(xmlSecOpenSSLX509CrlSet));
+    crlSet->refs = 1;
+
+    buf = xmlSecBufferCreate(0);
+    if(buf == NULL) {
+        xmlSecInternalError("xmlSecBufferCreate", NULL);
+        xmlSecOpenSSLX509CrlSetDestroy(crlSet);
+        return(NULL);
+    }
+    serial = ASN1_INTEGER_new();
+    if(serial == NULL) {
+        xmlSecOpenSSLError("ASN1_INTEGER_new", NULL);
+        xmlSecBufferDestroy(buf);
+        xmlSecOpenSSLX509CrlSetDestroy(crlSet);
+        return(NULL);
+    }
+
+    for(i = 0; i < sk_X509_CRL_num(crls); ++i) {
+        crl = sk_X509_CRL_value(crls, i);
+        if(crl == NULL) {
+            continue;
+        }
+
+        xmlSecBufferEmpty(buf);
+        if((xmlSecOpenSSLX509NameWrite(X509_CRL_get_issuer(crl), buf) < 0) ||
+           (xmlSecOpenSSLX509IndexKey(buf, key, sizeof(key)) < 0)) {
+            xmlSecInternalError("xmlSecOpenSSLX509NameWrite(issuer)", NULL);
+            ASN1_INTEGER_free(serial);
+            xmlSecBufferDestroy(buf);
+            xmlSecOpenSSLX509CrlSetDestroy(crlSet);
+            return(NULL);
+        }
+        ret = xmlSecPtrListIndexAdd(&(crlSet->issuerIndex), key, NULL, (xmlSecSize)i);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecPtrListIndexAdd(issuer)", NULL);
+            ASN1_INTEGER_free(serial);
+            xmlSecBufferDestroy(buf);
+            xmlSecOpenSSLX509CrlSetDestroy(crlSet);
+            return(NULL);
+        }
+
+        /* the first lookup sorts the revoked entries, do it now */
+        (void)X509_CRL_get0_by_serial(crl, &revoked, serial);
+    }
+    ASN1_INTEGER_free(serial);
+    xmlSecBufferDestroy(buf);
+
+    /* success: adopt crls */
+    crlSet->crls = crls;
+    return(crlSet);
+}
+
+static void
+xmlSecOpenSSLX509CrlSetDestroy(xmlSecOpenSSLX509CrlSetPtr crlSet) {
+    xmlSecAssert(crlSet != NULL);
+
+    if(crlSet->crls != NULL) {
+        sk_X509_CRL_pop_free(crlSet->crls, X509_CRL_free);
+    }
+    xmlSecPtrListIndexDestroy(crlSet->issuerIndex);
+    memset(crlSet, 0, sizeof(xmlSecOpenSSLX509CrlSet));
+    xmlFree(crlSet);
+}
+
+static int
+xmlSecOpenSSLX509CrlSetVerifyCert(xmlSecOpenSSLX509CrlSetPtr crlSet, X509* cert) {
+    xmlChar key[2 * EVP_MAX_MD_SIZE + 1];
+    xmlSecBufferPtr buf;
+    const xmlSecSize* positions;
+    xmlSecSize ii, size;
+    X509_NAME *issuer;
+    X509_CRL *crl;
+    int ret;
+
+    xmlSecAssert2(crlSet != NULL, -1);
+    xmlSecAssert2(crlSet->crls != NULL, -1);
+    xmlSecAssert2(cert != NULL, -1);
+
+    issuer = X509_get_issuer_name(cert);
+
+    buf = xmlSecBufferCreate(0);
+    if(buf == NULL) {
+        xmlSecInternalError("xmlSecBufferCreate", NULL);
+        return(-1);
+    }
+    ret = xmlSecOpenSSLX509NameWrite(issuer, buf);
+    if(ret >= 0) {
+        ret = xmlSecOpenSSLX509IndexKey(buf, key, sizeof(key));
+    }
+    xmlSecBufferDestroy(buf);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509NameWrite(issuer)", NULL);
+        return(-1);
+    }
+
+    /* the first CRL for this issuer is used */
+    positions = xmlSecPtrListIndexLookup(crlSet->issuerIndex, key, NULL, &size);
+    for(ii = 0; ii < size; ++ii) {
+        crl = sk_X509_CRL_value(crlSet->crls, (int)positions[ii]);
+        if((crl != NULL) && (xmlSecOpenSSLX509NamesCompare(X509_CRL_get_issuer(crl), issuer) == 0)) {
+            return(xmlSecOpenSSLX509VerifyCertAgainstCrl(crl, cert));
+        }
+    }
+
+    /* no crls for this issuer */
+    return(1);
+}
+
+static xmlSecOpenSSLX509CrlSetPtr
+xmlSecOpenSSLX509StoreGetCrlSet(xmlSecOpenSSLX509StoreCtxPtr ctx) {
+    xmlSecOpenSSLX509CrlSetPtr crlSet;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->crlsMutex != NULL, NULL);
+
+    xmlMutexLock(ctx->crlsMutex);
+    crlSet = ctx->crls;
+    if(crlSet != NULL) {
+        ++crlSet->refs;
+    }
+    xmlMutexUnlock(ctx->crlsMutex);
+    return(crlSet);
+}
+
+static void
+xmlSecOpenSSLX509StoreReleaseCrlSet(xmlSecOpenSSLX509StoreCtxPtr ctx, xmlSecOpenSSLX509CrlSetPtr crlSet) {
+    int refs;
+
+    xmlSecAssert(ctx != NULL);
+    xmlSecAssert(ctx->crlsMutex != NULL);
+    xmlSecAssert(crlSet != NULL);
+
+    xmlMutexLock(ctx->crlsMutex);
+    refs = --crlSet->refs;
+    xmlMutexUnlock(ctx->crlsMutex);
+
+    if(refs <= 0) {
+        xmlSecOpenSSLX509CrlSetDestroy(crlSet);
+    }
+}
+
+/* adopts @crls on success */
+static int
+xmlSecOpenSSLX509StoreSwapCrlSet(xmlSecOpenSSLX509StoreCtxPtr ctx, STACK_OF(X509_CRL)* crls) {
+    xmlSecOpenSSLX509CrlSetPtr crlSet;
+    xmlSecOpenSSLX509CrlSetPtr oldCrlSet;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->crlsMutex != NULL, -1);
+    xmlSecAssert2(crls != NULL, -1);
+
+    /* build the new set before taking the lock */
+    crlSet = xmlSecOpenSSLX509CrlSetCreate(crls);
+    if(crlSet == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509CrlSetCreate", NULL);
+        return(-1);
+    }
+
+    xmlMutexLock(ctx->crlsMutex);
+    oldCrlSet = ctx->crls;
+    ctx->crls = crlSet;
+    xmlMutexUnlock(ctx->crlsMutex);
+
+    if(oldCrlSet != NULL) {
+        xmlSecOpenSSLX509StoreReleaseCrlSet(ctx, oldCrlSet);
+    }
+    xmlSecOpenSSLX509StoreVerifyCacheReset(ctx);
+    return(0);
+}
+
 /*****************************************************************************
  *
  * Low-level x509 functions
@@ -714,16 +1414,283 @@ err:
     return(-1);
 }
 
+/*****************************************************************************
+ *
+ * Untrusted certs index
+ *
+ *****************************************************************************/
+static int
+xmlSecOpenSSLX509StoreIndexUpdate(xmlSecOpenSSLX509StoreCtxPtr ctx) {
+    int pos, size;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->untrusted != NULL, -1);
+
+    size = sk_X509_num(ctx->untrusted);
+    if(ctx->untrustedIndexedSize > size) {
+        xmlSecOpenSSLX509StoreIndexReset(ctx);
+    }
+
+    for(pos = ctx->untrustedIndexedSize; pos < size; ++pos) {
+        ret = xmlSecOpenSSLX509StoreIndexCert(ctx, sk_X509_value(ctx->untrusted, pos), pos);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509StoreIndexCert", NULL);
+            xmlSecOpenSSLX509StoreIndexReset(ctx);
+            return(-1);
+        }
+    }
+    ctx->untrustedIndexedSize = size;
+    return(0);
+}
+
+static int
+xmlSecOpenSSLX509StoreIndexCert(xmlSecOpenSSLX509StoreCtxPtr ctx, X509* cert, int pos) {
+    xmlChar key[2 * EVP_MAX_MD_SIZE + 1];
+    xmlSecBufferPtr buf;
+    X509_EXTENSION *ext;
+    ASN1_OCTET_STRING *keyId;
+    int extPos;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(cert != NULL, -1);
+    xmlSecAssert2(pos >= 0, -1);
+
+    buf = xmlSecBufferCreate(0);
+    if(buf == NULL) {
+        xmlSecInternalError("xmlSecBufferCreate", NULL);
+        return(-1);
+    }
+
+    /* subject */
+    if((xmlSecOpenSSLX509NameWrite(X509_get_subject_name(cert), buf) < 0) ||
+       (xmlSecOpenSSLX509IndexKey(buf, key, sizeof(key)) < 0)) {
+        xmlSecInternalError("xmlSecOpenSSLX509NameWrite(subject)", NULL);
+        goto done;
+    }
+    ret = xmlSecPtrListIndexAdd(&(ctx->untrustedIndex), key, xmlSecOpenSSLX509IndexSubject, (xmlSecSize)pos);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListIndexAdd(subject)", NULL);
+        goto done;
+    }
+
+    /* issuer and serial */
+    xmlSecBufferEmpty(buf);
+    if((xmlSecOpenSSLX509NameWrite(X509_get_issuer_name(cert), buf) < 0) ||
+       (xmlSecOpenSSLX509SerialWrite(X509_get_serialNumber(cert), buf) < 0) ||
+       (xmlSecOpenSSLX509IndexKey(buf, key, sizeof(key)) < 0)) {
+        xmlSecInternalError("xmlSecOpenSSLX509NameWrite(issuer)", NULL);
+        goto done;
+    }
+    ret = xmlSecPtrListIndexAdd(&(ctx->untrustedIndex), key, xmlSecOpenSSLX509IndexIssuerSerial, (xmlSecSize)pos);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListIndexAdd(issuer-serial)", NULL);
+        goto done;
+    }
+
+    /* ski (optional) */
+    extPos = X509_get_ext_by_NID(cert, NID_subject_key_identifier, -1);
+    ext = (extPos >= 0) ? X509_get_ext(cert, extPos) : NULL;
+    keyId = (ext != NULL) ? (ASN1_OCTET_STRING *)X509V3_EXT_d2i(ext) : NULL;
+    if(keyId != NULL) {
+        xmlSecBufferEmpty(buf);
+        ret = xmlSecBufferAppend(buf, ASN1_STRING_get0_data(keyId), ASN1_STRING_length(keyId));
+        ASN1_OCTET_STRING_free(keyId);
+        if((ret < 0) || (xmlSecOpenSSLX509IndexKey(buf, key, sizeof(key)) < 0)) {
+            xmlSecInternalError("xmlSecOpenSSLX509IndexKey(ski)", NULL);
+            goto done;
+        }
+        ret = xmlSecPtrListIndexAdd(&(ctx->untrustedIndex), key, xmlSecOpenSSLX509IndexSki, (xmlSecSize)pos);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecPtrListIndexAdd(ski)", NULL);
+            goto done;
+        }
+    }
+
+    /* success */
+    res = 0;
+
+done:
+    xmlSecBufferDestroy(buf);
+    return(res);
+}
+
+static void
+xmlSecOpenSSLX509StoreIndexReset(xmlSecOpenSSLX509StoreCtxPtr ctx) {
+    xmlSecAssert(ctx != NULL);
+
+    xmlSecPtrListIndexDestroy(ctx->untrustedIndex);
+    ctx->untrustedIndex = NULL;
+    ctx->untrustedIndexedSize = 0;
+}
+
+/*
+ * Writes the name entries sorted the same way as in xmlSecOpenSSLX509NamesCompare()
+ * so the names that compare equal have the same representation.
+ */
+static int
+xmlSecOpenSSLX509NameWrite(X509_NAME* nm, xmlSecBufferPtr buf) {
+    STACK_OF(X509_NAME_ENTRY) *entries;
+    X509_NAME_ENTRY *entry;
+    ASN1_STRING *value;
+    char oid[128];
+    int len;
+    int ii;
+    int res = -1;
+
+    xmlSecAssert2(nm != NULL, -1);
+    xmlSecAssert2(buf != NULL, -1);
+
+    entries = xmlSecOpenSSLX509_NAME_ENTRIES_copy(nm);
+    if(entries == NULL) {
+        xmlSecInternalError("xmlSecOpenSSLX509_NAME_ENTRIES_copy", NULL);
+        return(-1);
+    }
+    (void)sk_X509_NAME_ENTRY_set_cmp_func(entries, xmlSecOpenSSLX509_NAME_ENTRY_cmp);
+    sk_X509_NAME_ENTRY_sort(entries);
+
+    for(ii = 0; ii < sk_X509_NAME_ENTRY_num(entries); ++ii) {
+        entry = sk_X509_NAME_ENTRY_value(entries, ii);
+
+        len = OBJ_obj2txt(oid, sizeof(oid), X509_NAME_ENTRY_get_object(entry), 1);
+        if((len < 0) || (len >= (int)sizeof(oid))) {
+            xmlSecOpenSSLError("OBJ_obj2txt", NULL);
+            goto done;
+        }
+        if(xmlSecBufferAppend(buf, (const xmlSecByte*)oid, len + 1) < 0) {
+            xmlSecInternalError("xmlSecBufferAppend", NULL);
+            goto done;
+        }
+
+        value = X509_NAME_ENTRY_get_data(entry);
+        len = (value != NULL) ? ASN1_STRING_length(value) : 0;
+        if((xmlSecBufferAppend(buf, (const xmlSecByte*)&len, sizeof(len)) < 0) ||
+           ((len > 0) && (xmlSecBufferAppend(buf, ASN1_STRING_get0_data(value), len) < 0))) {
+            xmlSecInternalError("xmlSecBufferAppend", NULL);
+            goto done;
+        }
+    }
+
+    /* success */
+    res = 0;
+
+done:
+    sk_X509_NAME_ENTRY_free(entries);
+    return(res);
+}
+
+static int
+xmlSecOpenSSLX509SerialWrite(ASN1_INTEGER* serial, xmlSecBufferPtr buf) {
+    BIGNUM *bn;
+    char *str;
+    int ret;
+
+    xmlSecAssert2(serial != NULL, -1);
+    xmlSecAssert2(buf != NULL, -1);
+
+    bn = ASN1_INTEGER_to_BN(serial, NULL);
+    if(bn == NULL) {
+        xmlSecOpenSSLError("ASN1_INTEGER_to_BN", NULL);
+        return(-1);
+    }
+    str = BN_bn2hex(bn);
+    BN_free(bn);
+    if(str == NULL) {
+        xmlSecOpenSSLError("BN_bn2hex", NULL);
+        return(-1);
+    }
+
+    ret = xmlSecBufferAppend(buf, (const xmlSecByte*)str, strlen(str) + 1);
+    OPENSSL_free(str);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecBufferAppend", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+static int
+xmlSecOpenSSLX509IndexKey(xmlSecBufferPtr buf, xmlChar* key, xmlSecSize keySize) {
+    static const char hex[] = "0123456789abcdef";
+    unsigned char md[EVP_MAX_MD_SIZE];
+    unsigned int mdLen = 0;
+    unsigned int ii;
+
+    xmlSecAssert2(buf != NULL, -1);
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(keySize >= 2 * EVP_MAX_MD_SIZE + 1, -1);
+
+    if(EVP_Digest(xmlSecBufferGetData(buf), xmlSecBufferGetSize(buf), md, &mdLen, EVP_sha256(), NULL) != 1) {
+        xmlSecOpenSSLError("EVP_Digest", NULL);
+        return(-1);
+    }
+    for(ii = 0; ii < mdLen; ++ii) {
+        key[2 * ii]     = hex[(md[ii] >> 4) & 0x0F];
+        key[2 * ii + 1] = hex[md[ii] & 0x0F];
+    }
+    key[2 * mdLen] = '\0';
+    return(0);
+}
+
+/*
+ * Picks the candidates positions for the key in @buf from @index or
+ * returns all the certs in @certs (@positions is NULL) if @index is NULL.
+ */
+static int
+xmlSecOpenSSLX509FindCertCandidates(STACK_OF(X509) *certs, xmlHashTablePtr index,
+                                    xmlSecBufferPtr buf, const xmlChar* kind,
+                                    const xmlSecSize** positions, xmlSecSize* size) {
+    xmlChar key[2 * EVP_MAX_MD_SIZE + 1];
+    int ret;
+
+    xmlSecAssert2(certs != NULL, -1);
+    xmlSecAssert2(kind != NULL, -1);
+    xmlSecAssert2(positions != NULL, -1);
+    xmlSecAssert2(size != NULL, -1);
+
+    if(index == NULL) {
+        (*positions) = NULL;
+        (*size) = (xmlSecSize)sk_X509_num(certs);
+        return(0);
+    }
+    xmlSecAssert2(buf != NULL, -1);
+
+    ret = xmlSecOpenSSLX509IndexKey(buf, key, sizeof(key));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecOpenSSLX509IndexKey", NULL);
+        return(-1);
+    }
+    (*positions) = xmlSecPtrListIndexLookup(index, key, kind, size);
+    return(0);
+}
+
+/*
+ * The @index (if not NULL) is used to pick the candidates from @certs, the
+ * candidates are still compared with the requested values.
+ */
 static X509*
-xmlSecOpenSSLX509FindCert(STACK_OF(X509) *certs, xmlChar *subjectName,
-                        xmlChar *issuerName, xmlChar *issuerSerial,
-                        xmlChar *ski) {
+xmlSecOpenSSLX509FindCert(STACK_OF(X509) *certs, xmlHashTablePtr index,
+                        xmlChar *subjectName, xmlChar *issuerName,
+                        xmlChar *issuerSerial, xmlChar *ski) {
+    xmlSecBufferPtr buf = NULL;
+    const xmlSecSize* positions = NULL;
+    xmlSecSize ii, size;
     X509 *cert = NULL;
-    int i;
+    X509 *res = NULL;
+    int ret;
 
     xmlSecAssert2(certs != NULL, NULL);
 
-    /* todo: may be this is not the fastest way to search certs */
+    if(index != NULL) {
+        buf = xmlSecBufferCreate(0);
+        if(buf == NULL) {
+            xmlSecInternalError("xmlSecBufferCreate", NULL);
+            return(NULL);
+        }
+    }
+
     if(subjectName != NULL) {
         X509_NAME *nm;
         X509_NAME *subj;
@@ -732,15 +1699,27 @@ xmlSecOpenSSLX509FindCert(STACK_OF(X509) *certs, xmlChar *subjectName,
         if(nm == NULL) {
             xmlSecInternalError2("xmlSecOpenSSLX509NameRead", NULL,
                                  "subject=%s", xmlSecErrorsSafeString(subjectName));
-            return(NULL);
+            goto done;
+        }
+        if((buf != NULL) && (xmlSecOpenSSLX509NameWrite(nm, buf) < 0)) {
+            xmlSecInternalError("xmlSecOpenSSLX509NameWrite", NULL);
+            X509_NAME_free(nm);
+            goto done;
         }
 
-        for(i = 0; i < sk_X509_num(certs); ++i) {
-            cert = sk_X509_value(certs, i);
+        ret = xmlSecOpenSSLX509FindCertCandidates(certs, index, buf, xmlSecOpenSSLX509IndexSubject,
+                                                  &positions, &size);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509FindCertCandidates", NULL);
+            X509_NAME_free(nm);
+            goto done;
+        }
+        for(ii = 0; ii < size; ++ii) {
+            cert = sk_X509_value(certs, (positions != NULL) ? (int)positions[ii] : (int)ii);
             subj = X509_get_subject_name(cert);
             if(xmlSecOpenSSLX509NamesCompare(nm, subj) == 0) {
-                X509_NAME_free(nm);
-                return(cert);
+                res = cert;
+                break;
             }
         }
         X509_NAME_free(nm);
@@ -754,20 +1733,20 @@ xmlSecOpenSSLX509FindCert(STACK_OF(X509) *certs, xmlChar *subjectName,
         if(nm == NULL) {
             xmlSecInternalError2("xmlSecOpenSSLX509NameRead", NULL,
                                  "issuer=%s", xmlSecErrorsSafeString(issuerName));
-            return(NULL);
+            goto done;
         }
 
         bn = BN_new();
         if(bn == NULL) {
             xmlSecOpenSSLError("BN_new", NULL);
             X509_NAME_free(nm);
-            return(NULL);
+            goto done;
         }
         if(BN_dec2bn(&bn, (char*)issuerSerial) == 0) {
             xmlSecOpenSSLError("BN_dec2bn", NULL);
             BN_free(bn);
             X509_NAME_free(nm);
-            return(NULL);
+            goto done;
         }
 
         serial = BN_to_ASN1_INTEGER(bn, NULL);
@@ -775,21 +1754,35 @@ xmlSecOpenSSLX509FindCert(STACK_OF(X509) *certs, xmlChar *subjectName,
             xmlSecOpenSSLError("BN_to_ASN1_INTEGER", NULL);
             BN_free(bn);
             X509_NAME_free(nm);
-            return(NULL);
+            goto done;
         }
         BN_free(bn);
 
+        if((buf != NULL) &&
+           ((xmlSecOpenSSLX509NameWrite(nm, buf) < 0) || (xmlSecOpenSSLX509SerialWrite(serial, buf) < 0))) {
+            xmlSecInternalError("xmlSecOpenSSLX509NameWrite", NULL);
+            ASN1_INTEGER_free(serial);
+            X509_NAME_free(nm);
+            goto done;
+        }
 
-        for(i = 0; i < sk_X509_num(certs); ++i) {
-            cert = sk_X509_value(certs, i);
+        ret = xmlSecOpenSSLX509FindCertCandidates(certs, index, buf, xmlSecOpenSSLX509IndexIssuerSerial,
+                                                  &positions, &size);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509FindCertCandidates", NULL);
+            ASN1_INTEGER_free(serial);
+            X509_NAME_free(nm);
+            goto done;
+        }
+        for(ii = 0; ii < size; ++ii) {
+            cert = sk_X509_value(certs, (positions != NULL) ? (int)positions[ii] : (int)ii);
             if(ASN1_INTEGER_cmp(X509_get_serialNumber(cert), serial) != 0) {
                 continue;
             }
             issuer = X509_get_issuer_name(cert);
             if(xmlSecOpenSSLX509NamesCompare(nm, issuer) == 0) {
-                ASN1_INTEGER_free(serial);
-                X509_NAME_free(nm);
-                return(cert);
+                res = cert;
+                break;
             }
         }
 
@@ -797,7 +1790,7 @@ xmlSecOpenSSLX509FindCert(STACK_OF(X509) *certs, xmlChar *subjectName,
         ASN1_INTEGER_free(serial);
     } else if(ski != NULL) {
         int len;
-        int index;
+        int extPos;
         X509_EXTENSION *ext;
         ASN1_OCTET_STRING *keyId;
 
@@ -806,15 +1799,26 @@ xmlSecOpenSSLX509FindCert(STACK_OF(X509) *certs, xmlChar *subjectName,
         if(len < 0) {
             xmlSecInternalError2("xmlSecBase64Decode", NULL,
                                  "ski=%s", xmlSecErrorsSafeString(ski));
-            return(NULL);
+            goto done;
+        }
+        if((buf != NULL) && (xmlSecBufferAppend(buf, ski, len) < 0)) {
+            xmlSecInternalError("xmlSecBufferAppend", NULL);
+            goto done;
+        }
+
+        ret = xmlSecOpenSSLX509FindCertCandidates(certs, index, buf, xmlSecOpenSSLX509IndexSki,
+                                                  &positions, &size);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecOpenSSLX509FindCertCandidates", NULL);
+            goto done;
         }
-        for(i = 0; i < sk_X509_num(certs); ++i) {
-            cert = sk_X509_value(certs, i);
-            index = X509_get_ext_by_NID(cert, NID_subject_key_identifier, -1);
-            if(index < 0) {
+        for(ii = 0; ii < size; ++ii) {
+            cert = sk_X509_value(certs, (positions != NULL) ? (int)positions[ii] : (int)ii);
+            extPos = X509_get_ext_by_NID(cert, NID_subject_key_identifier, -1);
+            if(extPos < 0) {
                 continue;
             }
-            ext = X509_get_ext(cert, index);
+            ext = X509_get_ext(cert, extPos);
             if(ext == NULL) {
                 continue;
             }
@@ -824,13 +1828,18 @@ xmlSecOpenSSLX509FindCert(STACK_OF(X509) *certs, xmlChar *subjectName,
             }
             if((keyId->length == len) && (memcmp(keyId->data, ski, len) == 0)) {
                 ASN1_OCTET_STRING_free(keyId);
-                return(cert);
+                res = cert;
+                break;
             }
             ASN1_OCTET_STRING_free(keyId);
         }
     }
 
-    return(NULL);
+done:
+    if(buf != NULL) {
+        xmlSecBufferDestroy(buf);
+    }
+    return(res);
 }
 
 static X509*
@@ -856,9 +1865,7 @@ static int
 xmlSecOpenSSLX509VerifyCertAgainstCrls(STACK_OF(X509_CRL) *crls, X509* cert) {
     X509_NAME *issuer;
     X509_CRL *crl = NULL;
-    X509_REVOKED *revoked;
     int i, n;
-    int ret;
 
     xmlSecAssert2(crls != NULL, -1);
     xmlSecAssert2(cert != NULL, -1);
@@ -884,6 +1891,17 @@ xmlSecOpenSSLX509VerifyCertAgainstCrls(STACK_OF(X509_CRL) *crls, X509* cert) {
         return(1);
     }
 
+    return(xmlSecOpenSSLX509VerifyCertAgainstCrl(crl, cert));
+}
+
+static int
+xmlSecOpenSSLX509VerifyCertAgainstCrl(X509_CRL *crl, X509* cert) {
+    X509_REVOKED *revoked = NULL;
+    int ret;
+
+    xmlSecAssert2(crl != NULL, -1);
+    xmlSecAssert2(cert != NULL, -1);
+
     /*
      * Check date of CRL to make sure it's not expired
      */
@@ -895,14 +1913,12 @@ xmlSecOpenSSLX509VerifyCertAgainstCrls(STACK_OF(X509_CRL) *crls, X509* cert) {
 
     /*
      * Check if the current certificate is revoked by this CRL
+     * (OpenSSL keeps the revoked entries sorted by serial)
      */
-    n = sk_X509_REVOKED_num(X509_CRL_get_REVOKED(crl));
-    for (i = 0; i < n; i++) {
-        revoked = sk_X509_REVOKED_value(X509_CRL_get_REVOKED(crl), i);
-        if (ASN1_INTEGER_cmp(X509_REVOKED_get0_serialNumber(revoked), X509_get_serialNumber(cert)) == 0) {
-            xmlSecOtherError(XMLSEC_ERRORS_R_CERT_REVOKED, NULL, NULL);
-            return(0);
-        }
+    ret = X509_CRL_get0_by_serial(crl, &revoked, X509_get_serialNumber(cert));
+    if(ret != 0) {
+        xmlSecOtherError(XMLSEC_ERRORS_R_CERT_REVOKED, NULL, NULL);
+        return(0);
     }
     return(1);
 }
@@ -22,6 +22,8 @@
 #include <libxml/tree.h>
 #include <libxml/parser.h>
 #include <libxml/parserInternals.h>
+#include <libxml/threads.h>
+#include <libxml/globals.h>
 
 #include <xmlsec/xmlsec.h>
 #include <xmlsec/xmltree.h>
@@ -30,6 +32,347 @@
 #include <xmlsec/parser.h>
 #include <xmlsec/errors.h>
 
+/**************************************************************************
+ *
+ * Parser contexts pool
+ *
+ * Creating libxml2 parser context (and its dictionary) is a noticeable part
+ * of parsing a small document. If enabled, the successfully used contexts
+ * are reset and kept in the process-wide pool. A pooled context is reused
+ * only if the current thread's libxml2 parser defaults are the same as
+ * when it was created.
+ *
+ * The documents might be used by other threads, hence they can not share
+ * a dictionary: each parse gets a new sub-dictionary of the context's
+ * original dictionary. The original dictionary is only read after the
+ * context creation.
+ *
+ *****************************************************************************/
+typedef struct _xmlSecParserPoolEntry                   xmlSecParserPoolEntry,
+                                                        *xmlSecParserPoolEntryPtr;
+struct _xmlSecParserPoolEntry {
+    xmlParserCtxtPtr                    ctxt;
+    xmlDictPtr                          dict;
+    int                                 defaults;
+
+    /* the context fields initialized from the defaults */
+    int                                 options;
+    int                                 loadsubset;
+    int                                 replaceEntities;
+    int                                 keepBlanks;
+    int                                 validate;
+    int                                 pedantic;
+    int                                 linenumbers;
+
+    xmlSecParserPoolEntryPtr            next;
+};
+
+static xmlMutexPtr              xmlSecParserPoolMutex = NULL;
+static xmlSecParserPoolEntryPtr xmlSecParserPoolHead = NULL;    /* most recently released */
+static xmlSecSize               xmlSecParserPoolSize = 0;
+static xmlSecSize               xmlSecParserPoolMaxSize = XMLSEC_PARSER_POOL_DEFAULT_MAX_SIZE;
+static xmlSecSize               xmlSecParserPoolHits = 0;
+static xmlSecSize               xmlSecParserPoolMisses = 0;
+
+static int                      xmlSecParserPoolGetDefaults     (void);
+static void                     xmlSecParserPoolTrim            (void);
+static int                      xmlSecParserPoolNewDict         (xmlSecParserPoolEntryPtr entry);
+static xmlSecParserPoolEntryPtr xmlSecParserPoolAcquire         (void);
+static void                     xmlSecParserPoolRelease         (xmlSecParserPoolEntryPtr entry,
+                                                                 int reuse);
+static void                     xmlSecParserPoolEntryDestroy    (xmlSecParserPoolEntryPtr entry);
+
+/**
+ * xmlSecParserPoolInit:
+ *
+ * Initializes the process-wide pool of libxml2 parser contexts used by
+ * #xmlSecParseFile, #xmlSecParseMemory, #xmlSecParseMemoryExt functions
+ * and the XML parser transform. This function is called from #xmlSecInit
+ * function and the application should not call it directly.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecParserPoolInit(void) {
+    if(xmlSecParserPoolMutex != NULL) {
+        return(0);
+    }
+
+    xmlSecParserPoolMutex = xmlNewMutex();
+    if(xmlSecParserPoolMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        return(-1);
+    }
+
+    xmlSecParserPoolHits = xmlSecParserPoolMisses = 0;
+    return(0);
+}
+
+/**
+ * xmlSecParserPoolShutdown:
+ *
+ * Frees all the pooled parser contexts. This function is called from
+ * #xmlSecShutdown function and the application should not call it directly.
+ */
+void
+xmlSecParserPoolShutdown(void) {
+    xmlSecParserPoolEntryPtr entry;
+
+    if(xmlSecParserPoolMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecParserPoolMutex);
+    while(xmlSecParserPoolHead != NULL) {
+        entry = xmlSecParserPoolHead;
+        xmlSecParserPoolHead = entry->next;
+        xmlSecParserPoolEntryDestroy(entry);
+    }
+    xmlSecParserPoolSize = 0;
+    xmlMutexUnlock(xmlSecParserPoolMutex);
+
+    xmlFreeMutex(xmlSecParserPoolMutex);
+    xmlSecParserPoolMutex = NULL;
+}
+
+/**
+ * xmlSecParserPoolSetMaxSize:
+ * @maxSize:            the max number of pooled parser contexts.
+ *
+ * Sets the max number of parser contexts kept for reuse. The pool is
+ * disabled by default (#XMLSEC_PARSER_POOL_DEFAULT_MAX_SIZE) and a new
+ * parser context is created for each document.
+ */
+void
+xmlSecParserPoolSetMaxSize(xmlSecSize maxSize) {
+    if(xmlSecParserPoolMutex == NULL) {
+        xmlSecParserPoolMaxSize = maxSize;
+        return;
+    }
+
+    xmlMutexLock(xmlSecParserPoolMutex);
+    xmlSecParserPoolMaxSize = maxSize;
+    xmlSecParserPoolTrim();
+    xmlMutexUnlock(xmlSecParserPoolMutex);
+}
+
+/**
+ * xmlSecParserPoolGetStats:
+ * @size:               the pointer to the current number of pooled contexts (optional).
+ * @hits:               the pointer to the number of reused contexts (optional).
+ * @misses:             the pointer to the number of created contexts (optional).
+ *
+ * Gets the parser contexts pool statistics.
+ */
+void
+xmlSecParserPoolGetStats(xmlSecSize* size, xmlSecSize* hits, xmlSecSize* misses) {
+    if(xmlSecParserPoolMutex != NULL) {
+        xmlMutexLock(xmlSecParserPoolMutex);
+    }
+    if(size != NULL) {
+        (*size) = xmlSecParserPoolSize;
+    }
+    if(hits != NULL) {
+        (*hits) = xmlSecParserPoolHits;
+    }
+    if(misses != NULL) {
+        (*misses) = xmlSecParserPoolMisses;
+    }
+    if(xmlSecParserPoolMutex != NULL) {
+        xmlMutexUnlock(xmlSecParserPoolMutex);
+    }
+}
+
+/* the (per thread) libxml2 globals used by xmlNewParserCtxt() */
+static int
+xmlSecParserPoolGetDefaults(void) {
+    return(((xmlKeepBlanksDefaultValue != 0) ? 0x01 : 0) |
+           ((xmlDoValidityCheckingDefaultValue != 0) ? 0x02 : 0) |
+           ((xmlPedanticParserDefaultValue != 0) ? 0x04 : 0) |
+           ((xmlLineNumbersDefaultValue != 0) ? 0x08 : 0) |
+           ((xmlGetWarningsDefaultValue != 0) ? 0x10 : 0) |
+           ((xmlSubstituteEntitiesDefaultValue != 0) ? 0x20 : 0) |
+           ((xmlLoadExtDtdDefaultValue & 0xFF) << 8));
+}
+
+/* must be called under the pool mutex */
+static void
+xmlSecParserPoolTrim(void) {
+    xmlSecParserPoolEntryPtr entry;
+    xmlSecParserPoolEntryPtr* prev;
+    xmlSecSize pos = 0;
+
+    /* keep the most recently released contexts */
+    for(prev = &xmlSecParserPoolHead; (*prev) != NULL; ) {
+        if(pos < xmlSecParserPoolMaxSize) {
+            prev = &((*prev)->next);
+            ++pos;
+            continue;
+        }
+        entry = (*prev);
+        (*prev) = entry->next;
+        xmlSecParserPoolEntryDestroy(entry);
+        --xmlSecParserPoolSize;
+    }
+}
+
+/* the documents own their dictionaries (see above) */
+static int
+xmlSecParserPoolNewDict(xmlSecParserPoolEntryPtr entry) {
+    xmlDictPtr dict;
+
+    xmlSecAssert2(entry != NULL, -1);
+    xmlSecAssert2(entry->ctxt != NULL, -1);
+    xmlSecAssert2(entry->dict != NULL, -1);
+
+    dict = xmlDictCreateSub(entry->dict);
+    if(dict == NULL) {
+        xmlSecXmlError("xmlDictCreateSub", NULL);
+        return(-1);
+    }
+    if(entry->ctxt->dict != NULL) {
+        xmlDictFree(entry->ctxt->dict);
+    }
+    entry->ctxt->dict = dict;
+    return(0);
+}
+
+/*
+ * Returns the parser context ready for the new input: either a pooled one
+ * created with the same defaults or a new one.
+ */
+static xmlSecParserPoolEntryPtr
+xmlSecParserPoolAcquire(void) {
+    xmlSecParserPoolEntryPtr entry = NULL;
+    xmlSecParserPoolEntryPtr* prev;
+    int defaults;
+
+    defaults = xmlSecParserPoolGetDefaults();
+
+    if((xmlSecParserPoolMutex != NULL) && (xmlSecParserPoolMaxSize > 0)) {
+        xmlMutexLock(xmlSecParserPoolMutex);
+        for(prev = &xmlSecParserPoolHead; (*prev) != NULL; prev = &((*prev)->next)) {
+            if((*prev)->defaults == defaults) {
+                entry = (*prev);
+                (*prev) = entry->next;
+                --xmlSecParserPoolSize;
+                break;
+            }
+        }
+        if(entry != NULL) {
+            ++xmlSecParserPoolHits;
+        } else {
+            ++xmlSecParserPoolMisses;
+        }
+        xmlMutexUnlock(xmlSecParserPoolMutex);
+    }
+
+    if(entry != NULL) {
+        /* restore the fields the previous user might have changed */
+        entry->ctxt->options            = entry->options;
+        entry->ctxt->loadsubset         = entry->loadsubset;
+        entry->ctxt->replaceEntities    = entry->replaceEntities;
+        entry->ctxt->keepBlanks         = entry->keepBlanks;
+        entry->ctxt->validate           = entry->validate;
+        entry->ctxt->pedantic           = entry->pedantic;
+        entry->ctxt->linenumbers        = entry->linenumbers;
+        entry->ctxt->dictNames          = 0;
+        entry->ctxt->recovery           = 0;
+
+        /* the document is the first input (see xmlSecNoXxeExternalEntityLoader) */
+        entry->ctxt->input_id           = 1;
+        entry->next = NULL;
+
+        if(xmlSecParserPoolNewDict(entry) < 0) {
+            xmlSecInternalError("xmlSecParserPoolNewDict", NULL);
+            xmlSecParserPoolEntryDestroy(entry);
+            return(NULL);
+        }
+        return(entry);
+    }
+
+    entry = (xmlSecParserPoolEntryPtr)xmlMalloc(sizeof(xmlSecParserPoolEntry));
+    if(entry == NULL) {
+        xmlSecMallocError(sizeof(xmlSecParserPoolEntry), NULL);
+        return(NULL);
+    }
+    memset(entry, 0, sizeof(xmlSecParserPoolEntry));
+
+    entry->ctxt = xmlNewParserCtxt();
+    if(entry->ctxt == NULL) {
+        xmlSecXmlError("xmlNewParserCtxt", NULL);
+        xmlFree(entry);
+        return(NULL);
+    }
+    entry->defaults         = defaults;
+    entry->options          = entry->ctxt->options;
+    entry->loadsubset       = entry->ctxt->loadsubset;
+    entry->replaceEntities  = entry->ctxt->replaceEntities;
+    entry->keepBlanks       = entry->ctxt->keepBlanks;
+    entry->validate         = entry->ctxt->validate;
+    entry->pedantic         = entry->ctxt->pedantic;
+    entry->linenumbers      = entry->ctxt->linenumbers;
+
+    /* the pooled context keeps the original dictionary */
+    if((xmlSecParserPoolMutex != NULL) && (xmlSecParserPoolMaxSize > 0) && (entry->ctxt->dict != NULL)) {
+        entry->dict = entry->ctxt->dict;
+        xmlDictReference(entry->dict);
+        if(xmlSecParserPoolNewDict(entry) < 0) {
+            xmlSecInternalError("xmlSecParserPoolNewDict", NULL);
+            xmlSecParserPoolEntryDestroy(entry);
+            return(NULL);
+        }
+    }
+    return(entry);
+}
+
+/*
+ * Returns the parser context to the pool if @reuse is set (i.e. the
+ * document was parsed successfully) or frees it.
+ */
+static void
+xmlSecParserPoolRelease(xmlSecParserPoolEntryPtr entry, int reuse) {
+    xmlSecAssert(entry != NULL);
+    xmlSecAssert(entry->ctxt != NULL);
+
+    if(entry->ctxt->myDoc != NULL) {
+        xmlFreeDoc(entry->ctxt->myDoc);
+        entry->ctxt->myDoc = NULL;
+    }
+    if((reuse == 0) || (xmlSecParserPoolMutex == NULL) || (entry->dict == NULL)) {
+        xmlSecParserPoolEntryDestroy(entry);
+        return;
+    }
+
+    /* drop the input */
+    xmlCtxtReset(entry->ctxt);
+
+    xmlMutexLock(xmlSecParserPoolMutex);
+    entry->next = xmlSecParserPoolHead;
+    xmlSecParserPoolHead = entry;
+    ++xmlSecParserPoolSize;
+    xmlSecParserPoolTrim();
+    xmlMutexUnlock(xmlSecParserPoolMutex);
+}
+
+static void
+xmlSecParserPoolEntryDestroy(xmlSecParserPoolEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+
+    if(entry->ctxt != NULL) {
+        if(entry->ctxt->myDoc != NULL) {
+            xmlFreeDoc(entry->ctxt->myDoc);
+            entry->ctxt->myDoc = NULL;
+        }
+        xmlFreeParserCtxt(entry->ctxt);
+    }
+    if(entry->dict != NULL) {
+        xmlDictFree(entry->dict);
+    }
+    memset(entry, 0, sizeof(xmlSecParserPoolEntry));
+    xmlFree(entry);
+}
+
 /**************************************************************************
  *
  * Internal parser
@@ -38,7 +381,7 @@
 typedef struct _xmlSecParserCtx                                 xmlSecParserCtx,
                                                                 *xmlSecParserCtxPtr;
 struct _xmlSecParserCtx {
-    xmlParserCtxtPtr    parserCtx;
+    xmlSecParserPoolEntryPtr    parserEntry;
 };
 
 /**************************************************************************
@@ -131,12 +474,8 @@ xmlSecParserFinalize(xmlSecTransformPtr transform) {
     ctx = xmlSecParserGetCtx(transform);
     xmlSecAssert(ctx != NULL);
 
-    if(ctx->parserCtx != NULL) {
-        if(ctx->parserCtx->myDoc != NULL) {
-            xmlFreeDoc(ctx->parserCtx->myDoc);
-	    ctx->parserCtx->myDoc = NULL;
-        }
-        xmlFreeParserCtxt(ctx->parserCtx);
+    if(ctx->parserEntry != NULL) {
+        xmlSecParserPoolRelease(ctx->parserEntry, 0);
     }
     memset(ctx, 0, sizeof(xmlSecParserCtx));
 }
@@ -145,6 +484,7 @@ static int
 xmlSecParserPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
                                 xmlSecSize dataSize, int final, xmlSecTransformCtxPtr transformCtx) {
     xmlSecParserCtxPtr ctx;
+    xmlParserCtxtPtr parserCtx;
     int ret;
 
     xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXmlParserId), -1);
@@ -155,18 +495,27 @@ xmlSecParserPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
 
     /* check/update current transform status */
     if(transform->status == xmlSecTransformStatusNone) {
-        xmlSecAssert2(ctx->parserCtx == NULL, -1);
+        xmlSecAssert2(ctx->parserEntry == NULL, -1);
 
-        ctx->parserCtx = xmlCreatePushParserCtxt(NULL, NULL, NULL, 0, NULL);
-        if(ctx->parserCtx == NULL) {
-            xmlSecXmlError("xmlCreatePushParserCtxt", xmlSecTransformGetName(transform));
+        ctx->parserEntry = xmlSecParserPoolAcquire();
+        if(ctx->parserEntry == NULL) {
+            xmlSecInternalError("xmlSecParserPoolAcquire", xmlSecTransformGetName(transform));
             return(-1);
         }
+        parserCtx = ctx->parserEntry->ctxt;
+
+        ret = xmlCtxtResetPush(parserCtx, NULL, 0, NULL, NULL);
+        if(ret != 0) {
+            xmlSecXmlParserError("xmlCtxtResetPush", parserCtx,
+                                 xmlSecTransformGetName(transform));
+            return(-1);
+        }
+        parserCtx->dictNames       = 1;
 
         /* required for c14n! */
-        ctx->parserCtx->loadsubset      = XML_DETECT_IDS | XML_COMPLETE_ATTRS;
-        ctx->parserCtx->replaceEntities = 1;
-        ctx->parserCtx->options         = XML_PARSE_NONET;
+        parserCtx->loadsubset      = XML_DETECT_IDS | XML_COMPLETE_ATTRS;
+        parserCtx->replaceEntities = 1;
+        parserCtx->options         = XML_PARSE_NONET;
 
         transform->status = xmlSecTransformStatusWorking;
     } else if(transform->status == xmlSecTransformStatusFinished) {
@@ -176,13 +525,15 @@ xmlSecParserPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
         return(-1);
     }
     xmlSecAssert2(transform->status == xmlSecTransformStatusWorking, -1);
-    xmlSecAssert2(ctx->parserCtx != NULL, -1);
+    xmlSecAssert2(ctx->parserEntry != NULL, -1);
+    parserCtx = ctx->parserEntry->ctxt;
+    xmlSecAssert2(parserCtx != NULL, -1);
 
     /* push data to the input buffer */
     if((data != NULL) && (dataSize > 0)) {
-        ret = xmlParseChunk(ctx->parserCtx, (const char*)data, dataSize, 0);
+        ret = xmlParseChunk(parserCtx, (const char*)data, dataSize, 0);
         if(ret != 0) {
-            xmlSecXmlParserError2("xmlParseChunk", ctx->parserCtx,
+            xmlSecXmlParserError2("xmlParseChunk", parserCtx,
                                   xmlSecTransformGetName(transform),
                                   "size=%lu", (unsigned long)dataSize);
             return(-1);
@@ -191,25 +542,29 @@ xmlSecParserPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
 
     /* finish parsing and push to next in the chain */
     if(final != 0) {
-        ret = xmlParseChunk(ctx->parserCtx, NULL, 0, 1);
-        if((ret != 0) || (ctx->parserCtx->myDoc == NULL)) {
-            xmlSecXmlParserError("xmlParseChunk", ctx->parserCtx,
+        ret = xmlParseChunk(parserCtx, NULL, 0, 1);
+        if((ret != 0) || (parserCtx->myDoc == NULL)) {
+            xmlSecXmlParserError("xmlParseChunk", parserCtx,
                                  xmlSecTransformGetName(transform));
             return(-1);
         }
 
         /* todo: check that document is well formed? */
-        transform->outNodes = xmlSecNodeSetCreate(ctx->parserCtx->myDoc,
+        transform->outNodes = xmlSecNodeSetCreate(parserCtx->myDoc,
                                                   NULL, xmlSecNodeSetTree);
         if(transform->outNodes == NULL) {
             xmlSecInternalError("xmlSecNodeSetCreate",
                                 xmlSecTransformGetName(transform));
-            xmlFreeDoc(ctx->parserCtx->myDoc);
-            ctx->parserCtx->myDoc = NULL;
+            xmlFreeDoc(parserCtx->myDoc);
+            parserCtx->myDoc = NULL;
             return(-1);
         }
         xmlSecNodeSetDocDestroy(transform->outNodes); /* this node set "owns" the doc pointer */
-        ctx->parserCtx->myDoc = NULL;
+        parserCtx->myDoc = NULL;
+
+        /* the parser is not needed anymore */
+        xmlSecParserPoolRelease(ctx->parserEntry, 1);
+        ctx->parserEntry = NULL;
 
         /* push result to the next transform (if exist) */
         if(transform->next != NULL) {
@@ -233,6 +588,7 @@ xmlSecParserPopXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr* nodes,
     xmlSecParserCtxPtr ctx;
     xmlParserInputBufferPtr buf;
     xmlParserInputPtr input;
+    xmlSecParserPoolEntryPtr entry;
     xmlParserCtxtPtr ctxt;
     xmlDocPtr doc;
     int ret;
@@ -276,19 +632,20 @@ xmlSecParserPopXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr* nodes,
         return(-1);
     }
 
-    ctxt = xmlNewParserCtxt();
-    if (ctxt == NULL) {
-        xmlSecXmlError("xmlNewParserCtxt",
-                       xmlSecTransformGetName(transform));
+    entry = xmlSecParserPoolAcquire();
+    if(entry == NULL) {
+        xmlSecInternalError("xmlSecParserPoolAcquire",
+                            xmlSecTransformGetName(transform));
         xmlFreeParserInputBuffer(buf);
         return(-1);
     }
+    ctxt = entry->ctxt;
 
     input = xmlNewIOInputStream(ctxt, buf, XML_CHAR_ENCODING_NONE);
     if(input == NULL) {
-        xmlSecXmlParserError("xmlNewParserCtxt", ctxt,
+        xmlSecXmlParserError("xmlNewIOInputStream", ctxt,
                              xmlSecTransformGetName(transform));
-        xmlFreeParserCtxt(ctxt);
+        xmlSecParserPoolRelease(entry, 0);
         xmlFreeParserInputBuffer(buf);
         return(-1);
     }
@@ -298,11 +655,7 @@ xmlSecParserPopXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr* nodes,
         xmlSecXmlParserError("inputPush", ctxt,
                              xmlSecTransformGetName(transform));
         xmlFreeInputStream(input);
-        if(ctxt->myDoc != NULL) {
-            xmlFreeDoc(ctxt->myDoc);
-            ctxt->myDoc = NULL;
-        }
-        xmlFreeParserCtxt(ctxt);
+        xmlSecParserPoolRelease(entry, 0);
         return(-1);
     }
 
@@ -315,18 +668,14 @@ xmlSecParserPopXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr* nodes,
     if(ret < 0) {
         xmlSecXmlParserError("xmlParseDocument", ctxt,
                              xmlSecTransformGetName(transform));
-        if(ctxt->myDoc != NULL) {
-            xmlFreeDoc(ctxt->myDoc);
-            ctxt->myDoc = NULL;
-        }
-        xmlFreeParserCtxt(ctxt);
+        xmlSecParserPoolRelease(entry, 0);
         return(-1);
     }
 
     /* remember the result and free parsing context */
     doc = ctxt->myDoc;
     ctxt->myDoc = NULL;
-    xmlFreeParserCtxt(ctxt);
+    xmlSecParserPoolRelease(entry, 1);
 
     /* return result to the caller */
     (*nodes) = xmlSecNodeSetCreate(doc, NULL, xmlSecNodeSetTree);
@@ -366,7 +715,9 @@ typedef struct _xmlSecExtMemoryParserCtx {
  */
 xmlDocPtr
 xmlSecParseFile(const char *filename) {
+    xmlSecParserPoolEntryPtr entry;
     xmlParserCtxtPtr ctxt;
+    xmlParserInputPtr input;
     xmlDocPtr res = NULL;
     char *directory = NULL;
     int ret;
@@ -374,10 +725,29 @@ xmlSecParseFile(const char *filename) {
     xmlSecAssert2(filename != NULL, NULL);
 
     xmlInitParser();
-    ctxt = xmlCreateFileParserCtxt(filename);
-    if (ctxt == NULL) {
-        xmlSecXmlError2("xmlCreateFileParserCtxt", NULL,
+    entry = xmlSecParserPoolAcquire();
+    if(entry == NULL) {
+        xmlSecInternalError2("xmlSecParserPoolAcquire", NULL,
+                             "filename=%s", xmlSecErrorsSafeString(filename));
+        return(NULL);
+    }
+    ctxt = entry->ctxt;
+    ctxt->linenumbers = 1;
+
+    input = xmlLoadExternalEntity(filename, NULL, ctxt);
+    if(input == NULL) {
+        xmlSecXmlError2("xmlLoadExternalEntity", NULL,
                         "filename=%s", xmlSecErrorsSafeString(filename));
+        xmlSecParserPoolRelease(entry, 0);
+        return(NULL);
+    }
+
+    ret = inputPush(ctxt, input);
+    if(ret < 0) {
+        xmlSecXmlParserError2("inputPush", ctxt, NULL,
+                              "filename=%s", xmlSecErrorsSafeString(filename));
+        xmlFreeInputStream(input);
+        xmlSecParserPoolRelease(entry, 0);
         return(NULL);
     }
 
@@ -390,17 +760,12 @@ xmlSecParseFile(const char *filename) {
         if(directory == NULL) {
             xmlSecXmlError2("xmlParserGetDirectory", NULL,
                             "filename=%s", xmlSecErrorsSafeString(filename));
-            xmlFreeParserCtxt(ctxt);
+            xmlSecParserPoolRelease(entry, 0);
             return(NULL);
         }
     }
     if ((ctxt->directory == NULL) && (directory != NULL)) {
-        ctxt->directory = (char *) xmlStrdup(BAD_CAST directory);
-        if(ctxt->directory == NULL) {
-            xmlSecStrdupError(BAD_CAST directory, NULL);
-            xmlFreeParserCtxt(ctxt);
-            return(NULL);
-        }
+        ctxt->directory = directory;
     }
 
     /* required for c14n! */
@@ -412,28 +777,20 @@ xmlSecParseFile(const char *filename) {
         xmlSecXmlParserError2("xmlParseDocument", ctxt, NULL,
                               "filename=%s",
                               xmlSecErrorsSafeString(filename));
-        if(ctxt->myDoc != NULL) {
-            xmlFreeDoc(ctxt->myDoc);
-            ctxt->myDoc = NULL;
-        }
-        xmlFreeParserCtxt(ctxt);
+        xmlSecParserPoolRelease(entry, 0);
         return(NULL);
     }
 
     if(!ctxt->wellFormed) {
        xmlSecInternalError("document is not well formed", NULL);
-       if(ctxt->myDoc != NULL) {
-           xmlFreeDoc(ctxt->myDoc);
-           ctxt->myDoc = NULL;
-       }
-       xmlFreeParserCtxt(ctxt);
+       xmlSecParserPoolRelease(entry, 0);
        return(NULL);
     }
 
     /* done */
     res = ctxt->myDoc;
     ctxt->myDoc = NULL;
-    xmlFreeParserCtxt(ctxt);
+    xmlSecParserPoolRelease(entry, 1);
     return(res);
 
 }
@@ -455,16 +812,25 @@ xmlDocPtr
 xmlSecParseMemoryExt(const xmlSecByte *prefix, xmlSecSize prefixSize,
                      const xmlSecByte *buffer, xmlSecSize bufferSize,
                      const xmlSecByte *postfix, xmlSecSize postfixSize) {
-    xmlParserCtxtPtr ctxt = NULL;
+    xmlSecParserPoolEntryPtr entry;
+    xmlParserCtxtPtr ctxt;
     xmlDocPtr doc = NULL;
     int ret;
 
     /* create context */
-    ctxt = xmlCreatePushParserCtxt(NULL, NULL, NULL, 0, NULL);
-    if(ctxt == NULL) {
-        xmlSecXmlError("xmlCreatePushParserCtxt", NULL);
+    entry = xmlSecParserPoolAcquire();
+    if(entry == NULL) {
+        xmlSecInternalError("xmlSecParserPoolAcquire", NULL);
+        return(NULL);
+    }
+    ctxt = entry->ctxt;
+
+    ret = xmlCtxtResetPush(ctxt, NULL, 0, NULL, NULL);
+    if(ret != 0) {
+        xmlSecXmlParserError("xmlCtxtResetPush", ctxt, NULL);
         goto done;
     }
+    ctxt->dictNames = 1;
 
     /* required for c14n! */
     ctxt->loadsubset = XML_DETECT_IDS | XML_COMPLETE_ATTRS;
@@ -513,13 +879,7 @@ xmlSecParseMemoryExt(const xmlSecByte *prefix, xmlSecSize prefixSize,
     ctxt->myDoc = NULL;
 
 done:
-    if(ctxt != NULL) {
-        if(ctxt->myDoc != NULL) {
-            xmlFreeDoc(ctxt->myDoc);
-            ctxt->myDoc = NULL;
-        }
-        xmlFreeParserCtxt(ctxt);
-    }
+    xmlSecParserPoolRelease(entry, (doc != NULL) ? 1 : 0);
     return(doc);
 }
 
@@ -537,15 +897,42 @@ done:
  */
 xmlDocPtr
 xmlSecParseMemory(const xmlSecByte *buffer, xmlSecSize size, int recovery) {
+    xmlSecParserPoolEntryPtr entry;
     xmlParserCtxtPtr ctxt;
+    xmlParserInputBufferPtr buf;
+    xmlParserInputPtr input;
     xmlDocPtr res = NULL;
     int ret;
 
     xmlSecAssert2(buffer != NULL, NULL);
 
-    ctxt = xmlCreateMemoryParserCtxt((char*)buffer, size);
-    if (ctxt == NULL) {
-        xmlSecXmlError("xmlCreateMemoryParserCtxt", NULL);
+    entry = xmlSecParserPoolAcquire();
+    if(entry == NULL) {
+        xmlSecInternalError("xmlSecParserPoolAcquire", NULL);
+        return(NULL);
+    }
+    ctxt = entry->ctxt;
+
+    buf = xmlParserInputBufferCreateMem((const char*)buffer, size, XML_CHAR_ENCODING_NONE);
+    if(buf == NULL) {
+        xmlSecXmlError("xmlParserInputBufferCreateMem", NULL);
+        xmlSecParserPoolRelease(entry, 0);
+        return(NULL);
+    }
+
+    input = xmlNewIOInputStream(ctxt, buf, XML_CHAR_ENCODING_NONE);
+    if(input == NULL) {
+        xmlSecXmlParserError("xmlNewIOInputStream", ctxt, NULL);
+        xmlFreeParserInputBuffer(buf);
+        xmlSecParserPoolRelease(entry, 0);
+        return(NULL);
+    }
+
+    ret = inputPush(ctxt, input);
+    if(ret < 0) {
+        xmlSecXmlParserError("inputPush", ctxt, NULL);
+        xmlFreeInputStream(input);
+        xmlSecParserPoolRelease(entry, 0);
         return(NULL);
     }
 
@@ -556,28 +943,20 @@ xmlSecParseMemory(const xmlSecByte *buffer, xmlSecSize size, int recovery) {
     ret = xmlParseDocument(ctxt);
     if(ret < 0) {
         xmlSecXmlParserError("xmlParseDocument", ctxt, NULL);
-        if(ctxt->myDoc != NULL) {
-            xmlFreeDoc(ctxt->myDoc);
-            ctxt->myDoc = NULL;
-        }	
-        xmlFreeParserCtxt(ctxt);
+        xmlSecParserPoolRelease(entry, 0);
         return(NULL);
     }
 
     if(!(ctxt->wellFormed) && !recovery) {
         xmlSecInternalError("document is not well formed", NULL);
-        if(ctxt->myDoc != NULL) {
-            xmlFreeDoc(ctxt->myDoc);
-            ctxt->myDoc = NULL;
-        }
-        xmlFreeParserCtxt(ctxt);
+        xmlSecParserPoolRelease(entry, 0);
         return(NULL);
     }
 
     /* done */
     res = ctxt->myDoc;
     ctxt->myDoc = NULL;
-    xmlFreeParserCtxt(ctxt);
+    xmlSecParserPoolRelease(entry, ctxt->wellFormed);
     return(res);
 }
 
@@ -678,9 +678,6 @@ xmlSecTransformRelationshipPopBin(xmlSecTransformPtr transform, xmlSecByte* data
        if(outSize > maxDataSize) {
            outSize = maxDataSize;
        }
-       if(outSize > XMLSEC_TRANSFORM_BINARY_CHUNK) {
-           outSize = XMLSEC_TRANSFORM_BINARY_CHUNK;
-       }
        if(outSize > 0) {
            xmlSecAssert2(xmlSecBufferGetData(out), -1);
 
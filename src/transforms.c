@@ -69,6 +69,7 @@
 #include <xmlsec/parser.h>
 #include <xmlsec/errors.h>
 
+#include <xmlsec/private/list.h>
 #include <xmlsec/private/xslt.h>
 
 /**************************************************************************
@@ -78,6 +79,13 @@
  *************************************************************************/
 static xmlSecPtrList xmlSecAllTransformIds;
 
+/* href -> positions in xmlSecAllTransformIds, updated on registration */
+static xmlHashTablePtr xmlSecAllTransformIdsHrefIndex = NULL;
+static xmlSecSize xmlSecAllTransformIdsIndexedSize = 0;
+static xmlSecSize xmlSecAllTransformIdsIndexedChanges = 0;
+
+static int              xmlSecTransformIdsIndexUpdate           (void);
+static void             xmlSecTransformIdsIndexReset            (void);
 
 /**
  * xmlSecTransformIdsGet:
@@ -109,6 +117,12 @@ xmlSecTransformIdsInit(void) {
         return(-1);
     }
 
+    ret = xmlSecPtrListTrackChanges(xmlSecTransformIdsGet());
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecPtrListTrackChanges", NULL);
+        return(-1);
+    }
+
     ret = xmlSecTransformIdsRegisterDefault();
     if(ret < 0) {
         xmlSecInternalError("xmlSecTransformIdsRegisterDefault", NULL);
@@ -134,6 +148,8 @@ xmlSecTransformIdsShutdown(void) {
     xmlSecTransformXsltShutdown();
 #endif /* XMLSEC_NO_XSLT */
 
+    xmlSecTransformIdsIndexReset();
+    xmlSecPtrListUntrackChanges(xmlSecTransformIdsGet());
     xmlSecPtrListFinalize(xmlSecTransformIdsGet());
 }
 
@@ -158,9 +174,55 @@ xmlSecTransformIdsRegister(xmlSecTransformId id) {
         return(-1);
     }
 
+    ret = xmlSecTransformIdsIndexUpdate();
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformIdsIndexUpdate",
+                            xmlSecTransformKlassGetName(id));
+        return(-1);
+    }
+
     return(0);
 }
 
+static int
+xmlSecTransformIdsIndexUpdate(void) {
+    xmlSecTransformId id;
+    xmlSecSize pos, size, changes;
+    int ret;
+
+    /* rebuild the index unless the items were only appended since the last update */
+    size = xmlSecPtrListGetSize(xmlSecTransformIdsGet());
+    changes = xmlSecPtrListGetChanges(xmlSecTransformIdsGet());
+    if((xmlSecAllTransformIdsIndexedSize > size) ||
+       ((changes - xmlSecAllTransformIdsIndexedChanges) != (size - xmlSecAllTransformIdsIndexedSize))) {
+        xmlSecTransformIdsIndexReset();
+    }
+
+    for(pos = xmlSecAllTransformIdsIndexedSize; pos < size; ++pos) {
+        id = (xmlSecTransformId)xmlSecPtrListGetItem(xmlSecTransformIdsGet(), pos);
+        if((id != xmlSecTransformIdUnknown) && (id->href != NULL)) {
+            ret = xmlSecPtrListIndexAdd(&xmlSecAllTransformIdsHrefIndex, id->href, NULL, pos);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecPtrListIndexAdd",
+                                    xmlSecTransformKlassGetName(id));
+                xmlSecTransformIdsIndexReset();
+                return(-1);
+            }
+        }
+    }
+    xmlSecAllTransformIdsIndexedSize = size;
+    xmlSecAllTransformIdsIndexedChanges = changes;
+    return(0);
+}
+
+static void
+xmlSecTransformIdsIndexReset(void) {
+    xmlSecPtrListIndexDestroy(xmlSecAllTransformIdsHrefIndex);
+    xmlSecAllTransformIdsHrefIndex = NULL;
+    xmlSecAllTransformIdsIndexedSize = 0;
+    xmlSecAllTransformIdsIndexedChanges = 0;
+}
+
 /**
  * xmlSecTransformIdsRegisterDefault:
  *
@@ -1890,7 +1952,9 @@ xmlSecTransformDefaultPushBin(xmlSecTransformPtr transform, const xmlSecByte* da
                         xmlSecSize dataSize, int final, xmlSecTransformCtxPtr transformCtx) {
     xmlSecSize inSize = 0;
     xmlSecSize outSize = 0;
+    xmlSecSize chunkSize, pos;
     int finalData = 0;
+    int chunkFinal;
     int ret;
 
     xmlSecAssert2(xmlSecTransformIsValid(transform), -1);
@@ -1899,8 +1963,6 @@ xmlSecTransformDefaultPushBin(xmlSecTransformPtr transform, const xmlSecByte* da
     do {
         /* append data to input buffer */
         if(dataSize > 0) {
-            xmlSecSize chunkSize;
-
             xmlSecAssert2(data != NULL, -1);
 
             chunkSize = dataSize;
@@ -1937,24 +1999,32 @@ xmlSecTransformDefaultPushBin(xmlSecTransformPtr transform, const xmlSecByte* da
             finalData = 0;
         }
 
-        /* we don't want to push too much */
-        if(outSize > XMLSEC_TRANSFORM_BINARY_CHUNK) {
-            outSize = XMLSEC_TRANSFORM_BINARY_CHUNK;
-            finalData = 0;
-        }
-        if((transform->next != NULL) && ((outSize > 0) || (finalData != 0))) {
-            ret = xmlSecTransformPushBin(transform->next,
-                            xmlSecBufferGetData(&(transform->outBuf)),
-                            outSize,
-                            finalData,
-                            transformCtx);
-            if(ret < 0) {
-                xmlSecInternalError3("xmlSecTransformPushBin",
-                                     xmlSecTransformGetName(transform->next),
-                                     "final=%d;outSize=%d", final, outSize);
-                return(-1);
+        /* we don't want to push too much at once but the pushed data
+         * is removed from the output buffer only once (moving the rest
+         * of a large buffer after each chunk is quadratic) */
+        pos = 0;
+        do {
+            chunkSize = outSize - pos;
+            chunkFinal = finalData;
+            if(chunkSize > XMLSEC_TRANSFORM_BINARY_CHUNK) {
+                chunkSize = XMLSEC_TRANSFORM_BINARY_CHUNK;
+                chunkFinal = 0;
             }
-        }
+            if((transform->next != NULL) && ((chunkSize > 0) || (chunkFinal != 0))) {
+                ret = xmlSecTransformPushBin(transform->next,
+                                xmlSecBufferGetData(&(transform->outBuf)) + pos,
+                                chunkSize,
+                                chunkFinal,
+                                transformCtx);
+                if(ret < 0) {
+                    xmlSecInternalError3("xmlSecTransformPushBin",
+                                         xmlSecTransformGetName(transform->next),
+                                         "final=%d;outSize=%d", final, chunkSize);
+                    return(-1);
+                }
+            }
+            pos += chunkSize;
+        } while(pos < outSize);
 
         /* remove data anyway */
         if(outSize > 0) {
@@ -2004,7 +2074,13 @@ xmlSecTransformDefaultPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
             xmlSecSize inSize, chunkSize;
 
             inSize = xmlSecBufferGetSize(&(transform->inBuf));
-            chunkSize = XMLSEC_TRANSFORM_BINARY_CHUNK;
+
+            /* take all the data the previous transform has ready: it is removed
+             * from its output buffer at once instead of chunk by chunk */
+            chunkSize = xmlSecBufferGetSize(&(transform->prev->outBuf));
+            if(chunkSize < XMLSEC_TRANSFORM_BINARY_CHUNK) {
+                chunkSize = XMLSEC_TRANSFORM_BINARY_CHUNK;
+            }
 
             /* ensure that we have space for at least one data chunk */
             ret = xmlSecBufferSetMaxSize(&(transform->inBuf), inSize + chunkSize);
@@ -2056,11 +2132,6 @@ xmlSecTransformDefaultPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
     if(outSize > maxDataSize) {
         outSize = maxDataSize;
     }
-
-    /* we don't want to put too much */
-    if(outSize > XMLSEC_TRANSFORM_BINARY_CHUNK) {
-        outSize = XMLSEC_TRANSFORM_BINARY_CHUNK;
-    }
     if(outSize > 0) {
         xmlSecAssert2(xmlSecBufferGetData(&(transform->outBuf)), -1);
 
@@ -2234,12 +2305,27 @@ xmlSecTransformId
 xmlSecTransformIdListFindByHref(xmlSecPtrListPtr list, const xmlChar* href,
                             xmlSecTransformUsage usage) {
     xmlSecTransformId transformId;
+    const xmlSecSize* pos;
     xmlSecSize i, size;
 
     xmlSecAssert2(xmlSecPtrListCheckId(list, xmlSecTransformIdListId), xmlSecTransformIdUnknown);
     xmlSecAssert2(href != NULL, xmlSecTransformIdUnknown);
 
     size = xmlSecPtrListGetSize(list);
+
+    /* the global list is indexed by href, check only the candidates */
+    if((list == xmlSecTransformIdsGet()) && (xmlSecAllTransformIdsIndexedSize == size) &&
+       (xmlSecAllTransformIdsIndexedChanges == xmlSecPtrListGetChanges(list))) {
+        pos = xmlSecPtrListIndexLookup(xmlSecAllTransformIdsHrefIndex, href, NULL, &size);
+        for(i = 0; i < size; ++i) {
+            transformId = (xmlSecTransformId)xmlSecPtrListGetItem(list, pos[i]);
+            if((transformId != xmlSecTransformIdUnknown) && ((usage & transformId->usage) != 0)) {
+                return(transformId);
+            }
+        }
+        return(xmlSecTransformIdUnknown);
+    }
+
     for(i = 0; i < size; ++i) {
         transformId = (xmlSecTransformId)xmlSecPtrListGetItem(list, i);
         xmlSecAssert2(transformId != xmlSecTransformIdUnknown, xmlSecTransformIdUnknown);
@@ -55,6 +55,18 @@ static int      xmlSecDSigCtxProcessManifestNode        (xmlSecDSigCtxPtr dsigCt
 
 static int      xmlSecDSigCtxProcessReferences          (xmlSecDSigCtxPtr dsigCtx,
                                                          xmlNodePtr firstReferenceNode);
+static int      xmlSecDSigCtxCalculateSignature         (xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlNodePtr signedInfoNode);
+static int      xmlSecDSigCtxProcessReferencesBatch     (xmlSecDSigCtxPtr dsigCtx,
+                                                         xmlNodePtr firstReferenceNode);
+
+static int      xmlSecDSigReferenceCtxPrepare           (xmlSecDSigReferenceCtxPtr dsigRefCtx,
+                                                         xmlNodePtr node,
+                                                         xmlNodePtr* digestValueNode);
+static int      xmlSecDSigReferenceCtxExecute           (xmlSecDSigReferenceCtxPtr dsigRefCtx,
+                                                         xmlDocPtr doc);
+static int      xmlSecDSigReferenceCtxComplete          (xmlSecDSigReferenceCtxPtr dsigRefCtx,
+                                                         xmlNodePtr digestValueNode);
 
 /* The ID attribute in XMLDSig is 'Id' */
 static const xmlChar*           xmlSecDSigIds[] = { xmlSecAttrId, NULL };
@@ -354,12 +366,14 @@ xmlSecDSigCtxVerify(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
         return(0);
     }
 
-    /* verify SignatureValue node content */
-    ret = xmlSecTransformVerifyNodeContent(dsigCtx->signMethod, dsigCtx->signValueNode,
-                                           &(dsigCtx->transformCtx));
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecTransformVerifyNodeContent", NULL);
-        return(-1);
+    /* verify SignatureValue node content (unless it was verified before references) */
+    if((dsigCtx->flags & XMLSEC_DSIG_FLAGS_VERIFY_SIGNATURE_FIRST) == 0) {
+        ret = xmlSecTransformVerifyNodeContent(dsigCtx->signMethod, dsigCtx->signValueNode,
+                                               &(dsigCtx->transformCtx));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformVerifyNodeContent", NULL);
+            return(-1);
+        }
     }
 
     /* set status and we are done */
@@ -423,7 +437,6 @@ xmlSecDSigCtxVerify(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
  */
 static int
 xmlSecDSigCtxProcessSignatureNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
-    xmlSecTransformDataType firstType;
     xmlNodePtr signedInfoNode = NULL;
     xmlNodePtr keyInfoNode = NULL;
     xmlNodePtr firstReferenceNode = NULL;
@@ -511,6 +524,28 @@ xmlSecDSigCtxProcessSignatureNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
     /* as the result, we should have a key */
     xmlSecAssert2(dsigCtx->signKey != NULL, -1);
 
+    /* reject bad signatures before digesting (potentially large) references */
+    if((dsigCtx->operation == xmlSecTransformOperationVerify) &&
+       ((dsigCtx->flags & XMLSEC_DSIG_FLAGS_VERIFY_SIGNATURE_FIRST) != 0)) {
+
+        ret = xmlSecDSigCtxCalculateSignature(dsigCtx, signedInfoNode);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecDSigCtxCalculateSignature", NULL);
+            return(-1);
+        }
+
+        ret = xmlSecTransformVerifyNodeContent(dsigCtx->signMethod, dsigCtx->signValueNode,
+                                               &(dsigCtx->transformCtx));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformVerifyNodeContent", NULL);
+            return(-1);
+        }
+        if(dsigCtx->signMethod->status != xmlSecTransformStatusOk) {
+            dsigCtx->status = xmlSecDSigStatusInvalid;
+            return(0);
+        }
+    }
+
     /* now actually process references and calculate digests */
     ret = xmlSecDSigCtxProcessReferences(dsigCtx, firstReferenceNode);
     if(ret < 0) {
@@ -534,15 +569,34 @@ xmlSecDSigCtxProcessSignatureNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
             return(-1);
         }
         base64Encode->operation = xmlSecTransformOperationEncode;
+    } else if((dsigCtx->flags & XMLSEC_DSIG_FLAGS_VERIFY_SIGNATURE_FIRST) != 0) {
+        /* the signature was already verified */
+        return(0);
     }
 
+    ret = xmlSecDSigCtxCalculateSignature(dsigCtx, signedInfoNode);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigCtxCalculateSignature", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/* runs <dsig:SignedInfo/> element through c14n and signature transforms */
+static int
+xmlSecDSigCtxCalculateSignature(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr signedInfoNode) {
+    xmlSecTransformDataType firstType;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(signedInfoNode != NULL, -1);
+
     firstType = xmlSecTransformGetDataType(dsigCtx->transformCtx.first,
                                            xmlSecTransformModePush,
                                            &(dsigCtx->transformCtx));
     if((firstType & xmlSecTransformDataTypeXml) != 0) {
         xmlSecNodeSetPtr nodeset = NULL;
 
-        xmlSecAssert2(signedInfoNode != NULL, -1);
         nodeset = xmlSecNodeSetGetChildren(signedInfoNode->doc, signedInfoNode, 1, 0);
         if(nodeset == NULL) {
             xmlSecInternalError("xmlSecNodeSetGetChildren(signedInfoNode)", NULL);
@@ -723,6 +777,11 @@ xmlSecDSigCtxProcessReferences(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr firstReferen
     xmlSecAssert2(xmlSecPtrListGetSize(&(dsigCtx->signedInfoReferences)) == 0, -1);
     xmlSecAssert2(firstReferenceNode != NULL, -1);
 
+    if(((dsigCtx->flags & XMLSEC_DSIG_FLAGS_PARALLEL_REFERENCES) != 0) &&
+       (dsigCtx->operation == xmlSecTransformOperationVerify)) {
+        return(xmlSecDSigCtxProcessReferencesBatch(dsigCtx, firstReferenceNode));
+    }
+
     /* process references */
     for(cur = firstReferenceNode; (cur != NULL); cur = xmlSecGetNextElementNode(cur->next)) {
         /* already checked but we trust none */
@@ -766,6 +825,167 @@ xmlSecDSigCtxProcessReferences(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr firstReferen
 }
 
 
+/* one <dsig:Reference/> from the batch, see xmlSecDSigCtxProcessReferencesBatch() */
+typedef struct _xmlSecDSigReferenceTask {
+    xmlSecDSigReferenceCtxPtr   dsigRefCtx;
+    xmlNodePtr                  digestValueNode;
+    xmlDocPtr                   doc;
+    int                         ret;
+} xmlSecDSigReferenceTask, *xmlSecDSigReferenceTaskPtr;
+
+static void
+xmlSecDSigReferenceTaskExecute(void* task) {
+    xmlSecDSigReferenceTaskPtr refTask = (xmlSecDSigReferenceTaskPtr)task;
+
+    xmlSecAssert(refTask != NULL);
+    xmlSecAssert(refTask->dsigRefCtx != NULL);
+
+    refTask->ret = xmlSecDSigReferenceCtxExecute(refTask->dsigRefCtx, refTask->doc);
+}
+
+/*
+ * Verifies references in three steps: all the <dsig:Reference/> nodes are
+ * read first, then the transforms are executed by the user supplied
+ * executor (possibly concurrently) and at last the digests are checked
+ * in document order. The references that are not reached
+ * by the sequential processing (after an invalid or broken one) are
+ * dropped so the dsigCtx->signedInfoReferences list and the status are
+ * exactly the same as in xmlSecDSigCtxProcessReferences().
+ */
+static int
+xmlSecDSigCtxProcessReferencesBatch(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr firstReferenceNode) {
+    xmlSecDSigReferenceTaskPtr tasks = NULL;
+    void** taskPtrs = NULL;
+    xmlSecSize tasksSize = 0;
+    xmlSecSize prepared = 0;
+    xmlSecSize total = 0;
+    xmlSecSize pos;
+    int prepareFailed = 0;
+    xmlNodePtr cur;
+    int res = -1;
+    int ret;
+
+    xmlSecAssert2(dsigCtx != NULL, -1);
+    xmlSecAssert2(firstReferenceNode != NULL, -1);
+    xmlSecAssert2(firstReferenceNode->doc != NULL, -1);
+
+    for(cur = firstReferenceNode; (cur != NULL); cur = xmlSecGetNextElementNode(cur->next)) {
+        ++tasksSize;
+    }
+    xmlSecAssert2(tasksSize > 0, -1);
+
+    tasks = (xmlSecDSigReferenceTaskPtr)xmlMalloc(sizeof(xmlSecDSigReferenceTask) * tasksSize);
+    if(tasks == NULL) {
+        xmlSecMallocError(sizeof(xmlSecDSigReferenceTask) * tasksSize, NULL);
+        goto done;
+    }
+    memset(tasks, 0, sizeof(xmlSecDSigReferenceTask) * tasksSize);
+
+    taskPtrs = (void**)xmlMalloc(sizeof(void*) * tasksSize);
+    if(taskPtrs == NULL) {
+        xmlSecMallocError(sizeof(void*) * tasksSize, NULL);
+        goto done;
+    }
+
+    /* read all the references, the DOM stays unchanged */
+    for(cur = firstReferenceNode; (cur != NULL); cur = xmlSecGetNextElementNode(cur->next)) {
+        /* already checked but we trust none */
+        if(!xmlSecCheckNodeName(cur, xmlSecNodeReference, xmlSecDSigNs)) {
+            xmlSecInvalidNodeError(cur, xmlSecNodeReference, NULL);
+            prepareFailed = 1;
+            break;
+        }
+
+        tasks[total].dsigRefCtx = xmlSecDSigReferenceCtxCreate(dsigCtx, xmlSecDSigReferenceOriginSignedInfo);
+        if(tasks[total].dsigRefCtx == NULL) {
+            xmlSecInternalError("xmlSecDSigReferenceCtxCreate", NULL);
+            prepareFailed = 1;
+            break;
+        }
+        tasks[total].doc = cur->doc;
+        taskPtrs[total] = &(tasks[total]);
+        ++total;
+
+        ret = xmlSecDSigReferenceCtxPrepare(tasks[total - 1].dsigRefCtx, cur,
+                                            &(tasks[total - 1].digestValueNode));
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecDSigReferenceCtxPrepare",
+                                xmlSecNodeGetName(cur));
+            tasks[total - 1].ret = -1;
+            prepareFailed = 1;
+            break;
+        }
+        ++prepared;
+    }
+
+    /* execute transforms */
+    if(prepared > 0) {
+        if(dsigCtx->referencesExecutor != NULL) {
+            ret = (dsigCtx->referencesExecutor)(dsigCtx, xmlSecDSigReferenceTaskExecute,
+                                                taskPtrs, prepared);
+            if(ret < 0) {
+                xmlSecInternalError("referencesExecutor", NULL);
+                goto done;
+            }
+        } else {
+            for(pos = 0; pos < prepared; ++pos) {
+                xmlSecDSigReferenceTaskExecute(taskPtrs[pos]);
+            }
+        }
+    }
+
+    /* merge results in document order */
+    for(pos = 0; pos < total; ++pos) {
+        xmlSecDSigReferenceCtxPtr dsigRefCtx = tasks[pos].dsigRefCtx;
+
+        /* the list owns the reference from now on */
+        ret = xmlSecPtrListAdd(&(dsigCtx->signedInfoReferences), dsigRefCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecPtrListAdd", NULL);
+            goto done;
+        }
+        tasks[pos].dsigRefCtx = NULL;
+
+        if(tasks[pos].ret < 0) {
+            xmlSecInternalError("xmlSecDSigReferenceCtxExecute", NULL);
+            goto done;
+        }
+
+        ret = xmlSecDSigReferenceCtxComplete(dsigRefCtx, tasks[pos].digestValueNode);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecDSigReferenceCtxComplete", NULL);
+            goto done;
+        }
+
+        /* bail out if next Reference processing failed */
+        if(dsigRefCtx->status != xmlSecDSigStatusSucceeded) {
+            dsigCtx->status = xmlSecDSigStatusInvalid;
+            res = 0;
+            goto done;
+        }
+    }
+
+    /* done */
+    if(prepareFailed == 0) {
+        res = 0;
+    }
+
+done:
+    if(tasks != NULL) {
+        for(pos = 0; pos < total; ++pos) {
+            if(tasks[pos].dsigRefCtx != NULL) {
+                xmlSecDSigReferenceCtxDestroy(tasks[pos].dsigRefCtx);
+            }
+        }
+        xmlFree(tasks);
+    }
+    if(taskPtrs != NULL) {
+        xmlFree(taskPtrs);
+    }
+    return(res);
+}
+
+
 static int
 xmlSecDSigCtxProcessKeyInfoNode(xmlSecDSigCtxPtr dsigCtx, xmlNodePtr node) {
     int ret;
@@ -1286,8 +1506,37 @@ xmlSecDSigReferenceCtxGetPreDigestBuffer(xmlSecDSigReferenceCtxPtr dsigRefCtx) {
  */
 int
 xmlSecDSigReferenceCtxProcessNode(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodePtr node) {
+    xmlNodePtr digestValueNode = NULL;
+    int ret;
+
+    xmlSecAssert2(dsigRefCtx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(node->doc != NULL, -1);
+
+    ret = xmlSecDSigReferenceCtxPrepare(dsigRefCtx, node, &digestValueNode);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigReferenceCtxPrepare", NULL);
+        return(-1);
+    }
+
+    ret = xmlSecDSigReferenceCtxExecute(dsigRefCtx, node->doc);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigReferenceCtxExecute", NULL);
+        return(-1);
+    }
+
+    ret = xmlSecDSigReferenceCtxComplete(dsigRefCtx, digestValueNode);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecDSigReferenceCtxComplete", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/* reads <dsig:Reference/> node and builds the transforms chain, the DOM is not modified */
+static int
+xmlSecDSigReferenceCtxPrepare(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodePtr node, xmlNodePtr* digestValueNode) {
     xmlSecTransformCtxPtr transformCtx;
-    xmlNodePtr digestValueNode;
     xmlNodePtr cur;
     int ret;
 
@@ -1298,6 +1547,7 @@ xmlSecDSigReferenceCtxProcessNode(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodeP
     xmlSecAssert2(dsigRefCtx->preDigestMemBufMethod == NULL, -1);
     xmlSecAssert2(node != NULL, -1);
     xmlSecAssert2(node->doc != NULL, -1);
+    xmlSecAssert2(digestValueNode != NULL, -1);
 
     transformCtx = &(dsigRefCtx->transformCtx);
 
@@ -1376,7 +1626,7 @@ xmlSecDSigReferenceCtxProcessNode(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodeP
 
     /* last node is required DigestValue */
     if((cur != NULL) && (xmlSecCheckNodeName(cur, xmlSecNodeDigestValue, xmlSecDSigNs))) {
-        digestValueNode = cur;
+        (*digestValueNode) = cur;
         cur = xmlSecGetNextElementNode(cur->next);
     } else {
         xmlSecInvalidNodeError(cur, xmlSecNodeDigestValue, NULL);
@@ -1402,13 +1652,36 @@ xmlSecDSigReferenceCtxProcessNode(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodeP
         base64Encode->operation = xmlSecTransformOperationEncode;
     }
 
-    /* finally get transforms results */
-    ret = xmlSecTransformCtxExecute(transformCtx, node->doc);
+    return(0);
+}
+
+/* executes the transforms chain, the DOM is not modified */
+static int
+xmlSecDSigReferenceCtxExecute(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlDocPtr doc) {
+    int ret;
+
+    xmlSecAssert2(dsigRefCtx != NULL, -1);
+    xmlSecAssert2(dsigRefCtx->digestMethod != NULL, -1);
+    xmlSecAssert2(doc != NULL, -1);
+
+    ret = xmlSecTransformCtxExecute(&(dsigRefCtx->transformCtx), doc);
     if(ret < 0) {
         xmlSecInternalError("xmlSecTransformCtxExecute", NULL);
         return(-1);
     }
-    dsigRefCtx->result = transformCtx->result;
+    dsigRefCtx->result = dsigRefCtx->transformCtx.result;
+    return(0);
+}
+
+/* writes or verifies <dsig:DigestValue/> node and sets the reference status */
+static int
+xmlSecDSigReferenceCtxComplete(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodePtr digestValueNode) {
+    int ret;
+
+    xmlSecAssert2(dsigRefCtx != NULL, -1);
+    xmlSecAssert2(dsigRefCtx->dsigCtx != NULL, -1);
+    xmlSecAssert2(dsigRefCtx->digestMethod != NULL, -1);
+    xmlSecAssert2(digestValueNode != NULL, -1);
 
     if(dsigRefCtx->dsigCtx->operation == xmlSecTransformOperationSign) {
         if((dsigRefCtx->result == NULL) || (xmlSecBufferGetData(dsigRefCtx->result) == NULL)) {
@@ -1426,7 +1699,7 @@ xmlSecDSigReferenceCtxProcessNode(xmlSecDSigReferenceCtxPtr dsigRefCtx, xmlNodeP
     } else {
         /* verify SignatureValue node content */
         ret = xmlSecTransformVerifyNodeContent(dsigRefCtx->digestMethod,
-                            digestValueNode, transformCtx);
+                            digestValueNode, &(dsigRefCtx->transformCtx));
         if(ret < 0) {
             xmlSecInternalError("xmlSecTransformVerifyNodeContent", NULL);
             return(-1);
@@ -43,6 +43,12 @@ static int      xmlSecEncCtxCipherDataNodeRead          (xmlSecEncCtxPtr encCtx,
                                                          xmlNodePtr node);
 static int      xmlSecEncCtxCipherReferenceNodeRead     (xmlSecEncCtxPtr encCtx,
                                                          xmlNodePtr node);
+static int      xmlSecEncCtxCipherValueExecute          (xmlSecEncCtxPtr encCtx,
+                                                         xmlNodePtr node);
+static int      xmlSecEncCtxCipherValueFlush            (xmlSecEncCtxPtr encCtx);
+static int      xmlSecEncCtxCipherValueWrite            (xmlSecEncCtxPtr encCtx,
+                                                         const xmlSecByte* data,
+                                                         xmlSecSize dataSize);
 
 /* The ID attribute in XMLEnc is 'Id' */
 static const xmlChar*           xmlSecEncIds[] = { BAD_CAST "Id", NULL };
@@ -297,11 +303,20 @@ xmlSecEncCtxBinaryEncrypt(xmlSecEncCtxPtr encCtx, xmlNodePtr tmpl,
         return(-1);
     }
 
-    ret = xmlSecTransformCtxBinaryExecute(&(encCtx->transformCtx), data, dataSize);
-    if(ret < 0) {
-        xmlSecInternalError2("xmlSecTransformCtxBinaryExecute", NULL,
-                             "dataSize=%d", dataSize);
-        return(-1);
+    if(((encCtx->flags & XMLSEC_ENC_STREAM_CIPHER_VALUE) != 0) && (encCtx->cipherValueNode != NULL)) {
+        ret = xmlSecEncCtxCipherValueWrite(encCtx, data, dataSize);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecEncCtxCipherValueWrite", NULL,
+                                 "dataSize=%d", dataSize);
+            return(-1);
+        }
+    } else {
+        ret = xmlSecTransformCtxBinaryExecute(&(encCtx->transformCtx), data, dataSize);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecTransformCtxBinaryExecute", NULL,
+                                 "dataSize=%d", dataSize);
+            return(-1);
+        }
     }
 
     encCtx->result = encCtx->transformCtx.result;
@@ -601,27 +616,11 @@ xmlSecEncCtxDecryptToBuffer(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
 
     /* decrypt the data */
     if(encCtx->cipherValueNode != NULL) {
-        xmlChar* data = NULL;
-        xmlSecSize dataSize = 0;
-
-        data = xmlNodeGetContent(encCtx->cipherValueNode);
-        if(data == NULL) {
-            xmlSecInvalidNodeContentError(encCtx->cipherValueNode, NULL, "empty");
-            return(NULL);
-        }
-        dataSize = xmlStrlen(data);
-
-        ret = xmlSecTransformCtxBinaryExecute(&(encCtx->transformCtx), data, dataSize);
+        ret = xmlSecEncCtxCipherValueExecute(encCtx, encCtx->cipherValueNode);
         if(ret < 0) {
-            xmlSecInternalError("xmlSecTransformCtxBinaryExecute", NULL);
-            if(data != NULL) {
-                xmlFree(data);
-            }
+            xmlSecInternalError("xmlSecEncCtxCipherValueExecute", NULL);
             return(NULL);
         }
-        if(data != NULL) {
-            xmlFree(data);
-        }
     } else {
         ret = xmlSecTransformCtxExecute(&(encCtx->transformCtx), node->doc);
         if(ret < 0) {
@@ -636,6 +635,152 @@ xmlSecEncCtxDecryptToBuffer(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
     return(encCtx->result);
 }
 
+typedef struct _xmlSecEncCtxCipherValuePushCtx {
+    xmlSecTransformCtxPtr       transformCtx;
+    xmlSecSize                  pushedSize;
+} xmlSecEncCtxCipherValuePushCtx;
+
+static int
+xmlSecEncCtxCipherValuePushCallback(const xmlChar* content, xmlSecSize contentSize, void* data) {
+    xmlSecEncCtxCipherValuePushCtx* ctx = (xmlSecEncCtxCipherValuePushCtx*)data;
+    int ret;
+
+    xmlSecAssert2(content != NULL, -1);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->transformCtx != NULL, -1);
+    xmlSecAssert2(ctx->transformCtx->first != NULL, -1);
+
+    if(contentSize == 0) {
+        return(0);
+    }
+
+    ret = xmlSecTransformPushBin(ctx->transformCtx->first, content, contentSize, 0, ctx->transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError2("xmlSecTransformPushBin", NULL,
+                             "dataSize=%d", contentSize);
+        return(-1);
+    }
+    ctx->pushedSize += contentSize;
+    return(0);
+}
+
+/* pushes the <enc:CipherValue/> text nodes one by one thru the transforms
+ * chain (starting with base64 decode) instead of copying the whole content */
+static int
+xmlSecEncCtxCipherValueExecute(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
+    xmlSecTransformCtxPtr transformCtx;
+    xmlSecEncCtxCipherValuePushCtx pushCtx;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(node != NULL, -1);
+
+    transformCtx = &(encCtx->transformCtx);
+    xmlSecAssert2(transformCtx->result == NULL, -1);
+    xmlSecAssert2(transformCtx->status == xmlSecTransformStatusNone, -1);
+    xmlSecAssert2(transformCtx->uri == NULL, -1);
+
+    ret = xmlSecTransformCtxPrepare(transformCtx, xmlSecTransformDataTypeBin);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxPrepare(TypeBin)", NULL);
+        return(-1);
+    }
+
+    pushCtx.transformCtx = transformCtx;
+    pushCtx.pushedSize = 0;
+    ret = xmlSecNodeContentWalk(node, xmlSecEncCtxCipherValuePushCallback, &pushCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecNodeContentWalk", NULL);
+        return(-1);
+    }
+    if(pushCtx.pushedSize == 0) {
+        xmlSecInvalidNodeContentError(node, NULL, "empty");
+        return(-1);
+    }
+
+    ret = xmlSecTransformPushBin(transformCtx->first, NULL, 0, 1, transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformPushBin", NULL);
+        return(-1);
+    }
+
+    transformCtx->status = xmlSecTransformStatusFinished;
+    return(0);
+}
+
+/* the input chunk size for encrypting straight into <enc:CipherValue/> */
+#define XMLSEC_ENC_CIPHER_VALUE_WRITE_CHUNK             (64 * 1024)
+
+static int
+xmlSecEncCtxCipherValueFlush(xmlSecEncCtxPtr encCtx) {
+    xmlSecBufferPtr result;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(encCtx->cipherValueNode != NULL, -1);
+
+    result = encCtx->transformCtx.result;
+    xmlSecAssert2(result != NULL, -1);
+
+    if(xmlSecBufferGetSize(result) > 0) {
+        xmlNodeAddContentLen(encCtx->cipherValueNode,
+                             xmlSecBufferGetData(result),
+                             xmlSecBufferGetSize(result));
+        xmlSecBufferEmpty(result);
+    }
+    return(0);
+}
+
+/* pushes @data thru the transforms chain (ending with base64 encode) in
+ * bounded chunks and appends the encoded text to <enc:CipherValue/> as it
+ * is produced instead of collecting the whole result first */
+static int
+xmlSecEncCtxCipherValueWrite(xmlSecEncCtxPtr encCtx, const xmlSecByte* data, xmlSecSize dataSize) {
+    xmlSecTransformCtxPtr transformCtx;
+    xmlSecSize chunkSize;
+    int ret;
+
+    xmlSecAssert2(encCtx != NULL, -1);
+    xmlSecAssert2(encCtx->cipherValueNode != NULL, -1);
+    xmlSecAssert2(encCtx->resultBase64Encoded != 0, -1);
+    xmlSecAssert2(data != NULL, -1);
+
+    transformCtx = &(encCtx->transformCtx);
+    xmlSecAssert2(transformCtx->result == NULL, -1);
+    xmlSecAssert2(transformCtx->status == xmlSecTransformStatusNone, -1);
+    xmlSecAssert2(transformCtx->uri == NULL, -1);
+
+    ret = xmlSecTransformCtxPrepare(transformCtx, xmlSecTransformDataTypeBin);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecTransformCtxPrepare(TypeBin)", NULL);
+        return(-1);
+    }
+    xmlNodeSetContent(encCtx->cipherValueNode, NULL);
+
+    do {
+        chunkSize = (dataSize < XMLSEC_ENC_CIPHER_VALUE_WRITE_CHUNK) ? dataSize : XMLSEC_ENC_CIPHER_VALUE_WRITE_CHUNK;
+        ret = xmlSecTransformPushBin(transformCtx->first, data, chunkSize,
+                                     (chunkSize == dataSize) ? 1 : 0, transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecTransformPushBin", NULL,
+                                 "dataSize=%d", chunkSize);
+            return(-1);
+        }
+
+        ret = xmlSecEncCtxCipherValueFlush(encCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecEncCtxCipherValueFlush", NULL);
+            return(-1);
+        }
+
+        data += chunkSize;
+        dataSize -= chunkSize;
+    } while(dataSize > 0);
+
+    transformCtx->status = xmlSecTransformStatusFinished;
+    encCtx->resultReplaced = 1;
+    return(0);
+}
+
 static int
 xmlSecEncCtxEncDataNodeRead(xmlSecEncCtxPtr encCtx, xmlNodePtr node) {
     xmlNodePtr cur;
@@ -817,8 +962,8 @@ xmlSecEncCtxEncDataNodeWrite(xmlSecEncCtxPtr encCtx) {
     xmlSecAssert2(encCtx->result != NULL, -1);
     xmlSecAssert2(encCtx->encKey != NULL, -1);
 
-    /* write encrypted data to xml (if requested) */
-    if(encCtx->cipherValueNode != NULL) {
+    /* write encrypted data to xml (if requested and not already written) */
+    if((encCtx->cipherValueNode != NULL) && (encCtx->resultReplaced == 0)) {
         xmlSecAssert2(xmlSecBufferGetData(encCtx->result) != NULL, -1);
 
         xmlNodeSetContentLen(encCtx->cipherValueNode,
@@ -27,7 +27,10 @@
 #include <xmlsec/transforms.h>
 #include <xmlsec/app.h>
 #include <xmlsec/io.h>
+#include <xmlsec/parser.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/private/keys.h>
+#include <xmlsec/private/xpath.h>
 
 /*
  * Custom external entity handler, denies all files except the initial
@@ -96,6 +99,11 @@ xmlSecInit(void) {
     }
 #endif /* XMLSEC_NO_CRYPTO_DYNAMIC_LOADING */
 
+    if(xmlSecKeysInitialize() < 0) {
+        xmlSecInternalError("xmlSecKeysInitialize", NULL);
+        return(-1);
+    }
+
     if(xmlSecKeyDataIdsInit() < 0) {
         xmlSecInternalError("xmlSecKeyDataIdsInit", NULL);
         return(-1);
@@ -106,6 +114,16 @@ xmlSecInit(void) {
         return(-1);
     }
 
+    if(xmlSecTransformXPathCacheInit() < 0) {
+        xmlSecInternalError("xmlSecTransformXPathCacheInit", NULL);
+        return(-1);
+    }
+
+    if(xmlSecParserPoolInit() < 0) {
+        xmlSecInternalError("xmlSecParserPoolInit", NULL);
+        return(-1);
+    }
+
     /* initialise safe external entity loader */
     if (!xmlSecDefaultExternalEntityLoader) {
         xmlSecDefaultExternalEntityLoader = xmlGetExternalEntityLoader();
@@ -129,8 +147,11 @@ int
 xmlSecShutdown(void) {
     int res = 0;
 
+    xmlSecParserPoolShutdown();
+    xmlSecTransformXPathCacheShutdown();
     xmlSecTransformIdsShutdown();
     xmlSecKeyDataIdsShutdown();
+    xmlSecKeysShutdown();
 
 #ifndef XMLSEC_NO_CRYPTO_DYNAMIC_LOADING
     if(xmlSecCryptoDLShutdown() < 0) {
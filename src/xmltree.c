@@ -21,6 +21,7 @@
 #include <ctype.h>
 
 #include <libxml/tree.h>
+#include <libxml/entities.h>
 #include <libxml/valid.h>
 #include <libxml/xpath.h>
 #include <libxml/xpathInternals.h>
@@ -813,6 +814,86 @@ xmlSecIsEmptyNode(xmlNodePtr node) {
     return(res);
 }
 
+/**
+ * xmlSecNodeContentWalk:
+ * @node:               the pointer to node.
+ * @walkFunc:           the callback function.
+ * @data:               the application specific data passed to the @walkFunc.
+ *
+ * Calls the function @walkFunc once per each text or CDATA node in the
+ * @node subtree (including the entities content) in the document order.
+ * The pieces are exactly what xmlNodeGetContent() would concatenate but
+ * the content is not copied. If the @walkFunc returns a negative value,
+ * then the walk procedure is interrupted.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecNodeContentWalk(xmlNodePtr node, xmlSecNodeContentWalkCallback walkFunc, void* data) {
+    xmlNodePtr cur;
+    xmlEntityPtr ent;
+    int ret;
+
+    xmlSecAssert2(node != NULL, -1);
+    xmlSecAssert2(walkFunc != NULL, -1);
+
+    switch(node->type) {
+    case XML_TEXT_NODE:
+    case XML_CDATA_SECTION_NODE:
+        if(node->content == NULL) {
+            return(0);
+        }
+        return(walkFunc(node->content, xmlStrlen(node->content), data));
+    case XML_ELEMENT_NODE:
+    case XML_DOCUMENT_FRAG_NODE:
+    case XML_ENTITY_DECL:
+        break;
+    default:
+        /* no text content */
+        return(0);
+    }
+
+    /* walk the subtree without recursion */
+    cur = node->children;
+    while(cur != NULL) {
+        switch(cur->type) {
+        case XML_TEXT_NODE:
+        case XML_CDATA_SECTION_NODE:
+            if(cur->content != NULL) {
+                ret = walkFunc(cur->content, xmlStrlen(cur->content), data);
+                if(ret < 0) {
+                    return(ret);
+                }
+            }
+            break;
+        case XML_ENTITY_REF_NODE:
+            ent = xmlGetDocEntity(cur->doc, cur->name);
+            if(ent != NULL) {
+                ret = xmlSecNodeContentWalk((xmlNodePtr)ent, walkFunc, data);
+                if(ret < 0) {
+                    return(ret);
+                }
+            }
+            break;
+        case XML_ELEMENT_NODE:
+            if(cur->children != NULL) {
+                cur = cur->children;
+                continue;
+            }
+            break;
+        default:
+            break;
+        }
+
+        /* next sibling or up */
+        while((cur != node) && (cur->next == NULL)) {
+            cur = cur->parent;
+        }
+        cur = (cur != node) ? cur->next : NULL;
+    }
+    return(0);
+}
+
 /**
  * xmlSecIsEmptyString:
  * @str:                the string to check
@@ -19,8 +19,11 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 
 #include <libxml/tree.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
 #include <libxml/xpath.h>
 #include <libxml/xpathInternals.h>
 #include <libxml/xpointer.h>
@@ -31,6 +34,7 @@
 #include <xmlsec/list.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/errors.h>
+#include <xmlsec/private/xpath.h>
 
 
 /**************************************************************************
@@ -54,6 +58,316 @@ xmlSecXPathHereFunction(xmlXPathParserContextPtr ctxt, int nargs) {
     valuePush(ctxt, xmlXPathNewNodeSet(ctxt->context->here));
 }
 
+/**************************************************************************
+ *
+ * Compiled XPath expressions cache
+ *
+ * The process-wide cache maps the expression text (plus the namespaces
+ * registered in the context and the expression type) to the compiled
+ * expression. The least recently used entries are evicted once there
+ * are more than xmlSecXPathCacheMaxSize entries. libxml2 updates the
+ * compiled expression during evaluation, thus an entry is lent to one
+ * evaluation at a time: if it is busy then a private copy is compiled.
+ * A busy entry evicted from the cache is freed when it is released.
+ *
+ *****************************************************************************/
+typedef struct _xmlSecXPathCacheEntry           xmlSecXPathCacheEntry,
+                                                *xmlSecXPathCacheEntryPtr;
+struct _xmlSecXPathCacheEntry {
+    xmlChar*                            key;
+    xmlXPathCompExprPtr                 comp;
+    int                                 busy;
+    int                                 evicted;
+    xmlSecXPathCacheEntryPtr            prev;
+    xmlSecXPathCacheEntryPtr            next;
+};
+
+static xmlMutexPtr              xmlSecXPathCacheMutex = NULL;
+static xmlHashTablePtr          xmlSecXPathCacheTable = NULL;
+static xmlSecXPathCacheEntryPtr xmlSecXPathCacheHead = NULL;   /* most recently used */
+static xmlSecXPathCacheEntryPtr xmlSecXPathCacheTail = NULL;   /* least recently used */
+static xmlSecSize               xmlSecXPathCacheSize = 0;
+static xmlSecSize               xmlSecXPathCacheMaxSize = XMLSEC_TRANSFORM_XPATH_CACHE_DEFAULT_MAX_SIZE;
+static xmlSecSize               xmlSecXPathCacheHits = 0;
+static xmlSecSize               xmlSecXPathCacheMisses = 0;
+
+static void
+xmlSecXPathCacheEntryDestroy(xmlSecXPathCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+
+    if(entry->key != NULL) {
+        xmlFree(entry->key);
+    }
+    if(entry->comp != NULL) {
+        xmlXPathFreeCompExpr(entry->comp);
+    }
+    memset(entry, 0, sizeof(xmlSecXPathCacheEntry));
+    xmlFree(entry);
+}
+
+/* the mutex must be locked */
+static void
+xmlSecXPathCacheUnlink(xmlSecXPathCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+    xmlSecAssert(xmlSecXPathCacheTable != NULL);
+    xmlSecAssert(xmlSecXPathCacheSize > 0);
+
+    if(entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        xmlSecXPathCacheHead = entry->next;
+    }
+    if(entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        xmlSecXPathCacheTail = entry->prev;
+    }
+    entry->prev = entry->next = NULL;
+
+    xmlHashRemoveEntry(xmlSecXPathCacheTable, entry->key, NULL);
+    --xmlSecXPathCacheSize;
+
+    if(entry->busy != 0) {
+        entry->evicted = 1;
+    } else {
+        xmlSecXPathCacheEntryDestroy(entry);
+    }
+}
+
+/* the mutex must be locked */
+static void
+xmlSecXPathCacheTrim(void) {
+    while((xmlSecXPathCacheSize > xmlSecXPathCacheMaxSize) && (xmlSecXPathCacheTail != NULL)) {
+        xmlSecXPathCacheUnlink(xmlSecXPathCacheTail);
+    }
+}
+
+/* the mutex must be locked */
+static void
+xmlSecXPathCachePushFront(xmlSecXPathCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+
+    entry->prev = NULL;
+    entry->next = xmlSecXPathCacheHead;
+    if(xmlSecXPathCacheHead != NULL) {
+        xmlSecXPathCacheHead->prev = entry;
+    } else {
+        xmlSecXPathCacheTail = entry;
+    }
+    xmlSecXPathCacheHead = entry;
+}
+
+/**
+ * xmlSecTransformXPathCacheInit:
+ *
+ * Initializes the process-wide cache of compiled XPath and XPointer
+ * expressions used by XPath, XPath2 and XPointer transforms.
+ *
+ * Returns: 0 on success or a negative value if an error occurs.
+ */
+int
+xmlSecTransformXPathCacheInit(void) {
+    if(xmlSecXPathCacheMutex != NULL) {
+        return(0);
+    }
+
+    xmlSecXPathCacheTable = xmlHashCreate(0);
+    if(xmlSecXPathCacheTable == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        return(-1);
+    }
+
+    xmlSecXPathCacheMutex = xmlNewMutex();
+    if(xmlSecXPathCacheMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        xmlHashFree(xmlSecXPathCacheTable, NULL);
+        xmlSecXPathCacheTable = NULL;
+        return(-1);
+    }
+
+    xmlSecXPathCacheHits = xmlSecXPathCacheMisses = 0;
+    return(0);
+}
+
+/**
+ * xmlSecTransformXPathCacheShutdown:
+ *
+ * Drops all the compiled expressions from the cache.
+ */
+void
+xmlSecTransformXPathCacheShutdown(void) {
+    if(xmlSecXPathCacheMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecXPathCacheMutex);
+    while(xmlSecXPathCacheHead != NULL) {
+        xmlSecXPathCacheUnlink(xmlSecXPathCacheHead);
+    }
+    xmlHashFree(xmlSecXPathCacheTable, NULL);
+    xmlSecXPathCacheTable = NULL;
+    xmlMutexUnlock(xmlSecXPathCacheMutex);
+
+    xmlFreeMutex(xmlSecXPathCacheMutex);
+    xmlSecXPathCacheMutex = NULL;
+}
+
+/**
+ * xmlSecTransformXPathCacheSetMaxSize:
+ * @maxSize:            the max number of compiled expressions.
+ *
+ * Sets the max number of compiled expressions in the cache
+ * (#XMLSEC_TRANSFORM_XPATH_CACHE_DEFAULT_MAX_SIZE by default).
+ * Zero disables the cache and every expression is compiled
+ * again for each document.
+ */
+void
+xmlSecTransformXPathCacheSetMaxSize(xmlSecSize maxSize) {
+    if(xmlSecXPathCacheMutex == NULL) {
+        xmlSecXPathCacheMaxSize = maxSize;
+        return;
+    }
+
+    xmlMutexLock(xmlSecXPathCacheMutex);
+    xmlSecXPathCacheMaxSize = maxSize;
+    xmlSecXPathCacheTrim();
+    xmlMutexUnlock(xmlSecXPathCacheMutex);
+}
+
+/**
+ * xmlSecTransformXPathCacheGetStats:
+ * @size:               the pointer to the current number of cached expressions (optional).
+ * @hits:               the pointer to the number of cache hits (optional).
+ * @misses:             the pointer to the number of cache misses (optional).
+ *
+ * Gets the XPath expressions cache statistics.
+ */
+void
+xmlSecTransformXPathCacheGetStats(xmlSecSize* size, xmlSecSize* hits, xmlSecSize* misses) {
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexLock(xmlSecXPathCacheMutex);
+    }
+    if(size != NULL) {
+        (*size) = xmlSecXPathCacheSize;
+    }
+    if(hits != NULL) {
+        (*hits) = xmlSecXPathCacheHits;
+    }
+    if(misses != NULL) {
+        (*misses) = xmlSecXPathCacheMisses;
+    }
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+    }
+}
+
+/*
+ * Finds or compiles the expression for one evaluation. Returns 0 and sets
+ * @entry (NULL if the cache is disabled) or a negative value if the
+ * compilation fails. The entry must be released after the evaluation.
+ */
+static int
+xmlSecXPathCacheAcquire(const xmlChar* key, const xmlChar* expr, xmlXPathContextPtr ctx,
+                        xmlSecXPathCacheEntryPtr* entry) {
+    xmlSecXPathCacheEntryPtr cur;
+    xmlXPathCompExprPtr comp;
+
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(expr != NULL, -1);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(entry != NULL, -1);
+
+    (*entry) = NULL;
+    if(xmlSecXPathCacheMutex == NULL) {
+        return(0);
+    }
+
+    xmlMutexLock(xmlSecXPathCacheMutex);
+    if(xmlSecXPathCacheMaxSize == 0) {
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+        return(0);
+    }
+    cur = (xmlSecXPathCacheEntryPtr)xmlHashLookup(xmlSecXPathCacheTable, key);
+    if((cur != NULL) && (cur->busy == 0)) {
+        ++xmlSecXPathCacheHits;
+        cur->busy = 1;
+        if(cur != xmlSecXPathCacheHead) {
+            /* move to front */
+            cur->prev->next = cur->next;
+            if(cur->next != NULL) {
+                cur->next->prev = cur->prev;
+            } else {
+                xmlSecXPathCacheTail = cur->prev;
+            }
+            xmlSecXPathCachePushFront(cur);
+        }
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+        (*entry) = cur;
+        return(0);
+    }
+    ++xmlSecXPathCacheMisses;
+    xmlMutexUnlock(xmlSecXPathCacheMutex);
+
+    /* compile outside of the lock */
+    comp = xmlXPathCtxtCompile(ctx, expr);
+    if(comp == NULL) {
+        xmlSecXmlError2("xmlXPathCtxtCompile", NULL,
+                        "expr=%s", xmlSecErrorsSafeString(expr));
+        return(-1);
+    }
+
+    cur = (xmlSecXPathCacheEntryPtr)xmlMalloc(sizeof(xmlSecXPathCacheEntry));
+    if(cur == NULL) {
+        xmlSecMallocError(sizeof(xmlSecXPathCacheEntry), NULL);
+        xmlXPathFreeCompExpr(comp);
+        return(-1);
+    }
+    memset(cur, 0, sizeof(xmlSecXPathCacheEntry));
+    cur->comp = comp;
+    cur->busy = 1;
+    cur->key = xmlStrdup(key);
+    if(cur->key == NULL) {
+        xmlSecStrdupError(key, NULL);
+        xmlSecXPathCacheEntryDestroy(cur);
+        return(-1);
+    }
+
+    xmlMutexLock(xmlSecXPathCacheMutex);
+    if(xmlSecXPathCacheTable == NULL) {
+        /* the cache was shutdown meanwhile: keep the entry private */
+        cur->evicted = 1;
+    } else if(xmlHashAddEntry(xmlSecXPathCacheTable, cur->key, cur) == 0) {
+        xmlSecXPathCachePushFront(cur);
+        ++xmlSecXPathCacheSize;
+        xmlSecXPathCacheTrim();
+    } else {
+        /* either the same expression is in the cache (and busy) or there
+         * is no memory: in both cases just keep the entry private */
+        cur->evicted = 1;
+    }
+    xmlMutexUnlock(xmlSecXPathCacheMutex);
+
+    (*entry) = cur;
+    return(0);
+}
+
+static void
+xmlSecXPathCacheRelease(xmlSecXPathCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+    xmlSecAssert(entry->busy != 0);
+
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexLock(xmlSecXPathCacheMutex);
+    }
+    entry->busy = 0;
+    if(entry->evicted != 0) {
+        xmlSecXPathCacheEntryDestroy(entry);
+    }
+    if(xmlSecXPathCacheMutex != NULL) {
+        xmlMutexUnlock(xmlSecXPathCacheMutex);
+    }
+}
+
 /**************************************************************************
  *
  * XPath/XPointer data
@@ -64,15 +378,29 @@ typedef struct _xmlSecXPathData                 xmlSecXPathData,
 typedef enum {
     xmlSecXPathDataTypeXPath,
     xmlSecXPathDataTypeXPath2,
-    xmlSecXPathDataTypeXPointer
+    xmlSecXPathDataTypeXPointer,
+    xmlSecXPathDataTypeXPointerId
 } xmlSecXPathDataType;
 
+/* XPath transform predicates evaluated without XPath engine */
+typedef enum {
+    xmlSecXPathDataShortcutNone = 0,
+    xmlSecXPathDataShortcutAncestorOrSelf,      /* "ancestor-or-self::X" */
+    xmlSecXPathDataShortcutNotAncestorOrSelf,   /* "not(ancestor-or-self::X)" */
+    xmlSecXPathDataShortcutNotHereAncestor      /* "count(ancestor-or-self::X | here()/ancestor::X[1]) >
+                                                    count(ancestor-or-self::X)" */
+} xmlSecXPathDataShortcut;
+
 struct _xmlSecXPathData {
     xmlSecXPathDataType                 type;
     xmlXPathContextPtr                  ctx;
     xmlChar*                            expr;
     xmlSecNodeSetOp                     nodeSetOp;
     xmlSecNodeSetType                   nodeSetType;
+    xmlChar*                            nsList;
+    xmlSecXPathDataShortcut             shortcut;
+    xmlChar*                            shortcutName;
+    xmlChar*                            shortcutNs;
 };
 
 static xmlSecXPathDataPtr       xmlSecXPathDataCreate           (xmlSecXPathDataType type);
@@ -86,6 +414,17 @@ static int                      xmlSecXPathDataNodeRead         (xmlSecXPathData
 static xmlSecNodeSetPtr         xmlSecXPathDataExecute          (xmlSecXPathDataPtr data,
                                                                  xmlDocPtr doc,
                                                                  xmlNodePtr hereNode);
+static xmlChar*                 xmlSecXPathDataGetXPointerId    (const xmlChar* expr);
+static xmlSecNodeSetPtr         xmlSecXPathDataExecuteXPointerId(xmlSecXPathDataPtr data,
+                                                                 xmlDocPtr doc);
+static int                      xmlSecXPathDataCompile          (xmlSecXPathDataPtr data,
+                                                                 xmlSecXPathCacheEntryPtr* entry);
+static int                      xmlSecXPathDataParseShortcut    (xmlSecXPathDataPtr data);
+static xmlSecNodeSetPtr         xmlSecXPathDataExecuteShortcut  (xmlSecXPathDataPtr data,
+                                                                 xmlDocPtr doc,
+                                                                 xmlNodePtr hereNode,
+                                                                 int* fallback);
+static xmlChar*                 xmlSecXPathDataGetXPointerExpr  (const xmlChar* expr);
 
 static xmlSecXPathDataPtr
 xmlSecXPathDataCreate(xmlSecXPathDataType type) {
@@ -120,6 +459,9 @@ xmlSecXPathDataCreate(xmlSecXPathDataType type) {
             return(NULL);
         }
         break;
+    case xmlSecXPathDataTypeXPointerId:
+        /* we don't use XPath engine for this one */
+        break;
     }
 
     return(data);
@@ -129,6 +471,15 @@ static void
 xmlSecXPathDataDestroy(xmlSecXPathDataPtr data) {
     xmlSecAssert(data != NULL);
 
+    if(data->nsList != NULL) {
+        xmlFree(data->nsList);
+    }
+    if(data->shortcutName != NULL) {
+        xmlFree(data->shortcutName);
+    }
+    if(data->shortcutNs != NULL) {
+        xmlFree(data->shortcutNs);
+    }
     if(data->expr != NULL) {
         xmlFree(data->expr);
     }
@@ -176,6 +527,17 @@ xmlSecXPathDataRegisterNamespaces(xmlSecXPathDataPtr data, xmlNodePtr node) {
                                     "prefix=%s", xmlSecErrorsSafeString(ns->prefix));
                     return(-1);
                 }
+
+                /* remember the bindings for the compiled expressions cache key,
+                 * the control chars can't appear in XML text */
+                data->nsList = xmlStrcat(data->nsList, ns->prefix);
+                data->nsList = xmlStrcat(data->nsList, BAD_CAST "\x01");
+                data->nsList = xmlStrcat(data->nsList, ns->href);
+                data->nsList = xmlStrcat(data->nsList, BAD_CAST "\x01");
+                if(data->nsList == NULL) {
+                    xmlSecStrdupError(ns->href, NULL);
+                    return(-1);
+                }
             }
         }
     }
@@ -211,14 +573,30 @@ xmlSecXPathDataNodeRead(xmlSecXPathDataPtr data, xmlNodePtr node) {
 static xmlSecNodeSetPtr
 xmlSecXPathDataExecute(xmlSecXPathDataPtr data, xmlDocPtr doc, xmlNodePtr hereNode) {
     xmlXPathObjectPtr xpathObj = NULL;
+    xmlSecXPathCacheEntryPtr cacheEntry = NULL;
     xmlSecNodeSetPtr nodes;
+    int fallback = 0;
+    int ret;
 
     xmlSecAssert2(data != NULL, NULL);
     xmlSecAssert2(data->expr != NULL, NULL);
-    xmlSecAssert2(data->ctx != NULL, NULL);
     xmlSecAssert2(doc != NULL, NULL);
     xmlSecAssert2(hereNode != NULL, NULL);
 
+    /* "xpointer(id('...'))" is just a lookup in the document IDs table */
+    if(data->type == xmlSecXPathDataTypeXPointerId) {
+        return(xmlSecXPathDataExecuteXPointerId(data, doc));
+    }
+    xmlSecAssert2(data->ctx != NULL, NULL);
+
+    /* well-known predicates are evaluated with one walk over the tree */
+    if(data->shortcut != xmlSecXPathDataShortcutNone) {
+        nodes = xmlSecXPathDataExecuteShortcut(data, doc, hereNode, &fallback);
+        if((nodes != NULL) || (fallback == 0)) {
+            return(nodes);
+        }
+    }
+
     /* do not forget to set the doc */
     data->ctx->doc = doc;
 
@@ -229,25 +607,65 @@ xmlSecXPathDataExecute(xmlSecXPathDataPtr data, xmlDocPtr doc, xmlNodePtr hereNo
         data->ctx->xptr = 1;
     }
 
+    /* compile the expression or get it from cache */
+    ret = xmlSecXPathDataCompile(data, &cacheEntry);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecXPathDataCompile", NULL);
+        return(NULL);
+    }
+
     /* execute xpath or xpointer expression */
-    switch(data->type) {
-    case xmlSecXPathDataTypeXPath:
-    case xmlSecXPathDataTypeXPath2:
-        xpathObj = xmlXPathEvalExpression(data->expr, data->ctx);
+    if(cacheEntry != NULL) {
+        if(data->type == xmlSecXPathDataTypeXPointer) {
+            /* xmlXPtrEval() evaluates "xpointer()" scheme with doc as context */
+            data->ctx->node = (xmlNodePtr)doc;
+            data->ctx->proximityPosition = 1;
+            data->ctx->contextSize = 1;
+        }
+
+        xpathObj = xmlXPathCompiledEval(cacheEntry->comp, data->ctx);
+        xmlSecXPathCacheRelease(cacheEntry);
         if(xpathObj == NULL) {
-            xmlSecXmlError2("xmlXPathEvalExpression", NULL,
+            xmlSecXmlError2("xmlXPathCompiledEval", NULL,
                             "expr=%s", xmlSecErrorsSafeString(data->expr));
             return(NULL);
         }
-        break;
-    case xmlSecXPathDataTypeXPointer:
-        xpathObj = xmlXPtrEval(data->expr, data->ctx);
-        if(xpathObj == NULL) {
-            xmlSecXmlError2("xmlXPtrEval", NULL,
-                            "expr=%s", xmlSecErrorsSafeString(data->expr));
+
+        /* xmlXPtrEval() fails unless the result is a non-empty node set */
+        if((data->type == xmlSecXPathDataTypeXPointer) &&
+           ((xpathObj->type != XPATH_NODESET) || (xpathObj->nodesetval == NULL) ||
+            (xpathObj->nodesetval->nodeNr <= 0))) {
+            xmlSecXmlError2("xmlXPathCompiledEval", NULL,
+                            "expr=%s;error=empty xpointer result",
+                            xmlSecErrorsSafeString(data->expr));
+            xmlXPathFreeObject(xpathObj);
+            return(NULL);
+        }
+    } else {
+        switch(data->type) {
+        case xmlSecXPathDataTypeXPath:
+        case xmlSecXPathDataTypeXPath2:
+            xpathObj = xmlXPathEvalExpression(data->expr, data->ctx);
+            if(xpathObj == NULL) {
+                xmlSecXmlError2("xmlXPathEvalExpression", NULL,
+                                "expr=%s", xmlSecErrorsSafeString(data->expr));
+                return(NULL);
+            }
+            break;
+        case xmlSecXPathDataTypeXPointer:
+            xpathObj = xmlXPtrEval(data->expr, data->ctx);
+            if(xpathObj == NULL) {
+                xmlSecXmlError2("xmlXPtrEval", NULL,
+                                "expr=%s", xmlSecErrorsSafeString(data->expr));
+                return(NULL);
+            }
+            break;
+        case xmlSecXPathDataTypeXPointerId:
+            /* handled above */
+            xmlSecInvalidIntegerTypeError("xpath data type", data->type,
+                    "xpath, xpath2 or xpointer", NULL);
             return(NULL);
         }
-        break;
     }
 
     /* sometime LibXML2 returns an empty nodeset or just NULL, we want
@@ -276,6 +694,519 @@ xmlSecXPathDataExecute(xmlSecXPathDataPtr data, xmlDocPtr doc, xmlNodePtr hereNo
 }
 
 
+/*
+ * Skips blanks and @token in the expression. Returns the pointer
+ * after the token or NULL if there is no such token.
+ */
+static const xmlChar*
+xmlSecXPathDataSkipToken(const xmlChar* cur, const char* token) {
+    int len;
+
+    xmlSecAssert2(token != NULL, NULL);
+
+    if(cur == NULL) {
+        return(NULL);
+    }
+    while(isspace((int)(*cur))) {
+        ++cur;
+    }
+    len = xmlStrlen(BAD_CAST token);
+    if(xmlStrncmp(cur, BAD_CAST token, len) != 0) {
+        return(NULL);
+    }
+    return(cur + len);
+}
+
+/*
+ * Reads the element QName test after blanks and resolves the prefix
+ * with the registered namespaces. Only plain ASCII names are accepted.
+ */
+static const xmlChar*
+xmlSecXPathDataSkipElementName(xmlSecXPathDataPtr data, const xmlChar* cur,
+                               xmlChar** name, xmlChar** ns) {
+    const xmlChar* start;
+    const xmlChar* colon = NULL;
+    const xmlChar* href = NULL;
+    xmlChar* prefix;
+
+    xmlSecAssert2(data != NULL, NULL);
+    xmlSecAssert2(data->ctx != NULL, NULL);
+    xmlSecAssert2(name != NULL, NULL);
+    xmlSecAssert2((*name) == NULL, NULL);
+    xmlSecAssert2(ns != NULL, NULL);
+    xmlSecAssert2((*ns) == NULL, NULL);
+
+    if(cur == NULL) {
+        return(NULL);
+    }
+    while(isspace((int)(*cur))) {
+        ++cur;
+    }
+    for(start = cur; ; ++cur) {
+        if(isalpha((int)(*cur)) || ((*cur) == '_')) {
+            continue;
+        } else if((cur != start) && (cur - 1 != colon) &&
+                  (isdigit((int)(*cur)) || ((*cur) == '-') || ((*cur) == '.'))) {
+            continue;
+        } else if(((*cur) == ':') && (colon == NULL) && (cur != start) && (cur[1] != ':')) {
+            colon = cur;
+            continue;
+        }
+        break;
+    }
+    if((cur == start) || (cur - 1 == colon)) {
+        return(NULL);
+    }
+
+    if(colon != NULL) {
+        prefix = xmlStrndup(start, (int)(colon - start));
+        if(prefix == NULL) {
+            xmlSecStrdupError(start, NULL);
+            return(NULL);
+        }
+        href = xmlXPathNsLookup(data->ctx, prefix);
+        xmlFree(prefix);
+        if(href == NULL) {
+            /* unknown prefix is an error, let XPath engine report it */
+            return(NULL);
+        }
+        start = colon + 1;
+
+        (*ns) = xmlStrdup(href);
+        if((*ns) == NULL) {
+            xmlSecStrdupError(href, NULL);
+            return(NULL);
+        }
+    }
+
+    (*name) = xmlStrndup(start, (int)(cur - start));
+    if((*name) == NULL) {
+        xmlSecStrdupError(start, NULL);
+        if((*ns) != NULL) {
+            xmlFree(*ns);
+            (*ns) = NULL;
+        }
+        return(NULL);
+    }
+    return(cur);
+}
+
+static const xmlChar*
+xmlSecXPathDataSkipSameElementName(xmlSecXPathDataPtr data, const xmlChar* cur) {
+    xmlChar* name = NULL;
+    xmlChar* ns = NULL;
+    int same;
+
+    xmlSecAssert2(data != NULL, NULL);
+
+    cur = xmlSecXPathDataSkipElementName(data, cur, &name, &ns);
+    if(cur == NULL) {
+        return(NULL);
+    }
+    same = xmlStrEqual(name, data->shortcutName) && xmlStrEqual(ns, data->shortcutNs);
+    xmlFree(name);
+    if(ns != NULL) {
+        xmlFree(ns);
+    }
+    return((same) ? cur : NULL);
+}
+
+/*
+ * Recognizes the XPath transform predicates that can be evaluated as
+ * a tree walk (see xmlSecXPathDataExecuteShortcut()): most signatures
+ * exclude themselves with "not(ancestor-or-self::dsig:Signature)" or
+ * with the XMLDSig spec enveloped signature expression.
+ */
+static int
+xmlSecXPathDataParseShortcut(xmlSecXPathDataPtr data) {
+    const xmlChar* cur;
+    xmlSecXPathDataShortcut shortcut;
+
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(data->expr != NULL, -1);
+    xmlSecAssert2(data->shortcut == xmlSecXPathDataShortcutNone, -1);
+    xmlSecAssert2(data->shortcutName == NULL, -1);
+    xmlSecAssert2(data->shortcutNs == NULL, -1);
+
+    if((cur = xmlSecXPathDataSkipToken(data->expr, "not")) != NULL) {
+        cur = xmlSecXPathDataSkipToken(cur, "(");
+        cur = xmlSecXPathDataSkipToken(cur, "ancestor-or-self");
+        cur = xmlSecXPathDataSkipToken(cur, "::");
+        cur = xmlSecXPathDataSkipElementName(data, cur, &(data->shortcutName), &(data->shortcutNs));
+        cur = xmlSecXPathDataSkipToken(cur, ")");
+        shortcut = xmlSecXPathDataShortcutNotAncestorOrSelf;
+    } else if((cur = xmlSecXPathDataSkipToken(data->expr, "ancestor-or-self")) != NULL) {
+        cur = xmlSecXPathDataSkipToken(cur, "::");
+        cur = xmlSecXPathDataSkipElementName(data, cur, &(data->shortcutName), &(data->shortcutNs));
+        shortcut = xmlSecXPathDataShortcutAncestorOrSelf;
+    } else if((cur = xmlSecXPathDataSkipToken(data->expr, "count")) != NULL) {
+        cur = xmlSecXPathDataSkipToken(cur, "(");
+        cur = xmlSecXPathDataSkipToken(cur, "ancestor-or-self");
+        cur = xmlSecXPathDataSkipToken(cur, "::");
+        cur = xmlSecXPathDataSkipElementName(data, cur, &(data->shortcutName), &(data->shortcutNs));
+        cur = xmlSecXPathDataSkipToken(cur, "|");
+        cur = xmlSecXPathDataSkipToken(cur, "here");
+        cur = xmlSecXPathDataSkipToken(cur, "(");
+        cur = xmlSecXPathDataSkipToken(cur, ")");
+        cur = xmlSecXPathDataSkipToken(cur, "/");
+        cur = xmlSecXPathDataSkipToken(cur, "ancestor");
+        cur = xmlSecXPathDataSkipToken(cur, "::");
+        if(cur != NULL) {
+            cur = xmlSecXPathDataSkipSameElementName(data, cur);
+        }
+        cur = xmlSecXPathDataSkipToken(cur, "[");
+        cur = xmlSecXPathDataSkipToken(cur, "1");
+        cur = xmlSecXPathDataSkipToken(cur, "]");
+        cur = xmlSecXPathDataSkipToken(cur, ")");
+        cur = xmlSecXPathDataSkipToken(cur, ">");
+        cur = xmlSecXPathDataSkipToken(cur, "count");
+        cur = xmlSecXPathDataSkipToken(cur, "(");
+        cur = xmlSecXPathDataSkipToken(cur, "ancestor-or-self");
+        cur = xmlSecXPathDataSkipToken(cur, "::");
+        if(cur != NULL) {
+            cur = xmlSecXPathDataSkipSameElementName(data, cur);
+        }
+        cur = xmlSecXPathDataSkipToken(cur, ")");
+        shortcut = xmlSecXPathDataShortcutNotHereAncestor;
+    } else {
+        return(0);
+    }
+
+    /* nothing else is allowed */
+    if(cur != NULL) {
+        while(isspace((int)(*cur))) {
+            ++cur;
+        }
+    }
+    if((cur == NULL) || ((*cur) != '\0')) {
+        if(data->shortcutName != NULL) {
+            xmlFree(data->shortcutName);
+            data->shortcutName = NULL;
+        }
+        if(data->shortcutNs != NULL) {
+            xmlFree(data->shortcutNs);
+            data->shortcutNs = NULL;
+        }
+        return(0);
+    }
+
+    data->shortcut = shortcut;
+    return(0);
+}
+
+/*
+ * Evaluates the recognized predicate as one node set: all the nodes
+ * (including attributes and namespaces) of the matching elements
+ * subtrees (xmlSecNodeSetTree) or everything else (xmlSecNodeSetTreeInvert).
+ * It's exactly what "(//. | //@* | //namespace::*)[boolean(expr)]" selects
+ * but without materializing every node of the document. Sets @fallback
+ * if the document has the features we don't handle here.
+ */
+static xmlSecNodeSetPtr
+xmlSecXPathDataExecuteShortcut(xmlSecXPathDataPtr data, xmlDocPtr doc,
+                               xmlNodePtr hereNode, int* fallback) {
+    xmlNodeSetPtr nodeSet;
+    xmlSecNodeSetPtr nodes;
+    xmlSecNodeSetType type = xmlSecNodeSetTree;
+    xmlNodePtr cur;
+    int ret;
+
+    xmlSecAssert2(data != NULL, NULL);
+    xmlSecAssert2(data->shortcut != xmlSecXPathDataShortcutNone, NULL);
+    xmlSecAssert2(data->shortcutName != NULL, NULL);
+    xmlSecAssert2(doc != NULL, NULL);
+    xmlSecAssert2(hereNode != NULL, NULL);
+    xmlSecAssert2(fallback != NULL, NULL);
+
+    /* here() is not available for other documents */
+    if((data->shortcut == xmlSecXPathDataShortcutNotHereAncestor) && (hereNode->doc != doc)) {
+        (*fallback) = 1;
+        return(NULL);
+    }
+
+    nodeSet = xmlXPathNodeSetCreate(NULL);
+    if(nodeSet == NULL) {
+        xmlSecXmlError("xmlXPathNodeSetCreate", NULL);
+        return(NULL);
+    }
+
+    switch(data->shortcut) {
+    case xmlSecXPathDataShortcutAncestorOrSelf:
+    case xmlSecXPathDataShortcutNotAncestorOrSelf:
+        /* find the top most matching elements, the nested ones are in their subtrees */
+        cur = doc->children;
+        while(cur != NULL) {
+            if(cur->type == XML_ENTITY_REF_NODE) {
+                /* XPath engine walks thru the entities content */
+                xmlXPathFreeNodeSet(nodeSet);
+                (*fallback) = 1;
+                return(NULL);
+            } else if(cur->type == XML_ELEMENT_NODE) {
+                if(xmlSecCheckNodeName(cur, data->shortcutName, data->shortcutNs)) {
+                    ret = xmlXPathNodeSetAdd(nodeSet, cur);
+                    if(ret < 0) {
+                        xmlSecXmlError("xmlXPathNodeSetAdd", NULL);
+                        xmlXPathFreeNodeSet(nodeSet);
+                        return(NULL);
+                    }
+                } else if(cur->children != NULL) {
+                    cur = cur->children;
+                    continue;
+                }
+            }
+
+            /* next sibling or up */
+            while((cur != NULL) && (cur->next == NULL)) {
+                cur = (cur->parent != (xmlNodePtr)doc) ? cur->parent : NULL;
+            }
+            if(cur != NULL) {
+                cur = cur->next;
+            }
+        }
+
+        type = (data->shortcut == xmlSecXPathDataShortcutNotAncestorOrSelf) ?
+            xmlSecNodeSetTreeInvert : xmlSecNodeSetTree;
+        break;
+    case xmlSecXPathDataShortcutNotHereAncestor:
+        /* everything but the subtree of the closest X ancestor of here()
+         * node or nothing if there is no such ancestor */
+        for(cur = hereNode->parent; cur != NULL; cur = cur->parent) {
+            if((cur->type == XML_ELEMENT_NODE) && xmlSecCheckNodeName(cur, data->shortcutName, data->shortcutNs)) {
+                break;
+            }
+        }
+        if(cur != NULL) {
+            ret = xmlXPathNodeSetAdd(nodeSet, cur);
+            if(ret < 0) {
+                xmlSecXmlError("xmlXPathNodeSetAdd", NULL);
+                xmlXPathFreeNodeSet(nodeSet);
+                return(NULL);
+            }
+            type = xmlSecNodeSetTreeInvert;
+        } else {
+            type = xmlSecNodeSetTree;
+        }
+        break;
+    default:
+        xmlSecInvalidIntegerTypeError("xpath shortcut", data->shortcut,
+                "supported xpath shortcut", NULL);
+        xmlXPathFreeNodeSet(nodeSet);
+        return(NULL);
+    }
+
+    nodes = xmlSecNodeSetCreate(doc, nodeSet, type);
+    if(nodes == NULL) {
+        xmlSecInternalError2("xmlSecNodeSetCreate", NULL, "type=%d", type);
+        xmlXPathFreeNodeSet(nodeSet);
+        return(NULL);
+    }
+    return(nodes);
+}
+
+/*
+ * Looks up the compiled expression in the cache for one evaluation (sets
+ * @entry to NULL if the expression is not cacheable). XPointer expressions are cached only in the simple "xpointer(expr)"
+ * form when the XPath engine gives the same result as xmlXPtrEval().
+ */
+static int
+xmlSecXPathDataCompile(xmlSecXPathDataPtr data, xmlSecXPathCacheEntryPtr* entry) {
+    xmlChar* expr = NULL;
+    xmlChar* key;
+    int ret;
+
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(data->expr != NULL, -1);
+    xmlSecAssert2(data->ctx != NULL, -1);
+    xmlSecAssert2(entry != NULL, -1);
+
+    (*entry) = NULL;
+
+    switch(data->type) {
+    case xmlSecXPathDataTypeXPath:
+    case xmlSecXPathDataTypeXPath2:
+        key = xmlStrdup(BAD_CAST "p");
+        break;
+    case xmlSecXPathDataTypeXPointer:
+        expr = xmlSecXPathDataGetXPointerExpr(data->expr);
+        if(expr == NULL) {
+            /* not cacheable */
+            return(0);
+        }
+        key = xmlStrdup(BAD_CAST "x");
+        break;
+    default:
+        return(0);
+    }
+
+    /* key = type + namespaces + expression */
+    key = xmlStrcat(key, data->nsList);
+    key = xmlStrcat(key, BAD_CAST "\x02");
+    key = xmlStrcat(key, (expr != NULL) ? expr : data->expr);
+    if(key == NULL) {
+        xmlSecStrdupError(data->expr, NULL);
+        if(expr != NULL) {
+            xmlFree(expr);
+        }
+        return(-1);
+    }
+
+    ret = xmlSecXPathCacheAcquire(key, (expr != NULL) ? expr : data->expr,
+                                  data->ctx, entry);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecXPathCacheAcquire", NULL);
+        xmlFree(key);
+        if(expr != NULL) {
+            xmlFree(expr);
+        }
+        return(-1);
+    }
+
+    xmlFree(key);
+    if(expr != NULL) {
+        xmlFree(expr);
+    }
+    return(0);
+}
+
+/*
+ * Returns the XPath expression from "xpointer(expr)" if the XPointer is
+ * the only XPointer part and doesn't use escapes or XPointer ranges and
+ * points extensions. Otherwise, returns NULL. The parentheses are counted
+ * exactly as xmlXPtrEval() does (ignoring quotes).
+ */
+static xmlChar*
+xmlSecXPathDataGetXPointerExpr(const xmlChar* expr) {
+    static const char prefix[] = "xpointer(";
+    xmlChar* res;
+    int len, prefixLen, level, i;
+
+    xmlSecAssert2(expr != NULL, NULL);
+
+    /* xmlXPtrEval() skips blanks around the XPointer */
+    while(isspace((int)(*expr))) {
+        ++expr;
+    }
+    len = xmlStrlen(expr);
+    while((len > 0) && isspace((int)expr[len - 1])) {
+        --len;
+    }
+    prefixLen = xmlStrlen(BAD_CAST prefix);
+    if((len <= prefixLen + 1) || (xmlStrncmp(expr, BAD_CAST prefix, prefixLen) != 0) ||
+       (expr[len - 1] != ')')) {
+        return(NULL);
+    }
+    for(i = prefixLen, level = 1; i < len - 1; ++i) {
+        if(expr[i] == '^') {
+            return(NULL);
+        } else if(expr[i] == '(') {
+            ++level;
+        } else if((expr[i] == ')') && (--level <= 0)) {
+            return(NULL);
+        }
+    }
+    if(level != 1) {
+        return(NULL);
+    }
+
+    res = xmlStrndup(expr + prefixLen, len - prefixLen - 1);
+    if(res == NULL) {
+        xmlSecStrdupError(expr, NULL);
+        return(NULL);
+    }
+    if((xmlStrstr(res, BAD_CAST "range") != NULL) || (xmlStrstr(res, BAD_CAST "-point") != NULL)) {
+        xmlFree(res);
+        return(NULL);
+    }
+    return(res);
+}
+
+/*
+ * Returns the ID from "xpointer(id('ID'))" expression if the ID is a single
+ * ID without any characters that XPointer or XPath would treat specially,
+ * i.e. we get exactly the same result from the IDs table lookup as from
+ * the XPointer engine. Otherwise, returns NULL.
+ */
+static xmlChar*
+xmlSecXPathDataGetXPointerId(const xmlChar* expr) {
+    static const char prefix[] = "xpointer(id(\'";
+    static const char suffix[] = "\'))";
+    int len, prefixLen, suffixLen, i;
+
+    xmlSecAssert2(expr != NULL, NULL);
+
+    len = xmlStrlen(expr);
+    prefixLen = xmlStrlen(BAD_CAST prefix);
+    suffixLen = xmlStrlen(BAD_CAST suffix);
+    if(len <= prefixLen + suffixLen) {
+        return(NULL);
+    }
+    if((xmlStrncmp(expr, BAD_CAST prefix, prefixLen) != 0) ||
+       (xmlStrcmp(expr + len - suffixLen, BAD_CAST suffix) != 0)) {
+        return(NULL);
+    }
+    for(i = prefixLen; i < len - suffixLen; ++i) {
+        switch(expr[i]) {
+        case '\'':
+        case '\"':
+        case '^':
+        case '(':
+        case ')':
+            return(NULL);
+        default:
+            if(isspace((int)expr[i])) {
+                return(NULL);
+            }
+            break;
+        }
+    }
+
+    return(xmlStrndup(expr + prefixLen, len - prefixLen - suffixLen));
+}
+
+static xmlSecNodeSetPtr
+xmlSecXPathDataExecuteXPointerId(xmlSecXPathDataPtr data, xmlDocPtr doc) {
+    xmlNodeSetPtr nodeSet;
+    xmlSecNodeSetPtr nodes;
+    xmlAttrPtr attr;
+    xmlNodePtr cur = NULL;
+
+    xmlSecAssert2(data != NULL, NULL);
+    xmlSecAssert2(data->type == xmlSecXPathDataTypeXPointerId, NULL);
+    xmlSecAssert2(data->expr != NULL, NULL);
+    xmlSecAssert2(doc != NULL, NULL);
+
+    /* the XPointer engine fails if the ID is not found (the empty result
+     * of the only xpointer() part is an error) and so do we: an empty
+     * nodes set would be silently digested */
+    attr = xmlGetID(doc, data->expr);
+    if(attr != NULL) {
+        if(attr->type == XML_ATTRIBUTE_NODE) {
+            cur = attr->parent;
+        } else if(attr->type == XML_ELEMENT_NODE) {
+            cur = (xmlNodePtr)attr;
+        }
+    }
+    if(cur == NULL) {
+        xmlSecInvalidNodeError(cur, data->expr, NULL);
+        return(NULL);
+    }
+
+    nodeSet = xmlXPathNodeSetCreate(cur);
+    if(nodeSet == NULL) {
+        xmlSecXmlError2("xmlXPathNodeSetCreate", NULL,
+                        "id=%s", xmlSecErrorsSafeString(data->expr));
+        return(NULL);
+    }
+
+    nodes = xmlSecNodeSetCreate(doc, nodeSet, data->nodeSetType);
+    if(nodes == NULL) {
+        xmlSecInternalError2("xmlSecNodeSetCreate", NULL, "type=%d", data->nodeSetType);
+        xmlXPathFreeNodeSet(nodeSet);
+        return(NULL);
+    }
+    return(nodes);
+}
+
 /**************************************************************************
  *
  * XPath data list
@@ -535,6 +1466,14 @@ xmlSecTransformXPathNodeRead(xmlSecTransformPtr transform, xmlNodePtr node, xmlS
         return(-1);
     }
 
+    /* check if we can avoid XPath engine for this predicate */
+    ret = xmlSecXPathDataParseShortcut(data);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecXPathDataParseShortcut",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
     /* create full XPath expression */
     xmlSecAssert2(data->expr != NULL, -1);
     tmpSize = xmlStrlen(data->expr) + xmlStrlen(BAD_CAST xpathPattern) + 1;
@@ -756,6 +1695,7 @@ xmlSecTransformXPointerSetExpr(xmlSecTransformPtr transform, const xmlChar* expr
                             xmlSecNodeSetType  nodeSetType, xmlNodePtr hereNode) {
     xmlSecPtrListPtr dataList;
     xmlSecXPathDataPtr data;
+    xmlChar* id;
     int ret;
 
     xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXPointerId), -1);
@@ -769,27 +1709,41 @@ xmlSecTransformXPointerSetExpr(xmlSecTransformPtr transform, const xmlChar* expr
     xmlSecAssert2(xmlSecPtrListCheckId(dataList, xmlSecXPathDataListId), -1);
     xmlSecAssert2(xmlSecPtrListGetSize(dataList) == 0, -1);
 
-    data = xmlSecXPathDataCreate(xmlSecXPathDataTypeXPointer);
-    if(data == NULL) {
-        xmlSecInternalError("xmlSecXPathDataCreate",
-                            xmlSecTransformGetName(transform));
-        return(-1);
-    }
+    /* the most common case: barename or "xpointer(id('...'))" reference
+     * doesn't need XPointer engine */
+    id = xmlSecXPathDataGetXPointerId(expr);
+    if(id != NULL) {
+        data = xmlSecXPathDataCreate(xmlSecXPathDataTypeXPointerId);
+        if(data == NULL) {
+            xmlSecInternalError("xmlSecXPathDataCreate",
+                                xmlSecTransformGetName(transform));
+            xmlFree(id);
+            return(-1);
+        }
+        data->expr = id;
+    } else {
+        data = xmlSecXPathDataCreate(xmlSecXPathDataTypeXPointer);
+        if(data == NULL) {
+            xmlSecInternalError("xmlSecXPathDataCreate",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
 
-    ret = xmlSecXPathDataRegisterNamespaces(data, hereNode);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecXPathDataRegisterNamespaces",
-                            xmlSecTransformGetName(transform));
-        xmlSecXPathDataDestroy(data);
-        return(-1);
-    }
+        ret = xmlSecXPathDataRegisterNamespaces(data, hereNode);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecXPathDataRegisterNamespaces",
+                                xmlSecTransformGetName(transform));
+            xmlSecXPathDataDestroy(data);
+            return(-1);
+        }
 
-    ret = xmlSecXPathDataSetExpr(data, expr);
-    if(ret < 0) {
-        xmlSecInternalError("xmlSecXPathDataSetExpr",
-                            xmlSecTransformGetName(transform));
-        xmlSecXPathDataDestroy(data);
-        return(-1);
+        ret = xmlSecXPathDataSetExpr(data, expr);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecXPathDataSetExpr",
+                                xmlSecTransformGetName(transform));
+            xmlSecXPathDataDestroy(data);
+            return(-1);
+        }
     }
 
     /* append it to the list */
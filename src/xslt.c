@@ -23,8 +23,14 @@
 #include <string.h>
 
 #include <libxml/tree.h>
+#include <libxml/hash.h>
+#include <libxml/threads.h>
+#include <libxml/uri.h>
+#include <libxml/c14n.h>
+#include <libxml/parserInternals.h>
 #include <libxslt/xslt.h>
 #include <libxslt/xsltInternals.h>
+#include <libxslt/imports.h>
 #include <libxslt/transform.h>
 #include <libxslt/xsltutils.h>
 
@@ -33,10 +39,53 @@
 #include <xmlsec/keys.h>
 #include <xmlsec/transforms.h>
 #include <xmlsec/keys.h>
+#include <xmlsec/nodeset.h>
 #include <xmlsec/parser.h>
 #include <xmlsec/errors.h>
 #include <xmlsec/private/xslt.h>
 
+/**************************************************************************
+ *
+ * Compiled XSLT stylesheets cache
+ *
+ * The process-wide cache maps the serialized stylesheet (the <dsig:Transform/>
+ * node children) to the compiled stylesheet. The lookup compares the whole
+ * serialized text, the hash table only speeds it up. The least recently
+ * used entries are evicted once there are more than xmlSecXsltCacheMaxSize
+ * entries; an entry still used by a transform is freed when the last
+ * reference is released.
+ *
+ *****************************************************************************/
+typedef struct _xmlSecXsltCacheEntry            xmlSecXsltCacheEntry,
+                                                *xmlSecXsltCacheEntryPtr;
+struct _xmlSecXsltCacheEntry {
+    xmlChar*                            key;
+    xsltStylesheetPtr                   xslt;
+    xmlSecSize                          refs;
+    int                                 evicted;
+    xmlSecXsltCacheEntryPtr             prev;
+    xmlSecXsltCacheEntryPtr             next;
+};
+
+static xmlMutexPtr              xmlSecXsltCacheMutex = NULL;
+static xmlHashTablePtr          xmlSecXsltCacheTable = NULL;
+static xmlSecXsltCacheEntryPtr  xmlSecXsltCacheHead = NULL;    /* most recently used */
+static xmlSecXsltCacheEntryPtr  xmlSecXsltCacheTail = NULL;    /* least recently used */
+static xmlSecSize               xmlSecXsltCacheSize = 0;
+static xmlSecSize               xmlSecXsltCacheMaxSize = XMLSEC_TRANSFORM_XSLT_CACHE_DEFAULT_MAX_SIZE;
+static xmlSecSize               xmlSecXsltCacheHits = 0;
+static xmlSecSize               xmlSecXsltCacheMisses = 0;
+
+static int              xmlSecXsltCacheInit                     (void);
+static void             xmlSecXsltCacheShutdown                 (void);
+static void             xmlSecXsltCacheFlush                    (void);
+static void             xmlSecXsltCacheTrim                     (void);
+static int              xmlSecXsltCacheAcquire                  (const xmlChar* key,
+                                                                 xmlSecSize keySize,
+                                                                 xsltStylesheetPtr* xslt,
+                                                                 xmlSecXsltCacheEntryPtr* entry);
+static void             xmlSecXsltCacheRelease                  (xmlSecXsltCacheEntryPtr entry);
+
 /**************************************************************************
  *
  * Internal xslt ctx
@@ -45,6 +94,7 @@
 typedef struct _xmlSecXsltCtx                   xmlSecXsltCtx, *xmlSecXsltCtxPtr;
 struct _xmlSecXsltCtx {
     xsltStylesheetPtr   xslt;
+    xmlSecXsltCacheEntryPtr cacheEntry;         /* owns xslt if not NULL */
     xmlParserCtxtPtr    parserCtx;
 };
 
@@ -70,6 +120,17 @@ static int              xmlSecXsltPushBin                       (xmlSecTransform
                                                                  xmlSecSize dataSize,
                                                                  int final,
                                                                  xmlSecTransformCtxPtr transformCtx);
+static int              xmlSecXsltPopBin                        (xmlSecTransformPtr transform,
+                                                                 xmlSecByte* data,
+                                                                 xmlSecSize maxDataSize,
+                                                                 xmlSecSize* dataSize,
+                                                                 xmlSecTransformCtxPtr transformCtx);
+static int              xmlSecXsltPushXml                       (xmlSecTransformPtr transform,
+                                                                 xmlSecNodeSetPtr nodes,
+                                                                 xmlSecTransformCtxPtr transformCtx);
+static int              xmlSecXsltPopXml                        (xmlSecTransformPtr transform,
+                                                                 xmlSecNodeSetPtr* nodes,
+                                                                 xmlSecTransformCtxPtr transformCtx);
 static int              xmlSecXsltExecute                       (xmlSecTransformPtr transform,
                                                                  int last,
                                                                  xmlSecTransformCtxPtr transformCtx);
@@ -78,6 +139,25 @@ static int              xmlSecXslProcess                        (xmlSecXsltCtxPt
                                                                  xmlSecBufferPtr out);
 static xmlDocPtr        xmlSecXsApplyStylesheet                 (xmlSecXsltCtxPtr ctx,
                                                                  xmlDocPtr doc);
+static xmlDocPtr        xmlSecXsltApplyToNodeSet                (xmlSecXsltCtxPtr ctx,
+                                                                 xmlSecNodeSetPtr nodes);
+static xmlDocPtr        xmlSecXsltPopDoc                        (xmlSecTransformPtr transform,
+                                                                 xmlSecTransformCtxPtr transformCtx);
+static int              xmlSecXsltPushResult                    (xmlSecTransformPtr transform,
+                                                                 xmlDocPtr docOut,
+                                                                 xmlSecTransformCtxPtr transformCtx);
+static xmlSecNodeSetPtr xmlSecXsltResultToNodeSet               (xmlSecXsltCtxPtr ctx,
+                                                                 xmlDocPtr docOut);
+static int              xmlSecXsltSaveResult                    (xmlSecXsltCtxPtr ctx,
+                                                                 xmlDocPtr doc,
+                                                                 xmlOutputBufferPtr output);
+static int              xmlSecXsltIsCanonicalInput              (xsltStylesheetPtr xslt,
+                                                                 xmlSecNodeSetPtr nodes);
+static int              xmlSecXsltIsCanonicalElement            (xmlNodePtr node);
+static int              xmlSecXsltAttrCompare                   (xmlAttrPtr attr1,
+                                                                 xmlAttrPtr attr2);
+static int              xmlSecXsltIsCanonicalResult             (xsltStylesheetPtr xslt,
+                                                                 xmlDocPtr doc);
                                                                  
 static xmlSecTransformKlass xmlSecXsltKlass = {
     /* klass/object sizes */
@@ -97,9 +177,9 @@ static xmlSecTransformKlass xmlSecXsltKlass = {
     NULL,                                       /* xmlSecTransformValidateMethod validate; */
     xmlSecTransformDefaultGetDataType,          /* xmlSecTransformGetDataTypeMethod getDataType; */
     xmlSecXsltPushBin,                          /* xmlSecTransformPushBinMethod pushBin; */
-    xmlSecTransformDefaultPopBin,               /* xmlSecTransformPopBinMethod popBin; */
-    NULL,                                       /* xmlSecTransformPushXmlMethod pushXml; */
-    NULL,                                       /* xmlSecTransformPopXmlMethod popXml; */
+    xmlSecXsltPopBin,                           /* xmlSecTransformPopBinMethod popBin; */
+    xmlSecXsltPushXml,                          /* xmlSecTransformPushXmlMethod pushXml; */
+    xmlSecXsltPopXml,                           /* xmlSecTransformPopXmlMethod popXml; */
     xmlSecXsltExecute,                          /* xmlSecTransformExecuteMethod execute; */
 
     NULL,                                       /* void* reserved0; */
@@ -122,9 +202,15 @@ void xmlSecTransformXsltInitialize(void) {
     xsltSetSecurityPrefs(g_xslt_default_security_prefs,  XSLT_SECPREF_CREATE_DIRECTORY, xsltSecurityForbid);
     xsltSetSecurityPrefs(g_xslt_default_security_prefs,  XSLT_SECPREF_READ_NETWORK,     xsltSecurityForbid);
     xsltSetSecurityPrefs(g_xslt_default_security_prefs,  XSLT_SECPREF_WRITE_NETWORK,    xsltSecurityForbid);
+
+    if(xmlSecXsltCacheInit() < 0) {
+        /* stylesheets are compiled for every transform */
+        xmlSecInternalError("xmlSecXsltCacheInit", NULL);
+    }
 }
 
 void xmlSecTransformXsltShutdown(void) {
+    xmlSecXsltCacheShutdown();
     if(g_xslt_default_security_prefs != NULL) {
         xsltFreeSecurityPrefs(g_xslt_default_security_prefs);
         g_xslt_default_security_prefs = NULL;
@@ -136,7 +222,8 @@ void xmlSecTransformXsltShutdown(void) {
  * @sec: the new security preferences
  *
  * Sets the new default security preferences. The xmlsec default security policy is 
- * to disable everything.
+ * to disable everything. The compiled stylesheets are dropped from the cache
+ * and compiled again under the new preferences.
  */
 XMLSEC_EXPORT void
 xmlSecTransformXsltSetDefaultSecurityPrefs(xsltSecurityPrefsPtr sec) {
@@ -149,6 +236,312 @@ xmlSecTransformXsltSetDefaultSecurityPrefs(xsltSecurityPrefsPtr sec) {
     XMLSEC_XSLT_COPY_SEC_PREF(sec, g_xslt_default_security_prefs, XSLT_SECPREF_CREATE_DIRECTORY);
     XMLSEC_XSLT_COPY_SEC_PREF(sec, g_xslt_default_security_prefs, XSLT_SECPREF_READ_NETWORK);
     XMLSEC_XSLT_COPY_SEC_PREF(sec, g_xslt_default_security_prefs, XSLT_SECPREF_WRITE_NETWORK);
+
+    xmlSecXsltCacheFlush();
+}
+
+/**
+ * xmlSecTransformXsltCacheSetMaxSize:
+ * @maxSize:            the max number of compiled stylesheets.
+ *
+ * Sets the max number of compiled stylesheets in the cache
+ * (#XMLSEC_TRANSFORM_XSLT_CACHE_DEFAULT_MAX_SIZE by default).
+ * Zero disables the cache and every stylesheet is compiled
+ * again for each transform.
+ */
+void
+xmlSecTransformXsltCacheSetMaxSize(xmlSecSize maxSize) {
+    if(xmlSecXsltCacheMutex == NULL) {
+        xmlSecXsltCacheMaxSize = maxSize;
+        return;
+    }
+
+    xmlMutexLock(xmlSecXsltCacheMutex);
+    xmlSecXsltCacheMaxSize = maxSize;
+    xmlSecXsltCacheTrim();
+    xmlMutexUnlock(xmlSecXsltCacheMutex);
+}
+
+/**
+ * xmlSecTransformXsltCacheGetStats:
+ * @size:               the pointer to the current number of cached stylesheets (optional).
+ * @hits:               the pointer to the number of cache hits (optional).
+ * @misses:             the pointer to the number of cache misses (optional).
+ *
+ * Gets the compiled XSLT stylesheets cache statistics.
+ */
+void
+xmlSecTransformXsltCacheGetStats(xmlSecSize* size, xmlSecSize* hits, xmlSecSize* misses) {
+    if(xmlSecXsltCacheMutex != NULL) {
+        xmlMutexLock(xmlSecXsltCacheMutex);
+    }
+    if(size != NULL) {
+        (*size) = xmlSecXsltCacheSize;
+    }
+    if(hits != NULL) {
+        (*hits) = xmlSecXsltCacheHits;
+    }
+    if(misses != NULL) {
+        (*misses) = xmlSecXsltCacheMisses;
+    }
+    if(xmlSecXsltCacheMutex != NULL) {
+        xmlMutexUnlock(xmlSecXsltCacheMutex);
+    }
+}
+
+static void
+xmlSecXsltCacheEntryDestroy(xmlSecXsltCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+
+    if(entry->key != NULL) {
+        xmlFree(entry->key);
+    }
+    if(entry->xslt != NULL) {
+        xsltFreeStylesheet(entry->xslt);
+    }
+    memset(entry, 0, sizeof(xmlSecXsltCacheEntry));
+    xmlFree(entry);
+}
+
+/* the mutex must be locked */
+static void
+xmlSecXsltCacheUnlink(xmlSecXsltCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+    xmlSecAssert(xmlSecXsltCacheTable != NULL);
+    xmlSecAssert(xmlSecXsltCacheSize > 0);
+
+    if(entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    } else {
+        xmlSecXsltCacheHead = entry->next;
+    }
+    if(entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    } else {
+        xmlSecXsltCacheTail = entry->prev;
+    }
+    entry->prev = entry->next = NULL;
+
+    xmlHashRemoveEntry(xmlSecXsltCacheTable, entry->key, NULL);
+    --xmlSecXsltCacheSize;
+
+    if(entry->refs > 0) {
+        entry->evicted = 1;
+    } else {
+        xmlSecXsltCacheEntryDestroy(entry);
+    }
+}
+
+/* the mutex must be locked */
+static void
+xmlSecXsltCacheTrim(void) {
+    while((xmlSecXsltCacheSize > xmlSecXsltCacheMaxSize) && (xmlSecXsltCacheTail != NULL)) {
+        xmlSecXsltCacheUnlink(xmlSecXsltCacheTail);
+    }
+}
+
+/* the mutex must be locked */
+static void
+xmlSecXsltCachePushFront(xmlSecXsltCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+
+    entry->prev = NULL;
+    entry->next = xmlSecXsltCacheHead;
+    if(xmlSecXsltCacheHead != NULL) {
+        xmlSecXsltCacheHead->prev = entry;
+    } else {
+        xmlSecXsltCacheTail = entry;
+    }
+    xmlSecXsltCacheHead = entry;
+}
+
+static int
+xmlSecXsltCacheInit(void) {
+    if(xmlSecXsltCacheMutex != NULL) {
+        return(0);
+    }
+
+    xmlSecXsltCacheTable = xmlHashCreate(0);
+    if(xmlSecXsltCacheTable == NULL) {
+        xmlSecXmlError("xmlHashCreate", NULL);
+        return(-1);
+    }
+
+    xmlSecXsltCacheMutex = xmlNewMutex();
+    if(xmlSecXsltCacheMutex == NULL) {
+        xmlSecXmlError("xmlNewMutex", NULL);
+        xmlHashFree(xmlSecXsltCacheTable, NULL);
+        xmlSecXsltCacheTable = NULL;
+        return(-1);
+    }
+
+    xmlSecXsltCacheHits = xmlSecXsltCacheMisses = 0;
+    return(0);
+}
+
+static void
+xmlSecXsltCacheShutdown(void) {
+    if(xmlSecXsltCacheMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecXsltCacheMutex);
+    while(xmlSecXsltCacheHead != NULL) {
+        xmlSecXsltCacheUnlink(xmlSecXsltCacheHead);
+    }
+    xmlHashFree(xmlSecXsltCacheTable, NULL);
+    xmlSecXsltCacheTable = NULL;
+    xmlMutexUnlock(xmlSecXsltCacheMutex);
+
+    xmlFreeMutex(xmlSecXsltCacheMutex);
+    xmlSecXsltCacheMutex = NULL;
+}
+
+static void
+xmlSecXsltCacheFlush(void) {
+    if(xmlSecXsltCacheMutex == NULL) {
+        return;
+    }
+
+    xmlMutexLock(xmlSecXsltCacheMutex);
+    while(xmlSecXsltCacheHead != NULL) {
+        xmlSecXsltCacheUnlink(xmlSecXsltCacheHead);
+    }
+    xmlMutexUnlock(xmlSecXsltCacheMutex);
+}
+
+static xsltStylesheetPtr
+xmlSecXsltCompile(const xmlChar* data, xmlSecSize dataSize) {
+    xsltStylesheetPtr xslt;
+    xmlDocPtr doc;
+
+    xmlSecAssert2(data != NULL, NULL);
+
+    /* parse the buffer */
+    doc = xmlSecParseMemory(data, dataSize, 1);
+    if(doc == NULL) {
+        xmlSecInternalError("xmlSecParseMemory", NULL);
+        return(NULL);
+    }
+
+    /* pre-process stylesheet */
+    xslt = xsltParseStylesheetDoc(doc);
+    if(xslt == NULL) {
+        xmlSecXsltError("xsltParseStylesheetDoc", NULL, NULL);
+
+        /* after parsing stylesheet doc is assigned
+         * to it and will be freed by xsltFreeStylesheet() */
+        xmlFreeDoc(doc);
+        return(NULL);
+    }
+    return(xslt);
+}
+
+/*
+ * Finds or compiles the stylesheet. Returns 0 and sets @xslt and @entry
+ * (NULL if the cache is disabled and the caller owns @xslt) or a negative
+ * value if the compilation fails.
+ */
+static int
+xmlSecXsltCacheAcquire(const xmlChar* key, xmlSecSize keySize, xsltStylesheetPtr* xslt,
+                       xmlSecXsltCacheEntryPtr* entry) {
+    xmlSecXsltCacheEntryPtr cur;
+    int useCache = 0;
+
+    xmlSecAssert2(key != NULL, -1);
+    xmlSecAssert2(xslt != NULL, -1);
+    xmlSecAssert2(entry != NULL, -1);
+
+    (*xslt) = NULL;
+    (*entry) = NULL;
+    if(xmlSecXsltCacheMutex != NULL) {
+        xmlMutexLock(xmlSecXsltCacheMutex);
+        if(xmlSecXsltCacheMaxSize > 0) {
+            cur = (xmlSecXsltCacheEntryPtr)xmlHashLookup(xmlSecXsltCacheTable, key);
+            if(cur != NULL) {
+                ++xmlSecXsltCacheHits;
+                ++(cur->refs);
+                if(cur != xmlSecXsltCacheHead) {
+                    /* move to front */
+                    cur->prev->next = cur->next;
+                    if(cur->next != NULL) {
+                        cur->next->prev = cur->prev;
+                    } else {
+                        xmlSecXsltCacheTail = cur->prev;
+                    }
+                    xmlSecXsltCachePushFront(cur);
+                }
+                xmlMutexUnlock(xmlSecXsltCacheMutex);
+                (*xslt) = cur->xslt;
+                (*entry) = cur;
+                return(0);
+            }
+            ++xmlSecXsltCacheMisses;
+            useCache = 1;
+        }
+        xmlMutexUnlock(xmlSecXsltCacheMutex);
+    }
+
+    /* compile outside of the lock */
+    (*xslt) = xmlSecXsltCompile(key, keySize);
+    if((*xslt) == NULL) {
+        xmlSecInternalError("xmlSecXsltCompile", NULL);
+        return(-1);
+    }
+    if(useCache == 0) {
+        return(0);
+    }
+
+    cur = (xmlSecXsltCacheEntryPtr)xmlMalloc(sizeof(xmlSecXsltCacheEntry));
+    if(cur == NULL) {
+        /* just keep the stylesheet private */
+        xmlSecMallocError(sizeof(xmlSecXsltCacheEntry), NULL);
+        return(0);
+    }
+    memset(cur, 0, sizeof(xmlSecXsltCacheEntry));
+    cur->key = xmlStrndup(key, keySize);
+    if(cur->key == NULL) {
+        xmlSecStrdupError(key, NULL);
+        xmlFree(cur);
+        return(0);
+    }
+    cur->xslt = (*xslt);
+    cur->refs = 1;
+
+    xmlMutexLock(xmlSecXsltCacheMutex);
+    if(xmlSecXsltCacheTable == NULL) {
+        /* the cache was shutdown meanwhile: keep the entry private */
+        cur->evicted = 1;
+    } else if(xmlHashAddEntry(xmlSecXsltCacheTable, cur->key, cur) == 0) {
+        xmlSecXsltCachePushFront(cur);
+        ++xmlSecXsltCacheSize;
+        xmlSecXsltCacheTrim();
+    } else {
+        /* either somebody else added the same stylesheet or there is
+         * no memory: in both cases just keep the entry private */
+        cur->evicted = 1;
+    }
+    xmlMutexUnlock(xmlSecXsltCacheMutex);
+
+    (*entry) = cur;
+    return(0);
+}
+
+static void
+xmlSecXsltCacheRelease(xmlSecXsltCacheEntryPtr entry) {
+    xmlSecAssert(entry != NULL);
+    xmlSecAssert(entry->refs > 0);
+
+    if(xmlSecXsltCacheMutex != NULL) {
+        xmlMutexLock(xmlSecXsltCacheMutex);
+    }
+    --(entry->refs);
+    if((entry->refs == 0) && (entry->evicted != 0)) {
+        xmlSecXsltCacheEntryDestroy(entry);
+    }
+    if(xmlSecXsltCacheMutex != NULL) {
+        xmlMutexUnlock(xmlSecXsltCacheMutex);
+    }
 }
 
 /**
@@ -215,7 +608,9 @@ xmlSecXsltFinalize(xmlSecTransformPtr transform) {
     ctx = xmlSecXsltGetCtx(transform);
     xmlSecAssert(ctx != NULL);
 
-    if(ctx->xslt != NULL) {
+    if(ctx->cacheEntry != NULL) {
+        xmlSecXsltCacheRelease(ctx->cacheEntry);
+    } else if(ctx->xslt != NULL) {
         xsltFreeStylesheet(ctx->xslt);
     }
     if(ctx->parserCtx != NULL) {
@@ -232,8 +627,8 @@ static int
 xmlSecXsltReadNode(xmlSecTransformPtr transform, xmlNodePtr node, xmlSecTransformCtxPtr transformCtx) {
     xmlSecXsltCtxPtr ctx;
     xmlBufferPtr buffer;
-    xmlDocPtr doc;
     xmlNodePtr cur;
+    int ret;
 
     xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXsltId), -1);
     xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecXsltSize), -1);
@@ -256,28 +651,16 @@ xmlSecXsltReadNode(xmlSecTransformPtr transform, xmlNodePtr node, xmlSecTransfor
         cur = cur->next;
     }
 
-    /* parse the buffer */
-    doc = xmlSecParseMemory(xmlBufferContent(buffer),
-                             xmlBufferLength(buffer), 1);
-    if(doc == NULL) {
-        xmlSecInternalError("xmlSecParseMemory",
+    /* find or compile the stylesheet */
+    ret = xmlSecXsltCacheAcquire(xmlBufferContent(buffer), xmlBufferLength(buffer),
+                                 &(ctx->xslt), &(ctx->cacheEntry));
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecXsltCacheAcquire",
                             xmlSecTransformGetName(transform));
         xmlBufferFree(buffer);
         return(-1);
     }
 
-    /* pre-process stylesheet */
-    ctx->xslt = xsltParseStylesheetDoc(doc);
-    if(ctx->xslt == NULL) {
-        xmlSecXsltError("xsltParseStylesheetDoc", NULL, xmlSecTransformGetName(transform));
-
-        /* after parsing stylesheet doc is assigned
-         * to it and will be freed by xsltFreeStylesheet() */
-        xmlFreeDoc(doc);
-        xmlBufferFree(buffer);
-        return(-1);
-    }
-
     xmlBufferFree(buffer);
     return(0);
 }
@@ -336,7 +719,6 @@ xmlSecXsltPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
     if(final != 0) {
         xmlDocPtr docIn;
         xmlDocPtr docOut;
-        xmlOutputBufferPtr output;
 
         /* finalize */
         ret = xmlParseChunk(ctx->parserCtx, NULL, 0, 1);
@@ -359,45 +741,795 @@ xmlSecXsltPushBin(xmlSecTransformPtr transform, const xmlSecByte* data,
         }
         xmlFreeDoc(docIn);
 
-        if(transform->next != NULL) {
-            output = xmlSecTransformCreateOutputBuffer(transform->next, transformCtx);
-            if(output == NULL) {
-                xmlSecInternalError("xmlSecTransformCreateOutputBuffer",
-                                    xmlSecTransformGetName(transform));
-                xmlFreeDoc(docOut);
-                return(-1);
-            }
-        } else {
-            output = xmlSecBufferCreateOutputBuffer(&(transform->outBuf));
-            if(output == NULL) {
-                xmlSecInternalError("xmlSecBufferCreateOutputBuffer",
-                                    xmlSecTransformGetName(transform));
-                xmlFreeDoc(docOut);
-                return(-1);
-            }
+        ret = xmlSecXsltPushResult(transform, docOut, transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecXsltPushResult",
+                                xmlSecTransformGetName(transform));
+            return(-1);
         }
 
-        ret = xsltSaveResultTo(output, docOut, ctx->xslt);
-        if(ret < 0) {
-            xmlSecXsltError("xsltParseStylesheetDoc", ctx->xslt, xmlSecTransformGetName(transform));
-            xmlOutputBufferClose(output);
+        transform->status = xmlSecTransformStatusFinished;
+    }
+
+    return(0);
+}
+
+/*
+ * XML input and output.
+ *
+ * The stylesheet is applied to the input document directly if the input
+ * nodes set is the whole document and canonicalizing and re-parsing it
+ * (as the c14n transform inserted before the binary input did) would
+ * produce the same tree. Otherwise the nodes set is canonicalized and
+ * re-parsed. Similarly, the result document is passed to the next transform
+ * as is if it does not change after serializing and re-parsing it.
+ */
+static int
+xmlSecXsltPopBin(xmlSecTransformPtr transform, xmlSecByte* data,
+                 xmlSecSize maxDataSize, xmlSecSize* dataSize,
+                 xmlSecTransformCtxPtr transformCtx) {
+    xmlSecXsltCtxPtr ctx;
+    xmlSecTransformDataType prevType;
+    xmlSecSize outSize;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXsltId), -1);
+    xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecXsltSize), -1);
+    xmlSecAssert2(data != NULL, -1);
+    xmlSecAssert2(dataSize != NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecXsltGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->xslt != NULL, -1);
+
+    /* binary input is processed by xmlSecXsltExecute() */
+    if(transform->prev == NULL) {
+        return(xmlSecTransformDefaultPopBin(transform, data, maxDataSize, dataSize, transformCtx));
+    }
+    prevType = xmlSecTransformGetDataType(transform->prev, xmlSecTransformModePop, transformCtx);
+    if((prevType & xmlSecTransformDataTypeBin) != 0) {
+        return(xmlSecTransformDefaultPopBin(transform, data, maxDataSize, dataSize, transformCtx));
+    }
+
+    if(transform->status == xmlSecTransformStatusNone) {
+        xmlOutputBufferPtr output;
+        xmlDocPtr docOut;
+
+        docOut = xmlSecXsltPopDoc(transform, transformCtx);
+        if(docOut == NULL) {
+            xmlSecInternalError("xmlSecXsltPopDoc",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+
+        output = xmlSecBufferCreateOutputBuffer(&(transform->outBuf));
+        if(output == NULL) {
+            xmlSecInternalError("xmlSecBufferCreateOutputBuffer",
+                                xmlSecTransformGetName(transform));
             xmlFreeDoc(docOut);
             return(-1);
         }
-        ret = xmlOutputBufferClose(output);
+
+        ret = xmlSecXsltSaveResult(ctx, docOut, output);
         if(ret < 0) {
-            xmlSecXmlError("xmlOutputBufferClose", xmlSecTransformGetName(transform));
+            xmlSecInternalError("xmlSecXsltSaveResult",
+                                xmlSecTransformGetName(transform));
             xmlFreeDoc(docOut);
             return(-1);
         }
         xmlFreeDoc(docOut);
 
         transform->status = xmlSecTransformStatusFinished;
+    } else if(transform->status != xmlSecTransformStatusFinished) {
+        xmlSecInvalidTransfromStatusError(transform);
+        return(-1);
+    }
+
+    /* copy result (if any) */
+    outSize = xmlSecBufferGetSize(&(transform->outBuf));
+    if(outSize > maxDataSize) {
+        outSize = maxDataSize;
+    }
+    if(outSize > 0) {
+        memcpy(data, xmlSecBufferGetData(&(transform->outBuf)), outSize);
+
+        ret = xmlSecBufferRemoveHead(&(transform->outBuf), outSize);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferRemoveHead",
+                                 xmlSecTransformGetName(transform),
+                                 "size=%d", outSize);
+            return(-1);
+        }
+    }
+
+    (*dataSize) = outSize;
+    return(0);
+}
+
+static int
+xmlSecXsltPushXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr nodes,
+                  xmlSecTransformCtxPtr transformCtx) {
+    xmlSecXsltCtxPtr ctx;
+    xmlDocPtr docOut;
+    int ret;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXsltId), -1);
+    xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecXsltSize), -1);
+    xmlSecAssert2(transform->inNodes == NULL, -1);
+    xmlSecAssert2(nodes != NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecXsltGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->xslt != NULL, -1);
+
+    if(transform->status != xmlSecTransformStatusNone) {
+        xmlSecInvalidTransfromStatusError(transform);
+        return(-1);
+    }
+    transform->status = xmlSecTransformStatusWorking;
+    transform->inNodes = nodes;
+
+    docOut = xmlSecXsltApplyToNodeSet(ctx, nodes);
+    if(docOut == NULL) {
+        xmlSecInternalError("xmlSecXsltApplyToNodeSet",
+                            xmlSecTransformGetName(transform));
+        return(-1);
+    }
+
+    ret = xmlSecXsltPushResult(transform, docOut, transformCtx);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecXsltPushResult",
+                            xmlSecTransformGetName(transform));
+        return(-1);
     }
 
+    transform->status = xmlSecTransformStatusFinished;
     return(0);
 }
 
+static int
+xmlSecXsltPopXml(xmlSecTransformPtr transform, xmlSecNodeSetPtr* nodes,
+                 xmlSecTransformCtxPtr transformCtx) {
+    xmlSecXsltCtxPtr ctx;
+    xmlDocPtr docOut;
+
+    xmlSecAssert2(xmlSecTransformCheckId(transform, xmlSecTransformXsltId), -1);
+    xmlSecAssert2(xmlSecTransformCheckSize(transform, xmlSecXsltSize), -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecXsltGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->xslt != NULL, -1);
+
+    if(transform->status == xmlSecTransformStatusNone) {
+        xmlSecAssert2(transform->outNodes == NULL, -1);
+
+        docOut = xmlSecXsltPopDoc(transform, transformCtx);
+        if(docOut == NULL) {
+            xmlSecInternalError("xmlSecXsltPopDoc",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+
+        transform->outNodes = xmlSecXsltResultToNodeSet(ctx, docOut);
+        if(transform->outNodes == NULL) {
+            xmlSecInternalError("xmlSecXsltResultToNodeSet",
+                                xmlSecTransformGetName(transform));
+            return(-1);
+        }
+
+        transform->status = xmlSecTransformStatusFinished;
+    } else if(transform->status != xmlSecTransformStatusFinished) {
+        xmlSecInvalidTransfromStatusError(transform);
+        return(-1);
+    }
+
+    /* return result if requested */
+    if(nodes != NULL) {
+        (*nodes) = transform->outNodes;
+    }
+    return(0);
+}
+
+static xmlDocPtr
+xmlSecXsltPopDoc(xmlSecTransformPtr transform, xmlSecTransformCtxPtr transformCtx) {
+    xmlSecXsltCtxPtr ctx;
+    xmlSecTransformDataType prevType;
+    xmlSecBufferPtr in;
+    xmlSecSize inSize, chunkSize;
+    xmlDocPtr docIn;
+    xmlDocPtr docOut;
+    int ret;
+
+    xmlSecAssert2(transform != NULL, NULL);
+    xmlSecAssert2(transform->prev != NULL, NULL);
+    xmlSecAssert2(transform->inNodes == NULL, NULL);
+    xmlSecAssert2(transformCtx != NULL, NULL);
+
+    ctx = xmlSecXsltGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, NULL);
+
+    prevType = xmlSecTransformGetDataType(transform->prev, xmlSecTransformModePop, transformCtx);
+    if((prevType & xmlSecTransformDataTypeXml) != 0) {
+        ret = xmlSecTransformPopXml(transform->prev, &(transform->inNodes), transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformPopXml",
+                                xmlSecTransformGetName(transform->prev));
+            return(NULL);
+        }
+        if(transform->inNodes == NULL) {
+            xmlSecInvalidTransfromStatusError(transform->prev);
+            return(NULL);
+        }
+        return(xmlSecXsltApplyToNodeSet(ctx, transform->inNodes));
+    }
+
+    /* read all the binary data from previous transform */
+    in = &(transform->inBuf);
+    do {
+        inSize = xmlSecBufferGetSize(in);
+
+        /* take all the data the previous transform has ready at once */
+        chunkSize = xmlSecBufferGetSize(&(transform->prev->outBuf));
+        if(chunkSize < XMLSEC_TRANSFORM_BINARY_CHUNK) {
+            chunkSize = XMLSEC_TRANSFORM_BINARY_CHUNK;
+        }
+
+        ret = xmlSecBufferSetMaxSize(in, inSize + chunkSize);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferSetMaxSize",
+                                 xmlSecTransformGetName(transform),
+                                 "size=%d", inSize + chunkSize);
+            return(NULL);
+        }
+
+        ret = xmlSecTransformPopBin(transform->prev, xmlSecBufferGetData(in) + inSize,
+                                    chunkSize, &chunkSize, transformCtx);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecTransformPopBin",
+                                xmlSecTransformGetName(transform->prev));
+            return(NULL);
+        }
+
+        ret = xmlSecBufferSetSize(in, inSize + chunkSize);
+        if(ret < 0) {
+            xmlSecInternalError2("xmlSecBufferSetSize",
+                                 xmlSecTransformGetName(transform),
+                                 "size=%d", inSize + chunkSize);
+            return(NULL);
+        }
+    } while(chunkSize > 0);
+
+    docIn = xmlSecParseMemory(xmlSecBufferGetData(in), xmlSecBufferGetSize(in), 1);
+    if(docIn == NULL) {
+        xmlSecInternalError("xmlSecParseMemory",
+                            xmlSecTransformGetName(transform));
+        return(NULL);
+    }
+    xmlSecBufferEmpty(in);
+
+    docOut = xmlSecXsApplyStylesheet(ctx, docIn);
+    if(docOut == NULL) {
+        xmlSecInternalError("xmlSecXsApplyStylesheet",
+                            xmlSecTransformGetName(transform));
+        xmlFreeDoc(docIn);
+        return(NULL);
+    }
+    xmlFreeDoc(docIn);
+
+    return(docOut);
+}
+
+static xmlDocPtr
+xmlSecXsltApplyToNodeSet(xmlSecXsltCtxPtr ctx, xmlSecNodeSetPtr nodes) {
+    xmlSecBufferPtr buffer;
+    xmlOutputBufferPtr output;
+    xmlDocPtr docIn;
+    xmlDocPtr docOut;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->xslt != NULL, NULL);
+    xmlSecAssert2(nodes != NULL, NULL);
+    xmlSecAssert2(nodes->doc != NULL, NULL);
+
+    if(xmlSecXsltIsCanonicalInput(ctx->xslt, nodes) != 0) {
+        /* the copy is equivalent to the re-parsed document (it does not have
+         * the IDs registered by the application either) without serializing
+         * and parsing it, and the stylesheet never touches the source document */
+        docIn = xmlCopyDoc(nodes->doc, 1);
+        if(docIn == NULL) {
+            xmlSecXmlError("xmlCopyDoc", NULL);
+            return(NULL);
+        }
+
+        docOut = xmlSecXsApplyStylesheet(ctx, docIn);
+        if(docOut == NULL) {
+            xmlSecInternalError("xmlSecXsApplyStylesheet", NULL);
+            xmlFreeDoc(docIn);
+            return(NULL);
+        }
+        xmlFreeDoc(docIn);
+
+        return(docOut);
+    }
+
+    /* canonicalize and re-parse the nodes set */
+    buffer = xmlSecBufferCreate(0);
+    if(buffer == NULL) {
+        xmlSecInternalError("xmlSecBufferCreate", NULL);
+        return(NULL);
+    }
+
+    output = xmlSecBufferCreateOutputBuffer(buffer);
+    if(output == NULL) {
+        xmlSecInternalError("xmlSecBufferCreateOutputBuffer", NULL);
+        xmlSecBufferDestroy(buffer);
+        return(NULL);
+    }
+
+    ret = xmlC14NExecute(nodes->doc, (xmlC14NIsVisibleCallback)xmlSecNodeSetContains,
+                         nodes, XML_C14N_1_0, NULL, 0, output);
+    if(ret < 0) {
+        xmlSecXmlError("xmlC14NExecute", NULL);
+        xmlOutputBufferClose(output);
+        xmlSecBufferDestroy(buffer);
+        return(NULL);
+    }
+
+    ret = xmlOutputBufferClose(output);
+    if(ret < 0) {
+        xmlSecXmlError("xmlOutputBufferClose", NULL);
+        xmlSecBufferDestroy(buffer);
+        return(NULL);
+    }
+
+    docIn = xmlSecParseMemory(xmlSecBufferGetData(buffer), xmlSecBufferGetSize(buffer), 0);
+    if(docIn == NULL) {
+        xmlSecInternalError("xmlSecParseMemory", NULL);
+        xmlSecBufferDestroy(buffer);
+        return(NULL);
+    }
+    xmlSecBufferDestroy(buffer);
+
+    docOut = xmlSecXsApplyStylesheet(ctx, docIn);
+    if(docOut == NULL) {
+        xmlSecInternalError("xmlSecXsApplyStylesheet", NULL);
+        xmlFreeDoc(docIn);
+        return(NULL);
+    }
+    xmlFreeDoc(docIn);
+
+    return(docOut);
+}
+
+/* takes ownership of docOut */
+static int
+xmlSecXsltPushResult(xmlSecTransformPtr transform, xmlDocPtr docOut,
+                     xmlSecTransformCtxPtr transformCtx) {
+    xmlSecXsltCtxPtr ctx;
+    xmlSecTransformDataType nextType;
+    xmlOutputBufferPtr output;
+    int ret;
+
+    xmlSecAssert2(transform != NULL, -1);
+    xmlSecAssert2(transform->outNodes == NULL, -1);
+    xmlSecAssert2(docOut != NULL, -1);
+    xmlSecAssert2(transformCtx != NULL, -1);
+
+    ctx = xmlSecXsltGetCtx(transform);
+    xmlSecAssert2(ctx != NULL, -1);
+
+    if(transform->next != NULL) {
+        /* the binary output is preferred if the next transform accepts both */
+        nextType = xmlSecTransformGetDataType(transform->next, xmlSecTransformModePush, transformCtx);
+        if(((nextType & xmlSecTransformDataTypeBin) == 0) &&
+           ((nextType & xmlSecTransformDataTypeXml) != 0)) {
+
+            transform->outNodes = xmlSecXsltResultToNodeSet(ctx, docOut);
+            if(transform->outNodes == NULL) {
+                xmlSecInternalError("xmlSecXsltResultToNodeSet",
+                                    xmlSecTransformGetName(transform));
+                return(-1);
+            }
+
+            ret = xmlSecTransformPushXml(transform->next, transform->outNodes, transformCtx);
+            if(ret < 0) {
+                xmlSecInternalError("xmlSecTransformPushXml",
+                                    xmlSecTransformGetName(transform));
+                return(-1);
+            }
+            return(0);
+        }
+
+        output = xmlSecTransformCreateOutputBuffer(transform->next, transformCtx);
+        if(output == NULL) {
+            xmlSecInternalError("xmlSecTransformCreateOutputBuffer",
+                                xmlSecTransformGetName(transform));
+            xmlFreeDoc(docOut);
+            return(-1);
+        }
+    } else {
+        output = xmlSecBufferCreateOutputBuffer(&(transform->outBuf));
+        if(output == NULL) {
+            xmlSecInternalError("xmlSecBufferCreateOutputBuffer",
+                                xmlSecTransformGetName(transform));
+            xmlFreeDoc(docOut);
+            return(-1);
+        }
+    }
+
+    ret = xmlSecXsltSaveResult(ctx, docOut, output);
+    if(ret < 0) {
+        xmlSecInternalError("xmlSecXsltSaveResult",
+                            xmlSecTransformGetName(transform));
+        xmlFreeDoc(docOut);
+        return(-1);
+    }
+    xmlFreeDoc(docOut);
+
+    return(0);
+}
+
+/* takes ownership of docOut */
+static xmlSecNodeSetPtr
+xmlSecXsltResultToNodeSet(xmlSecXsltCtxPtr ctx, xmlDocPtr docOut) {
+    xmlSecBufferPtr buffer;
+    xmlOutputBufferPtr output;
+    xmlSecNodeSetPtr nodes;
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, NULL);
+    xmlSecAssert2(ctx->xslt != NULL, NULL);
+    xmlSecAssert2(docOut != NULL, NULL);
+
+    if(xmlSecXsltIsCanonicalResult(ctx->xslt, docOut) == 0) {
+        /* serialize and re-parse the result */
+        buffer = xmlSecBufferCreate(0);
+        if(buffer == NULL) {
+            xmlSecInternalError("xmlSecBufferCreate", NULL);
+            xmlFreeDoc(docOut);
+            return(NULL);
+        }
+
+        output = xmlSecBufferCreateOutputBuffer(buffer);
+        if(output == NULL) {
+            xmlSecInternalError("xmlSecBufferCreateOutputBuffer", NULL);
+            xmlSecBufferDestroy(buffer);
+            xmlFreeDoc(docOut);
+            return(NULL);
+        }
+
+        ret = xmlSecXsltSaveResult(ctx, docOut, output);
+        xmlFreeDoc(docOut);
+        if(ret < 0) {
+            xmlSecInternalError("xmlSecXsltSaveResult", NULL);
+            xmlSecBufferDestroy(buffer);
+            return(NULL);
+        }
+
+        docOut = xmlSecParseMemory(xmlSecBufferGetData(buffer), xmlSecBufferGetSize(buffer), 0);
+        if(docOut == NULL) {
+            xmlSecInternalError("xmlSecParseMemory", NULL);
+            xmlSecBufferDestroy(buffer);
+            return(NULL);
+        }
+        xmlSecBufferDestroy(buffer);
+    }
+
+    nodes = xmlSecNodeSetCreate(docOut, NULL, xmlSecNodeSetTree);
+    if(nodes == NULL) {
+        xmlSecInternalError("xmlSecNodeSetCreate", NULL);
+        xmlFreeDoc(docOut);
+        return(NULL);
+    }
+    xmlSecNodeSetDocDestroy(nodes);
+
+    return(nodes);
+}
+
+/* always closes the output */
+static int
+xmlSecXsltSaveResult(xmlSecXsltCtxPtr ctx, xmlDocPtr doc, xmlOutputBufferPtr output) {
+    int ret;
+
+    xmlSecAssert2(ctx != NULL, -1);
+    xmlSecAssert2(ctx->xslt != NULL, -1);
+    xmlSecAssert2(doc != NULL, -1);
+    xmlSecAssert2(output != NULL, -1);
+
+    ret = xsltSaveResultTo(output, doc, ctx->xslt);
+    if(ret < 0) {
+        xmlSecXsltError("xsltSaveResultTo", ctx->xslt, NULL);
+        xmlOutputBufferClose(output);
+        return(-1);
+    }
+
+    ret = xmlOutputBufferClose(output);
+    if(ret < 0) {
+        xmlSecXmlError("xmlOutputBufferClose", NULL);
+        return(-1);
+    }
+    return(0);
+}
+
+/*
+ * Returns 1 if canonicalizing and re-parsing the nodes set does not change
+ * the document as seen by the stylesheet: the whole document without DTD,
+ * comments, CDATA sections, entity references, empty or adjacent text nodes,
+ * superfluous namespace declarations and with attributes and namespace
+ * declarations already in the c14n order.
+ */
+static int
+xmlSecXsltIsCanonicalInput(xsltStylesheetPtr xslt, xmlSecNodeSetPtr nodes) {
+    xsltStylesheetPtr style;
+    xmlDocPtr doc;
+    xmlNodePtr cur;
+
+    xmlSecAssert2(xslt != NULL, 0);
+    xmlSecAssert2(nodes != NULL, 0);
+
+    doc = nodes->doc;
+    if((doc == NULL) || (doc->type != XML_DOCUMENT_NODE)) {
+        return(0);
+    }
+    if((doc->intSubset != NULL) || (doc->extSubset != NULL)) {
+        return(0);
+    }
+    if(xmlSecNodeSetIsWholeDocument(nodes) != 1) {
+        return(0);
+    }
+
+    /* xsl:strip-space modifies the source document */
+    for(style = xslt; style != NULL; style = xsltNextImport(style)) {
+        if((style->stripSpaces != NULL) || (style->stripAll != 0)) {
+            return(0);
+        }
+    }
+
+    for(cur = doc->children; cur != NULL; ) {
+        switch(cur->type) {
+        case XML_ELEMENT_NODE:
+            if(xmlSecXsltIsCanonicalElement(cur) == 0) {
+                return(0);
+            }
+            break;
+        case XML_TEXT_NODE:
+            if((cur->name == xmlStringTextNoenc) || (cur->content == NULL) || (cur->content[0] == '\0')) {
+                return(0);
+            }
+            if((cur->prev != NULL) && (cur->prev->type == XML_TEXT_NODE)) {
+                return(0);
+            }
+            break;
+        case XML_PI_NODE:
+            break;
+        default:
+            return(0);
+        }
+
+        /* next node in the document order */
+        if((cur->type == XML_ELEMENT_NODE) && (cur->children != NULL)) {
+            cur = cur->children;
+            continue;
+        }
+        while((cur->next == NULL) && (cur->parent != NULL) && (cur->parent != (xmlNodePtr)doc)) {
+            cur = cur->parent;
+        }
+        cur = cur->next;
+    }
+
+    return(1);
+}
+
+static int
+xmlSecXsltIsCanonicalElement(xmlNodePtr node) {
+    xmlAttrPtr attr;
+    xmlAttrPtr prevAttr = NULL;
+    xmlNsPtr ns;
+    xmlNsPtr prevNs = NULL;
+    xmlNsPtr visibleNs;
+    xmlURIPtr uri;
+    int absolute;
+
+    xmlSecAssert2(node != NULL, 0);
+
+    for(ns = node->nsDef; ns != NULL; ns = ns->next) {
+        if((prevNs != NULL) && (xmlStrcmp(prevNs->prefix, ns->prefix) >= 0)) {
+            return(0);
+        }
+        if(xmlStrEqual(ns->prefix, BAD_CAST "xml")) {
+            return(0);
+        }
+
+        visibleNs = NULL;
+        if((node->parent != NULL) && (node->parent->type == XML_ELEMENT_NODE)) {
+            visibleNs = xmlSearchNs(node->doc, node->parent, ns->prefix);
+        }
+        if((ns->href == NULL) || (ns->href[0] == '\0')) {
+            /* xmlns="" is rendered only if it undeclares the default namespace */
+            if((visibleNs == NULL) || (visibleNs->href == NULL) || (visibleNs->href[0] == '\0')) {
+                return(0);
+            }
+        } else {
+            if((visibleNs != NULL) && xmlStrEqual(visibleNs->href, ns->href)) {
+                return(0);
+            }
+
+            /* c14n fails on relative namespace URIs */
+            uri = xmlParseURI((const char*)ns->href);
+            if(uri == NULL) {
+                return(0);
+            }
+            absolute = (uri->scheme != NULL) ? 1 : 0;
+            xmlFreeURI(uri);
+            if(absolute == 0) {
+                return(0);
+            }
+        }
+        prevNs = ns;
+    }
+
+    for(attr = node->properties; attr != NULL; attr = attr->next) {
+        if((attr->children != NULL) &&
+           ((attr->children->type != XML_TEXT_NODE) || (attr->children->next != NULL))) {
+            return(0);
+        }
+        if((attr->ns != NULL) && xmlStrEqual(attr->ns->href, XML_XML_NAMESPACE) &&
+           xmlStrEqual(attr->name, BAD_CAST "id")) {
+            return(0);
+        }
+        if((prevAttr != NULL) && (xmlSecXsltAttrCompare(prevAttr, attr) >= 0)) {
+            return(0);
+        }
+        prevAttr = attr;
+    }
+
+    return(1);
+}
+
+/* the c14n attributes order: no namespace first, then by namespace URI and local name */
+static int
+xmlSecXsltAttrCompare(xmlAttrPtr attr1, xmlAttrPtr attr2) {
+    int ret;
+
+    xmlSecAssert2(attr1 != NULL, 0);
+    xmlSecAssert2(attr2 != NULL, 0);
+
+    if(attr1->ns == attr2->ns) {
+        return(xmlStrcmp(attr1->name, attr2->name));
+    }
+    if(attr1->ns == NULL) {
+        return(-1);
+    }
+    if(attr2->ns == NULL) {
+        return(1);
+    }
+    ret = xmlStrcmp(attr1->ns->href, attr2->ns->href);
+    if(ret == 0) {
+        ret = xmlStrcmp(attr1->name, attr2->name);
+    }
+    return(ret);
+}
+
+/*
+ * Returns 1 if serializing and re-parsing the result document does not
+ * change it: the default xml output method without indentation, doctype
+ * or CDATA sections, a single document element, no empty, adjacent or
+ * unescaped text nodes and all the namespaces resolvable by prefix.
+ */
+static int
+xmlSecXsltIsCanonicalResult(xsltStylesheetPtr xslt, xmlDocPtr doc) {
+    const xmlChar* method;
+    const xmlChar* methodURI;
+    const xmlChar* doctypePublic;
+    const xmlChar* doctypeSystem;
+    int indent;
+    xsltStylesheetPtr style;
+    xmlNodePtr cur;
+    xmlNodePtr child;
+    xmlAttrPtr attr;
+    xmlNsPtr ns;
+    int elements = 0;
+
+    xmlSecAssert2(xslt != NULL, 0);
+    xmlSecAssert2(doc != NULL, 0);
+
+    if(doc->type != XML_DOCUMENT_NODE) {
+        return(0);
+    }
+
+    XSLT_GET_IMPORT_PTR(method, xslt, method)
+    XSLT_GET_IMPORT_PTR(methodURI, xslt, methodURI)
+    if((methodURI != NULL) || ((method != NULL) && !xmlStrEqual(method, BAD_CAST "xml"))) {
+        return(0);
+    }
+    XSLT_GET_IMPORT_PTR(doctypePublic, xslt, doctypePublic)
+    XSLT_GET_IMPORT_PTR(doctypeSystem, xslt, doctypeSystem)
+    if((doctypePublic != NULL) || (doctypeSystem != NULL)) {
+        return(0);
+    }
+    XSLT_GET_IMPORT_INT(indent, xslt, indent)
+    if(indent == 1) {
+        return(0);
+    }
+    for(style = xslt; style != NULL; style = xsltNextImport(style)) {
+        if(style->cdataSection != NULL) {
+            return(0);
+        }
+    }
+
+    for(cur = doc->children; cur != NULL; ) {
+        switch(cur->type) {
+        case XML_ELEMENT_NODE:
+            if(cur->parent == (xmlNodePtr)doc) {
+                ++elements;
+            }
+
+            ns = xmlSearchNs(doc, cur, (cur->ns != NULL) ? cur->ns->prefix : NULL);
+            if(cur->ns != NULL) {
+                if((ns == NULL) || !xmlStrEqual(ns->href, cur->ns->href)) {
+                    return(0);
+                }
+            } else if((ns != NULL) && (ns->href != NULL) && (ns->href[0] != '\0')) {
+                return(0);
+            }
+
+            for(attr = cur->properties; attr != NULL; attr = attr->next) {
+                if(attr->ns != NULL) {
+                    if(attr->ns->prefix == NULL) {
+                        return(0);
+                    }
+                    ns = xmlSearchNs(doc, cur, attr->ns->prefix);
+                    if((ns == NULL) || !xmlStrEqual(ns->href, attr->ns->href)) {
+                        return(0);
+                    }
+                    /* xml:id attributes are IDs in the re-parsed document */
+                    if(xmlStrEqual(attr->ns->href, XML_XML_NAMESPACE) && xmlStrEqual(attr->name, BAD_CAST "id")) {
+                        return(0);
+                    }
+                }
+                for(child = attr->children; child != NULL; child = child->next) {
+                    if(child->type != XML_TEXT_NODE) {
+                        return(0);
+                    }
+                }
+            }
+            break;
+        case XML_TEXT_NODE:
+            if(cur->parent == (xmlNodePtr)doc) {
+                return(0);
+            }
+            if((cur->name == xmlStringTextNoenc) || (cur->content == NULL) || (cur->content[0] == '\0')) {
+                return(0);
+            }
+            if((cur->prev != NULL) && (cur->prev->type == XML_TEXT_NODE)) {
+                return(0);
+            }
+            break;
+        case XML_COMMENT_NODE:
+        case XML_PI_NODE:
+            break;
+        default:
+            return(0);
+        }
+
+        /* next node in the document order */
+        if((cur->type == XML_ELEMENT_NODE) && (cur->children != NULL)) {
+            cur = cur->children;
+            continue;
+        }
+        while((cur->next == NULL) && (cur->parent != NULL) && (cur->parent != (xmlNodePtr)doc)) {
+            cur = cur->parent;
+        }
+        cur = cur->next;
+    }
+
+    return((elements == 1) ? 1 : 0);
+}
+
 static int
 xmlSecXsltExecute(xmlSecTransformPtr transform, int last, xmlSecTransformCtxPtr transformCtx) {
     xmlSecXsltCtxPtr ctx;
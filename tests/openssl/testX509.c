@@ -0,0 +1,420 @@
+/**
+ * XML Security Library tests: OpenSSL X509 certificates and store
+ *
+ * Checks the OpenSSL X509 store and certificates functions that can
+ * not be reached with the xmlsec1 application.
+ *
+ * Usage:
+ *      testX509 <keys-folder>
+ *
+ * Example:
+ *      ./testX509 ../keys
+ *
+ * This is free software; see Copyright file in the source
+ * distribution for preciese wording.
+ *
+ * Copyright (C) 2002-2016 Aleksey Sanin <aleksey@aleksey.com>. All Rights Reserved.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <libxml/tree.h>
+#include <libxml/xmlmemory.h>
+#include <libxml/parser.h>
+
+#include <openssl/bio.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include <xmlsec/xmlsec.h>
+#include <xmlsec/buffer.h>
+#include <xmlsec/keys.h>
+#include <xmlsec/keyinfo.h>
+#include <xmlsec/keysmngr.h>
+#include <xmlsec/errors.h>
+#include <xmlsec/openssl/app.h>
+#include <xmlsec/openssl/crypto.h>
+#include <xmlsec/openssl/x509.h>
+
+static int      testFailures = 0;
+
+static void     testCheck                       (const char* name,
+                                                 int ok);
+static X509*    testLoadCert                    (const char* folder,
+                                                 const char* filename);
+static X509_CRL* testLoadCrl                    (const char* folder,
+                                                 const char* filename);
+static void     testX509StoreVerifyCache        (const char* folder);
+static void     testX509CertsCache              (const char* folder);
+static void     testX509CertsCacheShutdown      (void);
+static xmlSecKeyPtr testReadRawCert             (xmlSecBufferPtr buffer,
+                                                 xmlSecKeyInfoCtxPtr keyInfoCtx);
+static X509*    testGetKeyCert                  (xmlSecKeyPtr key);
+
+int
+main(int argc, char **argv) {
+    if(argc != 2) {
+        fprintf(stderr, "Error: wrong number of arguments.\n");
+        fprintf(stderr, "Usage: %s <keys-folder>\n", argv[0]);
+        return(1);
+    }
+
+    /* Init libxml library */
+    xmlInitParser();
+    LIBXML_TEST_VERSION
+
+    /* Init xmlsec library */
+    if(xmlSecInit() < 0) {
+        fprintf(stderr, "Error: xmlsec initialization failed.\n");
+        return(1);
+    }
+    if(xmlSecCheckVersion() != 1) {
+        fprintf(stderr, "Error: loaded xmlsec library version is not compatible.\n");
+        return(1);
+    }
+
+    /* Init OpenSSL and xmlsec-openssl libraries */
+    if(xmlSecOpenSSLAppInit(NULL) < 0) {
+        fprintf(stderr, "Error: crypto initialization failed.\n");
+        return(1);
+    }
+    if(xmlSecOpenSSLInit() < 0) {
+        fprintf(stderr, "Error: xmlsec-openssl initialization failed.\n");
+        return(1);
+    }
+
+    testX509StoreVerifyCache(argv[1]);
+    testX509CertsCache(argv[1]);
+
+    /* Shutdown xmlsec-openssl, OpenSSL and xmlsec libraries */
+    xmlSecOpenSSLShutdown();
+    testX509CertsCacheShutdown();
+    xmlSecOpenSSLAppShutdown();
+    xmlSecShutdown();
+
+    /* Shutdown libxml */
+    xmlCleanupParser();
+
+    if(testFailures > 0) {
+        fprintf(stdout, "TOTAL FAILED: %d\n", testFailures);
+        return(1);
+    }
+    fprintf(stdout, "ALL TESTS PASSED\n");
+    return(0);
+}
+
+static void
+testCheck(const char* name, int ok) {
+    if(ok) {
+        fprintf(stdout, "Test: %-70s Success\n", name);
+    } else {
+        fprintf(stdout, "Test: %-70s Fail\n", name);
+        ++testFailures;
+    }
+}
+
+static X509*
+testLoadCert(const char* folder, const char* filename) {
+    char path[1024];
+    BIO* bio;
+    X509* cert;
+
+    snprintf(path, sizeof(path), "%s/%s", folder, filename);
+    bio = BIO_new_file(path, "r");
+    if(bio == NULL) {
+        fprintf(stderr, "Error: failed to open file \"%s\".\n", path);
+        return(NULL);
+    }
+    cert = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+    if(cert == NULL) {
+        fprintf(stderr, "Error: failed to read certificate from \"%s\".\n", path);
+    }
+    BIO_free(bio);
+    return(cert);
+}
+
+static X509_CRL*
+testLoadCrl(const char* folder, const char* filename) {
+    char path[1024];
+    BIO* bio;
+    X509_CRL* crl;
+
+    snprintf(path, sizeof(path), "%s/%s", folder, filename);
+    bio = BIO_new_file(path, "r");
+    if(bio == NULL) {
+        fprintf(stderr, "Error: failed to open file \"%s\".\n", path);
+        return(NULL);
+    }
+    crl = PEM_read_bio_X509_CRL(bio, NULL, NULL, NULL);
+    if(crl == NULL) {
+        fprintf(stderr, "Error: failed to read CRL from \"%s\".\n", path);
+    }
+    BIO_free(bio);
+    return(crl);
+}
+
+/*
+ * Verifies rsacert.pem (issued by ca2cert.pem, issued by cacert.pem)
+ * with the verification cache enabled, then adopts ca2crl.pem (issued
+ * by ca2cert.pem, revokes rsacert.pem) and checks that the cached
+ * result is not used anymore. Both CA certs are trusted: the store
+ * verifies the adopted CRLs against the trusted certs.
+ */
+static void
+testX509StoreVerifyCache(const char* folder) {
+    xmlSecKeyDataStorePtr store = NULL;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    STACK_OF(X509)* certs = NULL;
+    X509* cacert = NULL;
+    X509* ca2cert = NULL;
+    X509* rsacert = NULL;
+    X509_CRL* crl = NULL;
+    X509* res;
+    int ret;
+
+    ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, NULL);
+    if(ret < 0) {
+        testCheck("verify cache: key info ctx initialization", 0);
+        return;
+    }
+
+    store = xmlSecKeyDataStoreCreate(xmlSecOpenSSLX509StoreId);
+    cacert = testLoadCert(folder, "cacert.pem");
+    ca2cert = testLoadCert(folder, "ca2cert.pem");
+    rsacert = testLoadCert(folder, "rsacert.pem");
+    crl = testLoadCrl(folder, "ca2crl.pem");
+    certs = sk_X509_new_null();
+    if((store == NULL) || (cacert == NULL) || (ca2cert == NULL) ||
+       (rsacert == NULL) || (crl == NULL) || (certs == NULL)) {
+        testCheck("verify cache: test data", 0);
+        goto done;
+    }
+
+    /* the store owns cacert and ca2cert now */
+    ret = xmlSecOpenSSLX509StoreAdoptCert(store, cacert, xmlSecKeyDataTypeTrusted);
+    if(ret < 0) {
+        testCheck("verify cache: adopt trusted cert", 0);
+        goto done;
+    }
+    cacert = NULL;
+    ret = xmlSecOpenSSLX509StoreAdoptCert(store, ca2cert, xmlSecKeyDataTypeTrusted);
+    if(ret < 0) {
+        testCheck("verify cache: adopt trusted cert", 0);
+        goto done;
+    }
+    ca2cert = NULL;
+
+    /* the certs stack owns rsacert now */
+    if(sk_X509_push(certs, rsacert) <= 0) {
+        testCheck("verify cache: test data", 0);
+        goto done;
+    }
+    rsacert = NULL;
+
+    ret = xmlSecOpenSSLX509StoreSetVerifyCacheSize(store, 16);
+    testCheck("verify cache: enable", ret == 0);
+
+    /* the first verification fills the cache, the second one finds it */
+    res = xmlSecOpenSSLX509StoreVerify(store, certs, NULL, &keyInfoCtx);
+    testCheck("verify cache: verify the chain", res == sk_X509_value(certs, 0));
+    res = xmlSecOpenSSLX509StoreVerify(store, certs, NULL, &keyInfoCtx);
+    testCheck("verify cache: verify the same chain again", res == sk_X509_value(certs, 0));
+
+    /* a new CRL flushes the cache: the chain is verified again and rejected */
+    ret = xmlSecOpenSSLX509StoreAdoptCrl(store, crl);
+    testCheck("verify cache: adopt CRL", ret == 0);
+    if(ret == 0) {
+        crl = NULL;
+    }
+
+    xmlSecErrorsDefaultCallbackEnableOutput(0);
+    res = xmlSecOpenSSLX509StoreVerify(store, certs, NULL, &keyInfoCtx);
+    testCheck("verify cache: revoked cert is rejected after adopting CRL", res == NULL);
+    res = xmlSecOpenSSLX509StoreVerify(store, certs, NULL, &keyInfoCtx);
+    testCheck("verify cache: revoked cert is not cached", res == NULL);
+
+    /* and the same without the cache */
+    ret = xmlSecOpenSSLX509StoreSetVerifyCacheSize(store, 0);
+    testCheck("verify cache: disable", ret == 0);
+    res = xmlSecOpenSSLX509StoreVerify(store, certs, NULL, &keyInfoCtx);
+    testCheck("verify cache: revoked cert is rejected without cache", res == NULL);
+    xmlSecErrorsDefaultCallbackEnableOutput(1);
+
+done:
+    if(certs != NULL) {
+        sk_X509_pop_free(certs, X509_free);
+    }
+    if(crl != NULL) {
+        X509_CRL_free(crl);
+    }
+    if(rsacert != NULL) {
+        X509_free(rsacert);
+    }
+    if(ca2cert != NULL) {
+        X509_free(ca2cert);
+    }
+    if(cacert != NULL) {
+        X509_free(cacert);
+    }
+    if(store != NULL) {
+        xmlSecKeyDataStoreDestroy(store);
+    }
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+}
+
+/*
+ * Reads rsacert.der twice with the certificates cache enabled: the second
+ * read must be a cache hit and return the same certificate. The keys
+ * must keep their certificates after the cache is flushed.
+ */
+static void
+testX509CertsCache(const char* folder) {
+    xmlSecKeysMngrPtr mngr = NULL;
+    xmlSecKeyInfoCtx keyInfoCtx;
+    xmlSecBufferPtr buffer = NULL;
+    xmlSecKeyPtr key1 = NULL;
+    xmlSecKeyPtr key2 = NULL;
+    X509* expected = NULL;
+    const xmlSecByte* p;
+    char path[1024];
+    xmlSecSize size, hits, misses;
+    xmlSecSize hits0, misses0;
+    int ret;
+
+    mngr = xmlSecKeysMngrCreate();
+    if(mngr == NULL) {
+        testCheck("certs cache: keys manager creation", 0);
+        return;
+    }
+    ret = xmlSecOpenSSLAppDefaultKeysMngrInit(mngr);
+    if(ret < 0) {
+        testCheck("certs cache: keys manager initialization", 0);
+        xmlSecKeysMngrDestroy(mngr);
+        return;
+    }
+    ret = xmlSecKeyInfoCtxInitialize(&keyInfoCtx, mngr);
+    if(ret < 0) {
+        testCheck("certs cache: key info ctx initialization", 0);
+        xmlSecKeysMngrDestroy(mngr);
+        return;
+    }
+    /* the chain is not checked here */
+    keyInfoCtx.flags |= XMLSEC_KEYINFO_FLAGS_X509DATA_DONT_VERIFY_CERTS;
+
+    snprintf(path, sizeof(path), "%s/%s", folder, "rsacert.der");
+    buffer = xmlSecBufferCreate(0);
+    if((buffer == NULL) || (xmlSecBufferReadFile(buffer, path) < 0)) {
+        testCheck("certs cache: test data", 0);
+        goto done;
+    }
+    p = xmlSecBufferGetData(buffer);
+    expected = d2i_X509(NULL, &p, (long)xmlSecBufferGetSize(buffer));
+    if(expected == NULL) {
+        testCheck("certs cache: test data", 0);
+        goto done;
+    }
+
+    xmlSecOpenSSLX509CertsCacheSetMaxSize(16);
+    xmlSecOpenSSLX509CertsCacheGetStats(&size, &hits0, &misses0);
+    testCheck("certs cache: empty", size == 0);
+
+    /* the first read parses the cert, the second one finds it */
+    key1 = testReadRawCert(buffer, &keyInfoCtx);
+    xmlSecOpenSSLX509CertsCacheGetStats(&size, &hits, &misses);
+    testCheck("certs cache: miss", (key1 != NULL) && (size == 1) &&
+                                   (hits == hits0) && (misses == misses0 + 1));
+    key2 = testReadRawCert(buffer, &keyInfoCtx);
+    xmlSecOpenSSLX509CertsCacheGetStats(&size, &hits, &misses);
+    testCheck("certs cache: hit", (key2 != NULL) && (size == 1) &&
+                                  (hits == hits0 + 1) && (misses == misses0 + 1));
+    if((key1 == NULL) || (key2 == NULL)) {
+        goto done;
+    }
+
+    testCheck("certs cache: hit returns the same cert",
+              (testGetKeyCert(key2) != NULL) &&
+              (testGetKeyCert(key2) == testGetKeyCert(key1)) &&
+              (X509_cmp(testGetKeyCert(key2), expected) == 0));
+    testCheck("certs cache: hit returns the same public key",
+              (xmlSecKeyGetValue(key1) != NULL) && (xmlSecKeyGetValue(key2) != NULL) &&
+              (xmlSecKeyGetType(key1) == xmlSecKeyGetType(key2)) &&
+              (xmlSecKeyDataGetSize(xmlSecKeyGetValue(key1)) ==
+               xmlSecKeyDataGetSize(xmlSecKeyGetValue(key2))));
+
+    /* the keys keep their references when the cache is flushed */
+    xmlSecOpenSSLX509CertsCacheSetMaxSize(0);
+    xmlSecOpenSSLX509CertsCacheGetStats(&size, NULL, NULL);
+    testCheck("certs cache: flushed when disabled", size == 0);
+    xmlSecKeyDestroy(key1);
+    key1 = NULL;
+    testCheck("certs cache: cert is valid after flush",
+              (testGetKeyCert(key2) != NULL) &&
+              (X509_cmp(testGetKeyCert(key2), expected) == 0));
+
+    /* the cache is filled again for the shutdown test */
+    xmlSecOpenSSLX509CertsCacheSetMaxSize(16);
+    xmlSecKeyDestroy(key2);
+    key2 = testReadRawCert(buffer, &keyInfoCtx);
+    xmlSecOpenSSLX509CertsCacheGetStats(&size, NULL, NULL);
+    testCheck("certs cache: filled again", (key2 != NULL) && (size == 1));
+
+done:
+    if(key2 != NULL) {
+        xmlSecKeyDestroy(key2);
+    }
+    if(key1 != NULL) {
+        xmlSecKeyDestroy(key1);
+    }
+    if(expected != NULL) {
+        X509_free(expected);
+    }
+    if(buffer != NULL) {
+        xmlSecBufferDestroy(buffer);
+    }
+    xmlSecKeyInfoCtxFinalize(&keyInfoCtx);
+    xmlSecKeysMngrDestroy(mngr);
+}
+
+/*
+ * Called after xmlSecOpenSSLShutdown(): the cached certs are released
+ * (the leaks checkers report them otherwise).
+ */
+static void
+testX509CertsCacheShutdown(void) {
+    xmlSecSize size = 1;
+
+    xmlSecOpenSSLX509CertsCacheGetStats(&size, NULL, NULL);
+    testCheck("certs cache: released on shutdown", size == 0);
+}
+
+static xmlSecKeyPtr
+testReadRawCert(xmlSecBufferPtr buffer, xmlSecKeyInfoCtxPtr keyInfoCtx) {
+    xmlSecKeyPtr key;
+    int ret;
+
+    key = xmlSecKeyCreate();
+    if(key == NULL) {
+        return(NULL);
+    }
+    ret = xmlSecKeyDataBinRead(xmlSecOpenSSLKeyDataRawX509CertId, key,
+                               xmlSecBufferGetData(buffer),
+                               xmlSecBufferGetSize(buffer),
+                               keyInfoCtx);
+    if(ret < 0) {
+        xmlSecKeyDestroy(key);
+        return(NULL);
+    }
+    return(key);
+}
+
+static X509*
+testGetKeyCert(xmlSecKeyPtr key) {
+    xmlSecKeyDataPtr data;
+
+    data = xmlSecKeyGetData(key, xmlSecOpenSSLKeyDataX509Id);
+    if(data == NULL) {
+        return(NULL);
+    }
+    return(xmlSecOpenSSLKeyDataX509GetKeyCert(data));
+}
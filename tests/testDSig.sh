@@ -475,6 +475,21 @@ execDSigTest $res_success \
     "$priv_key_option $topfolder/keys/rsakey.$priv_key_format --pwd secret123" \
     "--trusted-$cert_format $topfolder/keys/cacert.$cert_format --untrusted-$cert_format $topfolder/keys/ca2cert.$cert_format  --untrusted-$cert_format $topfolder/keys/rsacert.$cert_format --enabled-key-data x509"
 
+# XSLT transform on the XML input: the whole document is copied (xslt-*) or
+# the nodes set is canonicalized and re-parsed (xpath-xslt-*); the result is
+# used as is or serialized and re-parsed (*-indent-*). The signatures were
+# created by serializing and re-parsing in all the cases.
+for xslt_test in xslt-c14n xslt-indent-c14n xpath-xslt-c14n xpath-xslt-indent-c14n ; do
+    execDSigTest $res_success \
+        "" \
+        "aleksey-xmldsig-01/$xslt_test-hmac-sha1" \
+        "xpath xslt c14n sha1 hmac-sha1" \
+        "hmac" \
+        "--hmackey $topfolder/keys/hmackey.bin" \
+        "--hmackey $topfolder/keys/hmackey.bin" \
+        "--hmackey $topfolder/keys/hmackey.bin"
+done
+
 ##########################################################################
 #
 # merlin-xmldsig-twenty-three
@@ -899,6 +914,111 @@ execDSigTest $res_success \
     "--trusted-$cert_format certs/rsa-ca-cert.$cert_format --X509-skip-strict-checks --verification-time 2009-01-01+10:00:00"
 
 
+##########################################################################
+#
+# parallel references: the same results as the sequential processing
+#
+##########################################################################
+
+execDSigCompareTest $res_success \
+    "" \
+    "merlin-c14n-three/signature" \
+    "c14n c14n-with-comments exc-c14n exc-c14n-with-comments xpath sha1 dsa-sha1" \
+    "dsa" \
+    "" \
+    "--parallel-references"
+
+execDSigCompareTest $res_success \
+    "" \
+    "merlin-xmldsig-twenty-three/signature" \
+    "base64 xpath xslt enveloped-signature c14n-with-comments sha1 dsa-sha1" \
+    "dsa x509" \
+    "--trusted-$cert_format $topfolder/merlin-xmldsig-twenty-three/certs/merlin.$cert_format --verification-time 2005-01-01+10:00:00 $url_map_xml_stylesheet_2005 $url_map_xml_stylesheet_b64_2005" \
+    "--parallel-references"
+
+execDSigCompareTest $res_success \
+    "" \
+    "merlin-exc-c14n-one/exc-signature" \
+    "exc-c14n sha1 dsa-sha1" \
+    "dsa" \
+    "" \
+    "--parallel-references"
+
+execDSigCompareTest $res_success \
+    "" \
+    "merlin-xpath-filter2-three/sign-spec" \
+    "enveloped-signature xpath2 sha1 dsa-sha1" \
+    "dsa" \
+    "" \
+    "--parallel-references"
+
+execDSigCompareTest $res_fail \
+    "phaos-xmldsig-three" \
+    "signature-rsa-enveloped-bad-digest-val" \
+    "enveloped-signature sha1 rsa-sha1" \
+    "rsa x509" \
+    "--trusted-$cert_format certs/rsa-ca-cert.$cert_format" \
+    "--parallel-references"
+
+execDSigCompareTest $res_fail \
+    "" \
+    "aleksey-xmldsig-01/enveloping-sha1-hmac-sha1-missing-id" \
+    "sha1 hmac-sha1" \
+    "hmac" \
+    "--hmackey $topfolder/keys/hmackey.bin" \
+    "--parallel-references"
+
+##########################################################################
+#
+# verify SignatureValue first: the same results for the good signatures,
+# no references are processed for the bad ones
+#
+##########################################################################
+
+execDSigCompareTest $res_success \
+    "" \
+    "merlin-c14n-three/signature" \
+    "c14n c14n-with-comments exc-c14n exc-c14n-with-comments xpath sha1 dsa-sha1" \
+    "dsa" \
+    "" \
+    "--verify-signature-first"
+
+execDSigCompareTest $res_success \
+    "" \
+    "merlin-xmldsig-twenty-three/signature" \
+    "base64 xpath xslt enveloped-signature c14n-with-comments sha1 dsa-sha1" \
+    "dsa x509" \
+    "--trusted-$cert_format $topfolder/merlin-xmldsig-twenty-three/certs/merlin.$cert_format --verification-time 2005-01-01+10:00:00 $url_map_xml_stylesheet_2005 $url_map_xml_stylesheet_b64_2005" \
+    "--verify-signature-first"
+
+execDSigCompareTest $res_success \
+    "" \
+    "aleksey-xmldsig-01/enveloping-sha1-hmac-sha1" \
+    "sha1 hmac-sha1" \
+    "hmac" \
+    "--hmackey $topfolder/keys/hmackey.bin" \
+    "--verify-signature-first"
+
+# the reference to a missing ID can't be processed: this is an error unless
+# the bad SignatureValue is found first
+execDSigStatusTest $res_fail \
+    "" \
+    "aleksey-xmldsig-01/enveloping-sha1-hmac-sha1-bad-sig-missing-id" \
+    "sha1 hmac-sha1" \
+    "hmac" \
+    "--hmackey $topfolder/keys/hmackey.bin" \
+    "ERROR" \
+    "0/1"
+
+execDSigStatusTest $res_fail \
+    "" \
+    "aleksey-xmldsig-01/enveloping-sha1-hmac-sha1-bad-sig-missing-id" \
+    "sha1 hmac-sha1" \
+    "hmac" \
+    "--hmackey $topfolder/keys/hmackey.bin --verify-signature-first" \
+    "FAIL" \
+    "0/0"
+
 ##########################################################################
 #
 # test dynamic signature
@@ -956,6 +1076,14 @@ execDSigTest $res_fail \
     "hmac" \
     "--enabled-reference-uris empty --hmackey $topfolder/keys/hmackey.bin --dtd-file $topfolder/aleksey-xmldsig-01/dtd-hmac-91.dtd" 
 
+# The reference to a missing ID must fail, not digest an empty nodes set
+execDSigTest $res_fail \
+    "" \
+    "aleksey-xmldsig-01/enveloping-sha1-hmac-sha1-missing-id" \
+    "sha1 hmac-sha1" \
+    "hmac" \
+    "--hmackey $topfolder/keys/hmackey.bin"
+
 execDSigTest $res_fail \
     "phaos-xmldsig-three" \
     "signature-rsa-detached-xslt-transform-bad-retrieval-method" \
@@ -53,6 +53,31 @@ execEncTest $res_success \
     "--keys-file $keysfile --binary-data $topfolder/aleksey-xmlenc-01/enc-aes128cbc-keyname.data" \
     "--keys-file $keysfile"
 
+execEncTest $res_success \
+    "" \
+    "aleksey-xmlenc-01/enc-aes128cbc-keyname-large" \
+    "aes128-cbc" \
+    "--keys-file $topfolder/keys/keys.xml" \
+    "--keys-file $keysfile --binary-data $topfolder/aleksey-xmlenc-01/enc-aes128cbc-keyname-large.data" \
+    "--keys-file $keysfile"
+
+execEncTest $res_success \
+    "" \
+    "aleksey-xmlenc-01/enc-aes128cbc-keyname-huge" \
+    "aes128-cbc" \
+    "--keys-file $topfolder/keys/keys.xml" \
+    "--keys-file $keysfile --binary-data $topfolder/aleksey-xmlenc-01/enc-aes128cbc-keyname-huge.data" \
+    "--keys-file $keysfile"
+
+# the data is encrypted into <enc:CipherValue/> in several chunks
+execEncTest $res_success \
+    "" \
+    "aleksey-xmlenc-01/enc-aes128cbc-keyname-huge" \
+    "aes128-cbc" \
+    "--keys-file $topfolder/keys/keys.xml" \
+    "--keys-file $keysfile --stream-cipher-value --binary-data $topfolder/aleksey-xmlenc-01/enc-aes128cbc-keyname-huge.data" \
+    "--keys-file $keysfile"
+
 execEncTest $res_success \
     "" \
     "aleksey-xmlenc-01/enc-aes192cbc-keyname" \
@@ -419,6 +444,61 @@ for aesgcm_k_l in $aesgcm_key_lengths ; do
 done
 
 
+##########################################################################
+#
+# shared keys and the keys store index (keys-same-name.xml has keys of
+# different klasses with the same name, the first matching key is used)
+#
+##########################################################################
+echo "--------- Shared keys and keys store index ----------"
+
+execEncTest $res_success \
+    "" \
+    "aleksey-xmlenc-01/enc-aes128cbc-keyname" \
+    "aes128-cbc" \
+    "--keys-file $topfolder/keys/keys.xml --shared-keys" \
+    "--keys-file $keysfile --shared-keys --binary-data $topfolder/aleksey-xmlenc-01/enc-aes128cbc-keyname.data" \
+    "--keys-file $keysfile --shared-keys"
+
+execEncTest $res_success \
+    "" \
+    "aleksey-xmlenc-01/enc-aes128cbc-keyname" \
+    "aes128-cbc" \
+    "--keys-file $topfolder/keys/keys-same-name.xml" \
+    "--keys-file $topfolder/keys/keys-same-name.xml --binary-data $topfolder/aleksey-xmlenc-01/enc-aes128cbc-keyname.data" \
+    "--keys-file $topfolder/keys/keys-same-name.xml"
+
+execEncTest $res_success \
+    "" \
+    "aleksey-xmlenc-01/enc-aes128cbc-keyname" \
+    "aes128-cbc" \
+    "--keys-file $topfolder/keys/keys-same-name.xml --shared-keys" \
+    "--keys-file $topfolder/keys/keys-same-name.xml --shared-keys --binary-data $topfolder/aleksey-xmlenc-01/enc-aes128cbc-keyname.data" \
+    "--keys-file $topfolder/keys/keys-same-name.xml --shared-keys"
+
+execEncTest $res_success \
+    "" \
+    "merlin-xmlenc-five/encrypt-data-aes256-cbc-kw-tripledes" \
+    "aes256-cbc kw-tripledes" \
+    "--keys-file $topfolder/keys/keys-same-name.xml --keys-file $topfolder/merlin-xmlenc-five/keys.xml --shared-keys" \
+    "--keys-file $topfolder/keys/keys-same-name.xml --keys-file $topfolder/merlin-xmlenc-five/keys.xml --shared-keys --session-key aes-256 --binary-data $topfolder/merlin-xmlenc-five/encrypt-data-aes256-cbc-kw-tripledes.data" \
+    "--keys-file $topfolder/keys/keys-same-name.xml --keys-file $topfolder/merlin-xmlenc-five/keys.xml --shared-keys"
+
+##########################################################################
+#
+# test encryption result with and without streaming into <enc:CipherValue/>
+#
+##########################################################################
+execEncTmplResultTest \
+    "--keys-file $keysfile" \
+    "" \
+    "yes"
+
+execEncTmplResultTest \
+    "--keys-file $keysfile" \
+    "--stream-cipher-value" \
+    "no"
+
 ##########################################################################
 #
 # test dynamicencryption
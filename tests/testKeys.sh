@@ -67,6 +67,77 @@ execKeysTest $res_success \
     "test-aes256   " \
     "aes-256 "
 
+##########################################################################
+#
+# Binary keys file: convert the keys file created above, check the keys,
+# sign and verify with the binary keys file
+#
+##########################################################################
+echo "--------- Binary keys file ----------"
+keysbinfile=$crypto_config/keys.bin
+static_keysbinfile=$crypto_config/keys-static.bin
+rm -f $keysbinfile $static_keysbinfile
+echo "$xmlsec_app keys-binary $xmlsec_params --keys-file $keysfile $keysbinfile" >> $logfile
+$xmlsec_app keys-binary $xmlsec_params --keys-file $keysfile $keysbinfile >> $logfile 2>> $logfile
+echo "$xmlsec_app keys-binary $xmlsec_params --keys-file $topfolder/keys/keys.xml $static_keysbinfile" >> $logfile
+$xmlsec_app keys-binary $xmlsec_params --keys-file $topfolder/keys/keys.xml $static_keysbinfile >> $logfile 2>> $logfile
+
+execKeysBinaryTest $res_success \
+    "keys.bin" \
+    "$keysbinfile" \
+    "7"
+
+execDSigTest $res_success \
+    "" \
+    "aleksey-xmldsig-01/enveloping-sha1-hmac-sha1" \
+    "sha1 hmac-sha1" \
+    "hmac" \
+    "--keys-file $static_keysbinfile" \
+    "--keys-file $keysbinfile" \
+    "--keys-file $keysfile"
+
+##########################################################################
+##########################################################################
+##########################################################################
+echo "--------- Negative Testing: Following tests MUST FAIL ----------"
+
+# truncated file
+head -c 100 $keysbinfile > $keysbinfile.bad
+execKeysBinaryTest $res_fail \
+    "truncated" \
+    "$keysbinfile.bad"
+
+# corrupted keys table (file checksum mismatch)
+cp -f $keysbinfile $keysbinfile.bad
+printf 'X' | dd of=$keysbinfile.bad bs=1 seek=200 conv=notrunc 2> /dev/null
+execKeysBinaryTest $res_fail \
+    "corrupted" \
+    "$keysbinfile.bad"
+
+# corrupted last key data (key checksum mismatch when the key is read)
+cp -f $keysbinfile $keysbinfile.bad
+keysbinsize=`wc -c < $keysbinfile.bad`
+printf 'X' | dd of=$keysbinfile.bad bs=1 seek=`expr $keysbinsize - 1` conv=notrunc 2> /dev/null
+execKeysBinaryTest $res_fail \
+    "corrupted-key" \
+    "$keysbinfile.bad"
+
+# wrong magic (not detected as a binary keys file)
+cp -f $keysbinfile $keysbinfile.bad
+printf 'XMLSECKZ' | dd of=$keysbinfile.bad bs=1 seek=0 conv=notrunc 2> /dev/null
+execKeysBinaryTest $res_fail \
+    "wrong-magic" \
+    "$keysbinfile.bad"
+
+# unsupported version
+cp -f $keysbinfile $keysbinfile.bad
+printf '\000\000\000\002' | dd of=$keysbinfile.bad bs=1 seek=8 conv=notrunc 2> /dev/null
+execKeysBinaryTest $res_fail \
+    "wrong-version" \
+    "$keysbinfile.bad"
+
+rm -f $keysbinfile.bad
+
 ##########################################################################
 ##########################################################################
 ##########################################################################
@@ -236,6 +236,70 @@ execKeysTest() {
     rm -f $tmpfile
 }
 
+#
+# Binary keys file test: loads the binary keys file and converts it to
+# an XML keys file; if expected_count is set then checks the number of
+# keys and converts the XML keys file back to the same binary keys file
+#
+execKeysBinaryTest() {
+    expected_res="$1"
+    test_name="$2"
+    bin_file="$3"
+    expected_count="$4"
+    failures=0
+
+    if [ -n "$XMLSEC_TEST_NAME" -a "$XMLSEC_TEST_NAME" != "$test_name" ]; then
+        return
+    fi
+
+    # prepare
+    rm -f $tmpfile $tmpfile.2
+
+    # starting test
+    echo "Test: binary keys file $test_name ($expected_res)"
+    echo "Test: binary keys file $test_name ($expected_res)" > $curlogfile
+
+    # run tests
+    printf "    Load binary keys file                                 "
+    echo "$VALGRIND $xmlsec_app keys $xmlsec_params --keys-file $bin_file $tmpfile" >> $curlogfile
+    $VALGRIND $xmlsec_app keys $xmlsec_params --keys-file $bin_file $tmpfile >> $curlogfile 2>> $curlogfile
+    res=$?
+    echo "=== TEST RESULT: $res; expected: $expected_res" >> $curlogfile
+    printRes $expected_res $res
+    if [ $? != 0 ]; then
+        failures=`expr $failures + 1`
+    fi
+
+    if [ $res = 0 -a -n "$expected_count" ] ; then
+        printf "    %-54s" "Check keys count $expected_count"
+        count=`grep -c '<KeyInfo' $tmpfile`
+        echo "=== KEYS COUNT: $count; expected: $expected_count" >> $curlogfile
+        test "z$count" = "z$expected_count"
+        printRes $res_success $?
+        if [ $? != 0 ]; then
+            failures=`expr $failures + 1`
+        fi
+
+        printf "    Round trip to binary keys file                        "
+        echo "$VALGRIND $xmlsec_app keys-binary $xmlsec_params --keys-file $tmpfile $tmpfile.2" >> $curlogfile
+        $VALGRIND $xmlsec_app keys-binary $xmlsec_params --keys-file $tmpfile $tmpfile.2 >> $curlogfile 2>> $curlogfile && \
+            cmp $bin_file $tmpfile.2 >> $curlogfile 2>> $curlogfile
+        printRes $res_success $?
+        if [ $? != 0 ]; then
+            failures=`expr $failures + 1`
+        fi
+    fi
+
+    # save logs
+    cat $curlogfile >> $logfile
+    if [ $failures != 0 ] ; then
+        cat $curlogfile >> $failedlogfile
+    fi
+
+    # cleanup
+    rm -f $tmpfile $tmpfile.2
+}
+
 #
 # DSig test function
 #
@@ -347,6 +411,199 @@ execDSigTest() {
     rm -f $tmpfile
 }
 
+#
+# DSig verification with additional options: the status, the references
+# and the stored pre-digest data must be the same as without these options
+#
+execDSigCompareTest() {
+    expected_res="$1"
+    folder="$2"
+    filename="$3"
+    req_transforms="$4"
+    req_key_data="$5"
+    params="$6"
+    compare_params="$7"
+    failures=0
+
+    if [ -n "$XMLSEC_TEST_NAME" -a "$XMLSEC_TEST_NAME" != "$filename" ]; then
+        return
+    fi
+
+    # prepare
+    rm -f $tmpfile $tmpfile.2
+    old_pwd=`pwd`
+
+    # starting test
+    if [ -n "$folder" ] ; then
+        cd $topfolder/$folder
+        full_file=$filename
+        echo $folder/$filename
+        echo "Test: $folder/$filename in folder " `pwd` " ($expected_res)" > $curlogfile
+    else
+        full_file=$topfolder/$filename
+        echo $filename
+        echo "Test: $folder/$filename ($expected_res)" > $curlogfile
+    fi
+
+    # check transforms
+    if [ -n "$req_transforms" ] ; then
+        printf "    Checking required transforms                         "
+        echo "$xmlsec_app check-transforms $xmlsec_params $req_transforms" >> $curlogfile
+        $xmlsec_app check-transforms $xmlsec_params $req_transforms >> $curlogfile 2>> $curlogfile
+        printCheckStatus $?
+        res=$?
+        if [ $res != 0 ]; then
+            cat $curlogfile >> $logfile
+            cd $old_pwd
+            return
+        fi
+    fi
+
+    # check key data
+    if [ -n "$req_key_data" ] ; then
+        printf "    Checking required key data                           "
+        echo "$xmlsec_app check-key-data $xmlsec_params $req_key_data" >> $curlogfile
+        $xmlsec_app check-key-data $xmlsec_params $req_key_data >> $curlogfile 2>> $curlogfile
+        printCheckStatus $?
+        res=$?
+        if [ $res != 0 ]; then
+            cat $curlogfile >> $logfile
+            cd $old_pwd
+            return
+        fi
+    fi
+
+    # run tests
+    printf "    Verify existing signature                            "
+    echo "$VALGRIND $xmlsec_app verify $xmlsec_params --store-references --print-debug $params $full_file.xml" >> $curlogfile
+    $VALGRIND $xmlsec_app verify $xmlsec_params --store-references --print-debug $params $full_file.xml > $tmpfile 2>> $curlogfile
+    printRes $expected_res $?
+    if [ $? != 0 ]; then
+        failures=`expr $failures + 1`
+    fi
+
+    printf "    Verify existing signature with %-22s" "$compare_params"
+    echo "$VALGRIND $xmlsec_app verify $xmlsec_params --store-references --print-debug $params $compare_params $full_file.xml" >> $curlogfile
+    $VALGRIND $xmlsec_app verify $xmlsec_params --store-references --print-debug $params $compare_params $full_file.xml > $tmpfile.2 2>> $curlogfile
+    res=$?
+    if [ "z$expected_res" = "z$res_success" -a $res != 0 ] || [ "z$expected_res" = "z$res_fail" -a $res = 0 ] ; then
+        printRes $expected_res $res
+    else
+        # the flags are expected to be different
+        grep -v '^== flags' $tmpfile > $tmpfile.3
+        grep -v '^== flags' $tmpfile.2 > $tmpfile.4
+        diff $tmpfile.3 $tmpfile.4 >> $curlogfile 2>> $curlogfile
+        printRes $res_success $?
+    fi
+    if [ $? != 0 ]; then
+        failures=`expr $failures + 1`
+    fi
+
+    # save logs
+    cat $curlogfile >> $logfile
+    if [ $failures != 0 ] ; then
+        cat $curlogfile >> $failedlogfile
+    fi
+
+    # cleanup
+    cd $old_pwd
+    rm -f $tmpfile $tmpfile.2 $tmpfile.3 $tmpfile.4
+}
+
+#
+# DSig verification that checks the reported status and the number of
+# the processed <dsig:SignedInfo/> references (e.g. "FAIL" and "0/0")
+#
+execDSigStatusTest() {
+    expected_res="$1"
+    folder="$2"
+    filename="$3"
+    req_transforms="$4"
+    req_key_data="$5"
+    params="$6"
+    expected_status="$7"
+    expected_refs="$8"
+    failures=0
+
+    if [ -n "$XMLSEC_TEST_NAME" -a "$XMLSEC_TEST_NAME" != "$filename" ]; then
+        return
+    fi
+
+    # prepare
+    rm -f $tmpfile
+    old_pwd=`pwd`
+
+    # starting test
+    if [ -n "$folder" ] ; then
+        cd $topfolder/$folder
+        full_file=$filename
+        echo $folder/$filename
+        echo "Test: $folder/$filename in folder " `pwd` " ($expected_res)" > $curlogfile
+    else
+        full_file=$topfolder/$filename
+        echo $filename
+        echo "Test: $folder/$filename ($expected_res)" > $curlogfile
+    fi
+
+    # check transforms
+    if [ -n "$req_transforms" ] ; then
+        printf "    Checking required transforms                         "
+        echo "$xmlsec_app check-transforms $xmlsec_params $req_transforms" >> $curlogfile
+        $xmlsec_app check-transforms $xmlsec_params $req_transforms >> $curlogfile 2>> $curlogfile
+        printCheckStatus $?
+        res=$?
+        if [ $res != 0 ]; then
+            cat $curlogfile >> $logfile
+            cd $old_pwd
+            return
+        fi
+    fi
+
+    # check key data
+    if [ -n "$req_key_data" ] ; then
+        printf "    Checking required key data                           "
+        echo "$xmlsec_app check-key-data $xmlsec_params $req_key_data" >> $curlogfile
+        $xmlsec_app check-key-data $xmlsec_params $req_key_data >> $curlogfile 2>> $curlogfile
+        printCheckStatus $?
+        res=$?
+        if [ $res != 0 ]; then
+            cat $curlogfile >> $logfile
+            cd $old_pwd
+            return
+        fi
+    fi
+
+    # run tests
+    printf "    Verify existing signature                            "
+    echo "$VALGRIND $xmlsec_app verify $xmlsec_params $params $full_file.xml" >> $curlogfile
+    $VALGRIND $xmlsec_app verify $xmlsec_params $params $full_file.xml > /dev/null 2> $tmpfile
+    res=$?
+    cat $tmpfile >> $curlogfile
+    printRes $expected_res $res
+    if [ $? != 0 ]; then
+        failures=`expr $failures + 1`
+    fi
+
+    printf "    %-53s" "Check status $expected_status and references $expected_refs"
+    echo "=== EXPECTED STATUS: $expected_status; references: $expected_refs" >> $curlogfile
+    grep -x "$expected_status" $tmpfile > /dev/null && \
+        grep -x "SignedInfo References (ok/all): $expected_refs" $tmpfile > /dev/null
+    printRes $res_success $?
+    if [ $? != 0 ]; then
+        failures=`expr $failures + 1`
+    fi
+
+    # save logs
+    cat $curlogfile >> $logfile
+    if [ $failures != 0 ] ; then
+        cat $curlogfile >> $failedlogfile
+    fi
+
+    # cleanup
+    cd $old_pwd
+    rm -f $tmpfile
+}
+
 #
 # Enc test function
 #
@@ -468,6 +725,76 @@ execEncTest() {
     rm -f $tmpfile $tmpfile.2 
 }
 
+#
+# Encrypts the dynamically created template (encrypt-tmpl command) and checks
+# the encryption context result buffer (printed with --print-debug) against
+# the <enc:CipherValue/> node content: if expected_result is "yes" then both
+# must match, otherwise the result buffer must be empty (--stream-cipher-value)
+#
+execEncTmplResultTest() {
+    keys_params="$1"
+    enc_params="$2"
+    expected_result="$3"
+    failures=0
+
+    if [ -n "$XMLSEC_TEST_NAME" -a "$XMLSEC_TEST_NAME" != "enc-tmpl-result" ]; then
+        return
+    fi
+
+    # prepare
+    rm -f $tmpfile $tmpfile.2 $tmpfile.3
+    echo "Encryption template (result buffer: $expected_result)"
+    echo "Test: encryption template result ($enc_params; result: $expected_result)" > $curlogfile
+
+    # run tests
+    printf "    Encrypt template                                     "
+    echo "$VALGRIND $xmlsec_app encrypt-tmpl $xmlsec_params $keys_params $enc_params --print-debug --output $tmpfile" >> $curlogfile
+    $VALGRIND $xmlsec_app encrypt-tmpl $xmlsec_params $keys_params $enc_params --print-debug --output $tmpfile > $tmpfile.2 2>> $curlogfile
+    printRes $res_success $?
+    if [ $? != 0 ]; then
+        failures=`expr $failures + 1`
+    fi
+
+    printf "    %-53s" "Check result buffer ($expected_result)"
+    sed -n '/^== Result - start buffer:$/,/^== Result - end buffer$/p' $tmpfile.2 | \
+        grep -v '^== Result - ' | tr -d ' \r\n' > $tmpfile.3
+    if [ "z$expected_result" = "zyes" ] ; then
+        tr -d ' \r\n' < $tmpfile | \
+            sed -n 's/.*<CipherValue>\([^<]*\)<\/CipherValue>.*/\1/p' > $tmpfile.2
+        test -s $tmpfile.3 && cmp -s $tmpfile.2 $tmpfile.3
+    else
+        test ! -s $tmpfile.3
+    fi
+    res=$?
+    echo "=== RESULT CHECK: $res; expected result: $expected_result" >> $curlogfile
+    printRes $res_success $res
+    if [ $? != 0 ]; then
+        failures=`expr $failures + 1`
+    fi
+
+    printf "    Decrypt document                                     "
+    echo "$VALGRIND $xmlsec_app decrypt $xmlsec_params $keys_params --output $tmpfile.2 $tmpfile" >> $curlogfile
+    $VALGRIND $xmlsec_app decrypt $xmlsec_params $keys_params --output $tmpfile.2 $tmpfile >> $curlogfile 2>> $curlogfile
+    res=$?
+    if [ $res = 0 ]; then
+        printf "Hello, World!" | cmp -s - $tmpfile.2
+        res=$?
+    fi
+    printRes $res_success $res
+    if [ $? != 0 ]; then
+        failures=`expr $failures + 1`
+    fi
+
+    # save logs
+    cat $curlogfile >> $logfile
+    if [ $failures != 0 ] ; then
+        cat $curlogfile >> $failedlogfile
+    fi
+
+    # cleanup
+    rm -f $tmpfile $tmpfile.2 $tmpfile.3
+}
+
 # prepare
 rm -rf $tmpfile $tmpfile.2 tmpfile.3
 